@@ -0,0 +1,17 @@
+#version 330
+
+// Input vertex attributes (from vertex shader)
+in vec4 fragColor;
+in vec3 fragNormal;
+
+// Output fragment color
+out vec4 finalColor;
+
+// Corner directions interpolate to a sphere's normals, lit from a fixed light
+const vec3 light = normalize(vec3(0.3, 1.0, 0.6));
+
+void main()
+{
+    float shade = 0.55 + 0.45 * max(dot(normalize(fragNormal), light), 0.0);
+    finalColor = vec4(fragColor.rgb * shade, fragColor.a);
+}
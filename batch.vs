@@ -0,0 +1,31 @@
+#version 330
+
+// Input vertex attributes
+in vec3 vertexPosition;       // neuron center
+in vec3 vertexNormal;         // corner of a unit octahedron around it
+in vec2 vertexTexCoord;       // x: neuron index, y: radius scale of its layer
+in vec4 vertexColor;          // color of its layer
+in mat4 instanceTransform;    // where the replica sits in the grid
+
+// Input uniform values
+uniform mat4 mvp;
+uniform sampler2D texture0;   // activations, R32F, rowsPerReplica rows per replica
+uniform int rowsPerReplica;
+
+// Output vertex attributes (to fragment shader)
+out vec4 fragColor;
+out vec3 fragNormal;
+
+void main()
+{
+    // Replica gl_InstanceID's activations start at row gl_InstanceID * rowsPerReplica
+    int neuron = int(vertexTexCoord.x);
+    int width = textureSize(texture0, 0).x;
+    float act = texelFetch(texture0, ivec2(neuron % width, gl_InstanceID * rowsPerReplica + neuron / width), 0).r;
+
+    // Radius and opacity as DrawNN3D draws a neuron
+    float radius = (0.2 + act * 0.3) * vertexTexCoord.y;
+    fragColor = vec4(vertexColor.rgb, act > 0.1 ? 0.5 + act * 0.5 : 0.2);
+    fragNormal = vertexNormal;
+    gl_Position = mvp * instanceTransform * vec4(vertexPosition + vertexNormal * radius, 1.0);
+}
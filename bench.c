@@ -0,0 +1,1617 @@
+// Micro-benchmarks for the plugin's compute kernels. Built by nob as ./bench,
+// no window or raylib needed.
+//
+//     ./bench            run everything
+//     ./bench kernels    dense layer kernels only
+//     ./bench training   mini-batch training throughput per thread count
+//     ./bench neurons    per-frame neuron animation passes, AoS vs SoA
+//     ./bench model      model file save, mmap load and eager read
+//     ./bench checkpoint background checkpoint cost on the training thread
+//     ./bench int8       int8 kernels, quantized accuracy and throughput vs float
+//     ./bench conv       convolution layers through im2col + GEMM vs direct loops
+//     ./bench optim      fused optimizer updates, bytes/s against memory bandwidth
+//     ./bench autodiff   tape-recorded backward pass vs the hand-written one
+//     ./bench record     run log appends, packing ratio and replay seeks
+//     ./bench ingest     metrics socket throughput and the renderer's drain cost
+//     ./bench plot       loss plot appends and per-frame queries, 1k to 10M samples
+//     ./bench heatmap    dirty-tile scans and upload volume for a 4096x4096 weight heatmap
+//     ./bench histogram  histogram binning per instruction set and the per-frame feed cost
+//     ./bench pick       background BVH build and ray picks over 1M neuron spheres
+//     ./bench cull       per-frame frustum classification of 1M neurons, grid cells vs every point
+//
+// Theoretical peak assumes two vector pipes per core, each retiring one FMA
+// per cycle, and without FMA two multiplies and two adds per cycle, which
+// cores with separate adders (Golden Cove, Zen) reach. The clock is the fastest of many
+// short chains of dependent adds on x86, since preemption only slows one
+// down; set CONA_CPU_GHZ to override it or on other
+// architectures. The scalar variant is built without auto-vectorization on
+// x86, so it is a true one-lane baseline.
+#define _POSIX_C_SOURCE 199309L
+#include <math.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+    #include <x86intrin.h>
+#endif
+
+#include "checkpoint.h"
+#include "heatmap.h"
+#include "histogram.h"
+#include "bvh.h"
+#include "cull.h"
+#include "digits.h"
+#include "ingest.h"
+#include "kernels.h"
+#include "model.h"
+#include "optim.h"
+#include "tape.h"
+#include "parallel.h"
+#include "plot.h"
+#include "quant.h"
+#include "record.h"
+#include "trainer.h"
+
+#define BENCH_MIN_SECONDS 0.2
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static double cpu_ghz(void) {
+    const char *env = getenv("CONA_CPU_GHZ");
+    if (env) return atof(env);
+#if defined(__x86_64__) || defined(__i386__)
+    // Dependent adds retire one per cycle at the clock the core actually
+    // runs, turbo included, where the TSC ticks at the nominal one. The
+    // addend is a register: newer cores fold chains of immediate adds.
+    // Preemption and a hypervisor's steal only ever make a window look
+    // slower, so the fastest of many short ones is the clock.
+    unsigned long long x = 0, one = 1;
+    double best = 0.0;
+    for (int w = 0; w < 100; w++) {
+        double t0 = now_seconds();
+        for (int i = 0; i < 250000; i++) {
+            __asm__ volatile("add %1, %0\n\tadd %1, %0\n\tadd %1, %0\n\tadd %1, %0" : "+r"(x) : "r"(one));
+        }
+        double rate = 1e6 / (now_seconds() - t0);
+        best = rate > best ? rate : best;
+    }
+    return best * 1e-9;
+#else
+    return 0.0;
+#endif
+}
+
+// Flops per cycle a variant can retire at most, as the note at the top
+// counts them: two FMA pipes of two flops per lane, or two multiply and
+// two add pipes of one
+static double peak_flops_per_cycle(const Kernels *k) {
+    return k->fma ? k->lanes * 2.0 * 2.0 : k->lanes * (2.0 + 2.0);
+}
+
+static float *alloc_random(size_t n, unsigned int seed) {
+    float *v = malloc(sizeof(float) * n);
+    if (!v) {
+        fprintf(stderr, "ERROR: out of memory\n");
+        exit(1);
+    }
+    for (size_t i = 0; i < n; i++) {
+        seed = seed * 1664525u + 1013904223u;
+        v[i] = (float)(seed >> 8) / 16777216.0f - 0.5f;
+    }
+    return v;
+}
+
+static float max_abs_diff(const float *a, const float *b, size_t n) {
+    float m = 0.0f;
+    for (size_t i = 0; i < n; i++) m = fmaxf(m, fabsf(a[i] - b[i]));
+    return m;
+}
+
+// ------------------------------------------------------------
+// Dense layer kernels
+// ------------------------------------------------------------
+
+typedef enum { OP_FORWARD, OP_BACKWARD_DATA, OP_WEIGHT_GRAD } DenseOp;
+
+static const char *op_names[] = { "forward", "backward_data", "weight_grad" };
+
+static void run_op(const Kernels *k, DenseOp op, const float *X, const float *W, const float *b,
+                   const float *D, float *Y, float *dX, float *gW, float *gb, int batch, int in, int out) {
+    switch (op) {
+        case OP_FORWARD:       k->dense_forward(X, W, b, Y, batch, in, out); break;
+        case OP_BACKWARD_DATA: k->dense_backward_data(D, W, dX, batch, in, out); break;
+        case OP_WEIGHT_GRAD:   k->dense_weight_grad(D, X, gW, gb, batch, in, out); break;
+    }
+}
+
+static void bench_kernels(void) {
+    static const struct { int batch, in, out; } shapes[] = {
+        { 1,   64,   16 },    // the demo network's first layer
+        { 1,   1024, 1024 },  // GEMV
+        { 128, 1024, 1024 },  // GEMM
+    };
+
+    double ghz = cpu_ghz();
+    printf("== dense kernels (active: %s, clock %.2f GHz) ==\n", kernels->name, ghz);
+    printf("%-8s %-14s %-16s %10s %10s %8s %10s\n", "isa", "op", "shape", "GFLOP/s", "peak", "%peak", "max|err|");
+
+    for (size_t s = 0; s < sizeof(shapes)/sizeof(shapes[0]); s++) {
+        int batch = shapes[s].batch, in = shapes[s].in, out = shapes[s].out;
+        float *X = alloc_random((size_t)batch * in, 1);
+        float *W = alloc_random((size_t)out * in, 2);
+        float *b = alloc_random(out, 3);
+        float *D = alloc_random((size_t)batch * out, 4);
+        float *Y = calloc((size_t)batch * out, sizeof(float));
+        float *dX = calloc((size_t)batch * in, sizeof(float));
+        float *gW = calloc((size_t)out * in, sizeof(float));
+        float *gb = calloc(out, sizeof(float));
+        float *ref = malloc(sizeof(float) * (size_t)out * in);
+        float *gw_ref = calloc((size_t)out * in, sizeof(float));
+        float *gb_ref = calloc(out, sizeof(float));
+        if (!Y || !dX || !gW || !gb || !ref || !gw_ref || !gb_ref) {
+            fprintf(stderr, "ERROR: out of memory\n");
+            exit(1);
+        }
+        double flops = 2.0 * batch * in * out;
+        char shape[32];
+        snprintf(shape, sizeof(shape), "%dx%dx%d", batch, in, out);
+
+        for (int op = 0; op < 3; op++) {
+            // Scalar reference for the error column
+            const Kernels *scalar = kernels_get(KERNEL_SCALAR);
+            size_t n_out = op == OP_FORWARD ? (size_t)batch * out : op == OP_BACKWARD_DATA ? (size_t)batch * in : (size_t)out * in;
+            memset(gw_ref, 0, sizeof(float) * (size_t)out * in);
+            run_op(scalar, op, X, W, b, D, ref, ref, gw_ref, gb_ref, batch, in, out);
+            if (op == OP_WEIGHT_GRAD) memcpy(ref, gw_ref, sizeof(float) * n_out);
+
+            for (int isa = 0; isa < KERNEL_ISA_COUNT; isa++) {
+                const Kernels *k = kernels_get((KernelIsa)isa);
+                if (!k) continue;
+
+                memset(gW, 0, sizeof(float) * (size_t)out * in);
+                run_op(k, op, X, W, b, D, Y, dX, gW, gb, batch, in, out);
+                const float *got = op == OP_FORWARD ? Y : op == OP_BACKWARD_DATA ? dX : gW;
+                float err = max_abs_diff(got, ref, n_out);
+
+                long iters = 0;
+                double t0 = now_seconds(), t1;
+                do {
+                    run_op(k, op, X, W, b, D, Y, dX, gW, gb, batch, in, out);
+                    iters++;
+                    t1 = now_seconds();
+                } while (t1 - t0 < BENCH_MIN_SECONDS);
+
+                double gflops = flops * iters / (t1 - t0) * 1e-9;
+                double peak = ghz * peak_flops_per_cycle(k);
+                if (peak > 0.0) {
+                    printf("%-8s %-14s %-16s %10.2f %10.1f %7.1f%% %10.2e\n",
+                           k->name, op_names[op], shape, gflops, peak, 100.0 * gflops / peak, err);
+                } else {
+                    printf("%-8s %-14s %-16s %10.2f %10s %8s %10.2e\n",
+                           k->name, op_names[op], shape, gflops, "?", "?", err);
+                }
+            }
+        }
+
+        free(X); free(W); free(b); free(D); free(Y); free(dX);
+        free(gW); free(gb); free(ref); free(gw_ref); free(gb_ref);
+    }
+}
+
+// ------------------------------------------------------------
+// Neuron animation passes
+// ------------------------------------------------------------
+
+// The renderer's old per-neuron record and its per-layer scalar loops, kept
+// here as the baseline for the struct-of-arrays layout in plug.c.
+typedef struct {
+    float position[3];
+    float activation;
+    float target;
+    float error;
+} AosNeuron;
+
+static inline float lerp_scalar(float a, float b, float t) {
+    return a + t * (b - a);
+}
+
+static void aos_frame(AosNeuron **layers, const int *counts, int layer_count, float dt) {
+    // Decay pass (input state), then the propagate pass
+    for (int i = 1; i < layer_count; i++) {
+        for (int j = 0; j < counts[i]; j++) {
+            layers[i][j].activation = lerp_scalar(layers[i][j].activation, 0.0f, dt * 5.0f);
+            layers[i][j].error = 0.0f;
+        }
+    }
+    for (int i = 1; i < layer_count; i++) {
+        for (int j = 0; j < counts[i]; j++) {
+            layers[i][j].activation = lerp_scalar(layers[i][j].activation, layers[i][j].target, dt * 10.0f);
+        }
+    }
+}
+
+static void soa_frame(const Kernels *k, float *activation, const float *target, float *error, int begin, int n, float dt) {
+    k->lerp(activation + begin, NULL, dt * 5.0f, n - begin);
+    memset(error + begin, 0, sizeof(float) * (n - begin));
+    k->lerp(activation + begin, target + begin, dt * 10.0f, n - begin);
+}
+
+static void bench_neurons(void) {
+    static const struct { int layers, width; } shapes[] = {
+        { 4,   25000 },
+        { 32,  3125 },
+        { 100, 1000 },
+    };
+    const float dt = 1.0f / 60.0f;
+
+    printf("== neuron animation passes (decay + error clear + lerp per frame) ==\n");
+    printf("%-10s %-12s %12s %12s %10s\n", "layout", "shape", "us/frame", "Gneuron/s", "speedup");
+
+    for (size_t s = 0; s < sizeof(shapes)/sizeof(shapes[0]); s++) {
+        int L = shapes[s].layers, width = shapes[s].width;
+        int n = L * width;
+        char shape[32];
+        snprintf(shape, sizeof(shape), "%dx%d", L, width);
+
+        int *counts = malloc(sizeof(int) * L);
+        AosNeuron **aos = malloc(sizeof(AosNeuron *) * L);
+        float *activation = kernels_alloc(sizeof(float) * n);
+        float *target = alloc_random(n, 5);
+        float *error = kernels_alloc(sizeof(float) * n);
+        if (!counts || !aos || !activation || !error) {
+            fprintf(stderr, "ERROR: out of memory\n");
+            exit(1);
+        }
+        for (int i = 0; i < L; i++) {
+            counts[i] = width;
+            aos[i] = calloc(width, sizeof(AosNeuron));
+            if (!aos[i]) {
+                fprintf(stderr, "ERROR: out of memory\n");
+                exit(1);
+            }
+            for (int j = 0; j < width; j++) aos[i][j].target = target[i * width + j];
+        }
+
+        long iters = 0;
+        double t0 = now_seconds(), t1;
+        do {
+            aos_frame(aos, counts, L, dt);
+            iters++;
+            t1 = now_seconds();
+        } while (t1 - t0 < BENCH_MIN_SECONDS);
+        double base = (t1 - t0) / iters;
+        printf("%-10s %-12s %12.1f %12.2f %9.2fx\n", "aos", shape, base * 1e6, (n - width) / base * 1e-9, 1.0);
+
+        for (int isa = 0; isa < KERNEL_ISA_COUNT; isa++) {
+            const Kernels *k = kernels_get((KernelIsa)isa);
+            if (!k) continue;
+            iters = 0;
+            t0 = now_seconds();
+            do {
+                soa_frame(k, activation, target, error, width, n, dt);
+                iters++;
+                t1 = now_seconds();
+            } while (t1 - t0 < BENCH_MIN_SECONDS);
+            double per = (t1 - t0) / iters;
+            char layout[32];
+            snprintf(layout, sizeof(layout), "soa/%s", k->name);
+            printf("%-10s %-12s %12.1f %12.2f %9.2fx\n", layout, shape, per * 1e6, (n - width) / per * 1e-9, base / per);
+        }
+
+        for (int i = 0; i < L; i++) free(aos[i]);
+        free(aos); free(counts); free(target);
+        kernels_free(activation); kernels_free(error);
+    }
+}
+
+// ------------------------------------------------------------
+// Model files
+// ------------------------------------------------------------
+
+#define BENCH_MODEL_PATH "bench_model.bin"
+#define BENCH_CHECKPOINTS 4
+
+// About 192 MB of weights
+static const int model_sizes[] = { 4096, 4096, 4096, 4096, 10 };
+
+static void bench_model(void) {
+    const int *sizes = model_sizes;
+    int layers = sizeof(model_sizes)/sizeof(model_sizes[0]);
+
+    Mlp nn;
+    if (!nn_init(&nn, sizes, layers, 1)) {
+        fprintf(stderr, "ERROR: out of memory\n");
+        exit(1);
+    }
+    double t0 = now_seconds();
+    bool saved = model_save(&nn, BENCH_MODEL_PATH);
+    double t_save = now_seconds() - t0;
+    nn_free(&nn);
+    if (!saved) return;
+
+    uint64_t size = 0;
+    stat_file(BENCH_MODEL_PATH, &size, NULL);
+    double mb = size / 1048576.0;
+    printf("== model file (%.1f MB, page cache warm) ==\n", mb);
+    printf("%-28s %10.2f ms %10.0f MB/s\n", "save (write + rename)", t_save * 1e3, mb / t_save);
+
+    // Zero-copy: map and point the layers into the mapping
+    ModelFile m;
+    t0 = now_seconds();
+    bool ok = model_open(&m, BENCH_MODEL_PATH) && model_bind(&m, &nn);
+    double t_open = now_seconds() - t0;
+    if (ok) {
+        printf("%-28s %10.3f ms\n", "mmap open + bind", t_open * 1e3);
+        float *x = calloc(sizes[0], sizeof(float));
+        t0 = now_seconds();
+        if (x) nn_forward(&nn, x);
+        printf("%-28s %10.2f ms\n", "first forward (pages in)", (now_seconds() - t0) * 1e3);
+        free(x);
+        nn_free(&nn);
+        model_close(&m);
+    }
+
+    // Eager: read the whole file into memory, what a copying loader would do
+    t0 = now_seconds();
+    FILE *f = fopen(BENCH_MODEL_PATH, "rb");
+    void *buf = malloc(size);
+    if (f && buf) {
+        size_t got = fread(buf, 1, size, f);
+        double t_read = now_seconds() - t0;
+        if (got == size) printf("%-28s %10.2f ms %10.0f MB/s\n", "eager fread", t_read * 1e3, mb / t_read);
+    }
+    if (f) fclose(f);
+    free(buf);
+    remove(BENCH_MODEL_PATH);
+}
+
+// What training pays per checkpoint (the copy into a file image) against
+// what the I/O thread spends writing and syncing it, and against saving
+// synchronously on the training thread.
+static void bench_checkpoint(void) {
+    int layers = sizeof(model_sizes)/sizeof(model_sizes[0]);
+    Mlp nn;
+    Checkpointer c;
+    if (!nn_init(&nn, model_sizes, layers, 1) || !checkpoint_init(&c, &nn, BENCH_MODEL_PATH)
+        || !checkpoint_start(&c)) {
+        fprintf(stderr, "ERROR: could not set up checkpoints\n");
+        exit(1);
+    }
+    double mb = c.size / 1048576.0;
+    printf("== checkpoint (%.1f MB, %s) ==\n", mb, c.backend);
+
+    double copy = 0.0, write = 0.0;
+    for (int i = 0; i < BENCH_CHECKPOINTS; i++) {
+        long long saved = atomic_load(&c.saved);
+        checkpoint_capture(&c, &nn);
+        copy += atomic_load(&c.copy_ns) * 1e-9;
+        // One at a time, so every write is timed on its own
+        while (atomic_load(&c.saved) == saved && atomic_load(&c.failed) == 0) {
+            nanosleep(&(struct timespec){ .tv_nsec = 1000000 }, NULL);
+        }
+        write += atomic_load(&c.write_ns) * 1e-9;
+    }
+    copy /= BENCH_CHECKPOINTS;
+    write /= BENCH_CHECKPOINTS;
+    checkpoint_free(&c);
+    printf("%-28s %10.2f ms %10.0f MB/s\n", "capture (training thread)", copy * 1e3, mb / copy);
+    printf("%-28s %10.2f ms %10.0f MB/s\n", "write + fsync + rename", write * 1e3, mb / write);
+
+    double t0 = now_seconds();
+    model_save(&nn, BENCH_MODEL_PATH);
+    double t_save = now_seconds() - t0;
+    printf("%-28s %10.2f ms %10.0f MB/s\n", "model_save (synchronous)", t_save * 1e3, mb / t_save);
+    printf("training stalls %.1fx less than saving in place\n", t_save / copy);
+    nn_free(&nn);
+    remove(BENCH_MODEL_PATH);
+}
+
+// ------------------------------------------------------------
+// Mini-batch training
+// ------------------------------------------------------------
+
+// Random inputs with a label derived from them, so there is something to
+// learn and the work per sample matches real training.
+static void bench_sample_fn(void *user, NnRng *rng, float *input, int *label) {
+    int n = *(const int *)user;
+    for (int i = 0; i < n; i++) input[i] = nn_rng_float(rng);
+    *label = nn_argmax(input, 10);
+}
+
+static void bench_training(void) {
+    static const int sizes[] = { 784, 256, 128, 10 };
+    static const int batch = 256;
+    int layers = sizeof(sizes)/sizeof(sizes[0]);
+    int cpus = parallel_cpu_count();
+
+    printf("== mini-batch training (%d-%d-%d-%d, batch %d, %s, %d CPUs) ==\n",
+           sizes[0], sizes[1], sizes[2], sizes[3], batch, kernels->name, cpus);
+    printf("%8s %6s %14s %10s %12s\n", "threads", "tasks", "samples/s", "speedup", "efficiency");
+
+    double base = 0.0;
+    for (int threads = 1; threads <= cpus && threads <= 64; threads *= 2) {
+        Trainer t;
+        if (!trainer_init(&t, sizes, layers, 0.05f, batch, threads, 1)) {
+            fprintf(stderr, "ERROR: out of memory\n");
+            exit(1);
+        }
+        t.sample_fn = bench_sample_fn;
+        t.sample_user = (void *)&sizes[0];
+
+        trainer_step(&t, false); // spins up the pool, faults in the buffers
+        long iters = 0;
+        double t0 = now_seconds(), t1;
+        do {
+            trainer_step(&t, false);
+            iters++;
+            t1 = now_seconds();
+        } while (t1 - t0 < BENCH_MIN_SECONDS * 5);
+
+        double rate = (double)iters * batch / (t1 - t0);
+        if (threads == 1) base = rate;
+        printf("%8d %6d %14.0f %9.2fx %11.0f%%\n", threads, t.task_count, rate, rate / base, 100.0 * rate / base / threads);
+        trainer_free(&t);
+    }
+}
+
+// ------------------------------------------------------------
+// Int8 inference
+// ------------------------------------------------------------
+
+#define BENCH_INT8_TRAIN_STEPS 300
+#define BENCH_INT8_EVAL 8192
+#define BENCH_INT8_FLIP 0.2f   // extra pixels inverted, so accuracy stays off 100%
+
+// FONT_DIGITS glyphs on the square input with heavy speckle: a task the
+// network learns, but not perfectly, so accuracy lost to int8 shows
+static void bench_glyph_fn(void *user, NnRng *rng, float *input, int *label) {
+    int n = *(const int *)user, side = (int)sqrtf((float)n);
+    *label = (int)(nn_rng_next(rng) % 10);
+    make_digit_sample(*label, rng, input, side, side);
+    for (int i = 0; i < n; i++) {
+        if (nn_rng_float(rng) < BENCH_INT8_FLIP) input[i] = 1.0f - input[i];
+    }
+}
+
+static void bench_int8_kernels(void) {
+    static const int batch = 256, in = 1024, out = 1024;
+    uint8_t *X = kernels_alloc((size_t)batch * in);
+    int8_t *W = kernels_alloc((size_t)out * in);
+    int32_t *Y = kernels_alloc(sizeof(int32_t) * (size_t)batch * out);
+    int32_t *ref = kernels_alloc(sizeof(int32_t) * (size_t)batch * out);
+    if (!X || !W || !Y || !ref) {
+        fprintf(stderr, "ERROR: out of memory\n");
+        exit(1);
+    }
+    NnRng rng = { 7 };
+    for (size_t i = 0; i < (size_t)batch * in; i++) X[i] = (uint8_t)nn_rng_next(&rng);
+    for (size_t i = 0; i < (size_t)out * in; i++) W[i] = (int8_t)(nn_rng_next(&rng) % 255 - 127);
+    int8_kernels_get(KERNEL_INT8_SCALAR)->dense_forward(X, W, ref, batch, in, out);
+
+    printf("== int8 kernels (active: %s, %dx%dx%d) ==\n", int8_kernels->name, batch, in, out);
+    printf("%-12s %12s %10s %12s\n", "isa", "GOP/s", "speedup", "mismatches");
+    double ops = 2.0 * batch * in * out, base = 0.0;
+    for (int isa = 0; isa < KERNEL_INT8_ISA_COUNT; isa++) {
+        const Int8Kernels *k = int8_kernels_get((KernelInt8Isa)isa);
+        if (!k) continue;
+        k->dense_forward(X, W, Y, batch, in, out);
+        long mismatches = 0;
+        for (size_t i = 0; i < (size_t)batch * out; i++) mismatches += Y[i] != ref[i];
+
+        long iters = 0;
+        double t0 = now_seconds(), t1;
+        do {
+            k->dense_forward(X, W, Y, batch, in, out);
+            iters++;
+            t1 = now_seconds();
+        } while (t1 - t0 < BENCH_MIN_SECONDS);
+        double gops = ops * iters / (t1 - t0) * 1e-9;
+        if (base == 0.0) base = gops;
+        printf("%-12s %12.2f %9.2fx %12ld\n", k->name, gops, gops / base, mismatches);
+    }
+    kernels_free(X); kernels_free(W); kernels_free(Y); kernels_free(ref);
+}
+
+// Samples/s of a whole forward pass, activation quantization included
+static double forward_rate(const Mlp *nn, const QuantMlp *q, QuantScratch *qs, NnWorkspace *ws) {
+    long iters = 0;
+    double t0 = now_seconds(), t1;
+    do {
+        if (q) quant_forward_batch(q, qs, ws);
+        else nn_forward_batch(nn, ws);
+        iters++;
+        t1 = now_seconds();
+    } while (t1 - t0 < BENCH_MIN_SECONDS);
+    return (double)iters * ws->rows / (t1 - t0);
+}
+
+static void bench_int8(void) {
+    bench_int8_kernels();
+
+    static const int batch = 256;
+    static const struct { int sizes[4]; bool train; } nets[] = {
+        { { 784, 256, 128, 10 }, true },
+        { { 1024, 1024, 1024, 10 }, false },
+    };
+    printf("== int8 vs float inference (batch %d, %s / %s) ==\n", batch, kernels->name, int8_kernels->name);
+    printf("%-18s %9s %9s %9s %10s %14s %14s %8s\n",
+           "network", "acc f32", "acc int8", "agree", "max|dp|", "f32 samples/s", "int8 samples/s", "weights");
+
+    for (size_t n = 0; n < sizeof(nets)/sizeof(nets[0]); n++) {
+        const int *sizes = nets[n].sizes;
+        Trainer t;
+        if (!trainer_init(&t, sizes, 4, 0.05f, batch, 1, 1)) {
+            fprintf(stderr, "ERROR: out of memory\n");
+            exit(1);
+        }
+        t.sample_fn = bench_glyph_fn;
+        t.sample_user = (void *)&sizes[0];
+        // Accuracy only means something for a trained network; the wide
+        // one is there for throughput
+        for (int i = 0; nets[n].train && i < BENCH_INT8_TRAIN_STEPS; i++) trainer_step(&t, false);
+
+        QuantMlp q;
+        QuantScratch qs;
+        NnWorkspace wf, wq;
+        if (!quant_init(&q, &t.mlp) || !quant_scratch_init(&qs, &q, batch)
+            || !nn_workspace_init(&wf, &t.mlp, batch, 9) || !nn_workspace_init(&wq, &t.mlp, batch, 9)) {
+            fprintf(stderr, "ERROR: out of memory\n");
+            exit(1);
+        }
+
+        // Same held-out samples through both paths
+        NnRng rng = { 12345 };
+        int correct_f = 0, correct_q = 0, agree = 0, classes = sizes[3];
+        float max_dp = 0.0f;
+        for (int done = 0; done < BENCH_INT8_EVAL; done += batch) {
+            wf.rows = wq.rows = batch;
+            for (int r = 0; r < batch; r++) {
+                bench_glyph_fn((void *)&sizes[0], &rng, wf.act[0] + (size_t)r * sizes[0], &wf.labels[r]);
+            }
+            memcpy(wq.act[0], wf.act[0], sizeof(float) * batch * sizes[0]);
+            nn_forward_batch(&t.mlp, &wf);
+            quant_forward_batch(&q, &qs, &wq);
+            for (int r = 0; r < batch; r++) {
+                const float *pf = wf.act[3] + (size_t)r * classes;
+                const float *pq = wq.act[3] + (size_t)r * classes;
+                int af = nn_argmax(pf, classes), aq = nn_argmax(pq, classes);
+                correct_f += af == wf.labels[r];
+                correct_q += aq == wf.labels[r];
+                agree += af == aq;
+                for (int c = 0; c < classes; c++) max_dp = fmaxf(max_dp, fabsf(pf[c] - pq[c]));
+            }
+        }
+
+        double rate_f = forward_rate(&t.mlp, NULL, NULL, &wf);
+        double rate_q = forward_rate(&t.mlp, &q, &qs, &wq);
+        char name[32];
+        snprintf(name, sizeof(name), "%d-%d-%d-%d", sizes[0], sizes[1], sizes[2], sizes[3]);
+        double weights_f = 0.0;
+        for (int l = 0; l < 3; l++) weights_f += (double)sizes[l] * sizes[l + 1] * sizeof(float);
+        char acc_f[16], acc_q[16];
+        snprintf(acc_f, sizeof(acc_f), nets[n].train ? "%.2f%%" : "-", 100.0 * correct_f / BENCH_INT8_EVAL);
+        snprintf(acc_q, sizeof(acc_q), nets[n].train ? "%.2f%%" : "-", 100.0 * correct_q / BENCH_INT8_EVAL);
+        printf("%-18s %9s %9s %8.2f%% %10.4f %14.0f %14.0f %7.2fx\n", name, acc_f, acc_q,
+               100.0 * agree / BENCH_INT8_EVAL, max_dp, rate_f, rate_q, weights_f / q.weight_bytes);
+
+        nn_workspace_free(&wf, &t.mlp);
+        nn_workspace_free(&wq, &t.mlp);
+        quant_scratch_free(&qs);
+        quant_free(&q);
+        trainer_free(&t);
+    }
+    printf("(speedup is int8 over float samples/s; weights is the float/int8 size ratio)\n");
+}
+
+// ------------------------------------------------------------
+// Convolutions
+// ------------------------------------------------------------
+
+// Straightforward six-deep loop over the same [h][w][c] layout, what the
+// layer would be without im2col
+static void conv_direct(const NnDense *d, const float *x, float *y, int rows) {
+    for (int r = 0; r < rows; r++) {
+        const float *xs = x + (size_t)r * d->in;
+        float *ys = y + (size_t)r * d->out;
+        for (int oy = 0; oy < d->dst.h; oy++) {
+            for (int ox = 0; ox < d->dst.w; ox++) {
+                for (int o = 0; o < d->dst.c; o++) {
+                    float acc = d->b[o];
+                    for (int ky = 0; ky < d->k; ky++) {
+                        int iy = oy + ky - d->pad;
+                        if (iy < 0 || iy >= d->src.h) continue;
+                        for (int kx = 0; kx < d->k; kx++) {
+                            int ix = ox + kx - d->pad;
+                            if (ix < 0 || ix >= d->src.w) continue;
+                            const float *w = d->w + ((size_t)(o * d->k + ky) * d->k + kx) * d->src.c;
+                            const float *v = xs + ((size_t)iy * d->src.w + ix) * d->src.c;
+                            for (int i = 0; i < d->src.c; i++) acc += w[i] * v[i];
+                        }
+                    }
+                    ys[((size_t)oy * d->dst.w + ox) * d->dst.c + o] = acc;
+                }
+            }
+        }
+    }
+}
+
+static double conv_rate(const NnDense *d, const float *x, float *y, int rows, float *col, bool direct) {
+    long iters = 0;
+    double t0 = now_seconds(), t1;
+    do {
+        if (direct) conv_direct(d, x, y, rows);
+        else nn_layer_forward(d, x, y, rows, col, NULL);
+        iters++;
+        t1 = now_seconds();
+    } while (t1 - t0 < BENCH_MIN_SECONDS);
+    return 2.0 * rows * d->dst.h * d->dst.w * d->rows * d->cols * iters / (t1 - t0) * 1e-9;
+}
+
+static void bench_conv(void) {
+    static const int batch = 64;
+    static const NnLayerSpec layers[] = {
+        { .kind = NN_CONV, .size = 16, .k = 3, .pad = 1 }, { .kind = NN_MAXPOOL, .k = 2, .stride = 2 },
+        { .kind = NN_CONV, .size = 32, .k = 3, .pad = 1 }, { .kind = NN_MAXPOOL, .k = 2, .stride = 2 },
+        { .kind = NN_DENSE, .size = 128 }, { .kind = NN_DENSE, .size = 10 },
+    };
+    int count = sizeof(layers)/sizeof(layers[0]);
+    Mlp nn;
+    NnWorkspace ws;
+    if (!nn_init_layers(&nn, (NnShape){ 1, 28, 28 }, layers, count, 1) || !nn_workspace_init(&ws, &nn, batch, 2)) {
+        fprintf(stderr, "ERROR: out of memory\n");
+        exit(1);
+    }
+    ws.rows = batch;
+    int in = nn.sizes[0];
+    for (int r = 0; r < batch; r++) bench_sample_fn(&in, &ws.rng, ws.act[0] + (size_t)r * in, &ws.labels[r]);
+    nn_forward_batch(&nn, &ws); // inputs of every layer
+
+    printf("== convolution layers (28x28 input, batch %d, %s) ==\n", batch, kernels->name);
+    printf("%-22s %13s %13s %9s %10s\n", "layer", "im2col GF/s", "direct GF/s", "speedup", "max|dy|");
+    for (int l = 0; l < count; l++) {
+        const NnDense *d = &nn.dense[l];
+        if (d->kind != NN_CONV) continue;
+        float *y0 = malloc(sizeof(float) * batch * d->out);
+        float *y1 = malloc(sizeof(float) * batch * d->out);
+        if (!y0 || !y1) {
+            fprintf(stderr, "ERROR: out of memory\n");
+            exit(1);
+        }
+        double gemm = conv_rate(d, ws.act[l], y0, batch, ws.col, false);
+        double direct = conv_rate(d, ws.act[l], y1, batch, NULL, true);
+        float max_dy = 0.0f;
+        for (size_t i = 0; i < (size_t)batch * d->out; i++) max_dy = fmaxf(max_dy, fabsf(y0[i] - y1[i]));
+        char name[32];
+        snprintf(name, sizeof(name), "%dx%dx%d k%d -> %d", d->src.h, d->src.w, d->src.c, d->k, d->dst.c);
+        printf("%-22s %13.2f %13.2f %8.2fx %10.2g\n", name, gemm, direct, gemm / direct, max_dy);
+        free(y0);
+        free(y1);
+    }
+
+    // Whole network, pooling and dense layers included
+    long iters = 0;
+    double t0 = now_seconds(), t1;
+    do {
+        nn_forward_batch(&nn, &ws);
+        nn_backward_batch(&nn, &ws);
+        iters++;
+        t1 = now_seconds();
+    } while (t1 - t0 < BENCH_MIN_SECONDS * 5);
+    printf("%-22s %13.0f samples/s (forward + backward, 1 thread)\n", "network", (double)iters * batch / (t1 - t0));
+
+    nn_workspace_free(&ws, &nn);
+    nn_free(&nn);
+}
+
+// ------------------------------------------------------------
+// Optimizers
+// ------------------------------------------------------------
+
+// Big enough that weights, gradients and state stream from DRAM
+static const int optim_sizes[] = { 2048, 4096, 10 };
+
+typedef struct {
+    const Kernels *k;
+    float *x;
+    const float *target;  // NULL scales x in place
+    size_t n;
+} Stream;
+
+static void stream_task(void *ctx, int task, int worker) {
+    (void)worker;
+    Stream *t = ctx;
+    size_t begin = (size_t)task * OPTIM_SLICE;
+    size_t end = begin + OPTIM_SLICE < t->n ? begin + OPTIM_SLICE : t->n;
+    t->k->lerp(t->x + begin, t->target ? t->target + begin : NULL, 1e-7f, (int)(end - begin));
+}
+
+// Most timings a median is taken over
+#define BENCH_OPTIM_TIMINGS 4096
+
+static int compare_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// Sorts the timings
+static double median_seconds(double *times, int count) {
+    qsort(times, count, sizeof(double), compare_double);
+    return count % 2 ? times[count / 2] : 0.5 * (times[count / 2 - 1] + times[count / 2]);
+}
+
+static double stream_pass(ThreadPool *pool, Stream *t) {
+    int tasks = (int)((t->n + OPTIM_SLICE - 1) / OPTIM_SLICE);
+    pool_run(pool, tasks, stream_task, t);
+    double times[BENCH_OPTIM_TIMINGS], t0 = now_seconds(), t1 = t0;
+    int count = 0;
+    do {
+        double start = t1;
+        pool_run(pool, tasks, stream_task, t);
+        t1 = now_seconds();
+        times[count++] = t1 - start;
+    } while (t1 - t0 < BENCH_MIN_SECONDS && count < BENCH_OPTIM_TIMINGS);
+    return (t->target ? 3.0 : 2.0) * sizeof(float) * t->n / median_seconds(times, count);
+}
+
+// Attainable bandwidth over the first n floats of x: the faster of a triad
+// x += (target - x) t and a scale x *= 1 - t, both through a kernel table's
+// lerp so they are vectorized like the optimizers, in place like their
+// weights and state, and split the same way. The median pass counts, as it
+// does for the optimizers.
+static double stream_bandwidth(ThreadPool *pool, const Kernels *k, float *x, size_t n) {
+    Stream t = { k, x, NULL, n };
+    double scale = stream_pass(pool, &t);
+    t.n = n / 2;
+    t.target = t.x + t.n;
+    double triad = stream_pass(pool, &t);
+    return triad > scale ? triad : scale;
+}
+
+static void bench_optim(void) {
+    int layers = sizeof(optim_sizes)/sizeof(optim_sizes[0]);
+    int cpus = parallel_cpu_count();
+    ThreadPool *pool = cpus > 1 ? pool_create(cpus) : NULL;
+
+    Mlp nn;
+    if (!nn_init(&nn, optim_sizes, layers, 1)) {
+        fprintf(stderr, "ERROR: out of memory\n");
+        exit(1);
+    }
+    float *gw[2], *gb[2];
+    size_t params = 0;
+    for (int l = 0; l < layers - 1; l++) {
+        gw[l] = alloc_random(nn_weight_count(&nn.dense[l]), 10 + l);
+        gb[l] = alloc_random(nn.dense[l].rows, 20 + l);
+        params += nn_weight_count(&nn.dense[l]) + nn.dense[l].rows;
+    }
+    // Bandwidth falls as the footprint outgrows the caches, so there is a
+    // reference per footprint: weights and gradients, plus none, one or two
+    // state arrays. All come from one buffer, measured once before the rows
+    // on pages that are already resident.
+    float *x = alloc_random(params * 4, 1);
+    double stream[5] = { 0 };
+    for (int arrays = 2; arrays <= 4; arrays++) stream[arrays] = stream_bandwidth(pool, kernels, x, params * arrays);
+    free(x);
+
+    printf("== fused optimizers (%.1fM parameters, %d threads, stream with %s) ==\n",
+           params / 1e6, cpus, kernels->name);
+    printf("%-8s %-10s %10s %10s %10s %8s %12s\n", "isa", "optimizer", "ms/update", "GB/s", "stream GB/s", "%stream",
+           "bytes/param");
+    const Kernels *active = kernels;
+    for (int isa = 0; isa < KERNEL_ISA_COUNT; isa++) {
+        const Kernels *k = kernels_get((KernelIsa)isa);
+        if (!k) continue;
+        kernels = k;
+        for (int kind = 0; kind < OPTIM_COUNT; kind++) {
+            OptimParams op;
+            optim_defaults(&op, (OptimKind)kind);
+            Optimizer o;
+            if (!optim_init(&o, &nn, gw, gb, &op)) {
+                fprintf(stderr, "ERROR: out of memory\n");
+                exit(1);
+            }
+            optim_step(&o, pool, 1e-6f, 1.0f); // faults in the state
+            double times[BENCH_OPTIM_TIMINGS], t0 = now_seconds(), t1 = t0;
+            int count = 0;
+            do {
+                double start = t1;
+                optim_step(&o, pool, 1e-6f, 1.0f);
+                t1 = now_seconds();
+                times[count++] = t1 - start;
+            } while (t1 - t0 < BENCH_MIN_SECONDS && count < BENCH_OPTIM_TIMINGS);
+            double per = median_seconds(times, count);
+            double rate = o.bytes_per_update / per;
+
+            int arrays = 2 + (o.state[0] != NULL) + (o.state[1] != NULL);
+            printf("%-8s %-10s %10.2f %10.1f %10.1f %7.0f%% %12zu\n", k->name, optim_name((OptimKind)kind),
+                   per * 1e3, rate * 1e-9, stream[arrays] * 1e-9, 100.0 * rate / stream[arrays],
+                   o.bytes_per_update / o.param_count);
+            optim_free(&o);
+        }
+    }
+    kernels = active;
+
+    for (int l = 0; l < layers - 1; l++) {
+        free(gw[l]);
+        free(gb[l]);
+    }
+    nn_free(&nn);
+    pool_destroy(pool);
+}
+
+// ------------------------------------------------------------
+// Autodiff
+// ------------------------------------------------------------
+
+// Samples per second of one forward + backward over the workspace, by hand
+// or through `tape`
+static double backward_rate(const Mlp *nn, NnWorkspace *ws, Tape *tape) {
+    long iters = 0;
+    double t0 = now_seconds(), t1;
+    do {
+        if (tape) {
+            tape_reset(tape);
+            memset(ws->grad, 0, sizeof(float) * ws->grad_size);
+            TapeNode *loss = tape_record_mlp(tape, nn, ws->act[0], ws->rows, ws->labels, ws->gw, ws->gb, NULL);
+            if (!loss || !tape_backward(tape, loss)) {
+                fprintf(stderr, "ERROR: out of memory\n");
+                exit(1);
+            }
+        } else {
+            nn_forward_batch(nn, ws);
+            nn_backward_batch(nn, ws);
+        }
+        iters++;
+        t1 = now_seconds();
+    } while (t1 - t0 < BENCH_MIN_SECONDS);
+    return (double)iters * ws->rows / (t1 - t0);
+}
+
+static void bench_autodiff_net(const char *name, NnShape input, const NnLayerSpec *layers, int count, int batch) {
+    Mlp nn;
+    NnWorkspace ws;
+    Tape tape;
+    if (!nn_init_layers(&nn, input, layers, count, 1) || !nn_workspace_init(&ws, &nn, batch, 2) ||
+        !tape_init(&tape, 64 << 10)) {
+        fprintf(stderr, "ERROR: out of memory\n");
+        exit(1);
+    }
+    ws.rows = batch;
+    int in = nn.sizes[0];
+    for (int r = 0; r < batch; r++) bench_sample_fn(&in, &ws.rng, ws.act[0] + (size_t)r * in, &ws.labels[r]);
+
+    nn_forward_batch(&nn, &ws);
+    nn_backward_batch(&nn, &ws);
+    float *ref = malloc(sizeof(float) * ws.grad_size);
+    if (!ref) {
+        fprintf(stderr, "ERROR: out of memory\n");
+        exit(1);
+    }
+    memcpy(ref, ws.grad, sizeof(float) * ws.grad_size);
+
+    // The first recording grows the arena, every later one fits in it
+    double hand = backward_rate(&nn, &ws, NULL);
+    double taped = backward_rate(&nn, &ws, &tape);
+    long long grows = tape.arena.grows;
+    taped = backward_rate(&nn, &ws, &tape);
+    printf("%-18s %12.0f %12.0f %8.1f%% %10.2e %6d %9.0f %6lld\n", name, hand, taped,
+           100.0 * (hand / taped - 1.0), max_abs_diff(ref, ws.grad, ws.grad_size), tape.count,
+           tape.arena.peak / 1024.0, tape.arena.grows - grows);
+
+    free(ref);
+    tape_free(&tape);
+    nn_workspace_free(&ws, &nn);
+    nn_free(&nn);
+}
+
+static void bench_autodiff(void) {
+    static const int batch = 64;
+    static const NnLayerSpec dense[] = {
+        { .kind = NN_DENSE, .size = 256 }, { .kind = NN_DENSE, .size = 128 }, { .kind = NN_DENSE, .size = 10 },
+    };
+    static const NnLayerSpec conv[] = {
+        { .kind = NN_CONV, .size = 16, .k = 3, .pad = 1 }, { .kind = NN_MAXPOOL, .k = 2, .stride = 2 },
+        { .kind = NN_DENSE, .size = 64 }, { .kind = NN_DENSE, .size = 10 },
+    };
+    printf("== autodiff tape vs hand-written backward (batch %d, %s) ==\n", batch, kernels->name);
+    printf("%-18s %12s %12s %9s %10s %6s %9s %6s\n", "network", "hand smp/s", "tape smp/s", "overhead",
+           "max|dgrad|", "nodes", "arena KB", "grows");
+    bench_autodiff_net("784-256-128-10", (NnShape){ 784, 1, 1 }, dense, 3, batch);
+    bench_autodiff_net("conv16-pool-64-10", (NnShape){ 1, 28, 28 }, conv, 4, batch);
+}
+
+// ------------------------------------------------------------
+// Run log
+// ------------------------------------------------------------
+
+#define BENCH_RECORD_PATH "bench_run.log"
+#define BENCH_RECORD_FRAMES (20 * RECORD_CHUNK_FRAMES)
+#define BENCH_RECORD_SEEKS 1000
+
+static double snapshot_checksum(const TrainSnapshot *s, int neurons) {
+    double sum = 0.0;
+    for (int i = 0; i < neurons; i++) sum += s->act[i] + 2.0 * s->err[i];
+    return sum;
+}
+
+// Mostly blank inputs like the digit glyphs, so the frames have the zeros
+// real ones have
+static void bench_digit_fn(void *user, NnRng *rng, float *input, int *label) {
+    int n = *(const int *)user;
+    for (int i = 0; i < n; i++) input[i] = nn_rng_next(rng) % 5 == 0 ? nn_rng_float(rng) : 0.0f;
+    *label = nn_argmax(input, 10);
+}
+
+static void bench_record(void) {
+    static const int sizes[] = { 784, 256, 128, 10 };
+    int layers = sizeof(sizes)/sizeof(sizes[0]);
+    Trainer t;
+    Recorder r;
+    if (!trainer_init(&t, sizes, layers, 0.05f, 64, 1, 1)) {
+        fprintf(stderr, "ERROR: out of memory\n");
+        exit(1);
+    }
+    t.sample_fn = bench_digit_fn;
+    t.sample_user = (void *)&sizes[0];
+    if (!record_init(&r, &t, BENCH_RECORD_PATH) || !record_start(&r)) {
+        fprintf(stderr, "ERROR: could not set up the run log\n");
+        exit(1);
+    }
+    printf("== run log (%d-%d-%d-%d, %d frames of %zu bytes, %d per chunk) ==\n",
+           sizes[0], sizes[1], sizes[2], sizes[3], BENCH_RECORD_FRAMES, r.frame_bytes, RECORD_CHUNK_FRAMES);
+
+    // A frame per step, as the renderer would append at time scale 1
+    long long *steps = malloc(sizeof(long long) * BENCH_RECORD_FRAMES);
+    double *sums = malloc(sizeof(double) * BENCH_RECORD_FRAMES);
+    double append = 0.0, append_max = 0.0;
+    for (int f = 0; f < BENCH_RECORD_FRAMES; f++) {
+        trainer_step(&t, true);
+        const TrainSnapshot *s = trainer_snapshot(&t);
+        steps[f] = s->step;
+        sums[f] = snapshot_checksum(s, t.neuron_count);
+        double t0 = now_seconds();
+        record_append(&r, s, f * 0.01);
+        double dt = now_seconds() - t0;
+        append += dt;
+        if (dt > append_max) append_max = dt;
+    }
+    record_stop(&r);
+    long long dropped = atomic_load(&r.dropped), raw = atomic_load(&r.raw_bytes);
+    double pack = atomic_load(&r.pack_ns) * 1e-6;
+    double t0 = now_seconds();
+    record_close(&r);
+    double t_close = now_seconds() - t0;
+    trainer_free(&t);
+
+    Replay rp;
+    t0 = now_seconds();
+    if (!replay_open(&rp, BENCH_RECORD_PATH)) exit(1);
+    double t_open = now_seconds() - t0;
+    printf("%-28s %10.2f us  max %.2f us  %lld dropped\n", "append (renderer)",
+           append / BENCH_RECORD_FRAMES * 1e6, append_max * 1e6, dropped);
+    printf("%-28s %10.2f ms per chunk (last)\n", "pack + write (I/O thread)", pack);
+    printf("%-28s %10.2f ms\n", "close (index)", t_close * 1e3);
+    printf("%-28s %10.1f MB -> %.1f MB  %.2fx\n", "size", raw / 1048576.0, rp.file.size / 1048576.0,
+           (double)raw / rp.file.size);
+    printf("%-28s %10.2f ms  %zu chunks\n", "open (map, index)", t_open * 1e3, rp.chunk_count);
+
+    // Every frame in order, then seeks to random steps
+    TrainSnapshot s;
+    bool ok = rp.frame_count == BENCH_RECORD_FRAMES;
+    t0 = now_seconds();
+    for (long long f = 0; ok && f < rp.frame_count; f++) {
+        ok = replay_read(&rp, f, &s, NULL) && s.step == steps[f]
+          && snapshot_checksum(&s, (int)rp.header.neuron_count) == sums[f];
+    }
+    double t_seq = now_seconds() - t0;
+    printf("%-28s %10.2f us per frame  %s\n", "sequential read", t_seq / BENCH_RECORD_FRAMES * 1e6,
+           ok ? "all frames match" : "MISMATCH");
+
+    NnRng rng = { 7 };
+    double seek = 0.0, seek_max = 0.0;
+    for (int i = 0; i < BENCH_RECORD_SEEKS; i++) {
+        int f = (int)(nn_rng_next(&rng) % BENCH_RECORD_FRAMES);
+        t0 = now_seconds();
+        long long found = replay_find_step(&rp, steps[f]);
+        replay_read(&rp, found, &s, NULL);
+        double dt = now_seconds() - t0;
+        ok = ok && found == f && s.step == steps[f];
+        seek += dt;
+        if (dt > seek_max) seek_max = dt;
+    }
+    printf("%-28s %10.2f us  max %.2f us  last chunk decode %.2f us  %s\n", "random seek + read",
+           seek / BENCH_RECORD_SEEKS * 1e6, seek_max * 1e6, rp.decode_ns * 1e-3, ok ? "ok" : "MISMATCH");
+    replay_close(&rp);
+    free(steps);
+    free(sums);
+    remove(BENCH_RECORD_PATH);
+}
+
+// ------------------------------------------------------------
+// Metrics socket
+// ------------------------------------------------------------
+
+#define BENCH_INGEST_PATH "bench_ingest.sock"
+#define BENCH_INGEST_SECONDS 1.0
+#define BENCH_INGEST_BATCH 4096
+#define BENCH_INGEST_METRICS 8
+
+typedef struct {
+    _Atomic bool stop;
+    double rate;          // samples/s, 0 = as fast as the socket takes them
+    long long sent;
+    bool failed;
+} IngestClient;
+
+// A producer writing batches of samples, paced or flat out
+static void *ingest_client_main(void *arg) {
+    IngestClient *c = arg;
+    int fd = ingest_connect(BENCH_INGEST_PATH);
+    c->failed = fd < 0;
+    for (int m = 0; fd >= 0 && m < BENCH_INGEST_METRICS; m++) {
+        ingest_send_name(fd, (uint32_t)m, m == 0 ? "loss" : "metric");
+    }
+    IngestSample batch[BENCH_INGEST_BATCH];
+    long long step = 0;
+    double t0 = now_seconds();
+    while (fd >= 0 && !atomic_load(&c->stop)) {
+        for (int i = 0; i < BENCH_INGEST_BATCH; i++) {
+            batch[i] = (IngestSample){ .step = step, .metric = (uint32_t)(i % BENCH_INGEST_METRICS), .value = 1.0f / (step + 1) };
+            if (i % BENCH_INGEST_METRICS == BENCH_INGEST_METRICS - 1) step++;
+        }
+        if (!ingest_send_samples(fd, batch, BENCH_INGEST_BATCH)) {
+            c->failed = true;
+            break;
+        }
+        c->sent += BENCH_INGEST_BATCH;
+        double ahead = c->rate > 0.0 ? c->sent / c->rate - (now_seconds() - t0) : 0.0;
+        if (ahead > 0.0) nanosleep(&(struct timespec){ .tv_nsec = (long)(ahead * 1e9) }, NULL);
+    }
+    ingest_disconnect(fd);
+    return NULL;
+}
+
+static volatile float ingest_sink; // keeps the drain loop from being optimized out
+
+static void bench_ingest_run(Ingest *in, double rate) {
+    long long received0 = atomic_load(&in->samples), dropped0 = atomic_load(&in->dropped);
+    IngestClient client = { .rate = rate };
+    pthread_t thread;
+    pthread_create(&thread, NULL, ingest_client_main, &client);
+
+    // The renderer's share: drain what had arrived by the frame, in at most
+    // two peeks and INGEST_DRAIN_MAX samples, and fold it into per-metric
+    // state, as the HUD does
+    float last[INGEST_MAX_METRICS] = { 0 };
+    long long drained = 0, frames = 0;
+    double drain = 0.0, drain_max = 0.0;
+    double t0 = now_seconds(), t;
+    while ((t = now_seconds()) - t0 < BENCH_INGEST_SECONDS) {
+        double d0 = now_seconds();
+        const IngestSample *s;
+        size_t n, budget = INGEST_DRAIN_MAX;
+        for (int peek = 0; peek < 2 && budget > 0 && (n = ingest_peek(in, &s)) > 0; peek++) {
+            if (n > budget) n = budget;
+            budget -= n;
+            for (size_t i = 0; i < n; i++) last[s[i].metric % INGEST_MAX_METRICS] += s[i].value;
+            ingest_consume(in, n);
+            drained += (long long)n;
+        }
+        double d = now_seconds() - d0;
+        drain += d;
+        if (d > drain_max) drain_max = d;
+        frames++;
+        nanosleep(&(struct timespec){ .tv_nsec = 16666667 }, NULL);
+    }
+    atomic_store(&client.stop, true);
+    pthread_join(thread, NULL);
+    double elapsed = t - t0;
+    char label[32];
+    snprintf(label, sizeof(label), rate > 0.0 ? "%.0fM/s offered" : "flat out", rate * 1e-6);
+    printf("%-14s %12.2f %12.2f %10lld %12.1f %10.1f\n", label,
+           (atomic_load(&in->samples) - received0) / elapsed * 1e-6, drained / elapsed * 1e-6,
+           atomic_load(&in->dropped) - dropped0, drain / frames * 1e6, drain_max * 1e6);
+    ingest_sink = last[0];
+    if (client.failed) printf("client failed to send\n");
+}
+
+static void bench_ingest(void) {
+    Ingest in;
+    if (!ingest_init(&in, BENCH_INGEST_PATH) || !ingest_start(&in)) {
+        fprintf(stderr, "ERROR: could not set up the metrics socket\n");
+        return;
+    }
+    printf("== metrics socket (batches of %d samples, renderer draining at 60 Hz) ==\n", BENCH_INGEST_BATCH);
+    printf("%-14s %12s %12s %10s %12s %10s\n", "producer", "recv M/s", "drained M/s", "dropped",
+           "drain us/fr", "max us");
+    bench_ingest_run(&in, 1e6);
+    bench_ingest_run(&in, 10e6);
+    bench_ingest_run(&in, 0.0);
+    ingest_free(&in);
+}
+
+// ------------------------------------------------------------
+// Plots
+// ------------------------------------------------------------
+
+#define BENCH_PLOT_COLUMNS 1000
+#define BENCH_PLOT_CHECKS 200
+
+// A decaying loss with batch noise and the odd spike
+static float bench_loss(NnRng *rng, size_t i) {
+    float noise = nn_rng_float(rng) - 0.5f;
+    return 2.3f / (1.0f + i * 1e-5f) + 0.3f * noise + (nn_rng_next(rng) % 10000 == 0 ? 5.0f : 0.0f);
+}
+
+static void bench_plot(void) {
+    static const size_t counts[] = { 1000, 100000, 10000000 };
+    static PlotRange columns[BENCH_PLOT_COLUMNS];
+    printf("== plots (min/max pyramid, %d columns) ==\n", BENCH_PLOT_COLUMNS);
+    printf("%-10s %12s %10s %14s %14s %8s\n", "samples", "append ns", "MB", "whole run us", "random zoom us",
+           "check");
+    for (size_t k = 0; k < sizeof(counts)/sizeof(counts[0]); k++) {
+        size_t n = counts[k];
+        float *raw = malloc(sizeof(float) * n);
+        PlotSeries s;
+        plot_init(&s);
+        NnRng rng = { 11 };
+        for (size_t i = 0; i < n; i++) raw[i] = bench_loss(&rng, i);
+        double t0 = now_seconds();
+        for (size_t i = 0; i < n; i++) {
+            if (!plot_append(&s, (long long)i + 1, raw[i])) {
+                fprintf(stderr, "ERROR: out of memory\n");
+                exit(1);
+            }
+        }
+        double append = (now_seconds() - t0) / n;
+
+        int reps = 0;
+        t0 = now_seconds();
+        double elapsed;
+        do {
+            plot_columns(&s, 0, n, BENCH_PLOT_COLUMNS, columns);
+            reps++;
+        } while ((elapsed = now_seconds() - t0) < BENCH_MIN_SECONDS);
+        double whole = elapsed / reps;
+
+        // Windows of every width. Rounding moves a column's edges by less
+        // than a column, and never past its first sample.
+        bool ok = true;
+        double zoom = 0.0;
+        for (int q = 0; q < BENCH_PLOT_CHECKS; q++) {
+            size_t span = 1 + nn_rng_next(&rng) % n;
+            size_t first = nn_rng_next(&rng) % (n - span + 1);
+            t0 = now_seconds();
+            int m = plot_columns(&s, first, first + span, BENCH_PLOT_COLUMNS, columns);
+            zoom += now_seconds() - t0;
+            int c = (int)(nn_rng_next(&rng) % m);
+            size_t a = m < BENCH_PLOT_COLUMNS ? first + c : first + (size_t)((double)span * c / m);
+            size_t b = m < BENCH_PLOT_COLUMNS ? a + 1 : first + (size_t)((double)span * (c + 1) / m);
+            size_t slack = b - a;
+            PlotRange wide = { INFINITY, -INFINITY };
+            for (size_t i = a >= slack ? a - slack : 0; i < b + slack && i < n; i++) {
+                wide.min = fminf(wide.min, raw[i]);
+                wide.max = fmaxf(wide.max, raw[i]);
+            }
+            ok = ok && columns[c].min >= wide.min && columns[c].max <= wide.max
+                    && columns[c].min <= raw[a] && columns[c].max >= raw[a];
+        }
+        printf("%-10zu %12.1f %10.1f %14.1f %14.1f %8s\n", n, append * 1e9, plot_bytes(&s) / 1048576.0,
+               whole * 1e6, zoom / BENCH_PLOT_CHECKS * 1e6, ok ? "ok" : "MISMATCH");
+        plot_free(&s);
+        free(raw);
+    }
+}
+
+// ------------------------------------------------------------
+// Heatmaps
+// ------------------------------------------------------------
+
+#define BENCH_HEATMAP_SIDE 4096
+#define BENCH_HEATMAP_FRAMES 120
+
+typedef enum {
+    BENCH_HEATMAP_PAUSED,     // inference or a paused replay
+    BENCH_HEATMAP_DRIFT,      // every weight moves a little every frame
+    BENCH_HEATMAP_HOT_ROWS,   // a few output rows move fast
+} BenchHeatmapCase;
+
+// The renderer's loop without the GPU: scan, then pack what would be
+// uploaded. Full uploads would move 64 MB every frame.
+static void bench_heatmap_run(const char *label, BenchHeatmapCase kind, float *w, float *drift) {
+    HeatmapTiles h;
+    static float staging[HEATMAP_TILE * HEATMAP_TILE];
+    static int dirty[HEATMAP_UPLOAD_TILES];
+    size_t n = (size_t)BENCH_HEATMAP_SIDE * BENCH_HEATMAP_SIDE;
+    if (!heatmap_init(&h, BENCH_HEATMAP_SIDE, BENCH_HEATMAP_SIDE)) {
+        fprintf(stderr, "ERROR: out of memory\n");
+        exit(1);
+    }
+    // Until the first full upload is done, then the frames measured
+    int frames = 0;
+    double scan = 0.0, scan_max = 0.0;
+    long long bytes = 0, tiles = 0;
+    for (int f = -BENCH_HEATMAP_FRAMES; f < BENCH_HEATMAP_FRAMES; f++) {
+        if (f >= 0 && kind == BENCH_HEATMAP_DRIFT) {
+            for (size_t i = 0; i < n; i++) w[i] += drift[i & (BENCH_HEATMAP_SIDE - 1)];
+        } else if (f >= 0 && kind == BENCH_HEATMAP_HOT_ROWS) {
+            for (size_t i = 0; i < 16 * (size_t)BENCH_HEATMAP_SIDE; i++) w[i] += 1e-3f;
+        }
+        double t0 = now_seconds();
+        float range = h.max_abs > 0.0f ? h.max_abs : h.sweep_max;
+        int budget = HEATMAP_SCAN_TILES;
+        int d = heatmap_scan(&h, w, range / HEATMAP_LEVELS, &budget, dirty, HEATMAP_UPLOAD_TILES);
+        for (int i = 0; i < d; i++) {
+            HeatmapRect r = heatmap_take(&h, w, dirty[i], staging);
+            if (f >= 0) bytes += sizeof(float) * r.width * r.height;
+        }
+        double dt = now_seconds() - t0;
+        if (f >= 0) {
+            scan += dt;
+            if (dt > scan_max) scan_max = dt;
+            tiles += d;
+            frames++;
+        }
+    }
+    printf("%-22s %10.2f %10.2f %12.1f %12.2f\n", label, scan / frames * 1e3, scan_max * 1e3,
+           (double)tiles / frames, bytes / (double)frames / 1048576.0);
+    heatmap_free(&h);
+}
+
+static void bench_heatmap(void) {
+    size_t n = (size_t)BENCH_HEATMAP_SIDE * BENCH_HEATMAP_SIDE;
+    float *w = malloc(sizeof(float) * n);
+    float *drift = malloc(sizeof(float) * BENCH_HEATMAP_SIDE);
+    if (!w || !drift) {
+        fprintf(stderr, "ERROR: out of memory\n");
+        exit(1);
+    }
+    NnRng rng = { 5 };
+    for (size_t i = 0; i < n; i++) w[i] = (nn_rng_float(&rng) - 0.5f) * 0.1f;
+    // Crosses a color step every ~20 frames
+    for (int i = 0; i < BENCH_HEATMAP_SIDE; i++) drift[i] = (nn_rng_float(&rng) - 0.5f) * 0.1f / HEATMAP_LEVELS / 10.0f;
+
+    printf("== heatmaps (%dx%d weights, %.0f MB, dirty %dx%d tiles) ==\n", BENCH_HEATMAP_SIDE, BENCH_HEATMAP_SIDE,
+           n * sizeof(float) / 1048576.0, HEATMAP_TILE, HEATMAP_TILE);
+    printf("%-22s %10s %10s %12s %12s\n", "weights", "scan ms", "max ms", "tiles/frame", "MB/frame");
+    bench_heatmap_run("unchanged", BENCH_HEATMAP_PAUSED, w, drift);
+    bench_heatmap_run("drifting every frame", BENCH_HEATMAP_DRIFT, w, drift);
+    bench_heatmap_run("16 rows moving fast", BENCH_HEATMAP_HOT_ROWS, w, drift);
+    free(w);
+    free(drift);
+}
+
+// ------------------------------------------------------------
+// Histograms
+// ------------------------------------------------------------
+
+#define BENCH_HIST_VALUES (4 << 20)
+#define BENCH_HIST_FRAMES 240
+
+static void bench_histogram(void) {
+    size_t n = BENCH_HIST_VALUES;
+    float *w = malloc(sizeof(float) * n);
+    if (!w) {
+        fprintf(stderr, "ERROR: out of memory\n");
+        exit(1);
+    }
+    // Bell-shaped like trained weights, so most values share a few bins
+    NnRng rng = { 6 };
+    for (size_t i = 0; i < n; i++) {
+        w[i] = (nn_rng_float(&rng) + nn_rng_float(&rng) + nn_rng_float(&rng) - 1.5f) * 0.1f;
+    }
+    float lo = -0.2f, scale = HIST_BINS / 0.4f;
+
+    printf("== histograms (%.1fM values, %d bins) ==\n", n / 1048576.0, HIST_BINS);
+    printf("%-8s %12s %10s %8s\n", "isa", "Mvalues/s", "GB/s", "match");
+    static uint32_t ref[KERNELS_HIST_SUBS * HIST_BINS], counts[KERNELS_HIST_SUBS * HIST_BINS];
+    float ref_minmax[2] = { INFINITY, -INFINITY };
+    kernels_get(KERNEL_SCALAR)->histogram(w, (int)n, lo, scale, HIST_BINS, ref, ref_minmax);
+    for (int isa = 0; isa < KERNEL_ISA_COUNT; isa++) {
+        const Kernels *k = kernels_get((KernelIsa)isa);
+        if (!k) continue;
+        // Sub-histograms differ by lane order, their sums must not
+        memset(counts, 0, sizeof(counts));
+        float minmax[2] = { INFINITY, -INFINITY };
+        k->histogram(w, (int)n, lo, scale, HIST_BINS, counts, minmax);
+        bool match = minmax[0] == ref_minmax[0] && minmax[1] == ref_minmax[1];
+        for (int b = 0; b < HIST_BINS; b++) {
+            uint32_t a = 0, r = 0;
+            for (int s = 0; s < KERNELS_HIST_SUBS; s++) {
+                a += counts[s * HIST_BINS + b];
+                r += ref[s * HIST_BINS + b];
+            }
+            match = match && a == r;
+        }
+        long iters = 0;
+        double t0 = now_seconds(), t1;
+        do {
+            k->histogram(w, (int)n, lo, scale, HIST_BINS, counts, minmax);
+            iters++;
+            t1 = now_seconds();
+        } while (t1 - t0 < BENCH_MIN_SECONDS);
+        double rate = (double)iters * n / (t1 - t0);
+        printf("%-8s %12.0f %10.2f %8s\n", k->name, rate * 1e-6, rate * sizeof(float) * 1e-9, match ? "yes" : "NO");
+    }
+
+    // The renderer's weight histogram: a budget of values per frame, split
+    // over the pool, until a pass finishes and the range adapts
+    int cpus = parallel_cpu_count();
+    ThreadPool *pool = cpus > 1 ? pool_create(cpus) : NULL;
+    Histogram h;
+    histogram_init(&h);
+    double feed = 0.0, feed_max = 0.0;
+    for (int f = 0; f < BENCH_HIST_FRAMES; f++) {
+        double t0 = now_seconds();
+        histogram_feed(&h, w, n, HIST_FRAME_VALUES, pool);
+        double dt = now_seconds() - t0;
+        feed += dt;
+        if (dt > feed_max) feed_max = dt;
+    }
+    printf("feed %.2fM values/frame, %d threads, %s: %.3f ms/frame (max %.3f)  %lld passes  range [%.3f, %.3f] for [%.3f, %.3f]\n",
+           HIST_FRAME_VALUES / 1048576.0, cpus, kernels->name, feed / BENCH_HIST_FRAMES * 1e3, feed_max * 1e3, h.passes,
+           h.lo, h.hi, h.min, h.max);
+    pool_destroy(pool);
+    free(w);
+}
+
+// ------------------------------------------------------------
+// Picking
+// ------------------------------------------------------------
+
+// 16 layers of 256x256 neurons laid out like the renderer's grid layers
+#define BENCH_PICK_SIDE 256
+#define BENCH_PICK_LAYERS 16
+#define BENCH_PICK_RAYS 10000
+#define BENCH_PICK_CHECKED 200     // rays compared against testing every sphere
+#define BENCH_PICK_REPEATS 3       // per ray, the fastest is its cost without preemption
+
+typedef struct {
+    float (*center)[3];
+    float *radius;
+} BenchSpheres;
+
+static float bench_sphere_hit(void *ctx, int prim, const float origin[3], const float dir[3]) {
+    const BenchSpheres *s = ctx;
+    return bvh_ray_sphere(origin, dir, s->center[prim], s->radius[prim]);
+}
+
+static void sphere_box(const BenchSpheres *s, int i, BvhBox *box) {
+    for (int a = 0; a < 3; a++) {
+        box->lo[a] = s->center[i][a] - s->radius[i];
+        box->hi[a] = s->center[i][a] + s->radius[i];
+    }
+}
+
+static void bench_pick(void) {
+    int n = BENCH_PICK_SIDE * BENCH_PICK_SIDE * BENCH_PICK_LAYERS;
+    BenchSpheres s = { malloc(sizeof(float[3]) * n), malloc(sizeof(float) * n) };
+    double *times = malloc(sizeof(double) * BENCH_PICK_RAYS);
+    BvhBuilder builder;
+    if (!s.center || !s.radius || !times || !bvh_builder_init(&builder) || !bvh_builder_start(&builder)) {
+        fprintf(stderr, "ERROR: out of memory\n");
+        exit(1);
+    }
+    NnRng rng = { 7 };
+    float spacing = 12.0f / BENCH_PICK_SIDE;
+    for (int i = 0; i < n; i++) {
+        int layer = i / (BENCH_PICK_SIDE * BENCH_PICK_SIDE), k = i % (BENCH_PICK_SIDE * BENCH_PICK_SIDE);
+        s.center[i][0] = (k % BENCH_PICK_SIDE - BENCH_PICK_SIDE / 2.0f) * spacing;
+        s.center[i][1] = (BENCH_PICK_SIDE / 2.0f - k / BENCH_PICK_SIDE) * spacing + 3.0f;
+        s.center[i][2] = layer * 4.0f;
+        s.radius[i] = (0.2f + 0.3f * nn_rng_float(&rng)) * spacing;
+    }
+
+    // As the renderer does it: boxes staged on the calling thread, the
+    // tree built on the builder's while frames go on polling for it
+    printf("== picking (%.1fM spheres in %d layers) ==\n", n / 1e6, BENCH_PICK_LAYERS);
+    double t0 = now_seconds();
+    BvhBox *boxes = bvh_builder_boxes(&builder, n);
+    if (!boxes) {
+        fprintf(stderr, "ERROR: out of memory\n");
+        exit(1);
+    }
+    for (int i = 0; i < n; i++) sphere_box(&s, i, &boxes[i]);
+    bvh_builder_submit(&builder, 0);
+    double stage = now_seconds() - t0, poll_max = 0.0;
+    const Bvh *bvh;
+    for (;;) {
+        double t1 = now_seconds();
+        bvh = bvh_builder_poll(&builder);
+        double dt = now_seconds() - t1;
+        if (dt > poll_max) poll_max = dt;
+        if (builder.front_tag == 0) break;
+        nanosleep(&(struct timespec){ .tv_nsec = 1000000 }, NULL);
+    }
+    double build = now_seconds() - t0;
+    if (bvh->node_count == 0) {
+        fprintf(stderr, "ERROR: out of memory\n");
+        exit(1);
+    }
+    printf("%-28s %10.2f ms  (calling thread)\n", "stage boxes", stage * 1e3);
+    printf("%-28s %10.2f ms  (%d nodes, builder thread, polls at most %.2f us)\n", "build", build * 1e3,
+           bvh->node_count, poll_max * 1e6);
+
+    // Rays from a camera in front of the layers toward random points in them
+    float eye[3] = { 20.0f, 15.0f, -20.0f };
+    double pick = 0.0, pick_max = 0.0;
+    int hits = 0, wrong = 0;
+    for (int r = 0; r < BENCH_PICK_RAYS; r++) {
+        float target[3] = { (nn_rng_float(&rng) - 0.5f) * 12.0f, (nn_rng_float(&rng) - 0.5f) * 12.0f + 3.0f,
+                            nn_rng_float(&rng) * BENCH_PICK_LAYERS * 4.0f };
+        float dir[3] = { target[0] - eye[0], target[1] - eye[1], target[2] - eye[2] };
+        float t;
+        int hit = -1;
+        times[r] = INFINITY;
+        for (int k = 0; k < BENCH_PICK_REPEATS; k++) {
+            t0 = now_seconds();
+            hit = bvh_pick(bvh, eye, dir, INFINITY, bench_sphere_hit, &s, &t);
+            double dt = now_seconds() - t0;
+            pick += dt;
+            if (dt > pick_max) pick_max = dt;
+            if (dt < times[r]) times[r] = dt;
+        }
+        hits += hit >= 0;
+        if (r < BENCH_PICK_CHECKED) {
+            int best = -1;
+            float best_t = INFINITY;
+            for (int i = 0; i < n; i++) {
+                float ti = bench_sphere_hit(&s, i, eye, dir);
+                if (ti < best_t) {
+                    best_t = ti;
+                    best = i;
+                }
+            }
+            wrong += best != hit;
+        }
+    }
+    // The slowest ray is the traversal's worst case; the max of every pick
+    // adds whatever preempted one
+    qsort(times, BENCH_PICK_RAYS, sizeof(double), compare_double);
+    printf("%-28s %10.2f us  (p99 %.2f us, slowest ray %.2f us, max %.2f us)\n", "pick",
+           pick / (BENCH_PICK_RAYS * BENCH_PICK_REPEATS) * 1e6, times[BENCH_PICK_RAYS * 99 / 100] * 1e6,
+           times[BENCH_PICK_RAYS - 1] * 1e6, pick_max * 1e6);
+    printf("%-28s %10d%%   (%d of %d differ from testing every sphere)\n", "rays hitting",
+           hits * 100 / BENCH_PICK_RAYS, wrong, BENCH_PICK_CHECKED);
+    bvh_builder_free(&builder);
+    free(s.center);
+    free(s.radius);
+    free(times);
+}
+
+// ------------------------------------------------------------
+// Culling
+// ------------------------------------------------------------
+
+// The picking benchmark's layers, seen from two cameras
+#define BENCH_CULL_SIDE 256
+#define BENCH_CULL_LAYERS 16
+#define BENCH_CULL_FRAMES 20
+
+// Column-major projection * look-at, as raylib's BeginMode3D sets it up
+static void bench_view_projection(const float eye[3], const float target[3], float fovy, float aspect, float m[16]) {
+    float f[3] = { target[0] - eye[0], target[1] - eye[1], target[2] - eye[2] };
+    float fl = sqrtf(f[0] * f[0] + f[1] * f[1] + f[2] * f[2]);
+    for (int a = 0; a < 3; a++) f[a] /= fl;
+    float r[3] = { -f[2], 0.0f, f[0] }; // f x up, up = +y
+    float rl = sqrtf(r[0] * r[0] + r[2] * r[2]);
+    r[0] /= rl;
+    r[2] /= rl;
+    float u[3] = { r[1] * f[2] - r[2] * f[1], r[2] * f[0] - r[0] * f[2], r[0] * f[1] - r[1] * f[0] };
+    float view[4][4] = {
+        { r[0], r[1], r[2], -(r[0] * eye[0] + r[1] * eye[1] + r[2] * eye[2]) },
+        { u[0], u[1], u[2], -(u[0] * eye[0] + u[1] * eye[1] + u[2] * eye[2]) },
+        { -f[0], -f[1], -f[2], f[0] * eye[0] + f[1] * eye[1] + f[2] * eye[2] },
+        { 0.0f, 0.0f, 0.0f, 1.0f },
+    };
+    float t = 1.0f / tanf(fovy / 2.0f), near = 0.01f, far = 1000.0f;
+    float proj[4][4] = {
+        { t / aspect, 0.0f, 0.0f, 0.0f },
+        { 0.0f, t, 0.0f, 0.0f },
+        { 0.0f, 0.0f, (far + near) / (near - far), 2.0f * far * near / (near - far) },
+        { 0.0f, 0.0f, -1.0f, 0.0f },
+    };
+    for (int row = 0; row < 4; row++) {
+        for (int col = 0; col < 4; col++) {
+            float sum = 0.0f;
+            for (int k = 0; k < 4; k++) sum += proj[row][k] * view[k][col];
+            m[col * 4 + row] = sum;
+        }
+    }
+}
+
+static void bench_cull(void) {
+    int per_layer = BENCH_CULL_SIDE * BENCH_CULL_SIDE, n = per_layer * BENCH_CULL_LAYERS;
+    float (*xyz)[3] = malloc(sizeof(float[3]) * n);
+    unsigned char *codes = malloc(n), *brute = malloc(n);
+    CullGrid grids[BENCH_CULL_LAYERS] = { 0 };
+    if (!xyz || !codes || !brute) {
+        fprintf(stderr, "ERROR: out of memory\n");
+        exit(1);
+    }
+    float spacing = 12.0f / BENCH_CULL_SIDE;
+    for (int i = 0; i < n; i++) {
+        int layer = i / per_layer, k = i % per_layer;
+        xyz[i][0] = (k % BENCH_CULL_SIDE - BENCH_CULL_SIDE / 2.0f) * spacing;
+        xyz[i][1] = (BENCH_CULL_SIDE / 2.0f - k / BENCH_CULL_SIDE) * spacing + 3.0f;
+        xyz[i][2] = layer * 4.0f;
+    }
+
+    printf("== culling (%.1fM neurons in %d layers) ==\n", n / 1e6, BENCH_CULL_LAYERS);
+    double t0 = now_seconds();
+    for (int l = 0; l < BENCH_CULL_LAYERS; l++) {
+        if (!cull_grid_build(&grids[l], xyz[l * per_layer], per_layer, spacing)) {
+            fprintf(stderr, "ERROR: out of memory\n");
+            exit(1);
+        }
+    }
+    printf("%-28s %10.2f ms  (%d cells per layer)\n", "grid build", (now_seconds() - t0) * 1e3, grids[0].cells);
+
+    static const struct {
+        const char *name;
+        float eye[3], target[3];
+    } views[] = {
+        { "whole network", { 60.0f, 45.0f, -30.0f }, { 0.0f, 3.0f, 30.0f } },
+        { "zoomed into a corner", { 5.0f, 8.0f, 2.0f }, { 4.0f, 7.0f, 0.0f } },
+    };
+    for (size_t v = 0; v < sizeof(views) / sizeof(views[0]); v++) {
+        float m[16];
+        Frustum f;
+        bench_view_projection(views[v].eye, views[v].target, 50.0f * 3.14159265f / 180.0f, 16.0f / 9.0f, m);
+        frustum_from_matrix(&f, m);
+        int outside = 0;
+        t0 = now_seconds();
+        for (int frame = 0; frame < BENCH_CULL_FRAMES; frame++) {
+            outside = 0;
+            for (int l = 0; l < BENCH_CULL_LAYERS; l++) {
+                outside += cull_grid_classify(&grids[l], &f, xyz[l * per_layer], spacing, codes + l * per_layer);
+            }
+        }
+        double grid = (now_seconds() - t0) / BENCH_CULL_FRAMES;
+        t0 = now_seconds();
+        for (int frame = 0; frame < BENCH_CULL_FRAMES; frame++) {
+            for (int i = 0; i < n; i++) brute[i] = (unsigned char)frustum_outcode(&f, xyz[i], spacing);
+        }
+        double every = (now_seconds() - t0) / BENCH_CULL_FRAMES;
+        int differ = 0;
+        for (int i = 0; i < n; i++) differ += (codes[i] != 0) != (brute[i] != 0);
+        printf("%-28s %10.2f ms  (every point %.2f ms, %.1f%% culled, %d differ)\n", views[v].name, grid * 1e3,
+               every * 1e3, outside * 100.0 / n, differ);
+    }
+    for (int l = 0; l < BENCH_CULL_LAYERS; l++) cull_grid_free(&grids[l]);
+    free(xyz);
+    free(codes);
+    free(brute);
+}
+
+int main(int argc, char **argv) {
+    kernels_init(NULL);
+    const char *only = argc > 1 ? argv[1] : NULL;
+
+    if (!only || strcmp(only, "kernels") == 0) bench_kernels();
+    if (!only || strcmp(only, "neurons") == 0) bench_neurons();
+    if (!only || strcmp(only, "model") == 0) bench_model();
+    if (!only || strcmp(only, "checkpoint") == 0) bench_checkpoint();
+    if (!only || strcmp(only, "int8") == 0) bench_int8();
+    if (!only || strcmp(only, "conv") == 0) bench_conv();
+    if (!only || strcmp(only, "optim") == 0) bench_optim();
+    if (!only || strcmp(only, "autodiff") == 0) bench_autodiff();
+    if (!only || strcmp(only, "record") == 0) bench_record();
+    if (!only || strcmp(only, "ingest") == 0) bench_ingest();
+    if (!only || strcmp(only, "plot") == 0) bench_plot();
+    if (!only || strcmp(only, "heatmap") == 0) bench_heatmap();
+    if (!only || strcmp(only, "histogram") == 0) bench_histogram();
+    if (!only || strcmp(only, "pick") == 0) bench_pick();
+    if (!only || strcmp(only, "cull") == 0) bench_cull();
+    if (!only || strcmp(only, "training") == 0) bench_training();
+
+    return 0;
+}
@@ -0,0 +1,429 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bvh.h"
+
+static void box_empty(BvhBox *x) {
+    for (int a = 0; a < 3; a++) {
+        x->lo[a] = INFINITY;
+        x->hi[a] = -INFINITY;
+    }
+}
+
+// Comparisons rather than fminf/fmaxf, which are calls into libm unless
+// NaN handling is relaxed; an operand that is NaN leaves `a` as it is
+static inline float min_f(float a, float b) {
+    return b < a ? b : a;
+}
+
+static inline float max_f(float a, float b) {
+    return b > a ? b : a;
+}
+
+static void box_grow(BvhBox *x, const BvhBox *y) {
+    for (int a = 0; a < 3; a++) {
+        x->lo[a] = min_f(x->lo[a], y->lo[a]);
+        x->hi[a] = max_f(x->hi[a], y->hi[a]);
+    }
+}
+
+// Half the surface area, which is all the heuristic compares
+static float box_area(const BvhBox *x) {
+    float dx = x->hi[0] - x->lo[0], dy = x->hi[1] - x->lo[1], dz = x->hi[2] - x->lo[2];
+    if (dx < 0.0f) return 0.0f;
+    return dx * dy + dy * dz + dz * dx;
+}
+
+// A primitive during the build. Records are partitioned in place, so every
+// pass over a node's primitives reads memory in order.
+typedef struct {
+    BvhBox box;
+    int prim;
+} BvhRecord;
+
+static float centroid(const BvhRecord *r, int axis) {
+    return 0.5f * (r->box.lo[axis] + r->box.hi[axis]);
+}
+
+static int make_leaf(Bvh *b, BvhRecord *rec, int node, int begin, int end) {
+    b->nodes[node].first = begin;
+    b->nodes[node].count = end - begin;
+    for (int i = begin; i < end; i++) b->prims[i] = rec[i].prim;
+    return node;
+}
+
+// Box of the primitives of a range and box of their centroids
+typedef struct {
+    BvhBox box, cbox;
+} BvhBounds;
+
+static void bounds_empty(BvhBounds *x) {
+    box_empty(&x->box);
+    box_empty(&x->cbox);
+}
+
+static void bounds_add(BvhBounds *x, const BvhRecord *r) {
+    box_grow(&x->box, &r->box);
+    for (int a = 0; a < 3; a++) {
+        float c = centroid(r, a);
+        x->cbox.lo[a] = min_f(x->cbox.lo[a], c);
+        x->cbox.hi[a] = max_f(x->cbox.hi[a], c);
+    }
+}
+
+static void bounds_grow(BvhBounds *x, const BvhBounds *y) {
+    box_grow(&x->box, &y->box);
+    box_grow(&x->cbox, &y->cbox);
+}
+
+// Where the binned surface area heuristic splits [begin, end) along the
+// longest axis of the centroids, partitioned in place, or -1 when a leaf
+// is cheaper or no bin boundary separates the centroids. The bounds of
+// both sides come from the bins, so children need no pass of their own.
+static int sah_split(BvhRecord *rec, int begin, int end, const BvhBounds *bounds, BvhBounds *left, BvhBounds *right) {
+    const BvhBox *cbox = &bounds->cbox;
+    int axis = 0;
+    for (int a = 1; a < 3; a++) {
+        if (cbox->hi[a] - cbox->lo[a] > cbox->hi[axis] - cbox->lo[axis]) axis = a;
+    }
+    float lo = cbox->lo[axis], extent = cbox->hi[axis] - lo;
+    if (!(extent > 0.0f)) return -1;
+    float k = BVH_BINS * (1.0f - 1e-6f) / extent;
+
+    BvhBounds bins[BVH_BINS];
+    int counts[BVH_BINS] = { 0 };
+    for (int i = 0; i < BVH_BINS; i++) bounds_empty(&bins[i]);
+    for (int i = begin; i < end; i++) {
+        int bin = (int)((centroid(&rec[i], axis) - lo) * k);
+        bin = bin < BVH_BINS - 1 ? bin : BVH_BINS - 1;
+        counts[bin]++;
+        bounds_add(&bins[bin], &rec[i]);
+    }
+
+    // Area and count right of every boundary, then a sweep from the left
+    float right_area[BVH_BINS];
+    int right_count[BVH_BINS];
+    BvhBox acc;
+    box_empty(&acc);
+    int n = 0;
+    for (int i = BVH_BINS - 1; i > 0; i--) {
+        box_grow(&acc, &bins[i].box);
+        n += counts[i];
+        right_area[i] = box_area(&acc);
+        right_count[i] = n;
+    }
+    box_empty(&acc);
+    n = 0;
+    float best = INFINITY;
+    int split = -1;
+    for (int i = 1; i < BVH_BINS; i++) {
+        box_grow(&acc, &bins[i - 1].box);
+        n += counts[i - 1];
+        if (n == 0 || right_count[i] == 0) continue;
+        float cost = n * box_area(&acc) + right_count[i] * right_area[i];
+        if (cost < best) {
+            best = cost;
+            split = i;
+        }
+    }
+    if (split < 0) return -1;
+    // One step down costs about as much as one primitive test
+    float area = box_area(&bounds->box);
+    if (end - begin <= BVH_MAX_LEAF && (area <= 0.0f || 1.0f + best / area >= end - begin)) return -1;
+
+    bounds_empty(left);
+    bounds_empty(right);
+    for (int i = 0; i < BVH_BINS; i++) bounds_grow(i < split ? left : right, &bins[i]);
+    int i = begin, j = end - 1;
+    while (i <= j) {
+        if ((int)((centroid(&rec[i], axis) - lo) * k) < split) {
+            i++;
+        } else {
+            BvhRecord r = rec[i];
+            rec[i] = rec[j];
+            rec[j--] = r;
+        }
+    }
+    return i;
+}
+
+static int build(Bvh *b, BvhRecord *rec, int begin, int end, int depth, const BvhBounds *bounds) {
+    int node = b->node_count++;
+    b->nodes[node].box = bounds->box;
+    int count = end - begin;
+    if (count <= BVH_MIN_LEAF) return make_leaf(b, rec, node, begin, end);
+
+    BvhBounds left, right;
+    int mid = depth < BVH_MAX_DEPTH / 2 ? sah_split(rec, begin, end, bounds, &left, &right) : -1;
+    if (mid < 0) {
+        if (count <= BVH_MAX_LEAF) return make_leaf(b, rec, node, begin, end);
+        // Coinciding centroids, or deep enough that halving the count
+        // matters more than tight boxes
+        mid = begin + count / 2;
+        bounds_empty(&left);
+        bounds_empty(&right);
+        for (int i = begin; i < end; i++) bounds_add(i < mid ? &left : &right, &rec[i]);
+    }
+    build(b, rec, begin, mid, depth + 1, &left);
+    int r = build(b, rec, mid, end, depth + 1, &right);
+    b->nodes[node].first = r;
+    b->nodes[node].count = 0;
+    return node;
+}
+
+bool bvh_build(Bvh *b, const BvhBox *boxes, int count) {
+    // A tree of count leaves of one primitive has 2 count - 1 nodes
+    int max_nodes = count > 0 ? 2 * count - 1 : 0;
+    if (count > b->prim_count || !b->prims) {
+        bvh_free(b);
+        b->nodes = malloc(sizeof(BvhNode) * max_nodes);
+        b->prims = malloc(sizeof(int) * count);
+        if (count > 0 && (!b->nodes || !b->prims)) {
+            bvh_free(b);
+            return false;
+        }
+    }
+    b->prim_count = count;
+    b->node_count = 0;
+    if (count == 0) return true;
+
+    BvhRecord *rec = malloc(sizeof(BvhRecord) * count);
+    if (!rec) {
+        bvh_free(b);
+        return false;
+    }
+    BvhBounds bounds;
+    bounds_empty(&bounds);
+    for (int i = 0; i < count; i++) {
+        rec[i] = (BvhRecord){ boxes[i], i };
+        bounds_add(&bounds, &rec[i]);
+    }
+    build(b, rec, 0, count, 0, &bounds);
+    free(rec);
+    return true;
+}
+
+void bvh_free(Bvh *b) {
+    free(b->nodes);
+    free(b->prims);
+    memset(b, 0, sizeof(*b));
+}
+
+bool bvh_builder_init(BvhBuilder *b) {
+    memset(b, 0, sizeof(*b));
+    b->front_tag = -1;
+    return pthread_mutex_init(&b->lock, NULL) == 0 && pthread_cond_init(&b->cond, NULL) == 0;
+}
+
+void bvh_builder_free(BvhBuilder *b) {
+    bvh_builder_stop(b);
+    bvh_free(&b->tree[0]);
+    bvh_free(&b->tree[1]);
+    free(b->boxes);
+    pthread_mutex_destroy(&b->lock);
+    pthread_cond_destroy(&b->cond);
+    memset(b, 0, sizeof(*b));
+}
+
+static void *builder_main(void *arg) {
+    BvhBuilder *b = arg;
+
+    pthread_mutex_lock(&b->lock);
+    while (!b->quit) {
+        if (!b->pending) {
+            pthread_cond_wait(&b->cond, &b->lock);
+            continue;
+        }
+        // A finished tree nobody swapped in yet is older than these boxes
+        b->pending = false;
+        b->building = true;
+        b->done = false;
+        long long tag = b->tag;
+        int count = b->count;
+        Bvh *back = &b->tree[!b->front];
+        pthread_mutex_unlock(&b->lock);
+
+        bool ok = bvh_build(back, b->boxes, count);
+        if (!ok) fprintf(stderr, "ERROR: out of memory for a BVH over %d boxes\n", count);
+
+        pthread_mutex_lock(&b->lock);
+        b->building = false;
+        b->done = ok;
+        b->built_tag = tag;
+    }
+    pthread_mutex_unlock(&b->lock);
+    return NULL;
+}
+
+bool bvh_builder_start(BvhBuilder *b) {
+    if (b->thread_started) return true;
+    b->quit = false;
+    if (pthread_create(&b->thread, NULL, builder_main, b) != 0) return false;
+    b->thread_started = true;
+    return true;
+}
+
+void bvh_builder_stop(BvhBuilder *b) {
+    if (!b->thread_started) return;
+    pthread_mutex_lock(&b->lock);
+    b->quit = true;
+    pthread_cond_signal(&b->cond);
+    pthread_mutex_unlock(&b->lock);
+    pthread_join(b->thread, NULL);
+    b->thread_started = false;
+}
+
+BvhBox *bvh_builder_boxes(BvhBuilder *b, int count) {
+    pthread_mutex_lock(&b->lock);
+    bool building = b->building;
+    if (!building) b->pending = false;
+    pthread_mutex_unlock(&b->lock);
+    if (building) return NULL;
+    // The thread only reads the boxes while building, so they are ours now
+    if (count > b->capacity) {
+        BvhBox *boxes = realloc(b->boxes, sizeof(BvhBox) * count);
+        if (!boxes) return NULL;
+        b->boxes = boxes;
+        b->capacity = count;
+    }
+    b->count = count;
+    return b->boxes;
+}
+
+void bvh_builder_submit(BvhBuilder *b, long long tag) {
+    pthread_mutex_lock(&b->lock);
+    b->tag = tag;
+    b->pending = true;
+    pthread_cond_signal(&b->cond);
+    pthread_mutex_unlock(&b->lock);
+}
+
+const Bvh *bvh_builder_poll(BvhBuilder *b) {
+    pthread_mutex_lock(&b->lock);
+    if (b->done) {
+        b->front = !b->front;
+        b->front_tag = b->built_tag;
+        b->done = false;
+    }
+    pthread_mutex_unlock(&b->lock);
+    return &b->tree[b->front];
+}
+
+// Where the ray enters the box, if it does before max_t
+static bool ray_box(const BvhBox *x, const float o[3], const float inv[3], float max_t, float *t) {
+    float t0 = 0.0f, t1 = max_t;
+    for (int a = 0; a < 3; a++) {
+        float ta = (x->lo[a] - o[a]) * inv[a], tb = (x->hi[a] - o[a]) * inv[a];
+        t0 = max_f(t0, min_f(ta, tb));
+        t1 = min_f(t1, max_f(ta, tb));
+    }
+    *t = t0;
+    return t0 <= t1;
+}
+
+int bvh_pick(const Bvh *b, const float origin[3], const float dir[3], float max_t,
+             BvhHitFn hit, void *ctx, float *t) {
+    float inv[3] = { 1.0f / dir[0], 1.0f / dir[1], 1.0f / dir[2] };
+    struct { int node; float t; } stack[BVH_MAX_DEPTH];
+    int top = 0, best = -1;
+    float best_t = max_t, enter;
+    if (b->node_count == 0 || !ray_box(&b->nodes[0].box, origin, inv, best_t, &enter)) return -1;
+    stack[top++].node = 0;
+    stack[0].t = enter;
+    while (top > 0) {
+        top--;
+        if (stack[top].t > best_t) continue;
+        int node = stack[top].node;
+        for (;;) {
+            const BvhNode *n = &b->nodes[node];
+            if (n->count) {
+                for (int i = n->first; i < n->first + n->count; i++) {
+                    float ti = hit(ctx, b->prims[i], origin, dir);
+                    if (ti < best_t) {
+                        best_t = ti;
+                        best = b->prims[i];
+                    }
+                }
+                break;
+            }
+            int near = node + 1, far = n->first;
+            float tn, tf;
+            bool hn = ray_box(&b->nodes[near].box, origin, inv, best_t, &tn);
+            bool hf = ray_box(&b->nodes[far].box, origin, inv, best_t, &tf);
+            if (hn && hf) {
+                if (tf < tn) {
+                    int swap = near;
+                    near = far;
+                    far = swap;
+                    float st = tn;
+                    tn = tf;
+                    tf = st;
+                }
+                stack[top].node = far;
+                stack[top++].t = tf;
+                node = near;
+            } else if (hn || hf) {
+                node = hn ? near : far;
+            } else {
+                break;
+            }
+        }
+    }
+    if (t && best >= 0) *t = best_t;
+    return best;
+}
+
+static float dot3(const float a[3], const float b[3]) {
+    return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+float bvh_ray_sphere(const float origin[3], const float dir[3], const float center[3], float radius) {
+    // From the closest approach rather than the quadratic's discriminant,
+    // which cancels badly for grazing rays from far away
+    float oc[3] = { origin[0] - center[0], origin[1] - center[1], origin[2] - center[2] };
+    float a = dot3(dir, dir), mid = -dot3(oc, dir) / a;
+    float d[3] = { oc[0] + mid * dir[0], oc[1] + mid * dir[1], oc[2] + mid * dir[2] };
+    float miss = dot3(d, d);
+    if (miss > radius * radius) return INFINITY;
+    float half = sqrtf((radius * radius - miss) / a);
+    float t = mid - half;
+    if (t < 0.0f) t = mid + half; // from inside
+    return t >= 0.0f ? t : INFINITY;
+}
+
+float bvh_ray_segment(const float origin[3], const float dir[3], const float a[3], const float b[3], float radius) {
+    // Closest points of the ray o + s u, s >= 0, and the segment a + t v, t in [0, 1]
+    float v[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+    float w[3] = { origin[0] - a[0], origin[1] - a[1], origin[2] - a[2] };
+    float uu = dot3(dir, dir), uv = dot3(dir, v), vv = dot3(v, v), uw = dot3(dir, w), vw = dot3(v, w);
+    if (vv <= 0.0f) return bvh_ray_sphere(origin, dir, a, radius);
+    float den = uu * vv - uv * uv;
+    float sn, sd = den, tn, td = den;
+    if (den < 1e-6f * uu * vv) {
+        // Parallel: any point of the ray will do, take its start
+        sn = 0.0f;
+        sd = 1.0f;
+        tn = vw;
+        td = vv;
+    } else {
+        sn = uv * vw - vv * uw;
+        tn = uu * vw - uv * uw;
+        if (sn < 0.0f) {
+            sn = 0.0f;
+            tn = vw;
+            td = vv;
+        }
+    }
+    if (tn < 0.0f || tn > td) {
+        // Past an end of the segment: closest to that end instead
+        tn = tn < 0.0f ? 0.0f : td;
+        sn = fmaxf(tn / td * uv - uw, 0.0f);
+        sd = uu;
+    }
+    float s = sn / sd, t = tn / td;
+    float d[3];
+    for (int k = 0; k < 3; k++) d[k] = w[k] + s * dir[k] - t * v[k];
+    return dot3(d, d) <= radius * radius ? s : INFINITY;
+}
@@ -0,0 +1,105 @@
+#ifndef BVH_H_
+#define BVH_H_
+
+#include <pthread.h>
+#include <stdbool.h>
+
+// Most primitives in a leaf, and the count below which a node is always a leaf
+#define BVH_MAX_LEAF 8
+#define BVH_MIN_LEAF 4
+
+// Split candidates per axis of the binned surface area heuristic
+#define BVH_BINS 16
+
+// Deepest a tree gets. Past half of it nodes are split at the median, which
+// halves the count, so 2^32 primitives still fit.
+#define BVH_MAX_DEPTH 64
+
+typedef struct {
+    float lo[3], hi[3];
+} BvhBox;
+
+// Nodes are stored depth first: an inner node's left child follows it
+typedef struct {
+    BvhBox box;
+    int first;      // leaf: first of its entries in prims; inner: the right child
+    int count;      // primitives of a leaf, 0 for an inner node
+} BvhNode;
+
+// Bounding volume hierarchy over the boxes of caller-owned primitives,
+// e.g. spheres and line segments, for ray picks. Built once per layout;
+// boxes are made to hold whatever a primitive animates through, so the
+// tree is rebuilt only when the primitives themselves change.
+typedef struct {
+    BvhNode *nodes;
+    int node_count;
+    int *prims;          // primitive indices, grouped by leaf
+    int prim_count;
+} Bvh;
+
+// (Re)builds over `count` boxes, reusing the arrays when they are large
+// enough. False when out of memory; the tree is empty then.
+bool bvh_build(Bvh *b, const BvhBox *boxes, int count);
+void bvh_free(Bvh *b);
+
+// Builds trees on a thread of its own, so no pick waits for one: a 1M
+// primitive build takes about half a second. The caller stages boxes
+// under a tag, e.g. a counter of the layouts it has had, and keeps picking
+// from the last tree finished until one over the staged boxes is swapped
+// in by bvh_builder_poll. Boxes staged while a build runs wait for it.
+typedef struct {
+    Bvh tree[2];             // the one picks use and the one being built
+    int front;
+    long long front_tag;     // of the boxes the front tree holds, -1 = none
+    long long built_tag;     // of a finished tree waiting to be swapped in
+    BvhBox *boxes;           // staged, read by the thread while it builds
+    int count, capacity;
+    long long tag;
+
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    bool pending;            // staged boxes not yet built
+    bool building;
+    bool done;               // tree[!front] holds built_tag
+    bool quit;
+    pthread_t thread;
+    bool thread_started;
+} BvhBuilder;
+
+bool bvh_builder_init(BvhBuilder *b);
+void bvh_builder_free(BvhBuilder *b);
+
+// The thread runs code from this module, so it is stopped around hot
+// reloads. Stopping waits for a build in progress; staged boxes are built
+// once it is started again.
+bool bvh_builder_start(BvhBuilder *b);
+void bvh_builder_stop(BvhBuilder *b);
+
+// Room for `count` boxes to stage, or NULL while the thread is building
+// from the last ones or when out of memory. Boxes staged but not yet built
+// are dropped; bvh_builder_submit queues the new ones.
+BvhBox *bvh_builder_boxes(BvhBuilder *b, int count);
+void bvh_builder_submit(BvhBuilder *b, long long tag);
+
+// Swaps in a finished tree. Returns the tree picks use, which is empty
+// until the first build is done; its tag is in front_tag.
+const Bvh *bvh_builder_poll(BvhBuilder *b);
+
+// Distance along the ray to `prim`, or INFINITY for a miss
+typedef float (*BvhHitFn)(void *ctx, int prim, const float origin[3], const float dir[3]);
+
+// Nearest primitive the ray from `origin` along `dir` hits before max_t,
+// nearer children first, or -1. Its distance goes to *t when given.
+int bvh_pick(const Bvh *b, const float origin[3], const float dir[3], float max_t,
+             BvhHitFn hit, void *ctx, float *t);
+
+// Exact tests for the two shapes pickers need; dir need not be normalized
+// and distances are in units of it
+float bvh_ray_sphere(const float origin[3], const float dir[3], const float center[3], float radius);
+
+// A segment thickened to `radius`. Returns where the ray passes closest
+// to the segment if it passes within radius, which is close enough to the
+// capsule's surface for picking.
+float bvh_ray_segment(const float origin[3], const float dir[3], const float a[3], const float b[3], float radius);
+
+#endif // BVH_H_
@@ -0,0 +1,261 @@
+#ifdef CONA_HAVE_LIBURING
+    #define _GNU_SOURCE
+#else
+    #define _POSIX_C_SOURCE 200809L
+#endif
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "checkpoint.h"
+
+#ifdef _WIN32
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <unistd.h>
+#endif
+
+#ifdef CONA_HAVE_LIBURING
+    #include <liburing.h>
+#endif
+
+static long long now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// I/O backend, created up front so the backend is known before any write
+typedef struct {
+    #ifdef CONA_HAVE_LIBURING
+        struct io_uring ring;
+        bool have_ring;
+    #endif
+    int unused;
+} Writer;
+
+bool checkpoint_init(Checkpointer *c, const Mlp *nn, const char *path) {
+    memset(c, 0, sizeof(*c));
+    ModelLayout layout;
+    if (strlen(path) >= sizeof(c->path) || !model_layout(nn, &layout)) return false;
+    strcpy(c->path, path);
+    c->size = (size_t)layout.header.file_size;
+    for (int i = 0; i < 2; i++) {
+        // Zeroed, since model_write_image never touches the padding, and
+        // rendered once so the page faults happen here rather than in the
+        // first captures on the training thread
+        c->image[i] = calloc(1, c->size);
+        if (!c->image[i]) {
+            checkpoint_free(c);
+            return false;
+        }
+        model_write_image(nn, &layout, c->image[i]);
+    }
+    Writer *w = calloc(1, sizeof(*w));
+    if (!w) {
+        checkpoint_free(c);
+        return false;
+    }
+    c->io = w;
+    c->backend = "pwrite";
+    #ifdef CONA_HAVE_LIBURING
+        // Kernels or sandboxes without io_uring fall back to pwrite
+        w->have_ring = io_uring_queue_init(CHECKPOINT_QUEUE_DEPTH, &w->ring, 0) == 0;
+        if (w->have_ring) c->backend = "io_uring";
+    #endif
+    pthread_mutex_init(&c->lock, NULL);
+    pthread_cond_init(&c->cond, NULL);
+    c->pending = -1;
+    c->writing = -1;
+    return true;
+}
+
+void checkpoint_free(Checkpointer *c) {
+    checkpoint_stop(c);
+    if (c->io) {
+        #ifdef CONA_HAVE_LIBURING
+            Writer *w = c->io;
+            if (w->have_ring) io_uring_queue_exit(&w->ring);
+        #endif
+        free(c->io);
+        pthread_mutex_destroy(&c->lock);
+        pthread_cond_destroy(&c->cond);
+    }
+    free(c->image[0]);
+    free(c->image[1]);
+    memset(c, 0, sizeof(*c));
+}
+
+bool checkpoint_capture(Checkpointer *c, const Mlp *nn) {
+    ModelLayout layout;
+    if (!c->io || !model_layout(nn, &layout) || layout.header.file_size != c->size) return false;
+
+    // Only this thread fills images, so the one picked here stays ours
+    // until it is published as pending
+    pthread_mutex_lock(&c->lock);
+    int slot = -1;
+    for (int i = 0; i < 2; i++) {
+        if (i != c->pending && i != c->writing) slot = i;
+    }
+    pthread_mutex_unlock(&c->lock);
+    if (slot < 0) {
+        atomic_fetch_add_explicit(&c->skipped, 1, memory_order_relaxed);
+        return false;
+    }
+
+    long long t0 = now_ns();
+    model_write_image(nn, &layout, c->image[slot]);
+    atomic_store_explicit(&c->copy_ns, now_ns() - t0, memory_order_relaxed);
+
+    pthread_mutex_lock(&c->lock);
+    // A newer image replaces one the I/O thread has not picked up yet
+    if (c->pending >= 0) atomic_fetch_add_explicit(&c->skipped, 1, memory_order_relaxed);
+    c->pending = slot;
+    pthread_cond_signal(&c->cond);
+    pthread_mutex_unlock(&c->lock);
+    return true;
+}
+
+// ------------------------------------------------------------
+// I/O thread
+// ------------------------------------------------------------
+
+#ifndef _WIN32
+
+static bool pwrite_all(int fd, const uint8_t *data, size_t size, size_t offset) {
+    while (size > 0) {
+        size_t len = size < CHECKPOINT_CHUNK ? size : CHECKPOINT_CHUNK;
+        ssize_t n = pwrite(fd, data, len, (off_t)offset);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += n;
+        offset += (size_t)n;
+        size -= (size_t)n;
+    }
+    return true;
+}
+
+#ifdef CONA_HAVE_LIBURING
+// Keeps CHECKPOINT_QUEUE_DEPTH chunk writes in flight. Short writes are
+// finished synchronously; they only happen when the disk is nearly full.
+static bool uring_write_all(struct io_uring *ring, int fd, const uint8_t *data, size_t size) {
+    size_t next = 0;
+    int inflight = 0;
+    bool ok = true;
+    while (inflight > 0 || (ok && next < size)) {
+        while (ok && next < size && inflight < CHECKPOINT_QUEUE_DEPTH) {
+            struct io_uring_sqe *sqe = io_uring_get_sqe(ring);
+            if (!sqe) break;
+            size_t len = size - next < CHECKPOINT_CHUNK ? size - next : CHECKPOINT_CHUNK;
+            io_uring_prep_write(sqe, fd, data + next, (unsigned)len, next);
+            io_uring_sqe_set_data(sqe, (void *)(uintptr_t)next);
+            next += len;
+            inflight++;
+        }
+        if (io_uring_submit(ring) < 0) ok = false;
+
+        // In-flight requests still point into the image, so they are
+        // reaped even after an error
+        struct io_uring_cqe *cqe;
+        if (inflight == 0) break;
+        if (io_uring_wait_cqe(ring, &cqe) < 0) return false;
+        size_t offset = (size_t)(uintptr_t)io_uring_cqe_get_data(cqe);
+        int res = cqe->res;
+        io_uring_cqe_seen(ring, cqe);
+        inflight--;
+
+        size_t len = size - offset < CHECKPOINT_CHUNK ? size - offset : CHECKPOINT_CHUNK;
+        if (res < 0) {
+            ok = false;
+        } else if ((size_t)res < len) {
+            ok = ok && pwrite_all(fd, data + offset + res, len - (size_t)res, offset + (size_t)res);
+        }
+    }
+    return ok;
+}
+#endif
+
+#endif // !_WIN32
+
+static bool write_file(Writer *w, const char *path, const uint8_t *data, size_t size) {
+    char tmp[CONFIG_PATH_MAX + 128];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+
+    #ifdef _WIN32
+        (void)w;
+        FILE *f = fopen(tmp, "wb");
+        if (!f) return false;
+        bool ok = fwrite(data, 1, size, f) == size;
+        ok = (fflush(f) == 0) && ok;
+        ok = (fclose(f) == 0) && ok;
+        ok = ok && MoveFileExA(tmp, path, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+    #else
+        int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) return false;
+        bool ok;
+        #ifdef CONA_HAVE_LIBURING
+            if (w->have_ring) ok = uring_write_all(&w->ring, fd, data, size);
+            else ok = pwrite_all(fd, data, size, 0);
+        #else
+            (void)w;
+            ok = pwrite_all(fd, data, size, 0);
+        #endif
+        // The data has to be on disk before the rename is, or a crash could
+        // leave an empty file under the final name
+        ok = ok && fsync(fd) == 0;
+        ok = (close(fd) == 0) && ok;
+        ok = ok && rename(tmp, path) == 0;
+    #endif
+    if (!ok) remove(tmp);
+    return ok;
+}
+
+static void *checkpoint_main(void *arg) {
+    Checkpointer *c = arg;
+
+    pthread_mutex_lock(&c->lock);
+    for (;;) {
+        while (c->pending < 0 && !c->quit) pthread_cond_wait(&c->cond, &c->lock);
+        if (c->pending < 0) break;
+        c->writing = c->pending;
+        c->pending = -1;
+        pthread_mutex_unlock(&c->lock);
+
+        long long t0 = now_ns();
+        if (write_file(c->io, c->path, c->image[c->writing], c->size)) {
+            atomic_store_explicit(&c->write_ns, now_ns() - t0, memory_order_relaxed);
+            atomic_fetch_add_explicit(&c->saved, 1, memory_order_relaxed);
+        } else {
+            fprintf(stderr, "ERROR: could not write checkpoint %s\n", c->path);
+            atomic_fetch_add_explicit(&c->failed, 1, memory_order_relaxed);
+        }
+
+        pthread_mutex_lock(&c->lock);
+        c->writing = -1;
+    }
+    pthread_mutex_unlock(&c->lock);
+    return NULL;
+}
+
+bool checkpoint_start(Checkpointer *c) {
+    if (c->thread_started || !c->io) return c->thread_started;
+    c->quit = false;
+    if (pthread_create(&c->thread, NULL, checkpoint_main, c) != 0) return false;
+    c->thread_started = true;
+    return true;
+}
+
+void checkpoint_stop(Checkpointer *c) {
+    if (!c->thread_started) return;
+    pthread_mutex_lock(&c->lock);
+    c->quit = true;
+    pthread_cond_signal(&c->cond);
+    pthread_mutex_unlock(&c->lock);
+    pthread_join(c->thread, NULL);
+    c->thread_started = false;
+}
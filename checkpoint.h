@@ -0,0 +1,62 @@
+#ifndef CHECKPOINT_H_
+#define CHECKPOINT_H_
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "config.h"
+#include "model.h"
+#include "nn.h"
+
+// Bytes per write request, and requests in flight with io_uring
+#define CHECKPOINT_CHUNK (4u << 20)
+#define CHECKPOINT_QUEUE_DEPTH 8
+
+// Periodic model files written in the background. The training thread
+// renders the weights into one of two preallocated file images, which is
+// a plain memcpy, and hands it to an I/O thread. That thread writes it to
+// a temporary file with large sequential writes (io_uring when built with
+// liburing, pwrite otherwise), syncs it and renames it over `path`, so the
+// file on disk is always a complete model in the model.h format.
+//
+// While one image is being written the other can be filled. If both are
+// busy the capture is skipped rather than blocking training.
+typedef struct {
+    char path[CONFIG_PATH_MAX];
+    size_t size;           // bytes per image, fixed by the topology
+    uint8_t *image[2];
+
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int pending;           // image waiting for the I/O thread, -1 = none
+    int writing;           // image being written, -1 = none
+    bool quit;
+    pthread_t thread;
+    bool thread_started;
+    void *io;              // backend state, only touched by the I/O thread
+    const char *backend;   // "io_uring" or "pwrite"
+
+    // Statistics, read by the renderer
+    _Atomic long long saved;
+    _Atomic long long skipped;
+    _Atomic long long failed;
+    _Atomic long long copy_ns;    // training thread cost of the last capture
+    _Atomic long long write_ns;   // I/O thread time of the last write, sync included
+} Checkpointer;
+
+bool checkpoint_init(Checkpointer *c, const Mlp *nn, const char *path);
+void checkpoint_free(Checkpointer *c);
+
+// The I/O thread runs code from this module, so it is stopped around hot
+// reloads. Stopping waits for a queued image to reach the disk.
+bool checkpoint_start(Checkpointer *c);
+void checkpoint_stop(Checkpointer *c);
+
+// Training thread: copies the weights of `nn` into a free image and queues
+// it. Returns false if no image was free or the topology no longer fits.
+bool checkpoint_capture(Checkpointer *c, const Mlp *nn);
+
+#endif // CHECKPOINT_H_
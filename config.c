@@ -0,0 +1,185 @@
+#include <ctype.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h"
+
+typedef enum {
+    CONFIG_INT,
+    CONFIG_FLOAT,
+    CONFIG_BOOL,
+    CONFIG_STRING,
+    CONFIG_INT_LIST,
+} ConfigType;
+
+typedef struct {
+    const char *key;
+    ConfigType type;
+    size_t offset;
+} ConfigField;
+
+#define FIELD(name, type) { #name, type, offsetof(Config, name) }
+
+static const ConfigField fields[] = {
+    FIELD(input_rows,        CONFIG_INT),
+    FIELD(input_cols,        CONFIG_INT),
+    FIELD(mnist_images,      CONFIG_STRING),
+    FIELD(mnist_labels,      CONFIG_STRING),
+    FIELD(dataset_cache,     CONFIG_STRING),
+    FIELD(dataset_transpose, CONFIG_BOOL),
+    FIELD(conv_layers,       CONFIG_INT_LIST),
+    FIELD(conv_kernel,       CONFIG_INT),
+    FIELD(conv_pool,         CONFIG_INT),
+    FIELD(hidden_layers,     CONFIG_INT_LIST),
+    FIELD(output_size,       CONFIG_INT),
+    FIELD(model_path,        CONFIG_STRING),
+    FIELD(synapse_density,   CONFIG_FLOAT),
+    FIELD(prune_threshold,   CONFIG_FLOAT),
+    FIELD(batch_size,        CONFIG_INT),
+    FIELD(batch_view,        CONFIG_INT),
+    FIELD(learning_rate,     CONFIG_FLOAT),
+    FIELD(optimizer,         CONFIG_STRING),
+    FIELD(momentum,          CONFIG_FLOAT),
+    FIELD(adam_beta1,        CONFIG_FLOAT),
+    FIELD(adam_beta2,        CONFIG_FLOAT),
+    FIELD(adam_eps,          CONFIG_FLOAT),
+    FIELD(weight_decay,      CONFIG_FLOAT),
+    FIELD(autodiff,          CONFIG_BOOL),
+    FIELD(checkpoint_path,   CONFIG_STRING),
+    FIELD(checkpoint_interval, CONFIG_FLOAT),
+    FIELD(record_path,       CONFIG_STRING),
+    FIELD(replay_path,       CONFIG_STRING),
+    FIELD(shm_source,        CONFIG_STRING),
+    FIELD(metrics_socket,    CONFIG_STRING),
+    FIELD(run_mode,          CONFIG_STRING),
+    FIELD(menu_run_mode,     CONFIG_STRING),
+    FIELD(time_scale,        CONFIG_FLOAT),
+    FIELD(threads,           CONFIG_INT),
+};
+
+#undef FIELD
+
+void config_defaults(Config *c) {
+    memset(c, 0, sizeof(*c));
+    c->input_rows = 8;
+    c->input_cols = 8;
+    c->conv_kernel = 3;
+    c->conv_pool = 2;
+    c->hidden_layers = (ConfigIntList){ .count = 2, .values = { 16, 16 } };
+    c->output_size = 10;
+    c->synapse_density = 1.0f;
+    c->prune_threshold = 0.0f;
+    c->batch_size = 16;
+    c->batch_view = 64;
+    c->learning_rate = 0.1f;
+    strcpy(c->optimizer, "sgd");
+    c->momentum = 0.9f;
+    c->adam_beta1 = 0.9f;
+    c->adam_beta2 = 0.999f;
+    c->adam_eps = 1e-8f;
+    c->weight_decay = 0.01f;
+    c->autodiff = false;
+    c->checkpoint_interval = 30.0f;
+    strcpy(c->run_mode, "train");
+    strcpy(c->menu_run_mode, "train");
+    c->time_scale = 0.0f;
+    c->threads = 0;
+}
+
+static char *trim(char *s) {
+    while (isspace((unsigned char)*s)) s++;
+    char *end = s + strlen(s);
+    while (end > s && isspace((unsigned char)end[-1])) end--;
+    *end = '\0';
+    return s;
+}
+
+static bool parse_value(Config *c, const ConfigField *f, const char *value) {
+    void *dst = (char *)c + f->offset;
+    char *end = NULL;
+    switch (f->type) {
+        case CONFIG_INT: {
+            long v = strtol(value, &end, 10);
+            if (end == value || *end) return false;
+            *(int *)dst = (int)v;
+            return true;
+        }
+        case CONFIG_FLOAT: {
+            float v = strtof(value, &end);
+            if (end == value || *end) return false;
+            *(float *)dst = v;
+            return true;
+        }
+        case CONFIG_BOOL:
+            if (strcmp(value, "1") == 0 || strcmp(value, "true") == 0 || strcmp(value, "yes") == 0) {
+                *(bool *)dst = true;
+                return true;
+            }
+            if (strcmp(value, "0") == 0 || strcmp(value, "false") == 0 || strcmp(value, "no") == 0) {
+                *(bool *)dst = false;
+                return true;
+            }
+            return false;
+        case CONFIG_STRING:
+            if (strlen(value) >= CONFIG_PATH_MAX) return false;
+            strcpy((char *)dst, value);
+            return true;
+        case CONFIG_INT_LIST: {
+            ConfigIntList list = {0};
+            const char *s = value;
+            for (;;) {
+                while (isspace((unsigned char)*s) || *s == ',') s++;
+                if (!*s) break;
+                if (list.count == CONFIG_LIST_MAX) return false;
+                long v = strtol(s, &end, 10);
+                if (end == s || (*end && *end != ',' && !isspace((unsigned char)*end))) return false;
+                list.values[list.count++] = (int)v;
+                s = end;
+            }
+            *(ConfigIntList *)dst = list;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool config_load(Config *c, const char *path) {
+    FILE *f = fopen(path, "r");
+    if (!f) return false;
+
+    char line[1024];
+    int line_no = 0;
+    while (fgets(line, sizeof(line), f)) {
+        line_no++;
+        char *hash = strchr(line, '#');
+        if (hash) *hash = '\0';
+        char *s = trim(line);
+        if (*s == '\0') continue;
+
+        char *eq = strchr(s, '=');
+        if (!eq) {
+            fprintf(stderr, "WARNING: %s:%d: expected key = value\n", path, line_no);
+            continue;
+        }
+        *eq = '\0';
+        char *key = trim(s);
+        char *value = trim(eq + 1);
+
+        const ConfigField *field = NULL;
+        for (size_t i = 0; i < sizeof(fields)/sizeof(fields[0]); i++) {
+            if (strcmp(fields[i].key, key) == 0) field = &fields[i];
+        }
+        if (!field) {
+            fprintf(stderr, "WARNING: %s:%d: unknown key '%s'\n", path, line_no, key);
+            continue;
+        }
+        if (!parse_value(c, field, value)) {
+            fprintf(stderr, "WARNING: %s:%d: invalid value '%s' for %s\n", path, line_no, value, key);
+        }
+    }
+
+    fclose(f);
+    return true;
+}
@@ -0,0 +1,72 @@
+#ifndef CONFIG_H_
+#define CONFIG_H_
+
+#include <stdbool.h>
+
+#define CONFIG_PATH "cona.cfg"
+#define CONFIG_PATH_MAX 512
+#define CONFIG_LIST_MAX 64
+
+// Comma or space separated integers
+typedef struct {
+    int count;
+    int values[CONFIG_LIST_MAX];
+} ConfigIntList;
+
+// Runtime settings, read from `key = value` lines in cona.cfg. Anything not
+// present keeps its default. See cona.cfg for documentation of every key.
+typedef struct {
+    // Input image size the dataset is downsampled to
+    int input_rows;
+    int input_cols;
+
+    // Optional MNIST/EMNIST IDX files. Empty means the built-in FONT_DIGITS.
+    char mnist_images[CONFIG_PATH_MAX];
+    char mnist_labels[CONFIG_PATH_MAX];
+    char dataset_cache[CONFIG_PATH_MAX]; // empty: derived from mnist_images
+    bool dataset_transpose;              // EMNIST stores images transposed
+
+    // Network topology. The input layer is input_rows x input_cols.
+    ConfigIntList conv_layers;   // channels of convolution stages before the hidden layers
+    int conv_kernel;             // side of their kernels, padded to keep the map size
+    int conv_pool;               // max-pool window (and stride) after each stage, < 2 = none
+    ConfigIntList hidden_layers; // widths, input side first
+    int output_size;
+    char model_path[CONFIG_PATH_MAX]; // pretrained weights, empty = random init
+    float synapse_density;       // fraction of connections kept, 1 = dense
+    float prune_threshold;       // remove weights below this magnitude, 0 = off
+
+    // Training
+    int batch_size;      // samples per update, split across threads
+    int batch_view;      // samples of each batch published for the batch view, 0 = off
+    float learning_rate;
+    char optimizer[CONFIG_PATH_MAX]; // sgd, momentum, adam or adamw
+    float momentum;
+    float adam_beta1;
+    float adam_beta2;
+    float adam_eps;
+    float weight_decay;  // adamw only
+    bool autodiff;       // backward pass through the autodiff tape
+    char checkpoint_path[CONFIG_PATH_MAX]; // background model saves, empty = off
+    float checkpoint_interval;             // seconds between them
+    char record_path[CONFIG_PATH_MAX];     // run log of every shown snapshot, empty = off
+    char replay_path[CONFIG_PATH_MAX];     // run log to play back instead of training
+    char shm_source[CONFIG_PATH_MAX];      // shared-memory ring of an external trainer, empty = off
+    char metrics_socket[CONFIG_PATH_MAX];  // Unix-domain socket for streamed metrics, empty = off
+
+    // What the worker does: train, float or int8 (inference only)
+    char run_mode[CONFIG_PATH_MAX];
+    char menu_run_mode[CONFIG_PATH_MAX];   // the same while the menu is shown
+
+    float time_scale;  // training steps per animation cycle, 0 = as fast as possible
+
+    int threads; // worker threads for parallel stages, 0 = one per CPU
+} Config;
+
+void config_defaults(Config *c);
+
+// Applies the file on top of the current values. Returns false if the file
+// could not be opened; malformed lines are reported and skipped.
+bool config_load(Config *c, const char *path);
+
+#endif // CONFIG_H_
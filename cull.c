@@ -0,0 +1,170 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cull.h"
+
+static void box_empty(CullBox *b) {
+    for (int a = 0; a < 3; a++) {
+        b->lo[a] = INFINITY;
+        b->hi[a] = -INFINITY;
+    }
+}
+
+static void box_add(CullBox *b, const float p[3], float radius) {
+    for (int a = 0; a < 3; a++) {
+        b->lo[a] = p[a] - radius < b->lo[a] ? p[a] - radius : b->lo[a];
+        b->hi[a] = p[a] + radius > b->hi[a] ? p[a] + radius : b->hi[a];
+    }
+}
+
+void cull_grid_free(CullGrid *g) {
+    free(g->cell_box);
+    free(g->cell_start);
+    free(g->items);
+    memset(g, 0, sizeof(*g));
+}
+
+bool cull_grid_build(CullGrid *g, const float *xyz, int count, float radius) {
+    cull_grid_free(g);
+    g->count = count;
+    box_empty(&g->bounds);
+    for (int i = 0; i < count; i++) box_add(&g->bounds, xyz + 3 * i, 0.0f);
+
+    // Square cells over the axes the points spread along: a layer is a
+    // plane, a line or a single point
+    int target = (count + CULL_CELL_ITEMS - 1) / CULL_CELL_ITEMS;
+    float extent[3], volume = 1.0f;
+    int axes = 0;
+    for (int a = 0; a < 3; a++) {
+        extent[a] = count > 0 ? g->bounds.hi[a] - g->bounds.lo[a] : 0.0f;
+        if (extent[a] > 1e-6f) {
+            volume *= extent[a];
+            axes++;
+        }
+    }
+    float side = axes > 0 && target > 1 ? powf(volume / target, 1.0f / axes) : INFINITY;
+    int dims[3];
+    g->cells = 1;
+    for (int a = 0; a < 3; a++) {
+        dims[a] = extent[a] > 1e-6f ? (int)ceilf(extent[a] / side) : 1;
+        dims[a] = dims[a] < 1 ? 1 : dims[a] > target ? target : dims[a];
+        g->cells *= dims[a];
+    }
+
+    g->cell_box = malloc(sizeof(CullBox) * g->cells);
+    g->cell_start = calloc(g->cells + 1, sizeof(int));
+    g->items = malloc(sizeof(int) * (count > 0 ? count : 1));
+    int *cell_of = malloc(sizeof(int) * (count > 0 ? count : 1));
+    if (!g->cell_box || !g->cell_start || !g->items || !cell_of) {
+        free(cell_of);
+        cull_grid_free(g);
+        return false;
+    }
+
+    // Counting sort of the points by cell
+    for (int i = 0; i < count; i++) {
+        int c = 0;
+        for (int a = 2; a >= 0; a--) {
+            int k = dims[a] > 1 ? (int)((xyz[3 * i + a] - g->bounds.lo[a]) / side) : 0;
+            k = k < 0 ? 0 : k >= dims[a] ? dims[a] - 1 : k;
+            c = c * dims[a] + k;
+        }
+        cell_of[i] = c;
+        g->cell_start[c + 1]++;
+    }
+    for (int c = 0; c < g->cells; c++) g->cell_start[c + 1] += g->cell_start[c];
+    for (int c = 0; c < g->cells; c++) box_empty(&g->cell_box[c]);
+    int *next = malloc(sizeof(int) * g->cells);
+    if (!next) {
+        free(cell_of);
+        cull_grid_free(g);
+        return false;
+    }
+    memcpy(next, g->cell_start, sizeof(int) * g->cells);
+    for (int i = 0; i < count; i++) {
+        g->items[next[cell_of[i]]++] = i;
+        box_add(&g->cell_box[cell_of[i]], xyz + 3 * i, radius);
+    }
+    free(next);
+    free(cell_of);
+
+    box_empty(&g->bounds);
+    for (int c = 0; c < g->cells; c++) {
+        if (g->cell_start[c] == g->cell_start[c + 1]) continue;
+        box_add(&g->bounds, g->cell_box[c].lo, 0.0f);
+        box_add(&g->bounds, g->cell_box[c].hi, 0.0f);
+    }
+    return true;
+}
+
+void frustum_from_matrix(Frustum *f, const float m[16]) {
+    // Row r of the matrix is m[r], m[4 + r], m[8 + r], m[12 + r]. A point
+    // is inside when -w <= x, y, z <= w in clip space, one plane per bound.
+    for (int k = 0; k < CULL_PLANES; k++) {
+        int r = k / 2;
+        float sign = k % 2 == 0 ? 1.0f : -1.0f;
+        for (int c = 0; c < 4; c++) f->plane[k][c] = m[4 * c + 3] + sign * m[4 * c + r];
+        float len = sqrtf(f->plane[k][0] * f->plane[k][0] + f->plane[k][1] * f->plane[k][1] +
+                          f->plane[k][2] * f->plane[k][2]);
+        if (len > 0.0f) {
+            for (int c = 0; c < 4; c++) f->plane[k][c] /= len;
+        }
+    }
+}
+
+unsigned frustum_outcode(const Frustum *f, const float p[3], float margin) {
+    unsigned code = 0;
+    for (int k = 0; k < CULL_PLANES; k++) {
+        const float *q = f->plane[k];
+        code |= (unsigned)(q[0] * p[0] + q[1] * p[1] + q[2] * p[2] + q[3] < -margin) << k;
+    }
+    return code;
+}
+
+unsigned frustum_box(const Frustum *f, const CullBox *b, bool *inside) {
+    unsigned code = 0;
+    *inside = true;
+    for (int k = 0; k < CULL_PLANES; k++) {
+        const float *q = f->plane[k];
+        // The corners farthest inside and farthest outside along the normal
+        float near = q[3], far = q[3];
+        for (int a = 0; a < 3; a++) {
+            float lo = q[a] * b->lo[a], hi = q[a] * b->hi[a];
+            near += lo > hi ? lo : hi;
+            far += lo > hi ? hi : lo;
+        }
+        code |= (unsigned)(near < 0.0f) << k;
+        if (far < 0.0f) *inside = false;
+    }
+    return code;
+}
+
+// Widening the boxes by the radius keeps whole-cell results consistent
+// with the points' own: a box outside a plane holds only points more than
+// the radius outside it, and a box inside holds none.
+int cull_grid_classify(const CullGrid *g, const Frustum *f, const float *xyz, float margin, unsigned char *codes) {
+    bool inside;
+    unsigned code = frustum_box(f, &g->bounds, &inside);
+    if (code || inside) {
+        memset(codes, (int)code, g->count);
+        return code ? g->count : 0;
+    }
+    int outside = 0;
+    for (int c = 0; c < g->cells; c++) {
+        int first = g->cell_start[c], last = g->cell_start[c + 1];
+        if (first == last) continue;
+        code = frustum_box(f, &g->cell_box[c], &inside);
+        if (code || inside) {
+            for (int i = first; i < last; i++) codes[g->items[i]] = (unsigned char)code;
+            if (code) outside += last - first;
+            continue;
+        }
+        for (int i = first; i < last; i++) {
+            int item = g->items[i];
+            codes[item] = (unsigned char)frustum_outcode(f, xyz + 3 * item, margin);
+            outside += codes[item] != 0;
+        }
+    }
+    return outside;
+}
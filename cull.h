@@ -0,0 +1,59 @@
+#ifndef CULL_H_
+#define CULL_H_
+
+#include <stdbool.h>
+
+// Points per cell a grid aims for
+#define CULL_CELL_ITEMS 64
+
+// Bits of frustum_outcode: left, right, bottom, top, near, far
+#define CULL_PLANES 6
+
+typedef struct {
+    float lo[3], hi[3];
+} CullBox;
+
+// View frustum as six normalized planes a x + b y + c z + d, positive on
+// the inside, so a plane's value is a distance in world units
+typedef struct {
+    float plane[CULL_PLANES][4];
+} Frustum;
+
+// Points of one layer, e.g. neuron centers, bucketed into a uniform grid
+// over the layer's extent, with the bounds of every cell. The points are
+// the caller's and must not move; built once per layout.
+typedef struct {
+    CullBox bounds;      // of every point, widened by the radius
+    int count;
+    int cells;
+    CullBox *cell_box;   // widened by the radius
+    int *cell_start;     // cells + 1 entries; cell c owns items[cell_start[c] .. cell_start[c+1])
+    int *items;          // point indices grouped by cell
+} CullGrid;
+
+// Buckets `count` points of xyz (x, y, z per point, e.g. an array of raylib
+// Vector3) into cells of about CULL_CELL_ITEMS. Boxes are widened by
+// `radius`, the largest a point is drawn with. False when out of memory.
+bool cull_grid_build(CullGrid *g, const float *xyz, int count, float radius);
+void cull_grid_free(CullGrid *g);
+
+// Planes of a column-major view-projection matrix, as raylib's Matrix and
+// MatrixToFloat lay it out
+void frustum_from_matrix(Frustum *f, const float m[16]);
+
+// Bits of the planes the point is more than `margin` outside of; 0 for a
+// sphere of radius margin that may be visible
+unsigned frustum_outcode(const Frustum *f, const float p[3], float margin);
+
+// Bits of the planes the box lies entirely outside of, and in *inside
+// whether it lies entirely inside. A box with neither straddles a plane.
+unsigned frustum_box(const Frustum *f, const CullBox *b, bool *inside);
+
+// Outcodes of every point of the grid with `margin`, the radius its boxes
+// were built with, into codes[point]. Cells inside or outside the frustum
+// as a whole set theirs without testing each point. A segment between two
+// points is outside when their codes share a bit. Returns the points
+// with a nonzero code.
+int cull_grid_classify(const CullGrid *g, const Frustum *f, const float *xyz, float margin, unsigned char *codes);
+
+#endif // CULL_H_
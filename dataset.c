@@ -0,0 +1,279 @@
+#define _POSIX_C_SOURCE 200809L
+#include <math.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h"
+#include "dataset.h"
+#include "parallel.h"
+
+#define IDX_TYPE_UBYTE 0x08
+#define IDX_MAX_DIMS 3
+#define DATASET_ALIGN 64
+#define DATASET_MAX_TAPS 64
+
+// IDX header view into the mapping; dims are big-endian on disk
+typedef struct {
+    int ndims;
+    uint32_t dims[IDX_MAX_DIMS];
+    const uint8_t *data;
+} IdxView;
+
+static uint32_t read_be32(const uint8_t *b) {
+    return ((uint32_t)b[0] << 24) | ((uint32_t)b[1] << 16) | ((uint32_t)b[2] << 8) | b[3];
+}
+
+static bool idx_parse(const MappedFile *mf, int expect_dims, IdxView *v, const char *path) {
+    const uint8_t *b = mf->data;
+    if (mf->size < 4 || b[0] != 0 || b[1] != 0 || b[2] != IDX_TYPE_UBYTE || b[3] != expect_dims) {
+        fprintf(stderr, "ERROR: %s is not an unsigned byte IDX file with %d dimensions\n", path, expect_dims);
+        return false;
+    }
+    size_t header = 4 + 4 * (size_t)expect_dims;
+    if (mf->size < header) {
+        fprintf(stderr, "ERROR: %s: truncated header\n", path);
+        return false;
+    }
+    v->ndims = expect_dims;
+    size_t total = 1;
+    for (int i = 0; i < expect_dims; i++) {
+        v->dims[i] = read_be32(b + 4 + 4 * i);
+        total *= v->dims[i];
+    }
+    if (mf->size < header + total) {
+        fprintf(stderr, "ERROR: %s: expected %zu bytes of data, file has %zu\n", path, total, mf->size - header);
+        return false;
+    }
+    v->data = b + header;
+    return true;
+}
+
+// Area-averaging footprint of each destination pixel along one axis
+typedef struct {
+    int start[DATASET_MAX_TAPS];
+    int taps[DATASET_MAX_TAPS];
+    float weight[DATASET_MAX_TAPS][DATASET_MAX_TAPS];
+} AxisFilter;
+
+static bool axis_filter_init(AxisFilter *f, int src, int dst) {
+    float scale = (float)src / dst;
+    if (dst > DATASET_MAX_TAPS || ceilf(scale) + 1 > DATASET_MAX_TAPS) return false;
+    for (int o = 0; o < dst; o++) {
+        float lo = o * scale, hi = (o + 1) * scale;
+        int first = (int)floorf(lo);
+        int last = (int)ceilf(hi) - 1;
+        if (last >= src) last = src - 1;
+        f->start[o] = first;
+        f->taps[o] = last - first + 1;
+        for (int i = first; i <= last; i++) {
+            float cover = fminf(hi, (float)(i + 1)) - fmaxf(lo, (float)i);
+            f->weight[o][i - first] = cover > 0.0f ? cover / scale : 0.0f;
+        }
+    }
+    return true;
+}
+
+typedef struct {
+    const uint8_t *src;
+    uint8_t *dst;
+    int src_rows, src_cols;
+    int rows, cols;
+    bool transpose;
+    AxisFilter fx, fy;
+    atomic_bool failed;     // a range could not get its scratch row, images are missing
+} DownsampleJob;
+
+static void downsample_range(void *ctx, int begin, int end) {
+    DownsampleJob *job = ctx;
+    size_t src_stride = (size_t)job->src_rows * job->src_cols;
+    size_t dst_stride = (size_t)job->rows * job->cols;
+    float *tmp = malloc(sizeof(float) * job->src_rows * job->cols);
+    if (!tmp) {
+        atomic_store(&job->failed, true);
+        return;
+    }
+
+    for (int n = begin; n < end; n++) {
+        const uint8_t *img = job->src + n * src_stride;
+        uint8_t *out = job->dst + n * dst_stride;
+
+        // Horizontal pass: every source row collapsed to `cols` samples
+        for (int y = 0; y < job->src_rows; y++) {
+            for (int ox = 0; ox < job->cols; ox++) {
+                float acc = 0.0f;
+                for (int t = 0; t < job->fx.taps[ox]; t++) {
+                    int x = job->fx.start[ox] + t;
+                    uint8_t px = job->transpose ? img[(size_t)x * job->src_rows + y] : img[(size_t)y * job->src_cols + x];
+                    acc += job->fx.weight[ox][t] * px;
+                }
+                tmp[y * job->cols + ox] = acc;
+            }
+        }
+        // Vertical pass
+        for (int oy = 0; oy < job->rows; oy++) {
+            for (int ox = 0; ox < job->cols; ox++) {
+                float acc = 0.0f;
+                for (int t = 0; t < job->fy.taps[oy]; t++) {
+                    acc += job->fy.weight[oy][t] * tmp[(job->fy.start[oy] + t) * job->cols + ox];
+                }
+                int v = (int)(acc + 0.5f);
+                out[oy * job->cols + ox] = (uint8_t)(v > 255 ? 255 : v);
+            }
+        }
+    }
+    free(tmp);
+}
+
+static size_t align_up(size_t v) {
+    return (v + DATASET_ALIGN - 1) & ~(size_t)(DATASET_ALIGN - 1);
+}
+
+static bool set_from_blob(Dataset *ds, const uint8_t *blob, size_t size) {
+    const DatasetCacheHeader *h = (const DatasetCacheHeader *)blob;
+    size_t need = h->pixels_offset + (size_t)h->count * h->rows * h->cols;
+    if (size < need || h->labels_offset + h->count > h->pixels_offset) return false;
+    ds->count = (int)h->count;
+    ds->rows = (int)h->rows;
+    ds->cols = (int)h->cols;
+    ds->classes = (int)h->classes;
+    ds->labels = blob + h->labels_offset;
+    ds->pixels = blob + h->pixels_offset;
+    return true;
+}
+
+static bool try_load_cache(Dataset *ds, const char *cache_path, int rows, int cols, bool transpose,
+                           bool have_source, uint64_t src_size, uint64_t src_mtime) {
+    if (!stat_file(cache_path, NULL, NULL)) return false;
+    if (!map_file(&ds->cache, cache_path, MAP_READ_ONLY)) return false;
+
+    const DatasetCacheHeader *h = ds->cache.data;
+    bool ok = ds->cache.size >= sizeof(*h)
+        && memcmp(h->magic, DATASET_CACHE_MAGIC, 8) == 0
+        && h->version == DATASET_CACHE_VERSION
+        && h->rows == (uint32_t)rows && h->cols == (uint32_t)cols
+        && h->transposed == (uint32_t)transpose
+        && (!have_source || (h->source_size == src_size && h->source_mtime == src_mtime))
+        && set_from_blob(ds, ds->cache.data, ds->cache.size);
+    if (!ok) unmap_file(&ds->cache);
+    return ok;
+}
+
+static void write_cache(const char *cache_path, const uint8_t *blob, size_t size) {
+    char tmp[CONFIG_PATH_MAX + 128];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", cache_path);
+    FILE *f = fopen(tmp, "wb");
+    if (!f) {
+        fprintf(stderr, "WARNING: could not write dataset cache %s\n", tmp);
+        return;
+    }
+    bool ok = fwrite(blob, 1, size, f) == size;
+    ok = (fclose(f) == 0) && ok;
+    if (!ok || rename(tmp, cache_path) != 0) {
+        fprintf(stderr, "WARNING: could not write dataset cache %s\n", cache_path);
+        remove(tmp);
+    }
+}
+
+bool dataset_load_idx(Dataset *ds, const char *images_path, const char *labels_path,
+                      int rows, int cols, bool transpose, const char *cache_path, int threads) {
+    memset(ds, 0, sizeof(*ds));
+    if (rows <= 0 || cols <= 0) return false;
+
+    char derived[CONFIG_PATH_MAX + 64];
+    if (!cache_path || !*cache_path) {
+        snprintf(derived, sizeof(derived), "%s.%dx%d.cache", images_path, rows, cols);
+        cache_path = derived;
+    }
+
+    uint64_t src_size = 0, src_mtime = 0;
+    bool have_source = stat_file(images_path, &src_size, &src_mtime);
+    if (try_load_cache(ds, cache_path, rows, cols, transpose, have_source, src_size, src_mtime)) {
+        return true;
+    }
+    if (!have_source) {
+        fprintf(stderr, "ERROR: could not find %s\n", images_path);
+        return false;
+    }
+
+    MappedFile images = {0}, labels = {0};
+    IdxView iv, lv;
+    bool ok = map_file(&images, images_path, MAP_READ_ONLY) && map_file(&labels, labels_path, MAP_READ_ONLY)
+        && idx_parse(&images, 3, &iv, images_path) && idx_parse(&labels, 1, &lv, labels_path);
+    if (ok && iv.dims[0] != lv.dims[0]) {
+        fprintf(stderr, "ERROR: %s has %u images but %s has %u labels\n", images_path, iv.dims[0], labels_path, lv.dims[0]);
+        ok = false;
+    }
+
+    DownsampleJob job = {
+        .src = ok ? iv.data : NULL,
+        .src_rows = ok ? (int)iv.dims[1] : 0,
+        .src_cols = ok ? (int)iv.dims[2] : 0,
+        .rows = rows, .cols = cols,
+        .transpose = transpose,
+    };
+    if (ok && (!axis_filter_init(&job.fx, job.src_cols, cols) || !axis_filter_init(&job.fy, job.src_rows, rows))) {
+        fprintf(stderr, "ERROR: cannot downsample %dx%d to %dx%d\n", job.src_rows, job.src_cols, rows, cols);
+        ok = false;
+    }
+
+    if (ok) {
+        int count = (int)iv.dims[0];
+        size_t labels_off = align_up(sizeof(DatasetCacheHeader));
+        size_t pixels_off = align_up(labels_off + count);
+        size_t size = pixels_off + (size_t)count * rows * cols;
+        uint8_t *blob = calloc(1, size);
+        if (!blob) {
+            ok = false;
+        } else {
+            DatasetCacheHeader *h = (DatasetCacheHeader *)blob;
+            memcpy(h->magic, DATASET_CACHE_MAGIC, 8);
+            h->version = DATASET_CACHE_VERSION;
+            h->count = (uint32_t)count;
+            h->rows = (uint32_t)rows;
+            h->cols = (uint32_t)cols;
+            h->transposed = transpose;
+            h->source_size = src_size;
+            h->source_mtime = src_mtime;
+            h->labels_offset = labels_off;
+            h->pixels_offset = pixels_off;
+
+            memcpy(blob + labels_off, lv.data, count);
+            for (int i = 0; i < count; i++) {
+                if (lv.data[i] + 1u > h->classes) h->classes = lv.data[i] + 1u;
+            }
+
+            job.dst = blob + pixels_off;
+            parallel_for(count, threads, downsample_range, &job);
+
+            // A partly downsampled set must not be cached as if it were whole
+            if (atomic_load(&job.failed)) {
+                fprintf(stderr, "ERROR: out of memory downsampling %s\n", images_path);
+                free(blob);
+                ok = false;
+            } else {
+                write_cache(cache_path, blob, size);
+                ds->owned = blob;
+                set_from_blob(ds, blob, size);
+            }
+        }
+    }
+
+    unmap_file(&images);
+    unmap_file(&labels);
+    return ok;
+}
+
+void dataset_free(Dataset *ds) {
+    unmap_file(&ds->cache);
+    free(ds->owned);
+    memset(ds, 0, sizeof(*ds));
+}
+
+void dataset_get(const Dataset *ds, int index, float *out, int *label) {
+    int n = ds->rows * ds->cols;
+    const uint8_t *px = ds->pixels + (size_t)index * n;
+    for (int i = 0; i < n; i++) out[i] = px[i] * (1.0f / 255.0f);
+    if (label) *label = ds->labels[index];
+}
@@ -0,0 +1,51 @@
+#ifndef DATASET_H_
+#define DATASET_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "mapfile.h"
+
+#define DATASET_CACHE_MAGIC "CONADSET"
+#define DATASET_CACHE_VERSION 1
+
+// Preprocessed dataset cache. Written in host byte order: it is a local
+// cache, not an interchange format. Labels start at labels_offset, pixels
+// (count * rows * cols bytes, row-major) at pixels_offset.
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t count;
+    uint32_t rows;
+    uint32_t cols;
+    uint32_t classes;
+    uint32_t transposed;
+    uint64_t source_size;   // size and mtime of the IDX image file it came from
+    uint64_t source_mtime;
+    uint64_t labels_offset;
+    uint64_t pixels_offset;
+} DatasetCacheHeader;
+
+typedef struct {
+    int count;
+    int rows, cols;
+    int classes;            // max label + 1
+    const uint8_t *labels;
+    const uint8_t *pixels;  // count images of rows*cols, 0..255
+
+    MappedFile cache;       // backing store when loaded from the cache
+    uint8_t *owned;         // backing store when freshly built
+} Dataset;
+
+// Loads IDX images/labels (MNIST or EMNIST), area-averages every image down
+// to rows x cols on `threads` threads and writes the result to cache_path.
+// Later calls with a cache that matches the source file and size map it
+// directly. cache_path may be NULL to derive it from the images path.
+bool dataset_load_idx(Dataset *ds, const char *images_path, const char *labels_path,
+                      int rows, int cols, bool transpose, const char *cache_path, int threads);
+void dataset_free(Dataset *ds);
+
+// Image `index` as floats in [0, 1].
+void dataset_get(const Dataset *ds, int index, float *out, int *label);
+
+#endif // DATASET_H_
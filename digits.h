@@ -0,0 +1,43 @@
+#ifndef DIGITS_H_
+#define DIGITS_H_
+
+#include "nn.h"
+
+// Bitmaps for Digits 0-9
+static const unsigned char FONT_DIGITS[10][8] = {
+    { 0x3C, 0x42, 0x42, 0x42, 0x42, 0x42, 0x42, 0x3C }, // 0
+    { 0x10, 0x30, 0x10, 0x10, 0x10, 0x10, 0x10, 0x38 }, // 1
+    { 0x3C, 0x42, 0x02, 0x02, 0x3C, 0x40, 0x40, 0x7E }, // 2
+    { 0x3C, 0x42, 0x02, 0x1C, 0x02, 0x02, 0x42, 0x3C }, // 3
+    { 0x0C, 0x14, 0x24, 0x44, 0x7E, 0x04, 0x04, 0x04 }, // 4
+    { 0x7E, 0x40, 0x40, 0x7C, 0x02, 0x02, 0x42, 0x3C }, // 5
+    { 0x3C, 0x40, 0x40, 0x7C, 0x42, 0x42, 0x42, 0x3C }, // 6
+    { 0x7E, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x40 }, // 7
+    { 0x3C, 0x42, 0x42, 0x3C, 0x42, 0x42, 0x42, 0x3C }, // 8
+    { 0x3C, 0x42, 0x42, 0x3E, 0x02, 0x02, 0x02, 0x3C }  // 9
+};
+
+static inline float get_digit_pixel(int digit, int x, int y) {
+    if (digit < 0 || digit > 9) return 0.0f;
+    if (x < 0 || x >= 8 || y < 0 || y >= 8) return 0.0f;
+    unsigned char row = FONT_DIGITS[digit][y];
+    return (row & (1 << (7 - x))) ? 1.0f : 0.0f;
+}
+
+// Digit bitmap rescaled to rows x cols with a random one-pixel shift,
+// intensity jitter and speckle noise, so the network has something to
+// generalize over.
+static inline void make_digit_sample(int digit, NnRng *rng, float *out, int rows, int cols) {
+    int dx = (int)(nn_rng_next(rng) % 3) - 1;
+    int dy = (int)(nn_rng_next(rng) % 3) - 1;
+    float gain = 0.7f + 0.3f * nn_rng_float(rng);
+    for (int y = 0; y < rows; y++) {
+        for (int x = 0; x < cols; x++) {
+            float v = get_digit_pixel(digit, x*8/cols - dx, y*8/rows - dy) * gain;
+            if (nn_rng_float(rng) < 0.04f) v = 1.0f - v;
+            out[y*cols + x] = v;
+        }
+    }
+}
+
+#endif // DIGITS_H_
@@ -0,0 +1,113 @@
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "heatmap.h"
+
+static HeatmapRect tile_rect(const HeatmapTiles *h, int tile) {
+    HeatmapRect r = { (tile % h->tiles_x) * HEATMAP_TILE, (tile / h->tiles_x) * HEATMAP_TILE, HEATMAP_TILE, HEATMAP_TILE };
+    if (r.x + r.width > h->cols) r.width = h->cols - r.x;
+    if (r.y + r.height > h->rows) r.height = h->rows - r.y;
+    return r;
+}
+
+bool heatmap_init(HeatmapTiles *h, int rows, int cols) {
+    memset(h, 0, sizeof(*h));
+    h->rows = rows;
+    h->cols = cols;
+    h->tiles_x = (cols + HEATMAP_TILE - 1) / HEATMAP_TILE;
+    h->tiles_y = (rows + HEATMAP_TILE - 1) / HEATMAP_TILE;
+    h->shadow = malloc(sizeof(float) * (size_t)rows * cols);
+    if (!h->shadow) return false;
+    // Infinitely far from any value, so the first sweep uploads every tile
+    for (size_t i = 0; i < (size_t)rows * cols; i++) h->shadow[i] = INFINITY;
+    return true;
+}
+
+void heatmap_free(HeatmapTiles *h) {
+    free(h->shadow);
+    memset(h, 0, sizeof(*h));
+}
+
+// Tiles of one tile row compared together, so every matrix row is read
+// as one contiguous run rather than 64-float pieces a row apart
+#define HEATMAP_RUN 64
+
+// Largest change and largest |value| of one row of a tile, in one pass
+// without early exits; most tiles are clean and read in full anyway. The
+// max is taken on the bits: with the sign cleared, floats order like
+// unsigned integers, and an integer max vectorizes where a float one
+// would not. Full rows have a constant width so -O2 vectorizes them too.
+#define TILE_ROW(width)                                       \
+    for (int x = 0; x < (width); x++) {                       \
+        uint32_t bits;                                        \
+        memcpy(&bits, &v[x], sizeof(bits));                   \
+        bits &= 0x7fffffffu;                                  \
+        mx = bits > mx ? bits : mx;                           \
+        changed |= fabsf(v[x] - s[x]) > threshold;            \
+    }
+
+static void end_tiles(HeatmapTiles *h, int tiles) {
+    h->cursor += tiles;
+    if (h->cursor == heatmap_tile_count(h)) {
+        h->cursor = 0;
+        h->max_abs = h->sweep_max;
+        h->sweep_max = 0.0f;
+    }
+}
+
+int heatmap_scan(HeatmapTiles *h, const float *values, float threshold, int *budget, int *dirty, int max_dirty) {
+    int count = 0, tiles = heatmap_tile_count(h);
+    int max_tiles = *budget < tiles ? *budget : tiles;
+    while (max_tiles > 0) {
+        int ty = h->cursor / h->tiles_x, tx = h->cursor % h->tiles_x;
+        int run = h->tiles_x - tx;
+        if (run > max_tiles) run = max_tiles;
+        if (run > HEATMAP_RUN) run = HEATMAP_RUN;
+        int y0 = ty * HEATMAP_TILE, y1 = y0 + HEATMAP_TILE < h->rows ? y0 + HEATMAP_TILE : h->rows;
+
+        int flags[HEATMAP_RUN] = { 0 };
+        uint32_t mx;
+        memcpy(&mx, &h->sweep_max, sizeof(mx));
+        for (int y = y0; y < y1; y++) {
+            for (int k = 0; k < run; k++) {
+                int x0 = (tx + k) * HEATMAP_TILE;
+                const float *v = values + (size_t)y * h->cols + x0;
+                const float *s = h->shadow + (size_t)y * h->cols + x0;
+                int changed = 0;
+                if (x0 + HEATMAP_TILE <= h->cols) {
+                    TILE_ROW(HEATMAP_TILE)
+                } else {
+                    TILE_ROW(h->cols - x0)
+                }
+                flags[k] |= changed;
+            }
+        }
+        memcpy(&h->sweep_max, &mx, sizeof(mx));
+        *budget -= run;
+
+        // A dirty tile that does not fit is where the next scan starts
+        for (int k = 0; k < run; k++) {
+            if (!flags[k]) continue;
+            if (count == max_dirty) {
+                end_tiles(h, k);
+                return count;
+            }
+            dirty[count++] = h->cursor + k;
+        }
+        end_tiles(h, run);
+        max_tiles -= run;
+    }
+    return count;
+}
+
+HeatmapRect heatmap_take(HeatmapTiles *h, const float *values, int tile, float *staging) {
+    HeatmapRect r = tile_rect(h, tile);
+    for (int y = 0; y < r.height; y++) {
+        size_t at = (size_t)(r.y + y) * h->cols + r.x;
+        memcpy(h->shadow + at, values + at, sizeof(float) * r.width);
+        memcpy(staging + (size_t)y * r.width, values + at, sizeof(float) * r.width);
+    }
+    return r;
+}
@@ -0,0 +1,32 @@
+#version 330
+
+// Input vertex attributes (from vertex shader)
+in vec2 fragTexCoord;
+in vec4 fragColor;
+
+// Input uniform values
+uniform sampler2D texture0;   // weight matrix, or the output errors as a 1-row texture
+uniform sampler2D texture1;   // input activations as a 1-row texture
+uniform int outerProduct;     // 1: value = texture0[row] * texture1[col]
+uniform float range;          // |value| drawn at full color
+
+// Output fragment color
+out vec4 finalColor;
+
+// Diverging map on the dark background: negative blue, positive orange
+const vec3 zero = vec3(0.04, 0.04, 0.06);
+const vec3 negative = vec3(0.0, 0.47, 1.0);
+const vec3 positive = vec3(1.0, 0.45, 0.1);
+
+void main()
+{
+    float value;
+    if (outerProduct == 1) {
+        value = texture(texture0, vec2(fragTexCoord.y, 0.5)).r * texture(texture1, vec2(fragTexCoord.x, 0.5)).r;
+    } else {
+        value = texture(texture0, fragTexCoord).r;
+    }
+    float t = clamp(value / max(range, 1e-12), -1.0, 1.0);
+    vec3 color = mix(zero, t < 0.0 ? negative : positive, sqrt(abs(t)));
+    finalColor = vec4(color, 1.0) * fragColor;
+}
@@ -0,0 +1,64 @@
+#ifndef HEATMAP_H_
+#define HEATMAP_H_
+
+#include <stdbool.h>
+
+// Side of a square tile, the unit a matrix is compared and uploaded in
+#define HEATMAP_TILE 64
+
+// Tiles compared per frame across every matrix, 512K weights: with the
+// shadow that is 4 MB read, about 0.6 ms in ./bench heatmap. A 4096x4096
+// matrix is swept in 32 frames, and more or larger layers take longer
+// rather than costing more.
+#define HEATMAP_SCAN_TILES 128
+
+// Tiles uploaded per frame across every matrix, 1 MB. Each is also copied
+// into the shadow, so a frame that spends both budgets takes about 1.3 ms.
+#define HEATMAP_UPLOAD_TILES 64
+
+// Color steps over the range; a value has to move by one to be uploaded
+#define HEATMAP_LEVELS 256
+
+typedef struct {
+    int x, y, width, height;
+} HeatmapRect;
+
+// Tracks which tiles of a [rows][cols] matrix differ from what a texture
+// last received, so only those are uploaded. `shadow` mirrors the texture.
+// A tile is dirty when any value moved by more than the threshold, which
+// the caller sets to one step of its color map: training moves every
+// weight a little every step, and drift too small to change a color is
+// left until it adds up.
+//
+// Scans are round robin from a cursor with a budget of tiles, so a large
+// matrix is swept over several frames and the frame cost stays bounded.
+// Several matrices draw from one budget.
+typedef struct {
+    int rows, cols;
+    int tiles_x, tiles_y;
+    float *shadow;
+    int cursor;          // next tile to scan
+    float max_abs;       // largest |value| of the last full sweep, for the color range
+    float sweep_max;     // of the sweep in progress
+    bool fresh;          // nothing uploaded yet, every tile is dirty
+} HeatmapTiles;
+
+bool heatmap_init(HeatmapTiles *h, int rows, int cols);
+void heatmap_free(HeatmapTiles *h);
+
+static inline int heatmap_tile_count(const HeatmapTiles *h) {
+    return h->tiles_x * h->tiles_y;
+}
+
+// Scans up to `*budget` tiles from the cursor, one sweep at most, and
+// stores the dirty ones in `dirty`, at most `max_dirty`. The cursor stops
+// at the first dirty tile that did not fit, so it is found again next
+// time. Takes the tiles read from *budget and returns the number of dirty
+// tiles stored.
+int heatmap_scan(HeatmapTiles *h, const float *values, float threshold, int *budget, int *dirty, int max_dirty);
+
+// Copies `tile` of `values` into the shadow and, tightly packed, into
+// `staging` (HEATMAP_TILE * HEATMAP_TILE floats) for the upload.
+HeatmapRect heatmap_take(HeatmapTiles *h, const float *values, int tile, float *staging);
+
+#endif // HEATMAP_H_
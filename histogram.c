@@ -0,0 +1,102 @@
+#include <math.h>
+#include <string.h>
+
+#include "histogram.h"
+
+// Fraction of the value range added on either side when the range widens
+#define HIST_MARGIN 0.05f
+
+// How far a too-wide range moves toward the values per pass
+#define HIST_SHRINK 0.25f
+
+typedef struct {
+    uint32_t counts[KERNELS_HIST_SUBS * HIST_BINS];
+    float minmax[2];
+} HistPartial;
+
+typedef struct {
+    const float *x;
+    size_t n;
+    float lo, scale;
+    HistPartial *partials;
+} FeedJob;
+
+static void feed_task(void *ctx, int task, int worker) {
+    FeedJob *j = ctx;
+    size_t begin = (size_t)task * HIST_TASK_VALUES;
+    size_t end = begin + HIST_TASK_VALUES < j->n ? begin + HIST_TASK_VALUES : j->n;
+    HistPartial *part = &j->partials[worker];
+    kernels->histogram(j->x + begin, (int)(end - begin), j->lo, j->scale, HIST_BINS, part->counts, part->minmax);
+}
+
+static void start_pass(Histogram *h) {
+    memset(h->pending, 0, sizeof(h->pending));
+    h->pending_min = INFINITY;
+    h->pending_max = -INFINITY;
+    h->cursor = 0;
+}
+
+void histogram_init(Histogram *h) {
+    memset(h, 0, sizeof(*h));
+    h->lo = -1.0f;
+    h->hi = 1.0f;
+    start_pass(h);
+}
+
+// Publishes the pass and picks the range of the next one
+static void end_pass(Histogram *h) {
+    memcpy(h->bins, h->pending, sizeof(h->bins));
+    h->bins_lo = h->lo;
+    h->bins_hi = h->hi;
+    h->min = h->pending_min;
+    h->max = h->pending_max;
+    h->total = (long long)h->length;
+    h->passes++;
+
+    if (isfinite(h->min) && isfinite(h->max)) {
+        float width = h->max - h->min;
+        float margin = width > 0.0f ? width * HIST_MARGIN : fmaxf(fabsf(h->max) * HIST_MARGIN, 1e-6f);
+        float lo = h->min - margin, hi = h->max + margin;
+        h->lo = h->passes == 1 || lo < h->lo ? lo : h->lo + (lo - h->lo) * HIST_SHRINK;
+        h->hi = h->passes == 1 || hi > h->hi ? hi : h->hi + (hi - h->hi) * HIST_SHRINK;
+    }
+    start_pass(h);
+}
+
+size_t histogram_feed(Histogram *h, const float *x, size_t n, size_t budget, ThreadPool *pool) {
+    if (n != h->length) {
+        h->length = n;
+        start_pass(h);
+    }
+    if (n == 0 || budget == 0) return 0;
+    size_t count = n - h->cursor < budget ? n - h->cursor : budget;
+
+    // One partial per worker, so tasks never share counts
+    if (pool_size(pool) > HIST_MAX_WORKERS) pool = NULL;
+    int workers = pool_size(pool);
+    HistPartial partials[HIST_MAX_WORKERS];
+    for (int w = 0; w < workers; w++) {
+        memset(partials[w].counts, 0, sizeof(partials[w].counts));
+        partials[w].minmax[0] = INFINITY;
+        partials[w].minmax[1] = -INFINITY;
+    }
+    FeedJob job = { x + h->cursor, count, h->lo, HIST_BINS / (h->hi - h->lo), partials };
+    pool_run(pool, (int)((count + HIST_TASK_VALUES - 1) / HIST_TASK_VALUES), feed_task, &job);
+
+    for (int w = 0; w < workers; w++) {
+        for (int s = 0; s < KERNELS_HIST_SUBS; s++) {
+            for (int b = 0; b < HIST_BINS; b++) h->pending[b] += partials[w].counts[s * HIST_BINS + b];
+        }
+        h->pending_min = fminf(h->pending_min, partials[w].minmax[0]);
+        h->pending_max = fmaxf(h->pending_max, partials[w].minmax[1]);
+    }
+    h->cursor += count;
+    if (h->cursor == n) end_pass(h);
+    return count;
+}
+
+uint32_t histogram_peak(const Histogram *h) {
+    uint32_t peak = 0;
+    for (int b = 0; b < HIST_BINS; b++) peak = h->bins[b] > peak ? h->bins[b] : peak;
+    return peak;
+}
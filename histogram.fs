@@ -0,0 +1,19 @@
+#version 330
+
+// Input vertex attributes (from vertex shader)
+in vec3 fragNormal;
+
+// Input uniform values
+uniform vec4 colDiffuse;      // color of the kind of histogram
+
+// Output fragment color
+out vec4 finalColor;
+
+// Fixed light from above and in front, so bar edges read without a scene light
+const vec3 light = normalize(vec3(0.3, 1.0, 0.6));
+
+void main()
+{
+    float shade = 0.45 + 0.55 * max(dot(normalize(fragNormal), light), 0.0);
+    finalColor = vec4(colDiffuse.rgb * shade, colDiffuse.a);
+}
@@ -0,0 +1,57 @@
+#ifndef HISTOGRAM_H_
+#define HISTOGRAM_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "kernels.h"
+#include "parallel.h"
+
+#define HIST_BINS 64
+
+// Values per pool task; below this a slice runs on the calling thread
+#define HIST_TASK_VALUES (1 << 16)
+
+// Most pool workers a feed uses, each with its own partial counts
+#define HIST_MAX_WORKERS 16
+
+// Values the renderer bins per frame over all its histograms, about 0.3 ms
+// on one core. A layer of 4M weights is a new histogram every 32 frames.
+#define HIST_FRAME_VALUES (1 << 17)
+
+// Histogram of an array that changes between frames, e.g. one layer's
+// weights. Values are fed in slices of a per-frame budget: a pass over a
+// large array may span several frames, and `bins` shows the last finished
+// pass while the next accumulates in `pending`.
+//
+// The range adapts at the end of each pass. Values outside it are counted
+// in the edge bins; the next pass widens the range to the smallest and
+// largest value seen, with a margin, and a range much wider than the
+// values shrinks toward them over a few passes, so it does not jump
+// around with every outlier that comes and goes.
+typedef struct {
+    float lo, hi;                  // range of the pass in progress
+    uint32_t bins[HIST_BINS];      // last finished pass
+    float bins_lo, bins_hi;        // range those were binned over
+    float min, max;                // smallest and largest value of that pass
+    long long total;
+    long long passes;
+
+    uint32_t pending[HIST_BINS];
+    float pending_min, pending_max;
+    size_t cursor;                 // next value of the pass in progress
+    size_t length;                 // of the array being passed over
+} Histogram;
+
+void histogram_init(Histogram *h);
+
+// Bins up to `budget` values of x[0..n) from where the last call stopped,
+// split over `pool` (NULL runs on the caller) with one partial histogram
+// per worker, summed at the end. Finishing the array ends the pass; an
+// array whose length changed starts a new one. Returns the values binned.
+size_t histogram_feed(Histogram *h, const float *x, size_t n, size_t budget, ThreadPool *pool);
+
+// Largest bin of the last pass, for scaling
+uint32_t histogram_peak(const Histogram *h);
+
+#endif // HISTOGRAM_H_
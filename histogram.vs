@@ -0,0 +1,18 @@
+#version 330
+
+// Input vertex attributes
+in vec3 vertexPosition;
+in vec3 vertexNormal;
+in mat4 instanceTransform;    // one histogram bar: scale and place a unit cube
+
+// Input uniform values
+uniform mat4 mvp;
+
+// Output vertex attributes (to fragment shader)
+out vec3 fragNormal;
+
+void main()
+{
+    fragNormal = normalize(mat3(instanceTransform) * vertexNormal);
+    gl_Position = mvp * instanceTransform * vec4(vertexPosition, 1.0);
+}
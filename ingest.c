@@ -0,0 +1,348 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ingest.h"
+
+#ifndef _WIN32
+    #include <errno.h>
+    #include <fcntl.h>
+    #include <poll.h>
+    #include <sys/socket.h>
+    #include <sys/un.h>
+    #include <unistd.h>
+    #ifdef __linux__
+        #include <sys/epoll.h>
+    #endif
+#endif
+
+_Static_assert(sizeof(IngestSample) == 16, "samples are 16 bytes on the wire");
+
+#define INGEST_FRAME_HEADER 8
+#define INGEST_READ_BYTES (256u << 10)
+#define INGEST_READS_PER_WAKE 16
+
+void ingest_metric_name(Ingest *in, uint32_t metric, char name[INGEST_NAME_MAX]) {
+    name[0] = '\0';
+    if (metric >= INGEST_MAX_METRICS) return;
+    pthread_mutex_lock(&in->names_lock);
+    memcpy(name, in->names[metric], INGEST_NAME_MAX);
+    pthread_mutex_unlock(&in->names_lock);
+}
+
+#ifdef _WIN32
+
+bool ingest_init(Ingest *in, const char *path) {
+    memset(in, 0, sizeof(*in));
+    fprintf(stderr, "ERROR: metrics socket %s needs Unix-domain sockets\n", path);
+    return false;
+}
+
+void ingest_free(Ingest *in) { memset(in, 0, sizeof(*in)); }
+bool ingest_start(Ingest *in) { (void)in; return false; }
+void ingest_stop(Ingest *in) { (void)in; }
+int ingest_connect(const char *path) { (void)path; return -1; }
+void ingest_disconnect(int fd) { (void)fd; }
+bool ingest_send_samples(int fd, const IngestSample *samples, int count) { (void)fd; (void)samples; (void)count; return false; }
+bool ingest_send_name(int fd, uint32_t metric, const char *name) { (void)fd; (void)metric; (void)name; return false; }
+
+#else
+
+static bool set_nonblocking(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0
+        && fcntl(fd, F_SETFD, FD_CLOEXEC) == 0;
+}
+
+static bool socket_address(struct sockaddr_un *addr, const char *path) {
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr->sun_path)) return false;
+    strcpy(addr->sun_path, path);
+    return true;
+}
+
+// Wait set: epoll keeps it in the kernel, the poll fallback rebuilds it
+static bool watch(Ingest *in, int fd, int slot) {
+    #ifdef __linux__
+        struct epoll_event ev = { .events = EPOLLIN, .data.u32 = (uint32_t)slot };
+        return epoll_ctl(in->poll_fd, EPOLL_CTL_ADD, fd, &ev) == 0;
+    #else
+        (void)in; (void)fd; (void)slot;
+        return true;
+    #endif
+}
+
+enum { SLOT_LISTEN = INGEST_MAX_CONNECTIONS, SLOT_WAKE };
+
+bool ingest_init(Ingest *in, const char *path) {
+    memset(in, 0, sizeof(*in));
+    in->listen_fd = in->poll_fd = in->wake[0] = in->wake[1] = -1;
+    for (int i = 0; i < INGEST_MAX_CONNECTIONS; i++) in->connections[i].fd = -1;
+    pthread_mutex_init(&in->names_lock, NULL);
+    snprintf(in->path, sizeof(in->path), "%s", path);
+
+    struct sockaddr_un addr;
+    if (!socket_address(&addr, path)) {
+        fprintf(stderr, "ERROR: metrics socket path %s is too long\n", path);
+        ingest_free(in);
+        return false;
+    }
+    in->items = malloc(sizeof(IngestSample) * INGEST_QUEUE_CAPACITY);
+    if (!in->items) {
+        ingest_free(in);
+        return false;
+    }
+    spsc_queue_init(&in->queue, in->items, sizeof(IngestSample), INGEST_QUEUE_CAPACITY);
+
+    // A socket file left by a previous run refuses the bind
+    unlink(path);
+    in->listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    bool ok = in->listen_fd >= 0 && set_nonblocking(in->listen_fd)
+           && bind(in->listen_fd, (struct sockaddr *)&addr, sizeof(addr)) == 0
+           && listen(in->listen_fd, INGEST_MAX_CONNECTIONS) == 0
+           && pipe(in->wake) == 0 && set_nonblocking(in->wake[0]) && set_nonblocking(in->wake[1]);
+    #ifdef __linux__
+        ok = ok && (in->poll_fd = epoll_create1(EPOLL_CLOEXEC)) >= 0
+                && watch(in, in->listen_fd, SLOT_LISTEN) && watch(in, in->wake[0], SLOT_WAKE);
+    #endif
+    if (!ok) {
+        fprintf(stderr, "ERROR: could not listen on %s: %s\n", path, strerror(errno));
+        ingest_free(in);
+        return false;
+    }
+    return true;
+}
+
+static void close_connection(Ingest *in, IngestConnection *c) {
+    // Closing the descriptor also removes it from the epoll set
+    close(c->fd);
+    c->fd = -1;
+    c->used = 0;
+    atomic_fetch_sub_explicit(&in->clients, 1, memory_order_relaxed);
+}
+
+void ingest_free(Ingest *in) {
+    ingest_stop(in);
+    for (int i = 0; i < INGEST_MAX_CONNECTIONS; i++) {
+        if (in->connections[i].fd >= 0) close_connection(in, &in->connections[i]);
+        free(in->connections[i].buffer);
+    }
+    if (in->listen_fd >= 0) {
+        close(in->listen_fd);
+        unlink(in->path);
+    }
+    if (in->poll_fd >= 0) close(in->poll_fd);
+    if (in->wake[0] >= 0) close(in->wake[0]);
+    if (in->wake[1] >= 0) close(in->wake[1]);
+    pthread_mutex_destroy(&in->names_lock);
+    free(in->items);
+    memset(in, 0, sizeof(*in));
+    in->listen_fd = in->poll_fd = in->wake[0] = in->wake[1] = -1;
+}
+
+static void accept_connections(Ingest *in) {
+    for (;;) {
+        int fd = accept(in->listen_fd, NULL, NULL);
+        if (fd < 0) return;
+        IngestConnection *c = NULL;
+        for (int i = 0; i < INGEST_MAX_CONNECTIONS && !c; i++) {
+            if (in->connections[i].fd < 0) c = &in->connections[i];
+        }
+        if (c && !c->buffer) c->buffer = malloc(INGEST_FRAME_HEADER + INGEST_MAX_FRAME);
+        if (!c || !c->buffer || !set_nonblocking(fd) || !watch(in, fd, (int)(c - in->connections))) {
+            close(fd);
+            continue;
+        }
+        c->fd = fd;
+        c->used = 0;
+        atomic_fetch_add_explicit(&in->clients, 1, memory_order_relaxed);
+    }
+}
+
+// Handles the complete frames at the start of `data` and returns the bytes
+// they took, or -1 if one is malformed
+static long parse_frames(Ingest *in, const uint8_t *data, size_t size) {
+    size_t at = 0;
+    long long samples = 0, frames = 0;
+    while (size - at >= INGEST_FRAME_HEADER) {
+        uint32_t length;
+        uint16_t type, count;
+        memcpy(&length, data + at, 4);
+        memcpy(&type, data + at + 4, 2);
+        memcpy(&count, data + at + 6, 2);
+        if (length < 4 || length > INGEST_MAX_FRAME + 4) return -1;
+        if (size - at < 4 + (size_t)length) break;
+        const uint8_t *payload = data + at + INGEST_FRAME_HEADER;
+        size_t bytes = length - 4;
+        if (type == INGEST_FRAME_SAMPLES) {
+            if (bytes != (size_t)count * sizeof(IngestSample)) return -1;
+            size_t pushed = spsc_queue_push(&in->queue, payload, count);
+            if (pushed < count) atomic_fetch_add_explicit(&in->dropped, (long long)(count - pushed), memory_order_relaxed);
+            samples += pushed;
+        } else if (type == INGEST_FRAME_NAME) {
+            if (count >= INGEST_MAX_METRICS || bytes >= INGEST_NAME_MAX) return -1;
+            pthread_mutex_lock(&in->names_lock);
+            memcpy(in->names[count], payload, bytes);
+            in->names[count][bytes] = '\0';
+            pthread_mutex_unlock(&in->names_lock);
+        } else {
+            return -1;
+        }
+        frames++;
+        at += 4 + (size_t)length;
+    }
+    atomic_fetch_add_explicit(&in->samples, samples, memory_order_relaxed);
+    atomic_fetch_add_explicit(&in->frames, frames, memory_order_relaxed);
+    return (long)at;
+}
+
+// Reads until the socket would block, parsing as the buffer fills. A busy
+// producer gets a bounded number of reads per wakeup so it cannot starve
+// the others; the wait reports it again right away.
+static void read_connection(Ingest *in, IngestConnection *c) {
+    size_t capacity = INGEST_FRAME_HEADER + INGEST_MAX_FRAME;
+    for (int reads = 0; reads < INGEST_READS_PER_WAKE; reads++) {
+        size_t want = capacity - c->used;
+        if (want > INGEST_READ_BYTES) want = INGEST_READ_BYTES;
+        ssize_t n = read(c->fd, c->buffer + c->used, want);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+        if (n <= 0) {
+            close_connection(in, c);
+            return;
+        }
+        atomic_fetch_add_explicit(&in->bytes, n, memory_order_relaxed);
+        c->used += (uint32_t)n;
+        long done = parse_frames(in, c->buffer, c->used);
+        if (done < 0) {
+            atomic_fetch_add_explicit(&in->rejected, 1, memory_order_relaxed);
+            close_connection(in, c);
+            return;
+        }
+        // At most one partial frame is left, moved to the front
+        c->used -= (uint32_t)done;
+        memmove(c->buffer, c->buffer + done, c->used);
+    }
+}
+
+static void handle(Ingest *in, int slot) {
+    if (slot == SLOT_LISTEN) {
+        accept_connections(in);
+    } else if (slot == SLOT_WAKE) {
+        char drain[64];
+        while (read(in->wake[0], drain, sizeof(drain)) > 0) {}
+    } else if (in->connections[slot].fd >= 0) {
+        read_connection(in, &in->connections[slot]);
+    }
+}
+
+static void *ingest_main(void *arg) {
+    Ingest *in = arg;
+    while (!atomic_load(&in->quit)) {
+        #ifdef __linux__
+            struct epoll_event events[INGEST_MAX_CONNECTIONS + 2];
+            int n = epoll_wait(in->poll_fd, events, INGEST_MAX_CONNECTIONS + 2, -1);
+            for (int i = 0; i < n; i++) handle(in, (int)events[i].data.u32);
+        #else
+            struct pollfd fds[INGEST_MAX_CONNECTIONS + 2];
+            int slots[INGEST_MAX_CONNECTIONS + 2], count = 0;
+            for (int i = 0; i < INGEST_MAX_CONNECTIONS; i++) {
+                if (in->connections[i].fd < 0) continue;
+                fds[count] = (struct pollfd){ .fd = in->connections[i].fd, .events = POLLIN };
+                slots[count++] = i;
+            }
+            fds[count] = (struct pollfd){ .fd = in->listen_fd, .events = POLLIN };
+            slots[count++] = SLOT_LISTEN;
+            fds[count] = (struct pollfd){ .fd = in->wake[0], .events = POLLIN };
+            slots[count++] = SLOT_WAKE;
+            if (poll(fds, count, -1) <= 0) continue;
+            for (int i = 0; i < count; i++) {
+                if (fds[i].revents) handle(in, slots[i]);
+            }
+        #endif
+    }
+    return NULL;
+}
+
+bool ingest_start(Ingest *in) {
+    if (in->thread_started || in->listen_fd < 0) return in->thread_started;
+    atomic_store(&in->quit, false);
+    if (pthread_create(&in->thread, NULL, ingest_main, in) != 0) return false;
+    in->thread_started = true;
+    return true;
+}
+
+void ingest_stop(Ingest *in) {
+    if (!in->thread_started) return;
+    atomic_store(&in->quit, true);
+    ssize_t n = write(in->wake[1], "q", 1);
+    (void)n;
+    pthread_join(in->thread, NULL);
+    in->thread_started = false;
+}
+
+int ingest_connect(const char *path) {
+    struct sockaddr_un addr;
+    if (!socket_address(&addr, path)) return -1;
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    #ifdef SO_NOSIGPIPE
+        // CONA going away must fail the write, not kill the producer
+        int one = 1;
+        setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+    #endif
+    return fd;
+}
+
+void ingest_disconnect(int fd) {
+    if (fd >= 0) close(fd);
+}
+
+static bool write_all(int fd, const void *data, size_t size) {
+    const uint8_t *p = data;
+    while (size > 0) {
+        #ifdef MSG_NOSIGNAL
+            ssize_t n = send(fd, p, size, MSG_NOSIGNAL);
+        #else
+            ssize_t n = send(fd, p, size, 0);
+        #endif
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        p += n;
+        size -= (size_t)n;
+    }
+    return true;
+}
+
+static bool send_frame(int fd, uint16_t type, uint16_t count, const void *payload, size_t bytes) {
+    uint8_t header[INGEST_FRAME_HEADER];
+    uint32_t length = (uint32_t)(4 + bytes);
+    memcpy(header, &length, 4);
+    memcpy(header + 4, &type, 2);
+    memcpy(header + 6, &count, 2);
+    return write_all(fd, header, sizeof(header)) && write_all(fd, payload, bytes);
+}
+
+bool ingest_send_samples(int fd, const IngestSample *samples, int count) {
+    while (count > 0) {
+        int n = count < UINT16_MAX ? count : UINT16_MAX;
+        if (!send_frame(fd, INGEST_FRAME_SAMPLES, (uint16_t)n, samples, sizeof(*samples) * n)) return false;
+        samples += n;
+        count -= n;
+    }
+    return true;
+}
+
+bool ingest_send_name(int fd, uint32_t metric, const char *name) {
+    size_t bytes = strlen(name);
+    if (metric >= INGEST_MAX_METRICS || bytes >= INGEST_NAME_MAX) return false;
+    return send_frame(fd, INGEST_FRAME_NAME, (uint16_t)metric, name, bytes);
+}
+
+#endif // _WIN32
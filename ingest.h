@@ -0,0 +1,111 @@
+#ifndef INGEST_H_
+#define INGEST_H_
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "config.h"
+#include "spsc_queue.h"
+
+#define INGEST_MAX_CONNECTIONS 16
+#define INGEST_MAX_METRICS 64
+#define INGEST_NAME_MAX 32
+#define INGEST_MAX_FRAME (1u << 20)     // payload bytes, samples frames hold up to 65535
+#define INGEST_QUEUE_CAPACITY (1u << 20) // samples between the reader thread and the renderer
+#define INGEST_DRAIN_MAX (1u << 18)      // samples the renderer folds per frame, ~16M/s at 60 Hz
+
+// Training metrics streamed over a Unix-domain socket. CONA listens on a
+// path; any number of producers (up to INGEST_MAX_CONNECTIONS at once)
+// connect and write frames in the byte order of the machine:
+//
+//     uint32_t length        bytes that follow, type and count included
+//     uint16_t type          INGEST_FRAME_*
+//     uint16_t count
+//     payload
+//
+// INGEST_FRAME_SAMPLES carries `count` IngestSample, 16 bytes each, so a
+// batch of n scalars costs 8 + 16n bytes. INGEST_FRAME_NAME names metric
+// `count` with the payload (up to INGEST_NAME_MAX - 1 bytes, no NUL).
+// Metrics are ids below INGEST_MAX_METRICS; a malformed frame closes the
+// connection.
+//
+// One reader thread multiplexes the listening socket and the connections
+// (epoll on Linux, poll elsewhere) with non-blocking reads, parses the
+// frames and copies the samples into a lock-free queue. The renderer only
+// drains the queue, so its cost per frame is a walk over the samples that
+// arrived. A full queue drops samples rather than stalling the reader.
+enum {
+    INGEST_FRAME_SAMPLES = 1,
+    INGEST_FRAME_NAME = 2,
+};
+
+typedef struct {
+    int64_t step;
+    uint32_t metric;
+    float value;
+} IngestSample;
+
+typedef struct {
+    int fd;                    // -1 = free
+    uint32_t used;             // bytes buffered, a partial frame at most
+    uint8_t *buffer;           // 8 + INGEST_MAX_FRAME bytes
+} IngestConnection;
+
+typedef struct {
+    char path[CONFIG_PATH_MAX];
+    int listen_fd;
+    int poll_fd;               // epoll instance, -1 without epoll
+    int wake[2];               // pipe that interrupts the wait on stop
+    IngestConnection connections[INGEST_MAX_CONNECTIONS];
+    SpscQueue queue;
+    IngestSample *items;
+
+    pthread_t thread;
+    bool thread_started;
+    _Atomic bool quit;
+
+    // Names from INGEST_FRAME_NAME, written by the reader thread
+    pthread_mutex_t names_lock;
+    char names[INGEST_MAX_METRICS][INGEST_NAME_MAX];
+
+    // Statistics, read by the renderer
+    _Atomic long long samples;
+    _Atomic long long frames;
+    _Atomic long long bytes;
+    _Atomic long long dropped;   // samples that did not fit the queue
+    _Atomic long long rejected;  // connections closed over a malformed frame
+    _Atomic int clients;
+} Ingest;
+
+// Listens on `path`, replacing a stale socket file
+bool ingest_init(Ingest *in, const char *path);
+void ingest_free(Ingest *in);
+
+// The reader thread runs code from this module, so it is stopped around
+// hot reloads. The socket and the connections stay open in between.
+bool ingest_start(Ingest *in);
+void ingest_stop(Ingest *in);
+
+// Renderer: samples that arrived, in order, in place. Consume them before
+// peeking again; a second peek returns the rest when the queue wrapped.
+static inline size_t ingest_peek(Ingest *in, const IngestSample **samples) {
+    return spsc_queue_peek(&in->queue, (const void **)samples);
+}
+
+static inline void ingest_consume(Ingest *in, size_t count) {
+    spsc_queue_consume(&in->queue, count);
+}
+
+// Copies the name of `metric` into `name`, "" if none was sent
+void ingest_metric_name(Ingest *in, uint32_t metric, char name[INGEST_NAME_MAX]);
+
+// Producer side, for C clients: a blocking connection and framed writes
+int ingest_connect(const char *path);
+void ingest_disconnect(int fd);
+bool ingest_send_samples(int fd, const IngestSample *samples, int count);
+bool ingest_send_name(int fd, uint32_t metric, const char *name);
+
+#endif // INGEST_H_
@@ -0,0 +1,984 @@
+#define _POSIX_C_SOURCE 200809L
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "kernels.h"
+
+#ifdef _WIN32
+    #include <windows.h>
+#endif
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+    #define KERNELS_X86 1
+    #include <cpuid.h>
+    #include <immintrin.h>
+#endif
+
+// ------------------------------------------------------------
+// Scalar (portable C)
+// ------------------------------------------------------------
+
+// On x86 the scalar dense layer is the one-lane baseline the SIMD variants
+// are measured against, so the compiler is kept from vectorizing it: GCC
+// per function, clang per loop. Elsewhere it is the only variant and is
+// left to the auto-vectorizer.
+#if defined(KERNELS_X86) && defined(__clang__)
+    #define SCALAR_ATTR
+    #define SCALAR_LOOP _Pragma("clang loop vectorize(disable) interleave(disable)")
+#elif defined(KERNELS_X86)
+    #define SCALAR_ATTR __attribute__((optimize("no-tree-vectorize")))
+    #define SCALAR_LOOP
+#else
+    #define SCALAR_ATTR
+    #define SCALAR_LOOP
+#endif
+
+SCALAR_ATTR static inline float dot1_scalar(const float *restrict x, const float *restrict w, int n) {
+    float acc = 0.0f;
+    SCALAR_LOOP
+    for (int i = 0; i < n; i++) acc += x[i] * w[i];
+    return acc;
+}
+
+SCALAR_ATTR static inline void dot4_scalar(const float *restrict x, const float *restrict w, int stride, int n, float out[4]) {
+    const float *w0 = w, *w1 = w + stride, *w2 = w + 2 * stride, *w3 = w + 3 * stride;
+    float a0 = 0.0f, a1 = 0.0f, a2 = 0.0f, a3 = 0.0f;
+    SCALAR_LOOP
+    for (int i = 0; i < n; i++) {
+        a0 += x[i] * w0[i];
+        a1 += x[i] * w1[i];
+        a2 += x[i] * w2[i];
+        a3 += x[i] * w3[i];
+    }
+    out[0] = a0; out[1] = a1; out[2] = a2; out[3] = a3;
+}
+
+SCALAR_ATTR static inline void axpy1_scalar(float a, const float *restrict x, float *restrict y, int n) {
+    SCALAR_LOOP
+    for (int i = 0; i < n; i++) y[i] += a * x[i];
+}
+
+SCALAR_ATTR static inline void axpy4_scalar(const float a[4], const float *restrict x, int stride, float *restrict y, int n) {
+    const float *x0 = x, *x1 = x + stride, *x2 = x + 2 * stride, *x3 = x + 3 * stride;
+    SCALAR_LOOP
+    for (int i = 0; i < n; i++) {
+        y[i] += a[0] * x0[i] + a[1] * x1[i] + a[2] * x2[i] + a[3] * x3[i];
+    }
+}
+
+#define KERNEL_SUFFIX scalar
+#define KERNEL_ATTR SCALAR_ATTR
+#include "kernels_dense.h"
+#undef KERNEL_SUFFIX
+#undef KERNEL_ATTR
+
+static void lerp_scalar(float *restrict x, const float *restrict target, float t, int n) {
+    if (!target) {
+        float k = 1.0f - t;
+        for (int i = 0; i < n; i++) x[i] *= k;
+        return;
+    }
+    for (int i = 0; i < n; i++) x[i] += (target[i] - x[i]) * t;
+}
+
+#define KERNEL_SUFFIX scalar
+#define KERNEL_ATTR 
+#define VLANES 1
+#define VEC float
+#define VLOAD(p) (*(p))
+#define VSTORE(p, x) (*(p) = (x))
+#define VSET1(x) (x)
+#define VADD(a, b) ((a) + (b))
+#define VMUL(a, b) ((a) * (b))
+#define VDIV(a, b) ((a) / (b))
+#define VSQRT(a) sqrtf(a)
+#define VFMA(a, b, c) ((a) * (b) + (c))
+#include "kernels_hist.h"
+#include "kernels_optim.h"
+#undef KERNEL_SUFFIX
+#undef KERNEL_ATTR
+
+static const Kernels kernels_scalar = {
+    "scalar", KERNEL_SCALAR, 1, false,
+    dense_forward_scalar, dense_backward_data_scalar, dense_weight_grad_scalar,
+    lerp_scalar,
+    optim_sgd_scalar, optim_adam_scalar,
+    histogram_scalar,
+};
+
+static inline int32_t qdot1_scalar(const uint8_t *restrict x, const int8_t *restrict w, int n) {
+    int32_t acc = 0;
+    for (int i = 0; i < n; i++) acc += x[i] * w[i];
+    return acc;
+}
+
+static inline void qdot4_scalar(const uint8_t *restrict x, const int8_t *restrict w, int stride, int n, int32_t out[4]) {
+    const int8_t *w0 = w, *w1 = w + stride, *w2 = w + 2 * stride, *w3 = w + 3 * stride;
+    int32_t a0 = 0, a1 = 0, a2 = 0, a3 = 0;
+    for (int i = 0; i < n; i++) {
+        a0 += x[i] * w0[i];
+        a1 += x[i] * w1[i];
+        a2 += x[i] * w2[i];
+        a3 += x[i] * w3[i];
+    }
+    out[0] = a0; out[1] = a1; out[2] = a2; out[3] = a3;
+}
+
+#define KERNEL_SUFFIX scalar
+#define KERNEL_ATTR
+#include "kernels_int8.h"
+#undef KERNEL_SUFFIX
+#undef KERNEL_ATTR
+
+static const Int8Kernels int8_kernels_scalar = {
+    "scalar", KERNEL_INT8_SCALAR, 1, qdense_forward_scalar,
+};
+
+#ifdef KERNELS_X86
+
+// ------------------------------------------------------------
+// SSE4.2 (4 lanes, separate multiply and add)
+// ------------------------------------------------------------
+
+#define SSE_ATTR __attribute__((target("sse4.2")))
+
+SSE_ATTR static inline float hsum_sse(__m128 v) {
+    __m128 sh = _mm_movehdup_ps(v);
+    __m128 s = _mm_add_ps(v, sh);
+    sh = _mm_movehl_ps(sh, s);
+    return _mm_cvtss_f32(_mm_add_ss(s, sh));
+}
+
+SSE_ATTR static inline float dot1_sse42(const float *x, const float *w, int n) {
+    __m128 acc = _mm_setzero_ps();
+    int i = 0;
+    for (; i + 4 <= n; i += 4) acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(x + i), _mm_loadu_ps(w + i)));
+    float r = hsum_sse(acc);
+    for (; i < n; i++) r += x[i] * w[i];
+    return r;
+}
+
+SSE_ATTR static inline void dot4_sse42(const float *x, const float *w, int stride, int n, float out[4]) {
+    const float *w0 = w, *w1 = w + stride, *w2 = w + 2 * stride, *w3 = w + 3 * stride;
+    __m128 a0 = _mm_setzero_ps(), a1 = _mm_setzero_ps(), a2 = _mm_setzero_ps(), a3 = _mm_setzero_ps();
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128 xv = _mm_loadu_ps(x + i);
+        a0 = _mm_add_ps(a0, _mm_mul_ps(xv, _mm_loadu_ps(w0 + i)));
+        a1 = _mm_add_ps(a1, _mm_mul_ps(xv, _mm_loadu_ps(w1 + i)));
+        a2 = _mm_add_ps(a2, _mm_mul_ps(xv, _mm_loadu_ps(w2 + i)));
+        a3 = _mm_add_ps(a3, _mm_mul_ps(xv, _mm_loadu_ps(w3 + i)));
+    }
+    out[0] = hsum_sse(a0); out[1] = hsum_sse(a1); out[2] = hsum_sse(a2); out[3] = hsum_sse(a3);
+    for (; i < n; i++) {
+        out[0] += x[i] * w0[i]; out[1] += x[i] * w1[i];
+        out[2] += x[i] * w2[i]; out[3] += x[i] * w3[i];
+    }
+}
+
+SSE_ATTR static inline void axpy1_sse42(float a, const float *x, float *y, int n) {
+    __m128 av = _mm_set1_ps(a);
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        _mm_storeu_ps(y + i, _mm_add_ps(_mm_loadu_ps(y + i), _mm_mul_ps(av, _mm_loadu_ps(x + i))));
+    }
+    for (; i < n; i++) y[i] += a * x[i];
+}
+
+SSE_ATTR static inline void axpy4_sse42(const float a[4], const float *x, int stride, float *y, int n) {
+    const float *x0 = x, *x1 = x + stride, *x2 = x + 2 * stride, *x3 = x + 3 * stride;
+    __m128 c0 = _mm_set1_ps(a[0]), c1 = _mm_set1_ps(a[1]), c2 = _mm_set1_ps(a[2]), c3 = _mm_set1_ps(a[3]);
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128 s = _mm_add_ps(_mm_mul_ps(c0, _mm_loadu_ps(x0 + i)), _mm_mul_ps(c1, _mm_loadu_ps(x1 + i)));
+        s = _mm_add_ps(s, _mm_add_ps(_mm_mul_ps(c2, _mm_loadu_ps(x2 + i)), _mm_mul_ps(c3, _mm_loadu_ps(x3 + i))));
+        _mm_storeu_ps(y + i, _mm_add_ps(_mm_loadu_ps(y + i), s));
+    }
+    for (; i < n; i++) y[i] += a[0] * x0[i] + a[1] * x1[i] + a[2] * x2[i] + a[3] * x3[i];
+}
+
+#define KERNEL_SUFFIX sse42
+#define KERNEL_ATTR SSE_ATTR
+#include "kernels_dense.h"
+#undef KERNEL_SUFFIX
+#undef KERNEL_ATTR
+
+SSE_ATTR static void lerp_sse42(float *x, const float *target, float t, int n) {
+    int i = 0;
+    if (!target) {
+        __m128 k = _mm_set1_ps(1.0f - t);
+        for (; i + 4 <= n; i += 4) _mm_storeu_ps(x + i, _mm_mul_ps(_mm_loadu_ps(x + i), k));
+        for (; i < n; i++) x[i] *= 1.0f - t;
+        return;
+    }
+    __m128 tv = _mm_set1_ps(t);
+    for (; i + 4 <= n; i += 4) {
+        __m128 xv = _mm_loadu_ps(x + i);
+        _mm_storeu_ps(x + i, _mm_add_ps(xv, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(target + i), xv), tv)));
+    }
+    for (; i < n; i++) x[i] += (target[i] - x[i]) * t;
+}
+
+#define KERNEL_SUFFIX sse42
+#define KERNEL_ATTR SSE_ATTR
+#define VLANES 4
+#define VEC __m128
+#define VLOAD(p) _mm_loadu_ps(p)
+#define VSTORE(p, x) _mm_storeu_ps(p, x)
+#define VSET1(x) _mm_set1_ps(x)
+#define VADD(a, b) _mm_add_ps(a, b)
+#define VMUL(a, b) _mm_mul_ps(a, b)
+#define VDIV(a, b) _mm_div_ps(a, b)
+#define VSQRT(a) _mm_sqrt_ps(a)
+#define VFMA(a, b, c) _mm_add_ps(_mm_mul_ps(a, b), c)
+#define VSUB(a, b) _mm_sub_ps(a, b)
+#define VMIN(a, b) _mm_min_ps(a, b)
+#define VMAX(a, b) _mm_max_ps(a, b)
+#define VSTOREI(p, x) _mm_storeu_si128((__m128i *)(p), _mm_cvttps_epi32(x))
+#include "kernels_hist.h"
+#include "kernels_optim.h"
+#undef KERNEL_SUFFIX
+#undef KERNEL_ATTR
+
+static const Kernels kernels_sse42 = {
+    "sse4.2", KERNEL_SSE42, 4, false,
+    dense_forward_sse42, dense_backward_data_sse42, dense_weight_grad_sse42,
+    lerp_sse42,
+    optim_sgd_sse42, optim_adam_sse42,
+    histogram_sse42,
+};
+
+SSE_ATTR static inline int32_t hsum_epi32_sse(__m128i v) {
+    v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+    v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(v);
+}
+
+// 16 bytes of x against 16 bytes of w: both widened to 16 bits, then
+// pmaddwd sums adjacent products into 32 bits without saturating
+SSE_ATTR static inline __m128i qmac_sse41(__m128i acc, __m128i xlo, __m128i xhi, const int8_t *w) {
+    __m128i wv = _mm_loadu_si128((const __m128i *)w);
+    acc = _mm_add_epi32(acc, _mm_madd_epi16(xlo, _mm_cvtepi8_epi16(wv)));
+    return _mm_add_epi32(acc, _mm_madd_epi16(xhi, _mm_cvtepi8_epi16(_mm_srli_si128(wv, 8))));
+}
+
+SSE_ATTR static inline int32_t qdot1_sse41(const uint8_t *x, const int8_t *w, int n) {
+    __m128i acc = _mm_setzero_si128();
+    for (int i = 0; i < n; i += 16) {
+        __m128i xv = _mm_loadu_si128((const __m128i *)(x + i));
+        acc = qmac_sse41(acc, _mm_cvtepu8_epi16(xv), _mm_cvtepu8_epi16(_mm_srli_si128(xv, 8)), w + i);
+    }
+    return hsum_epi32_sse(acc);
+}
+
+SSE_ATTR static inline void qdot4_sse41(const uint8_t *x, const int8_t *w, int stride, int n, int32_t out[4]) {
+    const int8_t *w0 = w, *w1 = w + stride, *w2 = w + 2 * stride, *w3 = w + 3 * stride;
+    __m128i a0 = _mm_setzero_si128(), a1 = _mm_setzero_si128(), a2 = _mm_setzero_si128(), a3 = _mm_setzero_si128();
+    for (int i = 0; i < n; i += 16) {
+        __m128i xv = _mm_loadu_si128((const __m128i *)(x + i));
+        __m128i xlo = _mm_cvtepu8_epi16(xv), xhi = _mm_cvtepu8_epi16(_mm_srli_si128(xv, 8));
+        a0 = qmac_sse41(a0, xlo, xhi, w0 + i);
+        a1 = qmac_sse41(a1, xlo, xhi, w1 + i);
+        a2 = qmac_sse41(a2, xlo, xhi, w2 + i);
+        a3 = qmac_sse41(a3, xlo, xhi, w3 + i);
+    }
+    out[0] = hsum_epi32_sse(a0); out[1] = hsum_epi32_sse(a1);
+    out[2] = hsum_epi32_sse(a2); out[3] = hsum_epi32_sse(a3);
+}
+
+#define KERNEL_SUFFIX sse41
+#define KERNEL_ATTR SSE_ATTR
+#include "kernels_int8.h"
+#undef KERNEL_SUFFIX
+#undef KERNEL_ATTR
+
+static const Int8Kernels int8_kernels_sse41 = {
+    "sse4.1", KERNEL_INT8_SSE41, 8, qdense_forward_sse41,
+};
+
+// ------------------------------------------------------------
+// AVX2 + FMA (8 lanes)
+// ------------------------------------------------------------
+
+#define AVX2_ATTR __attribute__((target("avx2,fma")))
+
+AVX2_ATTR static inline float hsum_avx2(__m256 v) {
+    __m128 lo = _mm256_castps256_ps128(v);
+    __m128 hi = _mm256_extractf128_ps(v, 1);
+    lo = _mm_add_ps(lo, hi);
+    __m128 sh = _mm_movehdup_ps(lo);
+    __m128 s = _mm_add_ps(lo, sh);
+    sh = _mm_movehl_ps(sh, s);
+    return _mm_cvtss_f32(_mm_add_ss(s, sh));
+}
+
+AVX2_ATTR static inline float dot1_avx2(const float *x, const float *w, int n) {
+    __m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(x + i), _mm256_loadu_ps(w + i), acc0);
+        acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(x + i + 8), _mm256_loadu_ps(w + i + 8), acc1);
+    }
+    for (; i + 8 <= n; i += 8) acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(x + i), _mm256_loadu_ps(w + i), acc0);
+    float r = hsum_avx2(_mm256_add_ps(acc0, acc1));
+    for (; i < n; i++) r += x[i] * w[i];
+    return r;
+}
+
+AVX2_ATTR static inline void dot4_avx2(const float *x, const float *w, int stride, int n, float out[4]) {
+    const float *w0 = w, *w1 = w + stride, *w2 = w + 2 * stride, *w3 = w + 3 * stride;
+    __m256 a0 = _mm256_setzero_ps(), a1 = _mm256_setzero_ps(), a2 = _mm256_setzero_ps(), a3 = _mm256_setzero_ps();
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 xv = _mm256_loadu_ps(x + i);
+        a0 = _mm256_fmadd_ps(xv, _mm256_loadu_ps(w0 + i), a0);
+        a1 = _mm256_fmadd_ps(xv, _mm256_loadu_ps(w1 + i), a1);
+        a2 = _mm256_fmadd_ps(xv, _mm256_loadu_ps(w2 + i), a2);
+        a3 = _mm256_fmadd_ps(xv, _mm256_loadu_ps(w3 + i), a3);
+    }
+    out[0] = hsum_avx2(a0); out[1] = hsum_avx2(a1); out[2] = hsum_avx2(a2); out[3] = hsum_avx2(a3);
+    for (; i < n; i++) {
+        out[0] += x[i] * w0[i]; out[1] += x[i] * w1[i];
+        out[2] += x[i] * w2[i]; out[3] += x[i] * w3[i];
+    }
+}
+
+AVX2_ATTR static inline void axpy1_avx2(float a, const float *x, float *y, int n) {
+    __m256 av = _mm256_set1_ps(a);
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        _mm256_storeu_ps(y + i, _mm256_fmadd_ps(av, _mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i)));
+    }
+    for (; i < n; i++) y[i] += a * x[i];
+}
+
+AVX2_ATTR static inline void axpy4_avx2(const float a[4], const float *x, int stride, float *y, int n) {
+    const float *x0 = x, *x1 = x + stride, *x2 = x + 2 * stride, *x3 = x + 3 * stride;
+    __m256 c0 = _mm256_set1_ps(a[0]), c1 = _mm256_set1_ps(a[1]), c2 = _mm256_set1_ps(a[2]), c3 = _mm256_set1_ps(a[3]);
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 s = _mm256_loadu_ps(y + i);
+        s = _mm256_fmadd_ps(c0, _mm256_loadu_ps(x0 + i), s);
+        s = _mm256_fmadd_ps(c1, _mm256_loadu_ps(x1 + i), s);
+        s = _mm256_fmadd_ps(c2, _mm256_loadu_ps(x2 + i), s);
+        s = _mm256_fmadd_ps(c3, _mm256_loadu_ps(x3 + i), s);
+        _mm256_storeu_ps(y + i, s);
+    }
+    for (; i < n; i++) y[i] += a[0] * x0[i] + a[1] * x1[i] + a[2] * x2[i] + a[3] * x3[i];
+}
+
+#define KERNEL_SUFFIX avx2
+#define KERNEL_ATTR AVX2_ATTR
+#include "kernels_dense.h"
+#undef KERNEL_SUFFIX
+#undef KERNEL_ATTR
+
+AVX2_ATTR static void lerp_avx2(float *x, const float *target, float t, int n) {
+    int i = 0;
+    if (!target) {
+        __m256 k = _mm256_set1_ps(1.0f - t);
+        for (; i + 8 <= n; i += 8) _mm256_storeu_ps(x + i, _mm256_mul_ps(_mm256_loadu_ps(x + i), k));
+        for (; i < n; i++) x[i] *= 1.0f - t;
+        return;
+    }
+    __m256 tv = _mm256_set1_ps(t);
+    for (; i + 8 <= n; i += 8) {
+        __m256 xv = _mm256_loadu_ps(x + i);
+        _mm256_storeu_ps(x + i, _mm256_fmadd_ps(_mm256_sub_ps(_mm256_loadu_ps(target + i), xv), tv, xv));
+    }
+    for (; i < n; i++) x[i] += (target[i] - x[i]) * t;
+}
+
+#define KERNEL_SUFFIX avx2
+#define KERNEL_ATTR AVX2_ATTR
+#define VLANES 8
+#define VEC __m256
+#define VLOAD(p) _mm256_loadu_ps(p)
+#define VSTORE(p, x) _mm256_storeu_ps(p, x)
+#define VSET1(x) _mm256_set1_ps(x)
+#define VADD(a, b) _mm256_add_ps(a, b)
+#define VMUL(a, b) _mm256_mul_ps(a, b)
+#define VDIV(a, b) _mm256_div_ps(a, b)
+#define VSQRT(a) _mm256_sqrt_ps(a)
+#define VFMA(a, b, c) _mm256_fmadd_ps(a, b, c)
+#define VSUB(a, b) _mm256_sub_ps(a, b)
+#define VMIN(a, b) _mm256_min_ps(a, b)
+#define VMAX(a, b) _mm256_max_ps(a, b)
+#define VSTOREI(p, x) _mm256_storeu_si256((__m256i *)(p), _mm256_cvttps_epi32(x))
+#include "kernels_hist.h"
+#include "kernels_optim.h"
+#undef KERNEL_SUFFIX
+#undef KERNEL_ATTR
+
+static const Kernels kernels_avx2 = {
+    "avx2", KERNEL_AVX2, 8, true,
+    dense_forward_avx2, dense_backward_data_avx2, dense_weight_grad_avx2,
+    lerp_avx2,
+    optim_sgd_avx2, optim_adam_avx2,
+    histogram_avx2,
+};
+
+AVX2_ATTR static inline int32_t hsum_epi32_avx2(__m256i v) {
+    __m128i s = _mm_add_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(1, 0, 3, 2)));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(s);
+}
+
+// x is already widened; w is widened here, 16 bytes at a time
+AVX2_ATTR static inline __m256i qmac_avx2(__m256i acc, __m256i x16, const int8_t *w) {
+    __m256i w16 = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i *)w));
+    return _mm256_add_epi32(acc, _mm256_madd_epi16(x16, w16));
+}
+
+AVX2_ATTR static inline int32_t qdot1_avx2(const uint8_t *x, const int8_t *w, int n) {
+    __m256i acc0 = _mm256_setzero_si256(), acc1 = _mm256_setzero_si256();
+    for (int i = 0; i < n; i += 32) {
+        acc0 = qmac_avx2(acc0, _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(x + i))), w + i);
+        acc1 = qmac_avx2(acc1, _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(x + i + 16))), w + i + 16);
+    }
+    return hsum_epi32_avx2(_mm256_add_epi32(acc0, acc1));
+}
+
+AVX2_ATTR static inline void qdot4_avx2(const uint8_t *x, const int8_t *w, int stride, int n, int32_t out[4]) {
+    const int8_t *w0 = w, *w1 = w + stride, *w2 = w + 2 * stride, *w3 = w + 3 * stride;
+    __m256i a0 = _mm256_setzero_si256(), a1 = _mm256_setzero_si256();
+    __m256i a2 = _mm256_setzero_si256(), a3 = _mm256_setzero_si256();
+    for (int i = 0; i < n; i += 16) {
+        __m256i xv = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(x + i)));
+        a0 = qmac_avx2(a0, xv, w0 + i);
+        a1 = qmac_avx2(a1, xv, w1 + i);
+        a2 = qmac_avx2(a2, xv, w2 + i);
+        a3 = qmac_avx2(a3, xv, w3 + i);
+    }
+    out[0] = hsum_epi32_avx2(a0); out[1] = hsum_epi32_avx2(a1);
+    out[2] = hsum_epi32_avx2(a2); out[3] = hsum_epi32_avx2(a3);
+}
+
+#define KERNEL_SUFFIX avx2
+#define KERNEL_ATTR AVX2_ATTR
+#include "kernels_int8.h"
+#undef KERNEL_SUFFIX
+#undef KERNEL_ATTR
+
+static const Int8Kernels int8_kernels_avx2 = {
+    "avx2", KERNEL_INT8_AVX2, 16, qdense_forward_avx2,
+};
+
+// ------------------------------------------------------------
+// AVX-VNNI (vpdpbusd on ymm: 32 u8 x s8 products per instruction)
+// ------------------------------------------------------------
+
+#define AVXVNNI_ATTR __attribute__((target("avx2,avxvnni")))
+
+AVXVNNI_ATTR static inline int32_t qdot1_avxvnni(const uint8_t *x, const int8_t *w, int n) {
+    __m256i acc0 = _mm256_setzero_si256(), acc1 = _mm256_setzero_si256();
+    for (int i = 0; i < n; i += 64) {
+        acc0 = _mm256_dpbusd_avx_epi32(acc0, _mm256_loadu_si256((const __m256i *)(x + i)),
+                                       _mm256_loadu_si256((const __m256i *)(w + i)));
+        acc1 = _mm256_dpbusd_avx_epi32(acc1, _mm256_loadu_si256((const __m256i *)(x + i + 32)),
+                                       _mm256_loadu_si256((const __m256i *)(w + i + 32)));
+    }
+    return hsum_epi32_avx2(_mm256_add_epi32(acc0, acc1));
+}
+
+AVXVNNI_ATTR static inline void qdot4_avxvnni(const uint8_t *x, const int8_t *w, int stride, int n, int32_t out[4]) {
+    const int8_t *w0 = w, *w1 = w + stride, *w2 = w + 2 * stride, *w3 = w + 3 * stride;
+    __m256i a0 = _mm256_setzero_si256(), a1 = _mm256_setzero_si256();
+    __m256i a2 = _mm256_setzero_si256(), a3 = _mm256_setzero_si256();
+    for (int i = 0; i < n; i += 32) {
+        __m256i xv = _mm256_loadu_si256((const __m256i *)(x + i));
+        a0 = _mm256_dpbusd_avx_epi32(a0, xv, _mm256_loadu_si256((const __m256i *)(w0 + i)));
+        a1 = _mm256_dpbusd_avx_epi32(a1, xv, _mm256_loadu_si256((const __m256i *)(w1 + i)));
+        a2 = _mm256_dpbusd_avx_epi32(a2, xv, _mm256_loadu_si256((const __m256i *)(w2 + i)));
+        a3 = _mm256_dpbusd_avx_epi32(a3, xv, _mm256_loadu_si256((const __m256i *)(w3 + i)));
+    }
+    out[0] = hsum_epi32_avx2(a0); out[1] = hsum_epi32_avx2(a1);
+    out[2] = hsum_epi32_avx2(a2); out[3] = hsum_epi32_avx2(a3);
+}
+
+#define KERNEL_SUFFIX avxvnni
+#define KERNEL_ATTR AVXVNNI_ATTR
+#include "kernels_int8.h"
+#undef KERNEL_SUFFIX
+#undef KERNEL_ATTR
+
+static const Int8Kernels int8_kernels_avxvnni = {
+    "avx-vnni", KERNEL_INT8_AVXVNNI, 32, qdense_forward_avxvnni,
+};
+
+// ------------------------------------------------------------
+// AVX-512F (16 lanes, masked tails)
+// ------------------------------------------------------------
+
+#define AVX512_ATTR __attribute__((target("avx512f")))
+
+AVX512_ATTR static inline __mmask16 tail_mask_avx512(int remaining) {
+    return (__mmask16)((1u << remaining) - 1u);
+}
+
+AVX512_ATTR static inline float dot1_avx512(const float *x, const float *w, int n) {
+    __m512 acc = _mm512_setzero_ps();
+    int i = 0;
+    for (; i + 16 <= n; i += 16) acc = _mm512_fmadd_ps(_mm512_loadu_ps(x + i), _mm512_loadu_ps(w + i), acc);
+    if (i < n) {
+        __mmask16 m = tail_mask_avx512(n - i);
+        acc = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(m, x + i), _mm512_maskz_loadu_ps(m, w + i), acc);
+    }
+    return _mm512_reduce_add_ps(acc);
+}
+
+AVX512_ATTR static inline void dot4_avx512(const float *x, const float *w, int stride, int n, float out[4]) {
+    const float *w0 = w, *w1 = w + stride, *w2 = w + 2 * stride, *w3 = w + 3 * stride;
+    __m512 a0 = _mm512_setzero_ps(), a1 = _mm512_setzero_ps(), a2 = _mm512_setzero_ps(), a3 = _mm512_setzero_ps();
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m512 xv = _mm512_loadu_ps(x + i);
+        a0 = _mm512_fmadd_ps(xv, _mm512_loadu_ps(w0 + i), a0);
+        a1 = _mm512_fmadd_ps(xv, _mm512_loadu_ps(w1 + i), a1);
+        a2 = _mm512_fmadd_ps(xv, _mm512_loadu_ps(w2 + i), a2);
+        a3 = _mm512_fmadd_ps(xv, _mm512_loadu_ps(w3 + i), a3);
+    }
+    if (i < n) {
+        __mmask16 m = tail_mask_avx512(n - i);
+        __m512 xv = _mm512_maskz_loadu_ps(m, x + i);
+        a0 = _mm512_fmadd_ps(xv, _mm512_maskz_loadu_ps(m, w0 + i), a0);
+        a1 = _mm512_fmadd_ps(xv, _mm512_maskz_loadu_ps(m, w1 + i), a1);
+        a2 = _mm512_fmadd_ps(xv, _mm512_maskz_loadu_ps(m, w2 + i), a2);
+        a3 = _mm512_fmadd_ps(xv, _mm512_maskz_loadu_ps(m, w3 + i), a3);
+    }
+    out[0] = _mm512_reduce_add_ps(a0); out[1] = _mm512_reduce_add_ps(a1);
+    out[2] = _mm512_reduce_add_ps(a2); out[3] = _mm512_reduce_add_ps(a3);
+}
+
+AVX512_ATTR static inline void axpy1_avx512(float a, const float *x, float *y, int n) {
+    __m512 av = _mm512_set1_ps(a);
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        _mm512_storeu_ps(y + i, _mm512_fmadd_ps(av, _mm512_loadu_ps(x + i), _mm512_loadu_ps(y + i)));
+    }
+    if (i < n) {
+        __mmask16 m = tail_mask_avx512(n - i);
+        __m512 r = _mm512_fmadd_ps(av, _mm512_maskz_loadu_ps(m, x + i), _mm512_maskz_loadu_ps(m, y + i));
+        _mm512_mask_storeu_ps(y + i, m, r);
+    }
+}
+
+AVX512_ATTR static inline void axpy4_avx512(const float a[4], const float *x, int stride, float *y, int n) {
+    const float *x0 = x, *x1 = x + stride, *x2 = x + 2 * stride, *x3 = x + 3 * stride;
+    __m512 c0 = _mm512_set1_ps(a[0]), c1 = _mm512_set1_ps(a[1]), c2 = _mm512_set1_ps(a[2]), c3 = _mm512_set1_ps(a[3]);
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m512 s = _mm512_loadu_ps(y + i);
+        s = _mm512_fmadd_ps(c0, _mm512_loadu_ps(x0 + i), s);
+        s = _mm512_fmadd_ps(c1, _mm512_loadu_ps(x1 + i), s);
+        s = _mm512_fmadd_ps(c2, _mm512_loadu_ps(x2 + i), s);
+        s = _mm512_fmadd_ps(c3, _mm512_loadu_ps(x3 + i), s);
+        _mm512_storeu_ps(y + i, s);
+    }
+    if (i < n) {
+        __mmask16 m = tail_mask_avx512(n - i);
+        __m512 s = _mm512_maskz_loadu_ps(m, y + i);
+        s = _mm512_fmadd_ps(c0, _mm512_maskz_loadu_ps(m, x0 + i), s);
+        s = _mm512_fmadd_ps(c1, _mm512_maskz_loadu_ps(m, x1 + i), s);
+        s = _mm512_fmadd_ps(c2, _mm512_maskz_loadu_ps(m, x2 + i), s);
+        s = _mm512_fmadd_ps(c3, _mm512_maskz_loadu_ps(m, x3 + i), s);
+        _mm512_mask_storeu_ps(y + i, m, s);
+    }
+}
+
+#define KERNEL_SUFFIX avx512
+#define KERNEL_ATTR AVX512_ATTR
+#include "kernels_dense.h"
+#undef KERNEL_SUFFIX
+#undef KERNEL_ATTR
+
+AVX512_ATTR static void lerp_avx512(float *x, const float *target, float t, int n) {
+    int i = 0;
+    if (!target) {
+        __m512 k = _mm512_set1_ps(1.0f - t);
+        for (; i + 16 <= n; i += 16) _mm512_storeu_ps(x + i, _mm512_mul_ps(_mm512_loadu_ps(x + i), k));
+        if (i < n) {
+            __mmask16 m = tail_mask_avx512(n - i);
+            _mm512_mask_storeu_ps(x + i, m, _mm512_mul_ps(_mm512_maskz_loadu_ps(m, x + i), k));
+        }
+        return;
+    }
+    __m512 tv = _mm512_set1_ps(t);
+    for (; i + 16 <= n; i += 16) {
+        __m512 xv = _mm512_loadu_ps(x + i);
+        _mm512_storeu_ps(x + i, _mm512_fmadd_ps(_mm512_sub_ps(_mm512_loadu_ps(target + i), xv), tv, xv));
+    }
+    if (i < n) {
+        __mmask16 m = tail_mask_avx512(n - i);
+        __m512 xv = _mm512_maskz_loadu_ps(m, x + i);
+        __m512 r = _mm512_fmadd_ps(_mm512_sub_ps(_mm512_maskz_loadu_ps(m, target + i), xv), tv, xv);
+        _mm512_mask_storeu_ps(x + i, m, r);
+    }
+}
+
+#define KERNEL_SUFFIX avx512
+#define KERNEL_ATTR AVX512_ATTR
+#define VLANES 16
+#define VEC __m512
+#define VLOAD(p) _mm512_loadu_ps(p)
+#define VSTORE(p, x) _mm512_storeu_ps(p, x)
+#define VSET1(x) _mm512_set1_ps(x)
+#define VADD(a, b) _mm512_add_ps(a, b)
+#define VMUL(a, b) _mm512_mul_ps(a, b)
+#define VDIV(a, b) _mm512_div_ps(a, b)
+#define VSQRT(a) _mm512_sqrt_ps(a)
+#define VFMA(a, b, c) _mm512_fmadd_ps(a, b, c)
+#define VSUB(a, b) _mm512_sub_ps(a, b)
+#define VMIN(a, b) _mm512_min_ps(a, b)
+#define VMAX(a, b) _mm512_max_ps(a, b)
+#define VSTOREI(p, x) _mm512_storeu_si512(p, _mm512_cvttps_epi32(x))
+#include "kernels_hist.h"
+#include "kernels_optim.h"
+#undef KERNEL_SUFFIX
+#undef KERNEL_ATTR
+
+static const Kernels kernels_avx512 = {
+    "avx512", KERNEL_AVX512, 16, true,
+    dense_forward_avx512, dense_backward_data_avx512, dense_weight_grad_avx512,
+    lerp_avx512,
+    optim_sgd_avx512, optim_adam_avx512,
+    histogram_avx512,
+};
+
+// ------------------------------------------------------------
+// AVX-512 VNNI (vpdpbusd on zmm: 64 u8 x s8 products per instruction)
+// ------------------------------------------------------------
+
+#define AVX512VNNI_ATTR __attribute__((target("avx512f,avx512vnni")))
+
+AVX512VNNI_ATTR static inline int32_t qdot1_avx512vnni(const uint8_t *x, const int8_t *w, int n) {
+    __m512i acc = _mm512_setzero_si512();
+    for (int i = 0; i < n; i += 64) {
+        acc = _mm512_dpbusd_epi32(acc, _mm512_loadu_si512(x + i), _mm512_loadu_si512(w + i));
+    }
+    return _mm512_reduce_add_epi32(acc);
+}
+
+AVX512VNNI_ATTR static inline void qdot4_avx512vnni(const uint8_t *x, const int8_t *w, int stride, int n, int32_t out[4]) {
+    const int8_t *w0 = w, *w1 = w + stride, *w2 = w + 2 * stride, *w3 = w + 3 * stride;
+    __m512i a0 = _mm512_setzero_si512(), a1 = _mm512_setzero_si512();
+    __m512i a2 = _mm512_setzero_si512(), a3 = _mm512_setzero_si512();
+    for (int i = 0; i < n; i += 64) {
+        __m512i xv = _mm512_loadu_si512(x + i);
+        a0 = _mm512_dpbusd_epi32(a0, xv, _mm512_loadu_si512(w0 + i));
+        a1 = _mm512_dpbusd_epi32(a1, xv, _mm512_loadu_si512(w1 + i));
+        a2 = _mm512_dpbusd_epi32(a2, xv, _mm512_loadu_si512(w2 + i));
+        a3 = _mm512_dpbusd_epi32(a3, xv, _mm512_loadu_si512(w3 + i));
+    }
+    out[0] = _mm512_reduce_add_epi32(a0); out[1] = _mm512_reduce_add_epi32(a1);
+    out[2] = _mm512_reduce_add_epi32(a2); out[3] = _mm512_reduce_add_epi32(a3);
+}
+
+#define KERNEL_SUFFIX avx512vnni
+#define KERNEL_ATTR AVX512VNNI_ATTR
+#include "kernels_int8.h"
+#undef KERNEL_SUFFIX
+#undef KERNEL_ATTR
+
+static const Int8Kernels int8_kernels_avx512vnni = {
+    "avx512-vnni", KERNEL_INT8_AVX512VNNI, 64, qdense_forward_avx512vnni,
+};
+
+#endif // KERNELS_X86
+
+// ------------------------------------------------------------
+// Aligned storage
+// ------------------------------------------------------------
+
+void *kernels_alloc(size_t size) {
+    size = (size + KERNELS_ALIGN - 1) & ~(size_t)(KERNELS_ALIGN - 1);
+    if (size == 0) size = KERNELS_ALIGN;
+#ifdef _WIN32
+    void *ptr = _aligned_malloc(size, KERNELS_ALIGN);
+#else
+    void *ptr = aligned_alloc(KERNELS_ALIGN, size);
+#endif
+    if (ptr) memset(ptr, 0, size);
+    return ptr;
+}
+
+void kernels_free(void *ptr) {
+#ifdef _WIN32
+    _aligned_free(ptr);
+#else
+    free(ptr);
+#endif
+}
+
+// ------------------------------------------------------------
+// CPU detection and dispatch
+// ------------------------------------------------------------
+
+const Kernels *kernels = &kernels_scalar;
+const Int8Kernels *int8_kernels = &int8_kernels_scalar;
+
+static CpuFeatures features;
+static bool features_detected = false;
+
+#ifdef KERNELS_X86
+static unsigned long long read_xcr0(void) {
+    unsigned int eax, edx;
+    __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return ((unsigned long long)edx << 32) | eax;
+}
+#endif
+
+const CpuFeatures *cpu_features(void) {
+    if (features_detected) return &features;
+    memset(&features, 0, sizeof(features));
+#ifdef KERNELS_X86
+    unsigned int eax, ebx, ecx, edx;
+    unsigned int max_leaf = __get_cpuid_max(0, NULL);
+    if (max_leaf >= 1 && __get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+        features.sse42 = (ecx >> 20) & 1;
+        bool osxsave = (ecx >> 27) & 1;
+        bool avx_hw = (ecx >> 28) & 1;
+        bool fma_hw = (ecx >> 12) & 1;
+        unsigned long long xcr0 = osxsave ? read_xcr0() : 0;
+        bool os_ymm = (xcr0 & 0x6) == 0x6;    // XMM + YMM state
+        bool os_zmm = (xcr0 & 0xE6) == 0xE6;  // + opmask, ZMM_Hi256, Hi16_ZMM
+        features.avx = avx_hw && os_ymm;
+        features.fma = fma_hw && os_ymm;
+        if (max_leaf >= 7) {
+            __cpuid_count(7, 0, eax, ebx, ecx, edx);
+            features.avx2 = features.avx && ((ebx >> 5) & 1);
+            features.avx512f = os_zmm && ((ebx >> 16) & 1);
+            features.avx512bw = os_zmm && ((ebx >> 30) & 1);
+            features.avx512vnni = os_zmm && ((ecx >> 11) & 1);
+            unsigned int max_sub = eax;
+            if (max_sub >= 1) {
+                __cpuid_count(7, 1, eax, ebx, ecx, edx);
+                features.avxvnni = features.avx2 && ((eax >> 4) & 1);
+            }
+        }
+    }
+#endif
+    features_detected = true;
+    return &features;
+}
+
+const Kernels *kernels_get(KernelIsa isa) {
+    const CpuFeatures *f = cpu_features();
+    switch (isa) {
+        case KERNEL_SCALAR: return &kernels_scalar;
+#ifdef KERNELS_X86
+        case KERNEL_SSE42:  return f->sse42 ? &kernels_sse42 : NULL;
+        case KERNEL_AVX2:   return (f->avx2 && f->fma) ? &kernels_avx2 : NULL;
+        case KERNEL_AVX512: return f->avx512f ? &kernels_avx512 : NULL;
+#endif
+        default: (void)f; return NULL;
+    }
+}
+
+const Int8Kernels *int8_kernels_get(KernelInt8Isa isa) {
+    const CpuFeatures *f = cpu_features();
+    switch (isa) {
+        case KERNEL_INT8_SCALAR:     return &int8_kernels_scalar;
+#ifdef KERNELS_X86
+        case KERNEL_INT8_SSE41:      return f->sse42 ? &int8_kernels_sse41 : NULL;
+        case KERNEL_INT8_AVX2:       return f->avx2 ? &int8_kernels_avx2 : NULL;
+        case KERNEL_INT8_AVXVNNI:    return f->avxvnni ? &int8_kernels_avxvnni : NULL;
+        case KERNEL_INT8_AVX512VNNI: return (f->avx512f && f->avx512vnni) ? &int8_kernels_avx512vnni : NULL;
+#endif
+        default: (void)f; return NULL;
+    }
+}
+
+// Dense ops are timed on this shape at startup: W is 1 MB, past L2 on
+// most cores like a real hidden layer, and all of it takes about 60 ms.
+// The histogram bins W, bell-shaped like trained weights.
+#define TUNE_BATCH 64
+#define TUNE_IN 1024
+#define TUNE_OUT 256
+#define TUNE_RUNS 5
+#define TUNE_BINS 64
+
+// The widest table with each dense op and the histogram taken from
+// whichever variant ran it fastest. Widest is not always fastest: on some
+// cores the AVX-512 backward and weight gradient run at half the AVX2
+// rate, and the histogram's gathers and scattered increments can favor
+// SSE4.2 or even scalar code.
+static Kernels kernels_tuned;
+static char kernels_tuned_name[128];
+
+enum { TUNE_FORWARD, TUNE_BACKWARD_DATA, TUNE_WEIGHT_GRAD, TUNE_HISTOGRAM };
+
+static const char *const tune_op_names[KERNEL_TUNED_OPS] = { "forward", "backward_data", "weight_grad", "histogram" };
+
+// CPU time of the calling thread, so other threads of the process (audio,
+// trainer, I/O) and time spent preempted do not count against a variant
+static double tune_now(void) {
+#ifdef _WIN32
+    FILETIME created, exited, kernel, user;
+    GetThreadTimes(GetCurrentThread(), &created, &exited, &kernel, &user);
+    return (((unsigned long long)user.dwHighDateTime << 32) | user.dwLowDateTime) * 1e-7;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+#endif
+}
+
+typedef struct {
+    float *X, *W, *D, *Y, *dX, *gW;
+    uint32_t *counts;
+} TuneData;
+
+static double tune_time(const Kernels *k, int op, const TuneData *d) {
+    float minmax[2] = { INFINITY, -INFINITY };
+    double t0 = tune_now();
+    switch (op) {
+        case TUNE_FORWARD: k->dense_forward(d->X, d->W, NULL, d->Y, TUNE_BATCH, TUNE_IN, TUNE_OUT); break;
+        case TUNE_BACKWARD_DATA: k->dense_backward_data(d->D, d->W, d->dX, TUNE_BATCH, TUNE_IN, TUNE_OUT); break;
+        case TUNE_WEIGHT_GRAD: k->dense_weight_grad(d->D, d->X, d->gW, NULL, TUNE_BATCH, TUNE_IN, TUNE_OUT); break;
+        default: k->histogram(d->W, TUNE_OUT * TUNE_IN, -0.2f, TUNE_BINS / 0.4f, TUNE_BINS, d->counts, minmax); break;
+    }
+    return tune_now() - t0;
+}
+
+// Times every op on every variant into tuning->op, the widest variant
+// unless another was clearly faster. Leaves tuning invalid when out of
+// memory.
+static void tune_measure(const Kernels *widest, KernelTuning *tuning) {
+    TuneData d = {
+        kernels_alloc(sizeof(float) * TUNE_BATCH * TUNE_IN),
+        kernels_alloc(sizeof(float) * TUNE_OUT * TUNE_IN),
+        kernels_alloc(sizeof(float) * TUNE_BATCH * TUNE_OUT),
+        kernels_alloc(sizeof(float) * TUNE_BATCH * TUNE_OUT),
+        kernels_alloc(sizeof(float) * TUNE_BATCH * TUNE_IN),
+        kernels_alloc(sizeof(float) * TUNE_OUT * TUNE_IN),
+        kernels_alloc(sizeof(uint32_t) * KERNELS_HIST_SUBS * TUNE_BINS),
+    };
+    if (!d.X || !d.W || !d.D || !d.Y || !d.dX || !d.gW || !d.counts) goto done;
+    for (int i = 0; i < TUNE_BATCH * TUNE_IN; i++) d.X[i] = (float)(i % 7) * 0.01f;
+    // W is a sum of three uniform values, so most of it falls in a few bins
+    uint32_t seed = 1;
+    for (int i = 0; i < TUNE_OUT * TUNE_IN; i++) {
+        float sum = 0.0f;
+        for (int j = 0; j < 3; j++) {
+            seed = seed * 1664525u + 1013904223u;
+            sum += (float)(seed >> 8) / 16777216.0f;
+        }
+        d.W[i] = (sum - 1.5f) * 0.1f;
+    }
+    for (int i = 0; i < TUNE_BATCH * TUNE_OUT; i++) d.D[i] = (float)(i % 3) * 0.01f;
+
+    for (int op = 0; op < KERNEL_TUNED_OPS; op++) {
+        // Scalar is never the fastest dense op where there is a vector
+        // variant, and would take longest to time. The variants take turns,
+        // so a burst of noise does not fall on all runs of one of them.
+        int first = op == TUNE_HISTOGRAM ? KERNEL_SCALAR : KERNEL_SCALAR + 1;
+        double times[KERNEL_ISA_COUNT];
+        for (int isa = 0; isa < KERNEL_ISA_COUNT; isa++) times[isa] = INFINITY;
+        for (int r = 0; r < TUNE_RUNS; r++) {
+            for (int isa = first; isa < KERNEL_ISA_COUNT; isa++) {
+                const Kernels *k = kernels_get((KernelIsa)isa);
+                if (!k) continue;
+                double t = tune_time(k, op, &d);
+                times[isa] = t < times[isa] ? t : times[isa];
+            }
+        }
+        tuning->op[op] = widest->isa;
+        double best_t = times[widest->isa];
+        for (int isa = first; isa < KERNEL_ISA_COUNT; isa++) {
+            // Only a clear win moves an op off the widest variant
+            if (times[isa] < best_t * 0.9) {
+                tuning->op[op] = (KernelIsa)isa;
+                best_t = times[isa];
+            }
+        }
+    }
+    tuning->widest = widest->isa;
+    tuning->valid = true;
+done:
+    kernels_free(d.X); kernels_free(d.W); kernels_free(d.D);
+    kernels_free(d.Y); kernels_free(d.dX); kernels_free(d.gW);
+    kernels_free(d.counts);
+}
+
+// The widest table with the ops `tuning` moved taken from their variants
+static const Kernels *tune_float(const Kernels *widest, KernelTuning *tuning) {
+    KernelTuning local = { 0 };
+    if (!tuning) tuning = &local;
+    if (!tuning->valid || tuning->widest != widest->isa) {
+        tuning->valid = false;
+        tune_measure(widest, tuning);
+    }
+    if (!tuning->valid) return widest;
+
+    kernels_tuned = *widest;
+    int len = snprintf(kernels_tuned_name, sizeof(kernels_tuned_name), "%s", widest->name);
+    for (int op = 0; op < KERNEL_TUNED_OPS; op++) {
+        const Kernels *best = kernels_get(tuning->op[op]);
+        if (!best || best == widest) continue;
+        if (op == TUNE_FORWARD) kernels_tuned.dense_forward = best->dense_forward;
+        if (op == TUNE_BACKWARD_DATA) kernels_tuned.dense_backward_data = best->dense_backward_data;
+        if (op == TUNE_WEIGHT_GRAD) kernels_tuned.dense_weight_grad = best->dense_weight_grad;
+        if (op == TUNE_HISTOGRAM) kernels_tuned.histogram = best->histogram;
+        if (len > 0 && len < (int)sizeof(kernels_tuned_name)) {
+            len += snprintf(kernels_tuned_name + len, sizeof(kernels_tuned_name) - len, " %s:%s",
+                            tune_op_names[op], best->name);
+        }
+    }
+    kernels_tuned.name = kernels_tuned_name;
+    return &kernels_tuned;
+}
+
+static void select_float(KernelTuning *tuning) {
+    const char *force = getenv("CONA_KERNELS");
+    if (force) {
+        for (int isa = 0; isa < KERNEL_ISA_COUNT; isa++) {
+            const Kernels *k = kernels_get((KernelIsa)isa);
+            if (k && strcmp(k->name, force) == 0) {
+                kernels = k;
+                return;
+            }
+        }
+        fprintf(stderr, "WARNING: CONA_KERNELS=%s is not available, autodetecting\n", force);
+    }
+
+    for (int isa = KERNEL_ISA_COUNT - 1; isa >= 0; isa--) {
+        const Kernels *k = kernels_get((KernelIsa)isa);
+        if (k) {
+            kernels = tune_float(k, tuning);
+            return;
+        }
+    }
+}
+
+static void select_int8(void) {
+    const char *force = getenv("CONA_INT8_KERNELS");
+    if (force) {
+        for (int isa = 0; isa < KERNEL_INT8_ISA_COUNT; isa++) {
+            const Int8Kernels *k = int8_kernels_get((KernelInt8Isa)isa);
+            if (k && strcmp(k->name, force) == 0) {
+                int8_kernels = k;
+                return;
+            }
+        }
+        fprintf(stderr, "WARNING: CONA_INT8_KERNELS=%s is not available, autodetecting\n", force);
+    }
+
+    // The enum is ordered by width, so the last available one wins
+    for (int isa = KERNEL_INT8_ISA_COUNT - 1; isa >= 0; isa--) {
+        const Int8Kernels *k = int8_kernels_get((KernelInt8Isa)isa);
+        if (k) {
+            int8_kernels = k;
+            return;
+        }
+    }
+}
+
+void kernels_init(KernelTuning *tuning) {
+    select_float(tuning);
+    select_int8();
+}
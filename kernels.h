@@ -0,0 +1,147 @@
+#ifndef KERNELS_H_
+#define KERNELS_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Alignment of kernels_alloc, one cache line and one AVX-512 register
+#define KERNELS_ALIGN 64
+
+// Rows passed to the int8 kernels are zero-padded to a multiple of this
+// many bytes, so no variant needs a tail loop
+#define KERNELS_INT8_BLOCK 64
+
+// Copies of the counts the histogram kernel spreads its increments over, a
+// power of two
+#define KERNELS_HIST_SUBS 4
+
+// Values the histogram kernel computes bin indices for before counting them
+#define KERNELS_HIST_BLOCK 256
+
+// Scalars of one fused optimizer update. Gradients are multiplied by
+// grad_scale as they are read, e.g. 1 / batch size.
+typedef struct {
+    float lr;
+    float grad_scale;
+    float momentum;       // optim_sgd with a velocity buffer
+    float beta1, beta2;   // optim_adam moment decay
+    float eps;
+    float weight_decay;   // optim_adam, decoupled (AdamW); 0 is plain Adam
+    float bias1, bias2;   // optim_adam bias corrections, 1 / (1 - beta^t)
+} OptimStep;
+
+// Dense layer math with one implementation per instruction set. All matrices
+// are row-major: X is [batch][in], W is [out][in], Y and D are [batch][out].
+typedef enum {
+    KERNEL_SCALAR,
+    KERNEL_SSE42,
+    KERNEL_AVX2,
+    KERNEL_AVX512,
+    KERNEL_ISA_COUNT
+} KernelIsa;
+
+typedef struct {
+    const char *name;
+    KernelIsa isa;
+    int lanes;         // floats per vector register
+    bool fma;          // fused multiply-add available
+
+    // Y = X W^T + bias (bias may be NULL)
+    void (*dense_forward)(const float *X, const float *W, const float *bias, float *Y,
+                          int batch, int in, int out);
+    // dX = D W
+    void (*dense_backward_data)(const float *D, const float *W, float *dX,
+                                int batch, int in, int out);
+    // gW += D^T X, gb += column sums of D (gb may be NULL)
+    void (*dense_weight_grad)(const float *D, const float *X, float *gW, float *gb,
+                              int batch, int in, int out);
+
+    // x += (target - x) * t elementwise; a NULL target decays x toward zero
+    void (*lerp)(float *x, const float *target, float t, int n);
+
+    // Fused optimizer updates over n parameters, every element of w, g and
+    // the state read and written once.
+    // optim_sgd:  v = momentum v + g, w -= lr v; plain SGD when v is NULL.
+    // optim_adam: m and v are the first and second moments,
+    //             w -= lr (m bias1 / (sqrt(v bias2) + eps) + weight_decay w).
+    void (*optim_sgd)(float *w, const float *g, float *v, int n, const OptimStep *s);
+    void (*optim_adam)(float *w, const float *g, float *m, float *v, int n, const OptimStep *s);
+
+    // Adds x to counts, [KERNELS_HIST_SUBS][bins] that the caller sums: x
+    // goes to bin (x - lo) * scale clamped to [0, bins - 1], NaN to bin 0.
+    // minmax[0] and [1] are lowered and raised to the smallest and largest x.
+    void (*histogram)(const float *x, int n, float lo, float scale, int bins, uint32_t *counts, float minmax[2]);
+} Kernels;
+
+// Integer dense layer for quantized inference: Y = X W^T with X unsigned
+// 8-bit [batch][in], W signed 8-bit [out][in] and int32 sums. The sums are
+// exact for in < 65536 with |W| <= 127, so every variant returns exactly
+// what the scalar one does.
+typedef enum {
+    KERNEL_INT8_SCALAR,
+    KERNEL_INT8_SSE41,      // widen to 16 bits, pmaddwd
+    KERNEL_INT8_AVX2,       // same with 16 lanes
+    KERNEL_INT8_AVXVNNI,    // vpdpbusd on ymm
+    KERNEL_INT8_AVX512VNNI, // vpdpbusd on zmm
+    KERNEL_INT8_ISA_COUNT
+} KernelInt8Isa;
+
+typedef struct {
+    const char *name;
+    KernelInt8Isa isa;
+    int bytes;         // input bytes per multiply-accumulate instruction
+    void (*dense_forward)(const uint8_t *X, const int8_t *W, int32_t *Y, int batch, int in, int out);
+} Int8Kernels;
+
+typedef struct {
+    bool sse42;
+    bool avx;
+    bool avx2;
+    bool fma;
+    bool avx512f;
+    bool avx512bw;
+    bool avx512vnni;
+    bool avxvnni;
+} CpuFeatures;
+
+// Ops kernels_init times on every variant: dense forward, backward data,
+// weight gradient and the histogram
+#define KERNEL_TUNED_OPS 4
+
+// Variant each timed op runs on, as kernels_init measured it. The caller
+// may keep it to skip the timing next time, e.g. across hot reloads, where
+// the tables move with the library but the CPU stays the same.
+typedef struct {
+    bool valid;
+    KernelIsa widest;
+    KernelIsa op[KERNEL_TUNED_OPS];
+} KernelTuning;
+
+// Active kernel tables. Point at the scalar tables until kernels_init runs.
+extern const Kernels *kernels;
+extern const Int8Kernels *int8_kernels;
+
+// Detects CPU features through CPUID and selects the widest supported
+// variants. Each float dense op and the histogram are then timed on every
+// supported variant, the best of several runs in the thread's CPU time,
+// about 60 ms in all, and run on whichever was clearly fastest; the
+// table's name lists the ops that moved. A valid `tuning` is used instead
+// of timing, an invalid one receives the result; NULL times and forgets.
+// CONA_KERNELS=scalar|sse4.2|avx2|avx512 forces a specific float table as
+// it is, CONA_INT8_KERNELS=scalar|sse4.1|avx2|avx-vnni|avx512-vnni an int8
+// one.
+void kernels_init(KernelTuning *tuning);
+
+// NULL if the variant is not compiled in or not supported by this CPU.
+const Kernels *kernels_get(KernelIsa isa);
+const Int8Kernels *int8_kernels_get(KernelInt8Isa isa);
+
+const CpuFeatures *cpu_features(void);
+
+// Zeroed, KERNELS_ALIGN-aligned storage for arrays the kernels stream over.
+// Release with kernels_free.
+void *kernels_alloc(size_t size);
+void kernels_free(void *ptr);
+
+#endif // KERNELS_H_
@@ -0,0 +1,87 @@
+// Dense layer drivers, instantiated once per instruction set by kernels.c.
+// Not a standalone header: the includer defines KERNEL_SUFFIX, KERNEL_ATTR
+// and the dot1/dot4/axpy1/axpy4 primitives for that suffix.
+
+#define KCAT_(a, b) a##_##b
+#define KCAT(a, b) KCAT_(a, b)
+#define KFN(name) KCAT(name, KERNEL_SUFFIX)
+
+// Rows of X processed against one block of W before moving on, so the four
+// W rows stay in L1 while the X tile stays in L2.
+#ifndef KERNEL_BATCH_TILE
+#define KERNEL_BATCH_TILE 64
+#endif
+
+KERNEL_ATTR static void KFN(dense_forward)(const float *X, const float *W, const float *bias, float *Y,
+                                           int batch, int in, int out) {
+    for (int b0 = 0; b0 < batch; b0 += KERNEL_BATCH_TILE) {
+        int b1 = b0 + KERNEL_BATCH_TILE < batch ? b0 + KERNEL_BATCH_TILE : batch;
+        int o = 0;
+        for (; o + 4 <= out; o += 4) {
+            const float *w = W + (size_t)o * in;
+            for (int b = b0; b < b1; b++) {
+                float acc[4];
+                KFN(dot4)(X + (size_t)b * in, w, in, in, acc);
+                float *y = Y + (size_t)b * out + o;
+                for (int k = 0; k < 4; k++) y[k] = acc[k] + (bias ? bias[o + k] : 0.0f);
+            }
+        }
+        for (; o < out; o++) {
+            const float *w = W + (size_t)o * in;
+            for (int b = b0; b < b1; b++) {
+                Y[(size_t)b * out + o] = KFN(dot1)(X + (size_t)b * in, w, in) + (bias ? bias[o] : 0.0f);
+            }
+        }
+    }
+}
+
+KERNEL_ATTR static void KFN(dense_backward_data)(const float *D, const float *W, float *dX,
+                                                 int batch, int in, int out) {
+    for (int b0 = 0; b0 < batch; b0 += KERNEL_BATCH_TILE) {
+        int b1 = b0 + KERNEL_BATCH_TILE < batch ? b0 + KERNEL_BATCH_TILE : batch;
+        for (int b = b0; b < b1; b++) {
+            float *dx = dX + (size_t)b * in;
+            for (int i = 0; i < in; i++) dx[i] = 0.0f;
+        }
+        int o = 0;
+        for (; o + 4 <= out; o += 4) {
+            const float *w = W + (size_t)o * in;
+            for (int b = b0; b < b1; b++) {
+                KFN(axpy4)(D + (size_t)b * out + o, w, in, dX + (size_t)b * in, in);
+            }
+        }
+        for (; o < out; o++) {
+            const float *w = W + (size_t)o * in;
+            for (int b = b0; b < b1; b++) {
+                KFN(axpy1)(D[(size_t)b * out + o], w, dX + (size_t)b * in, in);
+            }
+        }
+    }
+}
+
+KERNEL_ATTR static void KFN(dense_weight_grad)(const float *D, const float *X, float *gW, float *gb,
+                                               int batch, int in, int out) {
+    for (int o = 0; o < out; o++) {
+        float *g = gW + (size_t)o * in;
+        float bsum = 0.0f;
+        int b = 0;
+        for (; b + 4 <= batch; b += 4) {
+            float a[4] = {
+                D[(size_t)(b + 0) * out + o], D[(size_t)(b + 1) * out + o],
+                D[(size_t)(b + 2) * out + o], D[(size_t)(b + 3) * out + o],
+            };
+            bsum += a[0] + a[1] + a[2] + a[3];
+            KFN(axpy4)(a, X + (size_t)b * in, in, g, in);
+        }
+        for (; b < batch; b++) {
+            float a = D[(size_t)b * out + o];
+            bsum += a;
+            KFN(axpy1)(a, X + (size_t)b * in, g, in);
+        }
+        if (gb) gb[o] += bsum;
+    }
+}
+
+#undef KFN
+#undef KCAT
+#undef KCAT_
@@ -0,0 +1,61 @@
+// Histogram binning, instantiated once per instruction set by kernels.c.
+// Not a standalone header: the includer defines KERNEL_SUFFIX, KERNEL_ATTR,
+// VLANES and the VEC type with VLOAD, VSTORE, VSET1 and VMUL as for
+// kernels_optim.h, plus VSUB, VMIN, VMAX and VSTOREI (truncate to int32
+// and store). VMIN/VMAX must return their second operand when either is
+// NaN, as minps/maxps do, so NaN lands in bin 0 and leaves min/max alone.
+// This file undefines only the operations it adds.
+//
+// Bin indices are computed a vector at a time into a block, then counted
+// with scalar increments spread over KERNELS_HIST_SUBS copies of the counts
+// so runs of the same bin do not wait on each other's stores. Counting a
+// whole block after the vector stores keeps the scalar reads of the index
+// lanes from stalling on a store still in flight.
+
+#define KCAT_(a, b) a##_##b
+#define KCAT(a, b) KCAT_(a, b)
+#define KFN(name) KCAT(name, KERNEL_SUFFIX)
+
+KERNEL_ATTR static void KFN(histogram)(const float *x, int n, float lo, float scale, int bins,
+                                       uint32_t *counts, float minmax[2]) {
+    int i = 0;
+#if VLANES > 1
+    VEC vlo = VSET1(lo), vs = VSET1(scale), zero = VSET1(0.0f), top = VSET1((float)(bins - 1));
+    VEC mn = VSET1(minmax[0]), mx = VSET1(minmax[1]);
+    int32_t idx[KERNELS_HIST_BLOCK];
+    for (; i + KERNELS_HIST_BLOCK <= n; i += KERNELS_HIST_BLOCK) {
+        for (int j = 0; j < KERNELS_HIST_BLOCK; j += VLANES) {
+            VEC v = VLOAD(x + i + j);
+            mn = VMIN(v, mn);
+            mx = VMAX(v, mx);
+            VSTOREI(idx + j, VMIN(VMAX(VMUL(VSUB(v, vlo), vs), zero), top));
+        }
+        for (int j = 0; j < KERNELS_HIST_BLOCK; j++) counts[(j & (KERNELS_HIST_SUBS - 1)) * bins + idx[j]]++;
+    }
+    float m[VLANES];
+    VSTORE(m, mn);
+    for (int k = 0; k < VLANES; k++) minmax[0] = m[k] < minmax[0] ? m[k] : minmax[0];
+    VSTORE(m, mx);
+    for (int k = 0; k < VLANES; k++) minmax[1] = m[k] > minmax[1] ? m[k] : minmax[1];
+    if (i < n) histogram_scalar(x + i, n - i, lo, scale, bins, counts, minmax);
+#else
+    float top = (float)(bins - 1);
+    for (; i < n; i++) {
+        float v = x[i];
+        minmax[0] = v < minmax[0] ? v : minmax[0];
+        minmax[1] = v > minmax[1] ? v : minmax[1];
+        float b = (v - lo) * scale;
+        b = b > 0.0f ? b : 0.0f;
+        b = b < top ? b : top;
+        counts[(i & (KERNELS_HIST_SUBS - 1)) * bins + (int)b]++;
+    }
+#endif
+}
+
+#undef KFN
+#undef KCAT
+#undef KCAT_
+#undef VSUB
+#undef VMIN
+#undef VMAX
+#undef VSTOREI
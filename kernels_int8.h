@@ -0,0 +1,36 @@
+// Int8 dense layer driver, instantiated once per instruction set by
+// kernels.c. Not a standalone header: the includer defines KERNEL_SUFFIX,
+// KERNEL_ATTR and the qdot1/qdot4 primitives for that suffix. `in` is a
+// multiple of KERNELS_INT8_BLOCK, so the primitives have no tails.
+
+#define KCAT_(a, b) a##_##b
+#define KCAT(a, b) KCAT_(a, b)
+#define KFN(name) KCAT(name, KERNEL_SUFFIX)
+
+#ifndef KERNEL_BATCH_TILE
+#define KERNEL_BATCH_TILE 64
+#endif
+
+KERNEL_ATTR static void KFN(qdense_forward)(const uint8_t *X, const int8_t *W, int32_t *Y,
+                                            int batch, int in, int out) {
+    for (int b0 = 0; b0 < batch; b0 += KERNEL_BATCH_TILE) {
+        int b1 = b0 + KERNEL_BATCH_TILE < batch ? b0 + KERNEL_BATCH_TILE : batch;
+        int o = 0;
+        for (; o + 4 <= out; o += 4) {
+            const int8_t *w = W + (size_t)o * in;
+            for (int b = b0; b < b1; b++) {
+                KFN(qdot4)(X + (size_t)b * in, w, in, in, Y + (size_t)b * out + o);
+            }
+        }
+        for (; o < out; o++) {
+            const int8_t *w = W + (size_t)o * in;
+            for (int b = b0; b < b1; b++) {
+                Y[(size_t)b * out + o] = KFN(qdot1)(X + (size_t)b * in, w, in);
+            }
+        }
+    }
+}
+
+#undef KFN
+#undef KCAT
+#undef KCAT_
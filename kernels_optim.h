@@ -0,0 +1,63 @@
+// Fused optimizer updates, instantiated once per instruction set by
+// kernels.c. Not a standalone header: the includer defines KERNEL_SUFFIX,
+// KERNEL_ATTR, VLANES and the VEC type with its V* operations, where
+// VFMA(a, b, c) is a * b + c; those are undefined again at the end.
+// Vector variants hand their tails to the scalar instantiation, which is
+// included first.
+
+#define KCAT_(a, b) a##_##b
+#define KCAT(a, b) KCAT_(a, b)
+#define KFN(name) KCAT(name, KERNEL_SUFFIX)
+
+KERNEL_ATTR static void KFN(optim_sgd)(float *w, const float *g, float *v, int n, const OptimStep *s) {
+    int i = 0;
+    if (!v) {
+        VEC a = VSET1(-s->lr * s->grad_scale);
+        for (; i + VLANES <= n; i += VLANES) VSTORE(w + i, VFMA(VLOAD(g + i), a, VLOAD(w + i)));
+    } else {
+        VEC gs = VSET1(s->grad_scale), mu = VSET1(s->momentum), a = VSET1(-s->lr);
+        for (; i + VLANES <= n; i += VLANES) {
+            VEC vv = VFMA(VLOAD(v + i), mu, VMUL(VLOAD(g + i), gs));
+            VSTORE(v + i, vv);
+            VSTORE(w + i, VFMA(vv, a, VLOAD(w + i)));
+        }
+    }
+#if VLANES > 1
+    if (i < n) optim_sgd_scalar(w + i, g + i, v ? v + i : NULL, n - i, s);
+#endif
+}
+
+KERNEL_ATTR static void KFN(optim_adam)(float *w, const float *g, float *m, float *v, int n, const OptimStep *s) {
+    VEC gs = VSET1(s->grad_scale);
+    VEC b1 = VSET1(s->beta1), nb1 = VSET1(1.0f - s->beta1);
+    VEC b2 = VSET1(s->beta2), nb2 = VSET1(1.0f - s->beta2);
+    VEC c2 = VSET1(s->bias2), eps = VSET1(s->eps);
+    VEC a = VSET1(-s->lr * s->bias1), decay = VSET1(1.0f - s->lr * s->weight_decay);
+    int i = 0;
+    for (; i + VLANES <= n; i += VLANES) {
+        VEC gv = VMUL(VLOAD(g + i), gs);
+        VEC mv = VFMA(VLOAD(m + i), b1, VMUL(gv, nb1));
+        VEC vv = VFMA(VLOAD(v + i), b2, VMUL(VMUL(gv, gv), nb2));
+        VSTORE(m + i, mv);
+        VSTORE(v + i, vv);
+        VEC den = VADD(VSQRT(VMUL(vv, c2)), eps);
+        VSTORE(w + i, VFMA(VDIV(mv, den), a, VMUL(VLOAD(w + i), decay)));
+    }
+#if VLANES > 1
+    if (i < n) optim_adam_scalar(w + i, g + i, m + i, v + i, n - i, s);
+#endif
+}
+
+#undef KFN
+#undef KCAT
+#undef KCAT_
+#undef VLANES
+#undef VEC
+#undef VLOAD
+#undef VSTORE
+#undef VSET1
+#undef VADD
+#undef VMUL
+#undef VDIV
+#undef VSQRT
+#undef VFMA
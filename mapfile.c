@@ -0,0 +1,107 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <string.h>
+
+#include "mapfile.h"
+
+#ifdef _WIN32
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+bool stat_file(const char *path, uint64_t *size, uint64_t *mtime) {
+    #ifdef _WIN32
+        WIN32_FILE_ATTRIBUTE_DATA attr;
+        if (!GetFileAttributesExA(path, GetFileExInfoStandard, &attr)) return false;
+        if (size) *size = ((uint64_t)attr.nFileSizeHigh << 32) | attr.nFileSizeLow;
+        if (mtime) {
+            uint64_t t = ((uint64_t)attr.ftLastWriteTime.dwHighDateTime << 32) | attr.ftLastWriteTime.dwLowDateTime;
+            *mtime = t / 10000000ULL - 11644473600ULL;
+        }
+        return true;
+    #else
+        struct stat st;
+        if (stat(path, &st) != 0) return false;
+        if (size) *size = (uint64_t)st.st_size;
+        if (mtime) *mtime = (uint64_t)st.st_mtime;
+        return true;
+    #endif
+}
+
+bool map_file(MappedFile *mf, const char *path, MapMode mode) {
+    memset(mf, 0, sizeof(*mf));
+    #ifdef _WIN32
+        HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                                  FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+        if (file == INVALID_HANDLE_VALUE) {
+            fprintf(stderr, "ERROR: could not open %s\n", path);
+            return false;
+        }
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+            CloseHandle(file);
+            fprintf(stderr, "ERROR: %s is empty or unreadable\n", path);
+            return false;
+        }
+        DWORD protect = (mode == MAP_COPY_ON_WRITE) ? PAGE_WRITECOPY : PAGE_READONLY;
+        HANDLE mapping = CreateFileMappingA(file, NULL, protect, 0, 0, NULL);
+        if (mapping == NULL) {
+            CloseHandle(file);
+            fprintf(stderr, "ERROR: could not map %s\n", path);
+            return false;
+        }
+        DWORD access = (mode == MAP_COPY_ON_WRITE) ? FILE_MAP_COPY : FILE_MAP_READ;
+        void *data = MapViewOfFile(mapping, access, 0, 0, 0);
+        if (data == NULL) {
+            CloseHandle(mapping);
+            CloseHandle(file);
+            fprintf(stderr, "ERROR: could not map %s\n", path);
+            return false;
+        }
+        mf->data = data;
+        mf->size = (size_t)size.QuadPart;
+        mf->file = file;
+        mf->mapping = mapping;
+        stat_file(path, NULL, &mf->mtime);
+        return true;
+    #else
+        int fd = open(path, O_RDONLY);
+        if (fd < 0) {
+            fprintf(stderr, "ERROR: could not open %s\n", path);
+            return false;
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size == 0) {
+            close(fd);
+            fprintf(stderr, "ERROR: %s is empty or unreadable\n", path);
+            return false;
+        }
+        int prot = PROT_READ | (mode == MAP_COPY_ON_WRITE ? PROT_WRITE : 0);
+        void *data = mmap(NULL, (size_t)st.st_size, prot, MAP_PRIVATE, fd, 0);
+        close(fd); // the mapping keeps its own reference
+        if (data == MAP_FAILED) {
+            fprintf(stderr, "ERROR: could not map %s\n", path);
+            return false;
+        }
+        mf->data = data;
+        mf->size = (size_t)st.st_size;
+        mf->mtime = (uint64_t)st.st_mtime;
+        return true;
+    #endif
+}
+
+void unmap_file(MappedFile *mf) {
+    if (mf->data == NULL) return;
+    #ifdef _WIN32
+        UnmapViewOfFile(mf->data);
+        CloseHandle((HANDLE)mf->mapping);
+        CloseHandle((HANDLE)mf->file);
+    #else
+        munmap(mf->data, mf->size);
+    #endif
+    memset(mf, 0, sizeof(*mf));
+}
@@ -0,0 +1,29 @@
+#ifndef MAPFILE_H_
+#define MAPFILE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef enum {
+    MAP_READ_ONLY,
+    MAP_COPY_ON_WRITE, // writable view, changes stay private to the process
+} MapMode;
+
+typedef struct {
+    void *data;
+    size_t size;
+    uint64_t mtime;     // last modification time, seconds since epoch
+    #ifdef _WIN32
+        void *file;
+        void *mapping;
+    #endif
+} MappedFile;
+
+bool map_file(MappedFile *mf, const char *path, MapMode mode);
+void unmap_file(MappedFile *mf);
+
+// Size and mtime without mapping. Returns false if the file is missing.
+bool stat_file(const char *path, uint64_t *size, uint64_t *mtime);
+
+#endif // MAPFILE_H_
@@ -0,0 +1,255 @@
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h"
+#include "model.h"
+
+_Static_assert(sizeof(ModelHeader) == MODEL_ALIGN, "model header must fill one aligned block");
+
+static uint64_t align_up(uint64_t v) {
+    return (v + MODEL_ALIGN - 1) & ~(uint64_t)(MODEL_ALIGN - 1);
+}
+
+static bool host_is_little_endian(void) {
+    const uint16_t probe = 1;
+    return *(const uint8_t *)&probe == 1;
+}
+
+static uint32_t swap32(uint32_t v) {
+    return (v >> 24) | ((v >> 8) & 0xFF00u) | ((v << 8) & 0xFF0000u) | (v << 24);
+}
+
+static uint64_t swap64(uint64_t v) {
+    return ((uint64_t)swap32((uint32_t)v) << 32) | swap32((uint32_t)(v >> 32));
+}
+
+// Big-endian hosts convert the mapping in place; it is copy-on-write, so
+// the file itself is untouched. Little-endian hosts never get here.
+static void swap_words(void *data, size_t count) {
+    uint32_t *w = data;
+    for (size_t i = 0; i < count; i++) w[i] = swap32(w[i]);
+}
+
+static void swap_header(ModelHeader *h) {
+    h->version = swap32(h->version);
+    h->layer_count = swap32(h->layer_count);
+    h->flags = swap32(h->flags);
+    h->file_size = swap64(h->file_size);
+    h->sizes_offset = swap64(h->sizes_offset);
+    h->tensors_offset = swap64(h->tensors_offset);
+}
+
+static bool range_ok(uint64_t offset, uint64_t bytes, uint64_t file_size) {
+    return offset % MODEL_ALIGN == 0 && offset <= file_size && bytes <= file_size - offset;
+}
+
+bool model_open(ModelFile *m, const char *path) {
+    memset(m, 0, sizeof(*m));
+    if (!map_file(&m->file, path, MAP_COPY_ON_WRITE)) return false;
+
+    bool swap = !host_is_little_endian();
+    uint8_t *base = m->file.data;
+    ModelHeader *h = (ModelHeader *)base;
+    if (m->file.size < sizeof(*h) || memcmp(h->magic, MODEL_MAGIC, 8) != 0) {
+        fprintf(stderr, "ERROR: %s is not a model file\n", path);
+        goto fail;
+    }
+    if (swap) swap_header(h);
+    if (h->version != MODEL_VERSION) {
+        fprintf(stderr, "ERROR: %s: unsupported model version %u\n", path, h->version);
+        goto fail;
+    }
+    if (h->layer_count < 2 || h->layer_count > MODEL_MAX_LAYERS || h->file_size != m->file.size
+        || !range_ok(h->sizes_offset, sizeof(uint32_t) * h->layer_count, h->file_size)
+        || !range_ok(h->tensors_offset, sizeof(ModelTensor) * (h->layer_count - 1), h->file_size)) {
+        fprintf(stderr, "ERROR: %s: corrupt model header\n", path);
+        goto fail;
+    }
+
+    m->layer_count = (int)h->layer_count;
+    m->flags = h->flags;
+    uint32_t *sizes = (uint32_t *)(base + h->sizes_offset);
+    if (swap) swap_words(sizes, m->layer_count);
+    for (int i = 0; i < m->layer_count; i++) {
+        if (sizes[i] == 0 || sizes[i] > (1u << 24)) {
+            fprintf(stderr, "ERROR: %s: invalid width %u for layer %d\n", path, sizes[i], i);
+            goto fail;
+        }
+        m->sizes[i] = (int)sizes[i];
+    }
+
+    ModelTensor *tensors = (ModelTensor *)(base + h->tensors_offset);
+    for (int i = 0; i < m->layer_count - 1; i++) {
+        ModelTensor *t = &tensors[i];
+        if (swap) {
+            t->weights_offset = swap64(t->weights_offset);
+            t->bias_offset = swap64(t->bias_offset);
+        }
+        uint64_t wn = (uint64_t)m->sizes[i] * m->sizes[i + 1];
+        uint64_t bn = (uint64_t)m->sizes[i + 1];
+        if (!range_ok(t->weights_offset, sizeof(float) * wn, h->file_size)
+            || !range_ok(t->bias_offset, sizeof(float) * bn, h->file_size)) {
+            fprintf(stderr, "ERROR: %s: tensor %d is out of bounds\n", path, i);
+            goto fail;
+        }
+        m->weights[i] = (float *)(base + t->weights_offset);
+        m->biases[i] = (float *)(base + t->bias_offset);
+        if (swap) {
+            swap_words(m->weights[i], wn);
+            swap_words(m->biases[i], bn);
+        }
+    }
+    return true;
+
+fail:
+    model_close(m);
+    return false;
+}
+
+void model_close(ModelFile *m) {
+    unmap_file(&m->file);
+    memset(m, 0, sizeof(*m));
+}
+
+bool model_bind(ModelFile *m, Mlp *nn) {
+    if (!nn_init_external(nn, m->sizes, m->layer_count, m->weights, m->biases)) return false;
+    if ((m->flags & MODEL_FLAG_SPARSE) && nn_mask_zeros(nn) < 0) {
+        nn_free(nn);
+        return false;
+    }
+    return true;
+}
+
+// Writes `count` floats little-endian
+static bool write_floats(FILE *f, const float *v, size_t count) {
+    if (host_is_little_endian()) return fwrite(v, sizeof(float), count, f) == count;
+    for (size_t i = 0; i < count; i++) {
+        uint32_t w;
+        memcpy(&w, &v[i], 4);
+        w = swap32(w);
+        if (fwrite(&w, 4, 1, f) != 1) return false;
+    }
+    return true;
+}
+
+static bool write_padding(FILE *f, uint64_t *pos) {
+    static const uint8_t zeros[MODEL_ALIGN] = {0};
+    uint64_t next = align_up(*pos);
+    size_t pad = (size_t)(next - *pos);
+    *pos = next;
+    return pad == 0 || fwrite(zeros, 1, pad, f) == pad;
+}
+
+bool model_layout(const Mlp *nn, ModelLayout *layout) {
+    int L = nn->layer_count;
+    if (L < 2 || L > MODEL_MAX_LAYERS) return false;
+    if (!nn_is_dense(nn)) {
+        fprintf(stderr, "ERROR: model files only hold fully connected networks\n");
+        return false;
+    }
+
+    ModelHeader *h = &layout->header;
+    memset(h, 0, sizeof(*h));
+    memcpy(h->magic, MODEL_MAGIC, 8);
+    h->version = MODEL_VERSION;
+    h->layer_count = (uint32_t)L;
+    uint64_t pos = sizeof(*h);
+    h->sizes_offset = pos = align_up(pos);
+    pos += sizeof(uint32_t) * L;
+    h->tensors_offset = pos = align_up(pos);
+    pos += sizeof(ModelTensor) * (L - 1);
+    for (int i = 0; i < L - 1; i++) {
+        const NnDense *d = &nn->dense[i];
+        if (d->mask) h->flags |= MODEL_FLAG_SPARSE;
+        layout->tensors[i].weights_offset = pos = align_up(pos);
+        pos += sizeof(float) * (uint64_t)d->in * d->out;
+        layout->tensors[i].bias_offset = pos = align_up(pos);
+        pos += sizeof(float) * (uint64_t)d->out;
+    }
+    h->file_size = pos;
+    return true;
+}
+
+// Header, sizes and tensor table as they go on disk
+typedef struct {
+    ModelHeader header;
+    uint32_t sizes[MODEL_MAX_LAYERS];
+    ModelTensor tensors[MODEL_MAX_LAYERS - 1];
+} DiskTables;
+
+static void disk_tables(const Mlp *nn, const ModelLayout *layout, DiskTables *t) {
+    int L = nn->layer_count;
+    t->header = layout->header;
+    memcpy(t->tensors, layout->tensors, sizeof(ModelTensor) * (L - 1));
+    for (int i = 0; i < L; i++) t->sizes[i] = (uint32_t)nn->sizes[i];
+    if (!host_is_little_endian()) {
+        swap_header(&t->header);
+        swap_words(t->sizes, L);
+        for (int i = 0; i < L - 1; i++) {
+            t->tensors[i].weights_offset = swap64(t->tensors[i].weights_offset);
+            t->tensors[i].bias_offset = swap64(t->tensors[i].bias_offset);
+        }
+    }
+}
+
+static void copy_floats(void *dst, const float *v, size_t count) {
+    memcpy(dst, v, sizeof(float) * count);
+    if (!host_is_little_endian()) swap_words(dst, count);
+}
+
+void model_write_image(const Mlp *nn, const ModelLayout *layout, void *image) {
+    int L = nn->layer_count;
+    uint8_t *base = image;
+    const ModelHeader *h = &layout->header;
+    DiskTables t;
+    disk_tables(nn, layout, &t);
+    memcpy(base, &t.header, sizeof(t.header));
+    memcpy(base + h->sizes_offset, t.sizes, sizeof(uint32_t) * L);
+    memcpy(base + h->tensors_offset, t.tensors, sizeof(ModelTensor) * (L - 1));
+    for (int i = 0; i < L - 1; i++) {
+        const NnDense *d = &nn->dense[i];
+        copy_floats(base + layout->tensors[i].weights_offset, d->w, (size_t)d->in * d->out);
+        copy_floats(base + layout->tensors[i].bias_offset, d->b, d->out);
+    }
+}
+
+bool model_save(const Mlp *nn, const char *path) {
+    int L = nn->layer_count;
+    ModelLayout layout;
+    if (!model_layout(nn, &layout)) return false;
+
+    char tmp[CONFIG_PATH_MAX + 128];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    FILE *f = fopen(tmp, "wb");
+    if (!f) {
+        fprintf(stderr, "ERROR: could not write %s\n", tmp);
+        return false;
+    }
+
+    DiskTables t;
+    disk_tables(nn, &layout, &t);
+    uint64_t pos = 0;
+    bool ok = fwrite(&t.header, sizeof(t.header), 1, f) == 1;
+    pos += sizeof(t.header);
+    ok = ok && write_padding(f, &pos) && fwrite(t.sizes, sizeof(uint32_t), L, f) == (size_t)L;
+    pos += sizeof(uint32_t) * L;
+    ok = ok && write_padding(f, &pos) && fwrite(t.tensors, sizeof(ModelTensor), L - 1, f) == (size_t)(L - 1);
+    pos += sizeof(ModelTensor) * (L - 1);
+    for (int i = 0; ok && i < L - 1; i++) {
+        const NnDense *d = &nn->dense[i];
+        size_t wn = (size_t)d->in * d->out;
+        ok = write_padding(f, &pos) && write_floats(f, d->w, wn);
+        pos += sizeof(float) * wn;
+        ok = ok && write_padding(f, &pos) && write_floats(f, d->b, d->out);
+        pos += sizeof(float) * d->out;
+    }
+    ok = (fclose(f) == 0) && ok && pos == layout.header.file_size;
+    if (!ok || rename(tmp, path) != 0) {
+        fprintf(stderr, "ERROR: could not write model %s\n", path);
+        remove(tmp);
+        return false;
+    }
+    return true;
+}
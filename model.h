@@ -0,0 +1,84 @@
+#ifndef MODEL_H_
+#define MODEL_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "mapfile.h"
+#include "nn.h"
+
+#define MODEL_MAGIC "CONAMODL"
+#define MODEL_VERSION 1
+#define MODEL_ALIGN 64
+#define MODEL_MAX_LAYERS 256
+
+// Zero weights are removed connections (see nn_mask_zeros)
+#define MODEL_FLAG_SPARSE 0x1
+
+// Model file layout. Every field and tensor is little-endian, every offset
+// is a multiple of MODEL_ALIGN from the start of the file:
+//
+//     ModelHeader                          64 bytes
+//     uint32_t sizes[layer_count]          neuron layer widths, input first
+//     ModelTensor tensors[layer_count-1]   one per weight layer
+//     float32 weights [out][in], float32 bias [out], per weight layer
+//
+// Aligned tensors let a mapping of the file be used as the weights directly.
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t layer_count;    // neuron layers, input included
+    uint32_t flags;
+    uint32_t reserved0;
+    uint64_t file_size;
+    uint64_t sizes_offset;
+    uint64_t tensors_offset;
+    uint8_t reserved[16];
+} ModelHeader;
+
+typedef struct {
+    uint64_t weights_offset;
+    uint64_t bias_offset;
+} ModelTensor;
+
+// An opened model file. The mapping is copy-on-write, so a network built
+// on it can keep training without touching the file.
+typedef struct {
+    MappedFile file;
+    int layer_count;
+    int sizes[MODEL_MAX_LAYERS];
+    float *weights[MODEL_MAX_LAYERS - 1];
+    float *biases[MODEL_MAX_LAYERS - 1];
+    uint32_t flags;
+} ModelFile;
+
+// Maps and validates `path`. Costs a few page faults regardless of the
+// model size; the tensors are paged in as they are used.
+bool model_open(ModelFile *m, const char *path);
+void model_close(ModelFile *m);
+
+// Builds `nn` on the mapped tensors with zero copies. The model must stay
+// open as long as the network exists.
+bool model_bind(ModelFile *m, Mlp *nn);
+
+// Writes the network to `path` through a temporary file and a rename, so
+// readers never see a partial model. Version 1 files describe fully
+// connected networks only; convolutional ones are refused.
+bool model_save(const Mlp *nn, const char *path);
+
+// Where everything of a given network goes in the file, in host byte order.
+// header.file_size is the total size.
+typedef struct {
+    ModelHeader header;
+    ModelTensor tensors[MODEL_MAX_LAYERS - 1];
+} ModelLayout;
+
+// False if the network cannot be stored (see model_save)
+bool model_layout(const Mlp *nn, ModelLayout *layout);
+
+// Renders the whole file into `image` (header.file_size bytes), for writers
+// that do their own I/O. Padding is never written, so the image must have
+// been zeroed once.
+void model_write_image(const Mlp *nn, const ModelLayout *layout, void *image);
+
+#endif // MODEL_H_
@@ -0,0 +1,607 @@
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "nn.h"
+#include "kernels.h"
+
+bool nn_layer_shapes(NnShape input, const NnLayerSpec *layers, int count, NnShape *shapes) {
+    shapes[0] = input;
+    bool flat = false;
+    for (int i = 0; i < count; i++) {
+        const NnLayerSpec *s = &layers[i];
+        NnShape src = shapes[i], dst;
+        switch (s->kind) {
+            case NN_DENSE:
+                dst = (NnShape){ s->size, 1, 1 };
+                flat = true;
+                break;
+            case NN_CONV:
+                if (flat || s->k < 1 || s->pad < 0) return false;
+                dst = (NnShape){ s->size, src.h + 2*s->pad - s->k + 1, src.w + 2*s->pad - s->k + 1 };
+                break;
+            case NN_MAXPOOL:
+                if (flat || s->k < 1 || s->stride < 1 || s->k > src.h || s->k > src.w) return false;
+                dst = (NnShape){ src.c, (src.h - s->k) / s->stride + 1, (src.w - s->k) / s->stride + 1 };
+                break;
+            default:
+                return false;
+        }
+        if (dst.c < 1 || dst.h < 1 || dst.w < 1) return false;
+        shapes[i + 1] = dst;
+    }
+    return true;
+}
+
+// Every layer's geometry from the specs
+static bool nn_geometry(Mlp *nn, NnShape input, const NnLayerSpec *specs, int count) {
+    if (!nn_layer_shapes(input, specs, count, nn->shape)) return false;
+    for (int i = 0; i <= count; i++) nn->sizes[i] = nn->shape[i].c * nn->shape[i].h * nn->shape[i].w;
+    for (int i = 0; i < count; i++) {
+        const NnLayerSpec *s = &specs[i];
+        NnDense *d = &nn->dense[i];
+        d->kind = s->kind;
+        d->in = nn->sizes[i];
+        d->out = nn->sizes[i + 1];
+        d->src = nn->shape[i];
+        d->dst = nn->shape[i + 1];
+        switch (s->kind) {
+            case NN_DENSE:
+                d->rows = d->out;
+                d->cols = d->in;
+                break;
+            case NN_CONV:
+                d->k = s->k;
+                d->stride = 1;
+                d->pad = s->pad;
+                d->rows = s->size;
+                d->cols = s->k * s->k * d->src.c;
+                break;
+            default:
+                d->k = s->k;
+                d->stride = s->stride;
+                break;
+        }
+    }
+    return true;
+}
+
+// Patch and patch-gradient blocks for the widest convolution, 0 without any
+static size_t nn_col_floats(const Mlp *nn) {
+    size_t n = 0;
+    for (int l = 0; l < nn->layer_count - 1; l++) {
+        if (nn_layer_col_floats(&nn->dense[l]) > n) n = nn_layer_col_floats(&nn->dense[l]);
+    }
+    return n;
+}
+
+static bool nn_alloc(Mlp *nn, NnShape input, const NnLayerSpec *specs, int count, uint64_t seed,
+                     float *const *weights, float *const *biases) {
+    assert(count >= 1);
+    memset(nn, 0, sizeof(*nn));
+    int layer_count = count + 1;
+    nn->layer_count = layer_count;
+    nn->sizes = malloc(sizeof(int) * layer_count);
+    nn->shape = malloc(sizeof(NnShape) * layer_count);
+    nn->dense = calloc(layer_count - 1, sizeof(NnDense));
+    nn->act = calloc(layer_count, sizeof(float *));
+    nn->delta = calloc(layer_count, sizeof(float *));
+    nn->argmax = calloc(layer_count - 1, sizeof(int *));
+    if (!nn->sizes || !nn->shape || !nn->dense || !nn->act || !nn->delta || !nn->argmax) goto fail;
+    if (!nn_geometry(nn, input, specs, count)) goto fail;
+
+    for (int i = 0; i < layer_count; i++) {
+        nn->act[i] = calloc(nn->sizes[i], sizeof(float));
+        nn->delta[i] = calloc(nn->sizes[i], sizeof(float));
+        if (!nn->act[i] || !nn->delta[i]) goto fail;
+    }
+    size_t col = nn_col_floats(nn);
+    if (col) {
+        nn->col = malloc(sizeof(float) * col);
+        if (!nn->col) goto fail;
+    }
+
+    NnRng rng = { seed ? seed : 0x9E3779B97F4A7C15ULL };
+    for (int i = 0; i < layer_count - 1; i++) {
+        NnDense *d = &nn->dense[i];
+        if (d->kind == NN_MAXPOOL) {
+            nn->argmax[i] = malloc(sizeof(int) * d->out);
+            if (!nn->argmax[i]) goto fail;
+            continue;
+        }
+        size_t n = nn_weight_count(d);
+        d->gw = calloc(n, sizeof(float));
+        d->gb = calloc(d->rows, sizeof(float));
+        if (!d->gw || !d->gb) goto fail;
+        if (weights) {
+            d->external = true;
+            d->w = weights[i];
+            d->b = biases[i];
+            continue;
+        }
+        d->w = malloc(sizeof(float) * n);
+        d->b = calloc(d->rows, sizeof(float));
+        if (!d->w || !d->b) goto fail;
+
+        // He-uniform for ReLU layers, Glorot-uniform for the softmax layer.
+        // A convolution's fan-in is its patch size.
+        bool last = (i == layer_count - 2);
+        float limit = last ? sqrtf(6.0f / (d->cols + d->rows)) : sqrtf(6.0f / d->cols);
+        for (size_t k = 0; k < n; k++) {
+            d->w[k] = (2.0f * nn_rng_float(&rng) - 1.0f) * limit;
+        }
+    }
+    return true;
+
+fail:
+    nn_free(nn);
+    return false;
+}
+
+static NnLayerSpec *dense_specs(const int *sizes, int layer_count) {
+    NnLayerSpec *specs = calloc(layer_count - 1, sizeof(NnLayerSpec));
+    for (int i = 0; specs && i < layer_count - 1; i++) specs[i] = (NnLayerSpec){ .kind = NN_DENSE, .size = sizes[i + 1] };
+    return specs;
+}
+
+static bool nn_init_dense(Mlp *nn, const int *sizes, int layer_count, uint64_t seed,
+                          float *const *weights, float *const *biases) {
+    assert(layer_count >= 2);
+    NnLayerSpec *specs = dense_specs(sizes, layer_count);
+    if (!specs) {
+        memset(nn, 0, sizeof(*nn));
+        return false;
+    }
+    bool ok = nn_alloc(nn, (NnShape){ sizes[0], 1, 1 }, specs, layer_count - 1, seed, weights, biases);
+    free(specs);
+    return ok;
+}
+
+bool nn_init(Mlp *nn, const int *sizes, int layer_count, uint64_t seed) {
+    return nn_init_dense(nn, sizes, layer_count, seed, NULL, NULL);
+}
+
+bool nn_init_layers(Mlp *nn, NnShape input, const NnLayerSpec *layers, int count, uint64_t seed) {
+    return nn_alloc(nn, input, layers, count, seed, NULL, NULL);
+}
+
+bool nn_init_external(Mlp *nn, const int *sizes, int layer_count, float *const *weights, float *const *biases) {
+    return nn_init_dense(nn, sizes, layer_count, 0, weights, biases);
+}
+
+void nn_free(Mlp *nn) {
+    if (nn->dense) {
+        for (int i = 0; i < nn->layer_count - 1; i++) {
+            if (!nn->dense[i].external) {
+                free(nn->dense[i].w);
+                free(nn->dense[i].b);
+            }
+            free(nn->dense[i].gw);
+            free(nn->dense[i].gb);
+            free(nn->dense[i].mask);
+        }
+    }
+    for (int i = 0; nn->act && i < nn->layer_count; i++) free(nn->act[i]);
+    for (int i = 0; nn->delta && i < nn->layer_count; i++) free(nn->delta[i]);
+    for (int i = 0; nn->argmax && i < nn->layer_count - 1; i++) free(nn->argmax[i]);
+    free(nn->act);
+    free(nn->delta);
+    free(nn->argmax);
+    free(nn->col);
+    free(nn->dense);
+    free(nn->shape);
+    free(nn->sizes);
+    memset(nn, 0, sizeof(*nn));
+}
+
+bool nn_is_dense(const Mlp *nn) {
+    for (int l = 0; l < nn->layer_count - 1; l++) if (nn->dense[l].kind != NN_DENSE) return false;
+    return true;
+}
+
+// ------------------------------------------------------------
+// Layer kernels. `rows` samples are stored back to back, each in the
+// layer's [h][w][c] order.
+// ------------------------------------------------------------
+
+// Patch rows g0..g1 of the batch's output positions (sample-major), one
+// [k][k][c_in] patch per row, zero outside the image
+static void im2col(const NnDense *d, const float *x, float *col, int g0, int g1) {
+    int P = d->dst.h * d->dst.w, c = d->src.c;
+    for (int g = g0; g < g1; g++) {
+        int pos = g % P, oy = pos / d->dst.w, ox = pos % d->dst.w;
+        const float *xs = x + (size_t)(g / P) * d->in;
+        float *row = col + (size_t)(g - g0) * d->cols;
+        for (int ky = 0; ky < d->k; ky++) {
+            int iy = oy + ky - d->pad;
+            for (int kx = 0; kx < d->k; kx++, row += c) {
+                int ix = ox + kx - d->pad;
+                if (iy < 0 || iy >= d->src.h || ix < 0 || ix >= d->src.w) memset(row, 0, sizeof(float) * c);
+                else memcpy(row, xs + ((size_t)iy * d->src.w + ix) * c, sizeof(float) * c);
+            }
+        }
+    }
+}
+
+// Scatter-adds patch gradients back onto the image they were gathered from
+static void col2im(const NnDense *d, const float *dcol, float *dx, int g0, int g1) {
+    int P = d->dst.h * d->dst.w, c = d->src.c;
+    for (int g = g0; g < g1; g++) {
+        int pos = g % P, oy = pos / d->dst.w, ox = pos % d->dst.w;
+        float *xs = dx + (size_t)(g / P) * d->in;
+        const float *row = dcol + (size_t)(g - g0) * d->cols;
+        for (int ky = 0; ky < d->k; ky++) {
+            int iy = oy + ky - d->pad;
+            for (int kx = 0; kx < d->k; kx++, row += c) {
+                int ix = ox + kx - d->pad;
+                if (iy < 0 || iy >= d->src.h || ix < 0 || ix >= d->src.w) continue;
+                float *dst = xs + ((size_t)iy * d->src.w + ix) * c;
+                for (int i = 0; i < c; i++) dst[i] += row[i];
+            }
+        }
+    }
+}
+
+// Every output position of the batch is one GEMM row, so a block of
+// NN_IM2COL_ROWS patches goes through the dense kernel in one call and
+// lands directly in the channels-last output.
+static void conv_forward(const NnDense *d, const float *x, float *y, int rows, float *col) {
+    int G = rows * d->dst.h * d->dst.w;
+    for (int g0 = 0; g0 < G; g0 += NN_IM2COL_ROWS) {
+        int g1 = g0 + NN_IM2COL_ROWS < G ? g0 + NN_IM2COL_ROWS : G;
+        im2col(d, x, col, g0, g1);
+        kernels->dense_forward(col, d->w, d->b, y + (size_t)g0 * d->rows, g1 - g0, d->cols, d->rows);
+    }
+}
+
+static void conv_backward(const NnDense *d, const float *x, const float *dy, float *dx,
+                          float *gw, float *gb, int rows, float *col) {
+    int G = rows * d->dst.h * d->dst.w;
+    float *dcol = col + (size_t)NN_IM2COL_ROWS * d->cols;
+    if (dx) memset(dx, 0, sizeof(float) * rows * d->in);
+    for (int g0 = 0; g0 < G; g0 += NN_IM2COL_ROWS) {
+        int g1 = g0 + NN_IM2COL_ROWS < G ? g0 + NN_IM2COL_ROWS : G;
+        const float *D = dy + (size_t)g0 * d->rows;
+        im2col(d, x, col, g0, g1);
+        kernels->dense_weight_grad(D, col, gw, gb, g1 - g0, d->cols, d->rows);
+        if (!dx) continue;
+        kernels->dense_backward_data(D, d->w, dcol, g1 - g0, d->cols, d->rows);
+        col2im(d, dcol, dx, g0, g1);
+    }
+}
+
+// argmax receives the flat input index of every output's maximum
+static void pool_forward(const NnDense *d, const float *x, float *y, int rows, int *argmax) {
+    int c = d->src.c;
+    for (int r = 0; r < rows; r++) {
+        const float *xs = x + (size_t)r * d->in;
+        for (int oy = 0; oy < d->dst.h; oy++) {
+            for (int ox = 0; ox < d->dst.w; ox++) {
+                size_t o = (size_t)r * d->out + ((size_t)oy * d->dst.w + ox) * c;
+                float *yo = y + o;
+                int *ao = argmax + o;
+                for (int ky = 0; ky < d->k; ky++) {
+                    for (int kx = 0; kx < d->k; kx++) {
+                        int idx = ((oy * d->stride + ky) * d->src.w + ox * d->stride + kx) * c;
+                        bool first = ky == 0 && kx == 0;
+                        for (int i = 0; i < c; i++) {
+                            if (first || xs[idx + i] > yo[i]) {
+                                yo[i] = xs[idx + i];
+                                ao[i] = idx + i;
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+static void pool_backward(const NnDense *d, const float *dy, float *dx, int rows, const int *argmax) {
+    memset(dx, 0, sizeof(float) * rows * d->in);
+    for (int r = 0; r < rows; r++) {
+        float *xs = dx + (size_t)r * d->in;
+        for (int o = 0; o < d->out; o++) {
+            size_t j = (size_t)r * d->out + o;
+            xs[argmax[j]] += dy[j];
+        }
+    }
+}
+
+void nn_layer_forward(const NnDense *d, const float *x, float *y, int rows, float *col, int *argmax) {
+    switch (d->kind) {
+        case NN_CONV:    conv_forward(d, x, y, rows, col); break;
+        case NN_MAXPOOL: pool_forward(d, x, y, rows, argmax); break;
+        default:         kernels->dense_forward(x, d->w, d->b, y, rows, d->in, d->out); break;
+    }
+}
+
+void nn_layer_backward(const NnDense *d, const float *x, const float *dy, float *dx,
+                       float *gw, float *gb, int rows, float *col, const int *argmax) {
+    switch (d->kind) {
+        case NN_CONV:
+            conv_backward(d, x, dy, dx, gw, gb, rows, col);
+            break;
+        case NN_MAXPOOL:
+            if (dx) pool_backward(d, dy, dx, rows, argmax);
+            break;
+        default:
+            kernels->dense_weight_grad(dy, x, gw, gb, rows, d->in, d->out);
+            if (dx) kernels->dense_backward_data(dy, d->w, dx, rows, d->in, d->out);
+            break;
+    }
+}
+
+void nn_softmax(float *v, int n) {
+    float max = v[0];
+    for (int i = 1; i < n; i++) if (v[i] > max) max = v[i];
+    float sum = 0.0f;
+    for (int i = 0; i < n; i++) {
+        v[i] = expf(v[i] - max);
+        sum += v[i];
+    }
+    float inv = 1.0f / sum;
+    for (int i = 0; i < n; i++) v[i] *= inv;
+}
+
+void nn_forward(Mlp *nn, const float *input) {
+    memcpy(nn->act[0], input, sizeof(float) * nn->sizes[0]);
+    int last = nn->layer_count - 1;
+    for (int l = 1; l <= last; l++) {
+        float *a = nn->act[l];
+        const NnDense *d = &nn->dense[l - 1];
+        nn_layer_forward(d, nn->act[l - 1], a, 1, nn->col, nn->argmax[l - 1]);
+        if (l == last) {
+            nn_softmax(a, nn->sizes[l]);
+        } else {
+            for (int i = 0; i < nn->sizes[l]; i++) a[i] = a[i] > 0.0f ? a[i] : 0.0f;
+        }
+    }
+}
+
+float nn_backward(Mlp *nn, int label) {
+    int last = nn->layer_count - 1;
+    const float *probs = nn->act[last];
+    float *dout = nn->delta[last];
+
+    // Softmax + cross-entropy: dL/dz = p - onehot
+    for (int i = 0; i < nn->sizes[last]; i++) dout[i] = probs[i];
+    dout[label] -= 1.0f;
+    float loss = -logf(fmaxf(probs[label], 1e-7f));
+
+    for (int l = last; l >= 1; l--) {
+        NnDense *d = &nn->dense[l - 1];
+        const float *delta = nn->delta[l];
+        const float *x = nn->act[l - 1];
+
+        // gW += delta x^T, gb += delta, then delta_prev = (W^T delta) *
+        // relu'(z_prev); the input layer has no nonlinearity, its delta is
+        // kept for visualization.
+        float *prev = nn->delta[l - 1];
+        nn_layer_backward(d, x, delta, prev, d->gw, d->gb, 1, nn->col, nn->argmax[l - 1]);
+        if (l - 1 > 0) {
+            for (int i = 0; i < d->in; i++) if (x[i] <= 0.0f) prev[i] = 0.0f;
+        }
+    }
+
+    nn->grad_count++;
+    return loss;
+}
+
+void nn_apply_gradients(Mlp *nn, float learning_rate) {
+    if (nn->grad_count == 0) return;
+    float scale = learning_rate / nn->grad_count;
+    for (int l = 0; l < nn->layer_count - 1; l++) {
+        NnDense *d = &nn->dense[l];
+        size_t n = nn_weight_count(d);
+        for (size_t k = 0; k < n; k++) {
+            d->w[k] -= scale * d->gw[k];
+            d->gw[k] = 0.0f;
+        }
+        if (d->mask) for (size_t k = 0; k < n; k++) d->w[k] *= d->mask[k];
+        for (int o = 0; o < d->rows; o++) {
+            d->b[o] -= scale * d->gb[o];
+            d->gb[o] = 0.0f;
+        }
+    }
+    nn->grad_count = 0;
+}
+
+float nn_train_sample(Mlp *nn, const float *input, int label, float learning_rate) {
+    nn_forward(nn, input);
+    float loss = nn_backward(nn, label);
+    nn_apply_gradients(nn, learning_rate);
+    return loss;
+}
+
+long long nn_sparsify(Mlp *nn, float density, uint64_t seed) {
+    NnRng rng = { seed ? seed : 0x9E3779B97F4A7C15ULL };
+    long long live = 0;
+    for (int l = 0; l < nn->layer_count - 1; l++) {
+        NnDense *d = &nn->dense[l];
+        size_t n = nn_weight_count(d);
+        if (n == 0) continue;
+        if (density >= 1.0f) {
+            live += (long long)n;
+            continue;
+        }
+        if (!d->mask) {
+            d->mask = malloc(n);
+            if (!d->mask) return -1;
+            memset(d->mask, 1, n);
+        }
+        float rescale = 1.0f / sqrtf(density);
+        for (int o = 0; o < d->rows; o++) {
+            uint8_t *m = d->mask + (size_t)o * d->cols;
+            float *w = d->w + (size_t)o * d->cols;
+            int keep = (int)(nn_rng_next(&rng) % (uint32_t)d->cols);
+            for (int i = 0; i < d->cols; i++) {
+                bool on = m[i] && (i == keep || nn_rng_float(&rng) < density);
+                m[i] = on;
+                w[i] = on ? w[i] * rescale : 0.0f;
+                live += on;
+            }
+        }
+    }
+    return live;
+}
+
+long long nn_mask_zeros(Mlp *nn) {
+    long long live = 0;
+    for (int l = 0; l < nn->layer_count - 1; l++) {
+        NnDense *d = &nn->dense[l];
+        size_t n = nn_weight_count(d);
+        if (n == 0) continue;
+        if (!d->mask) {
+            d->mask = malloc(n);
+            if (!d->mask) return -1;
+        }
+        for (size_t k = 0; k < n; k++) {
+            d->mask[k] = d->w[k] != 0.0f;
+            live += d->mask[k];
+        }
+    }
+    return live;
+}
+
+long long nn_prune(Mlp *nn, float threshold) {
+    long long removed = 0;
+    for (int l = 0; l < nn->layer_count - 1; l++) {
+        NnDense *d = &nn->dense[l];
+        size_t n = nn_weight_count(d);
+        if (n == 0) continue;
+        if (!d->mask) {
+            d->mask = malloc(n);
+            if (!d->mask) continue;
+            memset(d->mask, 1, n);
+        }
+        for (size_t k = 0; k < n; k++) {
+            if (d->mask[k] && fabsf(d->w[k]) < threshold) {
+                d->mask[k] = 0;
+                d->w[k] = 0.0f;
+                removed++;
+            }
+        }
+    }
+    return removed;
+}
+
+bool nn_workspace_init(NnWorkspace *ws, const Mlp *nn, int capacity, uint64_t seed) {
+    memset(ws, 0, sizeof(*ws));
+    int L = nn->layer_count;
+    ws->capacity = capacity;
+    ws->rng.state = seed ? seed : 0x9E3779B97F4A7C15ULL;
+    ws->act = calloc(L, sizeof(float *));
+    ws->delta = calloc(L, sizeof(float *));
+    ws->gw = calloc(L - 1, sizeof(float *));
+    ws->gb = calloc(L - 1, sizeof(float *));
+    ws->argmax = calloc(L - 1, sizeof(int *));
+    ws->labels = calloc(capacity, sizeof(int));
+    if (!ws->act || !ws->delta || !ws->gw || !ws->gb || !ws->argmax || !ws->labels) goto fail;
+
+    for (int l = 0; l < L; l++) {
+        ws->act[l] = calloc((size_t)capacity * nn->sizes[l], sizeof(float));
+        ws->delta[l] = calloc((size_t)capacity * nn->sizes[l], sizeof(float));
+        if (!ws->act[l] || !ws->delta[l]) goto fail;
+    }
+    for (int l = 0; l < L - 1; l++) {
+        if (nn->dense[l].kind != NN_MAXPOOL) continue;
+        ws->argmax[l] = malloc(sizeof(int) * capacity * nn->dense[l].out);
+        if (!ws->argmax[l]) goto fail;
+    }
+    size_t col = nn_col_floats(nn);
+    if (col) {
+        ws->col = malloc(sizeof(float) * col);
+        if (!ws->col) goto fail;
+    }
+
+    for (int l = 0; l < L - 1; l++) ws->grad_size += nn_weight_count(&nn->dense[l]) + nn->dense[l].rows;
+    ws->grad = calloc(ws->grad_size, sizeof(float));
+    if (!ws->grad) goto fail;
+    float *g = ws->grad;
+    for (int l = 0; l < L - 1; l++) {
+        ws->gw[l] = g;
+        g += nn_weight_count(&nn->dense[l]);
+    }
+    for (int l = 0; l < L - 1; l++) {
+        ws->gb[l] = g;
+        g += nn->dense[l].rows;
+    }
+    return true;
+
+fail:
+    nn_workspace_free(ws, nn);
+    return false;
+}
+
+void nn_workspace_free(NnWorkspace *ws, const Mlp *nn) {
+    for (int l = 0; ws->act && l < nn->layer_count; l++) free(ws->act[l]);
+    for (int l = 0; ws->delta && l < nn->layer_count; l++) free(ws->delta[l]);
+    for (int l = 0; ws->argmax && l < nn->layer_count - 1; l++) free(ws->argmax[l]);
+    free(ws->act);
+    free(ws->delta);
+    free(ws->argmax);
+    free(ws->col);
+    free(ws->gw);
+    free(ws->gb);
+    free(ws->labels);
+    free(ws->grad);
+    memset(ws, 0, sizeof(*ws));
+}
+
+void nn_forward_batch(const Mlp *nn, NnWorkspace *ws) {
+    int last = nn->layer_count - 1;
+    for (int l = 1; l <= last; l++) {
+        const NnDense *d = &nn->dense[l - 1];
+        float *a = ws->act[l];
+        nn_layer_forward(d, ws->act[l - 1], a, ws->rows, ws->col, ws->argmax[l - 1]);
+        if (l == last) {
+            for (int r = 0; r < ws->rows; r++) nn_softmax(a + (size_t)r * d->out, d->out);
+        } else {
+            size_t n = (size_t)ws->rows * d->out;
+            for (size_t i = 0; i < n; i++) a[i] = a[i] > 0.0f ? a[i] : 0.0f;
+        }
+    }
+}
+
+void nn_score_batch(const Mlp *nn, NnWorkspace *ws) {
+    int classes = nn_output_size(nn);
+    for (int r = 0; r < ws->rows; r++) {
+        const float *probs = ws->act[nn->layer_count - 1] + (size_t)r * classes;
+        int label = ws->labels[r];
+        ws->loss += -logf(fmaxf(probs[label], 1e-7f));
+        ws->correct += nn_argmax(probs, classes) == label;
+    }
+}
+
+void nn_backward_batch(const Mlp *nn, NnWorkspace *ws) {
+    int last = nn->layer_count - 1;
+    int classes = nn->sizes[last];
+    memset(ws->grad, 0, sizeof(float) * ws->grad_size);
+
+    nn_score_batch(nn, ws);
+    for (int r = 0; r < ws->rows; r++) {
+        float *dout = ws->delta[last] + (size_t)r * classes;
+        memcpy(dout, ws->act[last] + (size_t)r * classes, sizeof(float) * classes);
+        dout[ws->labels[r]] -= 1.0f;
+    }
+
+    for (int l = last; l >= 1; l--) {
+        const NnDense *d = &nn->dense[l - 1];
+        nn_layer_backward(d, ws->act[l - 1], ws->delta[l], ws->delta[l - 1], ws->gw[l - 1], ws->gb[l - 1],
+                       ws->rows, ws->col, ws->argmax[l - 1]);
+        if (l - 1 > 0) {
+            const float *x = ws->act[l - 1];
+            float *prev = ws->delta[l - 1];
+            size_t n = (size_t)ws->rows * d->in;
+            for (size_t i = 0; i < n; i++) if (x[i] <= 0.0f) prev[i] = 0.0f;
+        }
+    }
+}
+
+int nn_argmax(const float *values, int count) {
+    int best = 0;
+    for (int i = 1; i < count; i++) if (values[i] > values[best]) best = i;
+    return best;
+}
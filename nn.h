@@ -0,0 +1,194 @@
+#ifndef NN_H_
+#define NN_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Rows of im2col patches gathered per GEMM call. Bounds the per-thread
+// patch buffers and keeps a block of them in L2 while its weights stream.
+#define NN_IM2COL_ROWS 256
+
+typedef enum {
+    NN_DENSE,
+    NN_CONV,
+    NN_MAXPOOL,
+} NnKind;
+
+// Shape of a neuron layer. Feature maps are stored channels last,
+// [h][w][c]; a plain vector is h = w = 1.
+typedef struct {
+    int c, h, w;
+} NnShape;
+
+// Weight layer between two neuron layers.
+//
+// NN_DENSE: fully connected, weights stored row-major as [out][in].
+// NN_CONV: k x k kernels with zero padding `pad`, weights stored as
+// [c_out][k][k][c_in]. That is the row layout of an im2col patch, so the
+// layer runs as a dense layer over all output positions at once.
+// NN_MAXPOOL: k x k windows every `stride` pixels per channel, no weights.
+typedef struct {
+    NnKind kind;
+    int in, out;       // widths of the neuron layers on either side
+    NnShape src, dst;
+    int k, stride, pad;
+    int rows, cols;    // weight matrix: [rows][cols], one bias per row
+    float *w;
+    float *b;
+    float *gw; // gradient accumulators, same shape as w/b
+    float *gb;
+    uint8_t *mask; // NULL when fully connected, else 1 per live weight
+    bool external; // w and b belong to the caller, e.g. a mapped model file
+} NnDense;
+
+// Feed-forward network: ReLU hidden layers, softmax output, trained with
+// cross-entropy loss. sizes[0] is the input width. Convolution and pooling
+// layers, if any, come before the dense ones.
+typedef struct {
+    int layer_count;   // neuron layers, including the input
+    int *sizes;        // flattened widths
+    NnShape *shape;
+    NnDense *dense;    // layer_count - 1 weight layers
+    float **act;       // post-activation values per neuron layer
+    float **delta;     // dLoss/dz per neuron layer (delta[0] is dLoss/dinput)
+    int grad_count;    // samples accumulated into gw/gb since the last step
+    float *col;        // im2col scratch of nn_forward/nn_backward
+    int **argmax;      // per pooling layer, window maxima of the last sample
+} Mlp;
+
+typedef struct {
+    uint64_t state;
+} NnRng;
+
+// One weight layer of nn_init_layers
+typedef struct {
+    NnKind kind;
+    int size;          // NN_DENSE: width, NN_CONV: output channels
+    int k;             // NN_CONV, NN_MAXPOOL: window side
+    int stride;        // NN_MAXPOOL; convolutions always use 1
+    int pad;           // NN_CONV
+} NnLayerSpec;
+
+// Fully connected network of layer_count neuron layers
+bool nn_init(Mlp *nn, const int *sizes, int layer_count, uint64_t seed);
+
+// `count` weight layers on top of an input of the given shape. Fails if a
+// window does not fit the feature map it slides over, or a convolution or
+// pooling layer follows a dense one.
+bool nn_init_layers(Mlp *nn, NnShape input, const NnLayerSpec *layers, int count, uint64_t seed);
+
+// The count + 1 neuron layer shapes nn_init_layers would build, input first,
+// without allocating anything. False where nn_init_layers would fail.
+bool nn_layer_shapes(NnShape input, const NnLayerSpec *layers, int count, NnShape *shapes);
+
+// Like nn_init, but weight layer i uses weights[i] ([out][in]) and
+// biases[i] as they are, without copying. They must be writable if the
+// network is trained and outlive it; nn_free leaves them alone.
+bool nn_init_external(Mlp *nn, const int *sizes, int layer_count, float *const *weights, float *const *biases);
+void nn_free(Mlp *nn);
+
+// Runs one sample through the network. act[layer_count-1] holds the class
+// probabilities afterwards.
+void nn_forward(Mlp *nn, const float *input);
+
+// Backpropagates softmax cross-entropy against `label` after nn_forward,
+// accumulating gradients. Returns the sample loss.
+float nn_backward(Mlp *nn, int label);
+
+// SGD update with the mean of the accumulated gradients, then clears them.
+void nn_apply_gradients(Mlp *nn, float learning_rate);
+
+// forward + backward + update on a single sample. Returns the loss.
+float nn_train_sample(Mlp *nn, const float *input, int label, float learning_rate);
+
+// Keeps a random `density` fraction of every weight layer's connections,
+// rescaling the survivors to preserve activation variance. Every output
+// keeps at least one input. Removed weights stay exactly zero from now on.
+// Returns the number of live weights.
+long long nn_sparsify(Mlp *nn, float density, uint64_t seed);
+
+// Treats every weight that is exactly zero as a removed connection, e.g.
+// after loading a pruned model. Returns the number of live weights.
+long long nn_mask_zeros(Mlp *nn);
+
+// Magnitude pruning: removes live weights with |w| < threshold for good.
+// Returns the number removed.
+long long nn_prune(Mlp *nn, float threshold);
+
+// Per-thread buffers for mini-batch training. Rows of a sub-batch are
+// stored contiguously per layer ([rows][size]) so the dense kernels run as
+// GEMMs. Gradients live in one flat buffer so they can be reduced as a
+// single vector.
+typedef struct {
+    int capacity;        // max rows
+    int rows;            // rows in the current sub-batch
+    float **act;         // [layer] capacity x sizes[layer]
+    float **delta;
+    int *labels;
+    float *col;          // im2col patches and their gradients, 2 blocks
+    int **argmax;        // per pooling layer, capacity x out window maxima
+    float *grad;         // all weight then bias gradients, grad_size floats
+    float **gw;          // per weight layer, into grad
+    float **gb;
+    size_t grad_size;
+    float loss;          // summed over the sub-batch
+    int correct;
+    NnRng rng;
+} NnWorkspace;
+
+bool nn_workspace_init(NnWorkspace *ws, const Mlp *nn, int capacity, uint64_t seed);
+void nn_workspace_free(NnWorkspace *ws, const Mlp *nn);
+
+// Forward and backward for ws->rows samples already in ws->act[0] and
+// ws->labels. Gradients are summed into ws->grad (cleared first), loss and
+// correct count are updated.
+void nn_forward_batch(const Mlp *nn, NnWorkspace *ws);
+void nn_backward_batch(const Mlp *nn, NnWorkspace *ws);
+
+// One weight layer without the activation: `rows` samples of x to y. `col`
+// and `argmax` are the workspace buffers of that layer (ws->col,
+// ws->argmax[l]).
+void nn_layer_forward(const NnDense *d, const float *x, float *y, int rows, float *col, int *argmax);
+
+// Its backward pass: accumulates the weight gradients into gw/gb and
+// writes dLoss/dx, before the ReLU mask of x. dx may be NULL when nothing
+// upstream needs it; pooling layers take no gw/gb.
+void nn_layer_backward(const NnDense *d, const float *x, const float *dy, float *dx,
+                       float *gw, float *gb, int rows, float *col, const int *argmax);
+
+// Floats of the `col` buffer a layer needs, 0 for all but convolutions
+static inline size_t nn_layer_col_floats(const NnDense *d) {
+    return d->kind == NN_CONV ? (size_t)2 * NN_IM2COL_ROWS * d->cols : 0;
+}
+
+// Loss and correct count of the outputs in ws->act against ws->labels,
+// without gradients. nn_backward_batch does this itself.
+void nn_score_batch(const Mlp *nn, NnWorkspace *ws);
+
+// Weights in one layer. nn_is_dense tells whether every layer is fully
+// connected, the only kind model files and int8 inference handle.
+static inline size_t nn_weight_count(const NnDense *d) { return (size_t)d->rows * d->cols; }
+bool nn_is_dense(const Mlp *nn);
+
+int nn_argmax(const float *values, int count);
+
+// In place, numerically stable
+void nn_softmax(float *values, int count);
+
+static inline int nn_output_size(const Mlp *nn) { return nn->sizes[nn->layer_count - 1]; }
+static inline const float *nn_output(const Mlp *nn) { return nn->act[nn->layer_count - 1]; }
+
+// xorshift64*, small and deterministic so every thread can own one
+static inline uint32_t nn_rng_next(NnRng *r) {
+    r->state ^= r->state >> 12;
+    r->state ^= r->state << 25;
+    r->state ^= r->state >> 27;
+    return (uint32_t)((r->state * 0x2545F4914F6CDD1DULL) >> 32);
+}
+
+static inline float nn_rng_float(NnRng *r) {
+    return (nn_rng_next(r) >> 8) * (1.0f / 16777216.0f);
+}
+
+#endif // NN_H_
@@ -11,9 +11,9 @@
 
 void cc(Nob_Cmd *cmd) {
     nob_cmd_append(cmd, "cc");
-    nob_cmd_append(cmd, "-Wall", "-Wextra", "-g");
+    nob_cmd_append(cmd, "-Wall", "-Wextra", "-g", "-O2");
     #ifndef _WIN32
-         nob_cmd_append(cmd, "-std=c11"); 
+         nob_cmd_append(cmd, "-std=c11", "-pthread"); 
          // Assuming 'cc' on Windows is MinGW/gcc or clang. If MSVC `cl`, flags are different.
          // For now, let's assume MinGW for Windows or clang.
     #endif
@@ -55,18 +55,61 @@ void libs(Nob_Cmd *cmd) {
     #endif
 }
 
+// Translation units linked into the main plugin
+static const char *plug_sources[] = {
+    "plug.c",
+    "spectrum.c",
+    "nn.c",
+    "kernels.c",
+    "trainer.c",
+    "config.c",
+    "dataset.c",
+    "mapfile.c",
+    "parallel.c",
+    "synapse.c",
+    "model.c",
+    "checkpoint.c",
+    "quant.c",
+    "optim.c",
+    "tape.c",
+    "record.c",
+    "shmring.c",
+    "ingest.c",
+    "plot.c",
+    "heatmap.c",
+    "histogram.c",
+    "bvh.c",
+    "cull.c",
+};
+
+// io_uring for checkpoint writes, when liburing is installed (Linux only)
+void uring(Nob_Cmd *cmd) {
+    #if !defined(_WIN32) && !defined(__APPLE__)
+        if (nob_file_exists("/usr/include/liburing.h") == 1) {
+            nob_cmd_append(cmd, "-DCONA_HAVE_LIBURING");
+            nob_cmd_append(cmd, "-luring");
+        }
+    #else
+        (void)cmd;
+    #endif
+}
+
 bool build_plug(Nob_Cmd *cmd) {
     cmd->count = 0;
     cc(cmd);
     #ifdef _WIN32
-        nob_cmd_append(cmd, "-shared", "-o", "plug.dll", "plug.c");
+        nob_cmd_append(cmd, "-shared", "-o", "plug.dll");
+        nob_da_append_many(cmd, plug_sources, NOB_ARRAY_LEN(plug_sources));
         nob_cmd_append(cmd, "-lraylib", "-lgdi32", "-lwinmm"); 
         nob_cmd_append(cmd, "-L./raylib/raylib-5.5_win64_mingw/lib");
     #elif defined(__APPLE__)
-        nob_cmd_append(cmd, "-dynamiclib", "-o", "libplug.dylib", "plug.c");
+        nob_cmd_append(cmd, "-dynamiclib", "-o", "libplug.dylib");
+        nob_da_append_many(cmd, plug_sources, NOB_ARRAY_LEN(plug_sources));
         libs(cmd);
     #else
-        nob_cmd_append(cmd, "-shared", "-fPIC", "-o", "libplug.so", "plug.c");
+        nob_cmd_append(cmd, "-shared", "-fPIC", "-o", "libplug.so");
+        nob_da_append_many(cmd, plug_sources, NOB_ARRAY_LEN(plug_sources));
+        uring(cmd);
         libs(cmd);
     #endif
     return nob_cmd_run_sync(*cmd);
@@ -115,6 +158,73 @@ bool build_main(Nob_Cmd *cmd) {
     return nob_cmd_run_sync(*cmd);
 }
 
+// Standalone micro-benchmarks for the compute kernels (no raylib)
+static const char *bench_sources[] = {
+    "bench.c",
+    "kernels.c",
+    "nn.c",
+    "trainer.c",
+    "parallel.c",
+    "model.c",
+    "mapfile.c",
+    "checkpoint.c",
+    "quant.c",
+    "optim.c",
+    "tape.c",
+    "record.c",
+    "ingest.c",
+    "plot.c",
+    "heatmap.c",
+    "histogram.c",
+    "bvh.c",
+    "cull.c",
+    "synapse.c",
+};
+
+bool build_bench(Nob_Cmd *cmd) {
+    cmd->count = 0;
+    cc(cmd);
+    nob_cmd_append(cmd, "-o", "bench");
+    nob_da_append_many(cmd, bench_sources, NOB_ARRAY_LEN(bench_sources));
+    uring(cmd);
+    #ifndef _WIN32
+        nob_cmd_append(cmd, "-lm");
+    #endif
+    return nob_cmd_run_sync(*cmd);
+}
+
+// Stand-in external trainer for shm_source (no raylib)
+static const char *producer_sources[] = {
+    "tools/shm_producer.c",
+    "shmring.c",
+    "kernels.c",
+    "nn.c",
+    "trainer.c",
+    "parallel.c",
+    "model.c",
+    "mapfile.c",
+    "checkpoint.c",
+    "quant.c",
+    "optim.c",
+    "tape.c",
+    "synapse.c",
+};
+
+bool build_producer(Nob_Cmd *cmd) {
+    #ifdef _WIN32
+        (void)cmd;
+        return true; // no POSIX shared memory
+    #else
+        cmd->count = 0;
+        cc(cmd);
+        nob_cmd_append(cmd, "-I.", "-o", "shm_producer");
+        nob_da_append_many(cmd, producer_sources, NOB_ARRAY_LEN(producer_sources));
+        uring(cmd);
+        nob_cmd_append(cmd, "-lm");
+        return nob_cmd_run_sync(*cmd);
+    #endif
+}
+
 int main(int argc, char **argv) {
     NOB_GO_REBUILD_URSELF(argc, argv);
 
@@ -124,6 +234,8 @@ int main(int argc, char **argv) {
     if (!build_boot(&cmd)) return 1;
     if (!build_plug(&cmd)) return 1;
     if (!build_main(&cmd)) return 1;
+    if (!build_bench(&cmd)) return 1;
+    if (!build_producer(&cmd)) return 1;
 
     return 0;
 }
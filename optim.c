@@ -0,0 +1,149 @@
+#define _POSIX_C_SOURCE 200809L
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "optim.h"
+
+static long long now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static const char *names[OPTIM_COUNT] = { "sgd", "momentum", "adam", "adamw" };
+
+void optim_defaults(OptimParams *p, OptimKind kind) {
+    *p = (OptimParams){
+        .kind = kind,
+        .momentum = 0.9f,
+        .beta1 = 0.9f,
+        .beta2 = 0.999f,
+        .eps = 1e-8f,
+        .weight_decay = kind == OPTIM_ADAMW ? 0.01f : 0.0f,
+    };
+}
+
+const char *optim_name(OptimKind kind) {
+    return kind >= 0 && kind < OPTIM_COUNT ? names[kind] : "?";
+}
+
+bool optim_parse(const char *name, OptimKind *kind) {
+    for (int k = 0; k < OPTIM_COUNT; k++) {
+        if (strcmp(name, names[k]) == 0) {
+            *kind = (OptimKind)k;
+            return true;
+        }
+    }
+    return false;
+}
+
+static int state_buffers(OptimKind kind) {
+    switch (kind) {
+        case OPTIM_MOMENTUM: return 1;
+        case OPTIM_ADAM:
+        case OPTIM_ADAMW:    return 2;
+        default:             return 0;
+    }
+}
+
+static void add_slices(Optimizer *o, int layer, bool bias, size_t count, size_t *state) {
+    for (size_t begin = 0; begin < count; begin += OPTIM_SLICE) {
+        size_t n = count - begin < OPTIM_SLICE ? count - begin : OPTIM_SLICE;
+        if (o->slices) {
+            o->slices[o->slice_count] = (OptimSlice){ layer, bias, begin, (int)n, *state };
+        }
+        o->slice_count++;
+        *state += n;
+    }
+}
+
+// Counts the slices when o->slices is NULL, fills them otherwise
+static void build_slices(Optimizer *o) {
+    o->slice_count = 0;
+    size_t state = 0;
+    for (int l = 0; l < o->nn->layer_count - 1; l++) {
+        const NnDense *d = &o->nn->dense[l];
+        add_slices(o, l, false, nn_weight_count(d), &state);
+        add_slices(o, l, true, (size_t)d->rows, &state);
+    }
+    o->param_count = state;
+}
+
+bool optim_init(Optimizer *o, Mlp *nn, float *const *gw, float *const *gb, const OptimParams *params) {
+    memset(o, 0, sizeof(*o));
+    o->params = *params;
+    o->nn = nn;
+    o->gw = gw;
+    o->gb = gb;
+    build_slices(o);
+    o->slices = malloc(sizeof(OptimSlice) * (o->slice_count ? o->slice_count : 1));
+    if (!o->slices) return false;
+    build_slices(o);
+
+    int buffers = state_buffers(params->kind);
+    for (int i = 0; i < buffers; i++) {
+        o->state[i] = kernels_alloc(sizeof(float) * (o->param_count ? o->param_count : 1));
+        if (!o->state[i]) {
+            optim_free(o);
+            return false;
+        }
+        memset(o->state[i], 0, sizeof(float) * o->param_count);
+    }
+    // Read weight, gradient and state, write weight and state
+    o->bytes_per_update = sizeof(float) * o->param_count * (3 + 2 * buffers);
+    return true;
+}
+
+void optim_free(Optimizer *o) {
+    kernels_free(o->state[0]);
+    kernels_free(o->state[1]);
+    free(o->slices);
+    memset(o, 0, sizeof(*o));
+}
+
+static void optim_task(void *ctx, int task, int worker) {
+    (void)worker;
+    const Optimizer *o = ctx;
+    const OptimSlice *s = &o->slices[task];
+    NnDense *d = &o->nn->dense[s->layer];
+    float *w = (s->bias ? d->b : d->w) + s->begin;
+    const float *g = (s->bias ? o->gb[s->layer] : o->gw[s->layer]) + s->begin;
+    float *m = o->state[0] ? o->state[0] + s->state : NULL;
+    float *v = o->state[1] ? o->state[1] + s->state : NULL;
+
+    switch (o->params.kind) {
+        case OPTIM_ADAM:
+        case OPTIM_ADAMW:
+            kernels->optim_adam(w, g, m, v, s->count, &o->step);
+            break;
+        default:
+            kernels->optim_sgd(w, g, m, s->count, &o->step);
+            break;
+    }
+    // The slice is still in cache, so the mask costs no second trip to memory
+    if (!s->bias && d->mask) {
+        const uint8_t *mask = d->mask + s->begin;
+        for (int i = 0; i < s->count; i++) w[i] *= mask[i];
+    }
+}
+
+void optim_step(Optimizer *o, ThreadPool *pool, float lr, float grad_scale) {
+    const OptimParams *p = &o->params;
+    o->t++;
+    o->step = (OptimStep){
+        .lr = lr,
+        .grad_scale = grad_scale,
+        .momentum = p->momentum,
+        .beta1 = p->beta1,
+        .beta2 = p->beta2,
+        .eps = p->eps,
+        .weight_decay = p->kind == OPTIM_ADAMW ? p->weight_decay : 0.0f,
+        .bias1 = 1.0f / (1.0f - powf(p->beta1, (float)o->t)),
+        .bias2 = 1.0f / (1.0f - powf(p->beta2, (float)o->t)),
+    };
+    long long t0 = now_ns();
+    pool_run(pool, o->slice_count, optim_task, o);
+    atomic_store_explicit(&o->update_ns, now_ns() - t0, memory_order_relaxed);
+}
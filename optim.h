@@ -0,0 +1,78 @@
+#ifndef OPTIM_H_
+#define OPTIM_H_
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "kernels.h"
+#include "nn.h"
+#include "parallel.h"
+
+// Parameters per pool task. Large tensors are split so every worker gets a
+// share of the memory traffic; small ones are a task each.
+#define OPTIM_SLICE 16384
+
+typedef enum {
+    OPTIM_SGD,
+    OPTIM_MOMENTUM,
+    OPTIM_ADAM,
+    OPTIM_ADAMW,
+    OPTIM_COUNT
+} OptimKind;
+
+typedef struct {
+    OptimKind kind;
+    float momentum;       // OPTIM_MOMENTUM
+    float beta1, beta2;   // OPTIM_ADAM, OPTIM_ADAMW
+    float eps;
+    float weight_decay;   // OPTIM_ADAMW
+} OptimParams;
+
+// A contiguous run of one tensor, weights or biases of a layer
+typedef struct {
+    int layer;
+    bool bias;
+    size_t begin;         // into the tensor
+    int count;
+    size_t state;         // into each state buffer
+} OptimSlice;
+
+// The weight update of a network, one fused pass per parameter with the
+// active kernels. The state (velocity, or Adam's two moments) is one
+// buffer per moment over all parameters, updated in place.
+typedef struct {
+    OptimParams params;
+    Mlp *nn;
+    float *const *gw;     // gradients, laid out as in NnWorkspace
+    float *const *gb;
+    size_t param_count;
+    float *state[2];      // NULL where the kind has no such state
+    OptimSlice *slices;
+    int slice_count;
+    long long t;          // updates so far, for Adam's bias correction
+    OptimStep step;       // scalars of the update in progress
+
+    // Statistics, read by the renderer
+    size_t bytes_per_update;     // parameter, gradient and state traffic
+    _Atomic long long update_ns; // wall time of the last update
+} Optimizer;
+
+void optim_defaults(OptimParams *p, OptimKind kind);
+const char *optim_name(OptimKind kind);
+bool optim_parse(const char *name, OptimKind *kind);
+
+// Updates `nn` from the gradients gw/gb. Both must outlive the optimizer.
+bool optim_init(Optimizer *o, Mlp *nn, float *const *gw, float *const *gb, const OptimParams *params);
+void optim_free(Optimizer *o);
+
+// One update across the pool (NULL runs it on the calling thread). Masked
+// weights are held at zero afterwards.
+void optim_step(Optimizer *o, ThreadPool *pool, float lr, float grad_scale);
+
+static inline double optim_bytes_per_second(Optimizer *o) {
+    long long ns = atomic_load_explicit(&o->update_ns, memory_order_relaxed);
+    return ns > 0 ? o->bytes_per_update * 1e9 / ns : 0.0;
+}
+
+#endif // OPTIM_H_
@@ -0,0 +1,211 @@
+#define _POSIX_C_SOURCE 200809L
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "parallel.h"
+
+#ifdef _WIN32
+    #include <windows.h>
+#else
+    #include <unistd.h>
+#endif
+
+#define PARALLEL_MAX_THREADS 256
+
+int parallel_cpu_count(void) {
+    #ifdef _WIN32
+        SYSTEM_INFO info;
+        GetSystemInfo(&info);
+        int n = (int)info.dwNumberOfProcessors;
+    #else
+        int n = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    #endif
+    return n > 0 ? n : 1;
+}
+
+typedef struct {
+    ParallelRangeFn fn;
+    void *ctx;
+    int begin, end;
+} ParallelChunk;
+
+static void *parallel_chunk_main(void *arg) {
+    ParallelChunk *c = arg;
+    c->fn(c->ctx, c->begin, c->end);
+    return NULL;
+}
+
+void parallel_for(int count, int threads, ParallelRangeFn fn, void *ctx) {
+    if (count <= 0) return;
+    if (threads <= 0) threads = parallel_cpu_count();
+    if (threads > count) threads = count;
+    if (threads > PARALLEL_MAX_THREADS) threads = PARALLEL_MAX_THREADS;
+
+    if (threads == 1) {
+        fn(ctx, 0, count);
+        return;
+    }
+
+    ParallelChunk chunks[PARALLEL_MAX_THREADS];
+    pthread_t ids[PARALLEL_MAX_THREADS];
+    bool started[PARALLEL_MAX_THREADS] = {0};
+    for (int t = 0; t < threads; t++) {
+        chunks[t] = (ParallelChunk){
+            .fn = fn, .ctx = ctx,
+            .begin = (int)((long long)count * t / threads),
+            .end = (int)((long long)count * (t + 1) / threads),
+        };
+    }
+    for (int t = 1; t < threads; t++) {
+        started[t] = pthread_create(&ids[t], NULL, parallel_chunk_main, &chunks[t]) == 0;
+    }
+
+    // Calling thread does the first chunk, plus any chunk whose thread failed
+    parallel_chunk_main(&chunks[0]);
+    for (int t = 1; t < threads; t++) {
+        if (started[t]) pthread_join(ids[t], NULL);
+        else parallel_chunk_main(&chunks[t]);
+    }
+}
+
+struct ThreadPool {
+    int size;
+    pthread_t *ids;
+    int started;              // worker threads actually running
+
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    pthread_cond_t done;
+    unsigned generation;      // bumped for every job
+    int active;               // workers inside the current job
+    bool quit;
+
+    PoolTaskFn fn;
+    void *ctx;
+    int tasks;
+    atomic_int next_task;
+    atomic_int remaining;
+};
+
+typedef struct {
+    ThreadPool *pool;
+    int worker;
+} PoolWorkerArg;
+
+// fn, ctx and tasks are the job's, copied under the lock together with its
+// generation: a worker that reads the pool's fields afterwards may already
+// see the next job's and run a task of one with the function of the other.
+static void pool_drain(ThreadPool *pool, PoolTaskFn fn, void *ctx, int tasks, int worker) {
+    for (;;) {
+        int task = atomic_fetch_add_explicit(&pool->next_task, 1, memory_order_acquire);
+        if (task >= tasks) return;
+        fn(ctx, task, worker);
+        atomic_fetch_sub_explicit(&pool->remaining, 1, memory_order_release);
+    }
+}
+
+static void *pool_worker_main(void *arg) {
+    PoolWorkerArg a = *(PoolWorkerArg *)arg;
+    free(arg);
+    ThreadPool *pool = a.pool;
+
+    unsigned seen = 0;
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+        while (!pool->quit && pool->generation == seen) pthread_cond_wait(&pool->wake, &pool->lock);
+        if (pool->quit) break;
+        seen = pool->generation;
+        PoolTaskFn fn = pool->fn;
+        void *ctx = pool->ctx;
+        int tasks = pool->tasks;
+        pool->active++;
+        pthread_mutex_unlock(&pool->lock);
+
+        pool_drain(pool, fn, ctx, tasks, a.worker);
+
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->active == 0) pthread_cond_signal(&pool->done);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+ThreadPool *pool_create(int threads) {
+    if (threads <= 0) threads = parallel_cpu_count();
+    if (threads > PARALLEL_MAX_THREADS) threads = PARALLEL_MAX_THREADS;
+
+    ThreadPool *pool = calloc(1, sizeof(*pool));
+    if (!pool) return NULL;
+    pool->ids = calloc(threads, sizeof(pthread_t));
+    if (!pool->ids) {
+        free(pool);
+        return NULL;
+    }
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->wake, NULL);
+    pthread_cond_init(&pool->done, NULL);
+
+    // Worker ids must stay dense, so stop at the first thread that fails
+    pool->size = 1;
+    for (int w = 1; w < threads; w++) {
+        PoolWorkerArg *arg = malloc(sizeof(*arg));
+        if (!arg) break;
+        *arg = (PoolWorkerArg){ .pool = pool, .worker = w };
+        if (pthread_create(&pool->ids[w], NULL, pool_worker_main, arg) != 0) {
+            free(arg);
+            break;
+        }
+        pool->size++;
+    }
+    pool->started = pool->size - 1;
+    return pool;
+}
+
+void pool_destroy(ThreadPool *pool) {
+    if (!pool) return;
+    pthread_mutex_lock(&pool->lock);
+    pool->quit = true;
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->lock);
+    for (int w = 1; w <= pool->started; w++) pthread_join(pool->ids[w], NULL);
+
+    pthread_cond_destroy(&pool->done);
+    pthread_cond_destroy(&pool->wake);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool->ids);
+    free(pool);
+}
+
+int pool_size(const ThreadPool *pool) {
+    return pool ? pool->size : 1;
+}
+
+void pool_run(ThreadPool *pool, int tasks, PoolTaskFn fn, void *ctx) {
+    if (tasks <= 0) return;
+    if (!pool || pool->size == 1 || tasks == 1) {
+        for (int i = 0; i < tasks; i++) fn(ctx, i, 0);
+        return;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->fn = fn;
+    pool->ctx = ctx;
+    pool->tasks = tasks;
+    atomic_store_explicit(&pool->remaining, tasks, memory_order_relaxed);
+    atomic_store_explicit(&pool->next_task, 0, memory_order_release);
+    pool->generation++;
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->lock);
+
+    pool_drain(pool, fn, ctx, tasks, 0);
+
+    // Wait for stragglers. Workers that never woke for this job are not
+    // counted in `active`, but they also cannot claim a task any more.
+    pthread_mutex_lock(&pool->lock);
+    while (pool->active > 0 || atomic_load_explicit(&pool->remaining, memory_order_acquire) > 0) {
+        pthread_cond_wait(&pool->done, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
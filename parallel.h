@@ -0,0 +1,33 @@
+#ifndef PARALLEL_H_
+#define PARALLEL_H_
+
+// Processes [begin, end) of a range. Must be safe to run concurrently on
+// disjoint ranges.
+typedef void (*ParallelRangeFn)(void *ctx, int begin, int end);
+
+// Number of online CPUs, at least 1.
+int parallel_cpu_count(void);
+
+// Splits [0, count) into contiguous chunks and runs them on up to `threads`
+// threads (0 = one per CPU). The calling thread takes the first chunk.
+// Returns when every chunk is done.
+void parallel_for(int count, int threads, ParallelRangeFn fn, void *ctx);
+
+// Runs task `task` of a pool job on pool worker `worker` (0..pool_size-1).
+// A worker runs one task at a time, so per-worker scratch needs no locking.
+typedef void (*PoolTaskFn)(void *ctx, int task, int worker);
+
+// Persistent workers for per-step parallel work where spawning threads
+// like parallel_for would cost more than the work itself.
+typedef struct ThreadPool ThreadPool;
+
+// `threads` counts the calling thread, 0 = one per CPU.
+ThreadPool *pool_create(int threads);
+void pool_destroy(ThreadPool *pool);
+int pool_size(const ThreadPool *pool);
+
+// Runs tasks [0, tasks) across the pool. The caller works as worker 0 and
+// returns when every task has finished. Not reentrant.
+void pool_run(ThreadPool *pool, int tasks, PoolTaskFn fn, void *ctx);
+
+#endif // PARALLEL_H_
@@ -0,0 +1,147 @@
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "plot.h"
+
+// Coarse levels have few items, so their segments shrink with the level
+// down to this many items
+#define PLOT_MIN_SEGMENT_SHIFT 6
+
+static size_t block_size(int level) {
+    return (size_t)1 << (PLOT_FANOUT_SHIFT * level);
+}
+
+static int segment_shift(int level) {
+    int shift = PLOT_SEGMENT_SHIFT - PLOT_FANOUT_SHIFT * level;
+    return shift > PLOT_MIN_SEGMENT_SHIFT ? shift : PLOT_MIN_SEGMENT_SHIFT;
+}
+
+static void *item_at(const PlotArray *a, int shift, size_t i) {
+    return (uint8_t *)a->segments[i >> shift] + (i & (((size_t)1 << shift) - 1)) * a->item_size;
+}
+
+// Makes room for one more item
+static bool reserve(PlotArray *a, int shift) {
+    if (a->count < a->segment_count << shift) return true;
+    void **segments = realloc(a->segments, sizeof(void *) * (a->segment_count + 1));
+    if (!segments) return false;
+    a->segments = segments;
+    void *segment = malloc(a->item_size << shift);
+    if (!segment) return false;
+    a->segments[a->segment_count++] = segment;
+    return true;
+}
+
+void plot_init(PlotSeries *s) {
+    memset(s, 0, sizeof(*s));
+    s->levels[0].item_size = sizeof(float);
+    for (int l = 1; l < PLOT_LEVELS; l++) s->levels[l].item_size = sizeof(PlotRange);
+    s->bounds = (PlotRange){ INFINITY, -INFINITY };
+}
+
+void plot_free(PlotSeries *s) {
+    for (int l = 0; l < PLOT_LEVELS; l++) {
+        for (size_t i = 0; i < s->levels[l].segment_count; i++) free(s->levels[l].segments[i]);
+        free(s->levels[l].segments);
+    }
+    free(s->segment_steps);
+    plot_init(s);
+}
+
+bool plot_append(PlotSeries *s, long long step, float value) {
+    size_t i = s->levels[0].count;
+
+    // Everything that can fail comes first
+    if ((i & (PLOT_SEGMENT_ITEMS - 1)) == 0) {
+        long long *steps = realloc(s->segment_steps, sizeof(long long) * ((i >> PLOT_SEGMENT_SHIFT) + 1));
+        if (!steps) return false;
+        s->segment_steps = steps;
+    }
+    for (int l = 0; l < PLOT_LEVELS; l++) {
+        if ((i & (block_size(l) - 1)) == 0 && !reserve(&s->levels[l], segment_shift(l))) return false;
+    }
+
+    if ((i & (PLOT_SEGMENT_ITEMS - 1)) == 0) s->segment_steps[i >> PLOT_SEGMENT_SHIFT] = step;
+    *(float *)item_at(&s->levels[0], segment_shift(0), i) = value;
+    s->levels[0].count++;
+    for (int l = 1; l < PLOT_LEVELS; l++) {
+        PlotArray *a = &s->levels[l];
+        if ((i & (block_size(l) - 1)) == 0) {
+            *(PlotRange *)item_at(a, segment_shift(l), a->count++) = (PlotRange){ value, value };
+        } else {
+            PlotRange *r = item_at(a, segment_shift(l), a->count - 1);
+            r->min = fminf(r->min, value);
+            r->max = fmaxf(r->max, value);
+        }
+    }
+    s->bounds.min = fminf(s->bounds.min, value);
+    s->bounds.max = fmaxf(s->bounds.max, value);
+    s->last_step = step;
+    return true;
+}
+
+size_t plot_bytes(const PlotSeries *s) {
+    size_t bytes = 0;
+    for (int l = 0; l < PLOT_LEVELS; l++) {
+        bytes += (s->levels[l].segment_count * s->levels[l].item_size) << segment_shift(l);
+    }
+    return bytes;
+}
+
+long long plot_step_at(const PlotSeries *s, size_t index) {
+    size_t count = plot_count(s);
+    if (count == 0) return 0;
+    if (index >= count) index = count - 1;
+    size_t segment = index >> PLOT_SEGMENT_SHIFT;
+    size_t offset = index & (PLOT_SEGMENT_ITEMS - 1);
+    long long first = s->segment_steps[segment];
+    bool last_segment = segment == (count - 1) >> PLOT_SEGMENT_SHIFT;
+    long long next = last_segment ? s->last_step : s->segment_steps[segment + 1];
+    size_t span = last_segment ? count - 1 - (segment << PLOT_SEGMENT_SHIFT) : PLOT_SEGMENT_ITEMS;
+    if (span == 0) return first;
+    return first + (long long)((double)(next - first) * offset / span);
+}
+
+int plot_columns(const PlotSeries *s, size_t first, size_t last, int columns, PlotRange *out) {
+    size_t count = plot_count(s);
+    if (last > count) last = count;
+    if (first >= last || columns <= 0) return 0;
+    size_t n = last - first;
+    if (n <= (size_t)columns) {
+        for (size_t i = 0; i < n; i++) {
+            float v = *(const float *)item_at(&s->levels[0], segment_shift(0), first + i);
+            out[i] = (PlotRange){ v, v };
+        }
+        return (int)n;
+    }
+
+    // The coarsest level with at least one block per column; each column
+    // then takes one to four whole blocks from it
+    int level = 0;
+    while (level + 1 < PLOT_LEVELS && block_size(level + 1) <= n / columns) level++;
+    const PlotArray *a = &s->levels[level];
+    int shift = segment_shift(level);
+    int block_shift = PLOT_FANOUT_SHIFT * level;
+    size_t begin = first >> block_shift;
+    for (int c = 0; c < columns; c++) {
+        size_t end = c + 1 < columns ? (first + (size_t)((double)n * (c + 1) / columns)) >> block_shift
+                                     : (last + block_size(level) - 1) >> block_shift;
+        PlotRange r = { INFINITY, -INFINITY };
+        for (size_t b = begin; b < end; b++) {
+            if (level == 0) {
+                float v = *(const float *)item_at(a, shift, b);
+                r.min = fminf(r.min, v);
+                r.max = fmaxf(r.max, v);
+            } else {
+                const PlotRange *q = item_at(a, shift, b);
+                r.min = fminf(r.min, q->min);
+                r.max = fmaxf(r.max, q->max);
+            }
+        }
+        out[c] = r;
+        begin = end;
+    }
+    return columns;
+}
@@ -0,0 +1,66 @@
+#ifndef PLOT_H_
+#define PLOT_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Items per storage segment. Segments are allocated as the series grows and
+// never move, so appending does not copy what is already stored.
+#define PLOT_SEGMENT_SHIFT 16
+#define PLOT_SEGMENT_ITEMS ((size_t)1 << PLOT_SEGMENT_SHIFT)
+
+// Samples per block grow by 2^PLOT_FANOUT_SHIFT per pyramid level, so level
+// l summarizes blocks of 4^l samples. 16 levels cover 4^15 (1e9) samples.
+#define PLOT_FANOUT_SHIFT 2
+#define PLOT_LEVELS 16
+
+typedef struct {
+    float min, max;
+} PlotRange;
+
+typedef struct {
+    void **segments;
+    size_t segment_count;
+    size_t count;          // items stored
+    size_t item_size;
+} PlotArray;
+
+// A scalar series over a whole run, e.g. the loss of every training step.
+// Level 0 holds the samples; every level above it holds the min and max of
+// consecutive blocks of the level below, updated as each sample arrives, so
+// an append touches one item per level. A query for any range and number
+// of pixel columns reads whole blocks from the coarsest level that still
+// has one per column, at most four per column, so it costs about the same
+// for a thousand samples in range as for a billion.
+typedef struct {
+    PlotArray levels[PLOT_LEVELS];   // level 0: float, above: PlotRange
+    long long *segment_steps;        // step of the first sample of each level 0 segment
+    long long last_step;
+    PlotRange bounds;                // of every sample so far
+} PlotSeries;
+
+void plot_init(PlotSeries *s);
+void plot_free(PlotSeries *s);
+
+// False when out of memory; the series is unchanged then
+bool plot_append(PlotSeries *s, long long step, float value);
+
+static inline size_t plot_count(const PlotSeries *s) {
+    return s->levels[0].count;
+}
+
+// Storage of the samples and the pyramid
+size_t plot_bytes(const PlotSeries *s);
+
+// Step of sample `index`, exact while the steps of a segment are
+// consecutive and interpolated within the segment otherwise
+long long plot_step_at(const PlotSeries *s, size_t index);
+
+// Min and max of the samples [first, last) split evenly into `columns`
+// columns, one range per column. Column edges are rounded down to the
+// blocks read, which moves them by less than a column. With fewer samples
+// than columns every sample gets its own column. Returns the number of
+// columns written, at most `columns`.
+int plot_columns(const PlotSeries *s, size_t first, size_t last, int columns, PlotRange *out);
+
+#endif // PLOT_H_
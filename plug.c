@@ -7,21 +7,80 @@
 
 #include <raylib.h>
 #include <raymath.h>
+#include <rlgl.h>
 
 #define PLUG_IMPL
 #include "plug.h"
+#include "spectrum.h"
+#include "nn.h"
+#include "kernels.h"
+#include "trainer.h"
+#include "config.h"
+#include "dataset.h"
+#include "digits.h"
+#include "heatmap.h"
+#include "histogram.h"
+#include "bvh.h"
+#include "cull.h"
+#include "synapse.h"
+#include "model.h"
+#include "checkpoint.h"
+#include "tape.h"
+#include "ingest.h"
+#include "plot.h"
+#include "record.h"
+#include "shmring.h"
 
 // --- Constants & Config ---
 #define SAMPLE_RATE 44100
 #define STREAM_BUFFER_SIZE 1024
 
-#define INPUT_ROWS 8
-#define INPUT_COLS 8
-#define INPUT_SIZE (INPUT_ROWS * INPUT_COLS)
-#define HIDDEN1_SIZE 16
-#define HIDDEN2_SIZE 16
-#define OUTPUT_SIZE 10
-#define TOTAL_LAYERS 4
+// Network layout. Topology comes from cona.cfg, positions from these.
+// Every convolution stage can add a pooling layer.
+#define MAX_LAYERS (3 * CONFIG_LIST_MAX + 2)
+#define LAYOUT_LAYER_GAP 8.0f      // distance between layers along z
+#define LAYOUT_MAX_DEPTH 64.0f     // deeper networks are squeezed to fit
+#define LAYOUT_LINE_MAX 24         // wider layers become square grids
+#define LAYOUT_GRID_EXTENT 12.0f   // max side length of a grid layer
+#define DRAW_MAX_EDGES 4096        // strongest edges kept for drawing per layer pair
+#define PICK_SYNAPSE_RADIUS 0.08f  // how near the cursor's ray has to pass a synapse
+
+// Level of detail in DrawNN3D. Spheres are tessellated by their radius on
+// screen. Past LOD_SYNAPSE_DISTANCE the strength a faint synapse needs to
+// be drawn grows with its distance, from the usual 0.25 up to 1 at four
+// times that, where none are left.
+#define LOD_FULL_PIXELS 12.0f      // screen radius from which spheres get full tessellation
+#define LOD_MID_PIXELS 4.0f        // and the middle one; smaller ones get the coarsest
+#define LOD_SYNAPSE_DISTANCE 40.0f
+
+// One Input -> Propagate -> Output -> Learn cycle of UpdateNN, in seconds.
+// At time scale 1 the trainer takes one step per cycle.
+#define ANIM_CYCLE_SECONDS (1.0f + 1.0f / 1.5f + 1.0f + 1.0f)
+
+// Autodiff graph panel
+#define GRAPH_ARENA (256 << 10)    // renderer tape, grows on first use if too small
+#define GRAPH_BOX_W 96
+#define GRAPH_BOX_H 30
+#define GRAPH_GAP 14
+
+// Loss and accuracy plots, one vertex pair per pixel column at most
+#define PLOT_W 400
+#define PLOT_H 90
+#define PLOT_GAP 30
+#define PLOT_MIN_SPAN 16           // samples across the plot at the deepest zoom
+
+// Weight heatmap panels
+#define HEATMAP_PANEL 120          // pixels along the longer side of a matrix
+
+// Histogram bars above each layer, in world units
+#define HIST_BAR_WIDTH 0.08f       // per bin
+#define HIST_BAR_HEIGHT 2.5f       // of the largest bin
+#define HIST_GAP 1.0f              // between the histograms of a layer, and above its neurons
+
+// Batch view
+#define BATCH_MAX_NEURONS 65536    // larger networks are too many vertices per replica
+#define BATCH_TEX_W 2048           // activation texture width; a replica takes as many rows as it needs
+#define BATCH_CELL_MARGIN 4.0f     // world units between replicas
 
 // Colors
 #define COL_BG          (Color){ 10, 10, 15, 255 }      // Deep Dark Blue/Black
@@ -30,20 +89,6 @@
 #define COL_TEXT_MAIN   (Color){ 240, 240, 240, 255 }   // Off-White
 #define COL_TEXT_DIM    (Color){ 100, 100, 120, 255 }   // Dim Grey
 
-// Bitmaps for Digits 0-9
-const unsigned char FONT_DIGITS[10][8] = {
-    { 0x3C, 0x42, 0x42, 0x42, 0x42, 0x42, 0x42, 0x3C }, // 0
-    { 0x10, 0x30, 0x10, 0x10, 0x10, 0x10, 0x10, 0x38 }, // 1
-    { 0x3C, 0x42, 0x02, 0x02, 0x3C, 0x40, 0x40, 0x7E }, // 2
-    { 0x3C, 0x42, 0x02, 0x1C, 0x02, 0x02, 0x42, 0x3C }, // 3
-    { 0x0C, 0x14, 0x24, 0x44, 0x7E, 0x04, 0x04, 0x04 }, // 4
-    { 0x7E, 0x40, 0x40, 0x7C, 0x02, 0x02, 0x42, 0x3C }, // 5
-    { 0x3C, 0x40, 0x40, 0x7C, 0x42, 0x42, 0x42, 0x3C }, // 6
-    { 0x7E, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x40 }, // 7
-    { 0x3C, 0x42, 0x42, 0x3C, 0x42, 0x42, 0x42, 0x3C }, // 8
-    { 0x3C, 0x42, 0x42, 0x3E, 0x02, 0x02, 0x02, 0x3C }  // 9
-};
-
 // --- Structures ---
 
 typedef enum {
@@ -58,23 +103,96 @@ typedef enum {
     PLUG_DEMO
 } PlugState;
 
+// Convolution and pooling outputs are drawn as one texture per layer with
+// the channels tiled side by side, instead of a sphere per activation.
+// Pixels are recolored every frame but only uploaded when one changed.
 typedef struct {
-    Vector3 position;
-    float activation;
-    float target;
-    float error;
-} Neuron;
+    int tiles_x;          // channel tiles per row
+    int width, height;    // texture size, one pixel per neuron plus gaps
+    int *pixel;           // texture pixel of every neuron of the layer
+    Color *pixels;        // NULL for layers drawn as spheres
+    Texture2D texture;
+    Vector3 center;
+    float spacing;        // world size of a pixel
+} FeatureMap;
 
+// A layer is a window into the network's per-neuron arrays
 typedef struct {
+    NnKind kind;          // of the weight layer feeding it
+    NnShape shape;
+    FeatureMap map;
     int count;
-    Neuron *neurons;
+    int first;            // index of the first neuron, also its offset into snapshot act/err
+    Vector3 *position;
+    float *activation;
+    float *target;
+    float *error;
+    float scale;          // neuron radius multiplier, shrinks for dense grids
+    int weight_offset;    // into snapshot weights, for the pair to the next layer
+    int bias_offset;      // into snapshot biases, of the weight layer feeding it
+    CullGrid cull;        // cells of the neuron positions, for frustum culling
+    float cull_radius;    // largest a neuron is drawn with, its glow included
+    SynapseCsr synapses;  // real edges to the next layer, as drawn
 } Layer;
 
+// Neuron state is stored field by field over all layers in order, so the
+// per-frame animation passes are single contiguous sweeps.
 typedef struct {
     int layer_count;
-    Layer layers[TOTAL_LAYERS];
+    Layer *layers;
+    int neuron_count;
+    Vector3 *position;
+    float *activation;
+    float *target;
+    float *error;
+    unsigned char *outcode; // frustum planes each neuron is outside of, this frame
+    Vector3 home;         // camera position that frames the whole network
 } Network;
 
+typedef struct {
+    float value;
+    long long step;
+    long long count;      // samples received, 0 = never seen
+} IngestMetric;
+
+// One weight layer as a texture of its matrix. The GPU copy is kept up to
+// date tile by tile; colors are applied by heatmap.fs.
+typedef struct {
+    int layer;               // weight layer, between neuron layers layer and layer + 1
+    bool dense;
+    HeatmapTiles tiles;
+    Texture2D weights;       // R32F, [rows][cols]
+    Texture2D err, act;      // R32F vectors of the shown sample, dense layers only
+    float grad_range;
+    float scale;             // panel pixels per weight
+    long long step;          // weights_step last scanned
+    long long grad_step;     // snapshot the vectors came from
+    int clean_tiles;         // scanned without a dirty one since the weights changed
+} Heatmap;
+
+// What a layer's histograms are of: its activations and errors for the
+// shown sample, and the weights feeding it
+typedef enum {
+    HIST_ACT,
+    HIST_ERR,
+    HIST_WEIGHTS,
+    HIST_KIND_COUNT,
+} HistKind;
+
+// What DrawNN3D drew and left out in the last frame
+typedef struct {
+    int neurons, neurons_off, neurons_coarse;    // coarse: fewer rings for their distance
+    int synapses, synapses_off, synapses_faint;  // faint: dropped for their distance
+    int maps, maps_off;
+    int grid_lines, grid_off;
+} CullStats;
+
+typedef enum {
+    PICK_NONE,
+    PICK_NEURON,
+    PICK_SYNAPSE,
+} PickKind;
+
 typedef struct {
     float time;
     Camera3D camera;
@@ -88,13 +206,185 @@ typedef struct {
     float phase;
     float freq;
     float target_freq;
+    Spectrum spectrum;
     
     // NN
     Network nn;
+    NnShape input_shape;
+    NnLayerSpec specs[MAX_LAYERS - 1];
     TrainState train_state;
     float tr_timer;
     int current_digit;
     float signal_progress;
+
+    // Settings and training data
+    Config config;
+    KernelTuning kernel_tuning;    // measured once, reapplied after hot reloads
+    Dataset dataset;
+    bool use_dataset;      // false: train on the built-in FONT_DIGITS
+    ModelFile model;          // pretrained weights, mapped for the lifetime of the network
+    bool use_model;
+    ShmRing shm;              // live records of another process, which replaces the trainer
+    bool use_shm;
+    TrainSnapshot shm_frame;  // points into the newest record
+    long long shm_records;
+    long long shm_records_mark;
+    float shm_records_per_sec;
+
+    // Metrics streamed over the socket from cona.cfg, latest value per id
+    Ingest ingest;
+    bool use_ingest;
+    IngestMetric metrics[INGEST_MAX_METRICS];
+    long long ingest_mark;
+    float ingest_per_sec;
+    Checkpointer checkpoint;  // background saves of the trained weights
+    bool use_checkpoint;
+    TrainerMode run_mode;     // worker mode in the simulation, M cycles it
+    TrainerMode menu_run_mode;
+    float time_scale;         // training steps per animation cycle, 0 = as fast as possible
+
+    // Run log from cona.cfg. A replay takes the trainer's place as the source
+    // of snapshots and the trainer is never started.
+    Recorder recorder;
+    bool recording;
+    long long recorded_step;  // of the last frame appended, -1 = none
+    double record_start;
+    Replay replay;
+    bool replaying;
+    bool replay_paused;       // SPACE
+    bool replay_dragging;     // the slider is held
+    double replay_step;       // playback position, advances at replay_rate
+    double replay_rate;       // recorded steps per second
+    long long replay_frame_index;
+    TrainSnapshot replay_frame;
+    float replay_seek_ms;     // last find and read that left the cached chunk
+
+    // Model behind the visualization, trained on a worker thread
+    Trainer trainer;
+    const TrainSnapshot *live;  // latest snapshot, refreshed every frame
+    TrainSnapshot vis;          // renderer-owned copy animated for one cycle
+    bool vis_valid;
+    bool latch_pending;         // the next cycle waits for a step published with its weights
+    bool weights_asked;         // the trainer was asked for them
+    float sample_loss;
+    int predicted_digit;
+    int synapse_version;        // topology the edge lists were built from, -1 = none
+    bool synapse_reselect;      // rebuild thinned edge lists at the next frame
+    const SynapseCsr *synapse_edges; // trainer's edge lists they were copied from, NULL = none
+    long long synapse_step;     // weights_step of that copy
+
+    // Throughput
+    long long steps_mark;
+    long long samples_mark;
+    float steps_timer;
+    float steps_per_sec;
+    float samples_per_sec;
+    float frame_ms;
+    long long map_uploads;
+    long long map_uploads_mark;
+    float map_uploads_per_sec;
+
+    // Autodiff graph panel, G toggles. The trainer's network is recorded on
+    // the renderer's own tape for the shown sample, over the live snapshot's
+    // weights, every frame the panel is open, and drawn from the tape.
+    bool show_graph;
+    Tape graph;
+    NnDense graph_layers[MAX_LAYERS - 1]; // trainer's layer geometry, snapshot weights
+    Mlp graph_net;                        // the trainer's network over graph_layers
+    TapeNode *graph_loss;                 // NULL when nothing is recorded this frame
+    float graph_ms;
+
+    // Loss and accuracy over the whole run, P toggles. Every training step
+    // is a sample; the view is a window of samples, the whole run when
+    // plot_span is 0, and sticks to the newest samples while its right
+    // edge is at the end.
+    bool show_plots;
+    PlotSeries loss_plot;
+    PlotSeries accuracy_plot;
+    bool plot_full;             // out of memory, no more samples are added
+    size_t plot_first;
+    size_t plot_span;
+    bool plot_dragging;
+    float plot_drag_x;
+    size_t plot_drag_first;
+    PlotRange plot_ranges[PLOT_W];
+    Vector2 plot_points[2 * PLOT_W];
+    int plot_vertices;
+    float plot_ms;
+
+    // Weight and gradient heatmaps, H toggles
+    bool show_heatmaps;
+    bool heatmaps_ready;
+    Heatmap heatmaps[MAX_LAYERS - 1];
+    int heatmap_count;
+    int heatmap_next;           // first to scan next frame, where the budget ran out
+    float *heatmap_staging;     // one tile, packed for UpdateTextureRec
+    Shader heatmap_shader;
+    int heatmap_loc_outer;
+    int heatmap_loc_range;
+    int heatmap_loc_act;
+    int heatmap_tiles;          // uploaded this frame
+    long long heatmap_bytes;
+    long long heatmap_bytes_mark;
+    float heatmap_bytes_per_sec;
+
+    // Per-layer histograms, B toggles. Every kind is drawn for all layers
+    // as one instanced mesh, three draw calls in all.
+    bool show_histograms;
+    bool histograms_ready;
+    Histogram histograms[MAX_LAYERS][HIST_KIND_COUNT];
+    float histogram_top[MAX_LAYERS];    // highest neuron of the layer
+    long long histogram_step;           // snapshot whose act and err were binned
+    int histogram_layer;                // next layer whose weights are fed
+    ThreadPool *histogram_pool;         // NULL on one core
+    Mesh histogram_bar;
+    Material histogram_material;
+    Matrix *histogram_bars;             // [MAX_LAYERS * HIST_BINS], one kind at a time
+    size_t histogram_values;            // binned this frame
+    float histogram_ms;
+
+    // Batch view, V toggles: the first samples of each batch side by side
+    // as a grid of network replicas. One mesh holds every neuron of the
+    // network; a replica is an instance of it, moved by its transform and
+    // reading its own rows of the activation texture, so the whole grid is
+    // one draw call.
+    bool show_batch;
+    bool batch_ready;
+    int batch_rows;             // replicas, the trainer's view rows
+    Mesh batch_mesh;            // vaoId 0 when the view is not available
+    Material batch_material;
+    Texture2D batch_act;        // R32F [batch_rows * batch_tex_rows][BATCH_TEX_W]
+    int batch_tex_rows;         // texture rows per replica
+    float *batch_staging;       // the texture's contents
+    Matrix batch_offsets[TRAINER_VIEW_ROWS];
+    int batch_cols;             // replicas per grid row
+    Vector3 batch_label_at;     // below the output layer, where a replica's label goes
+    long long batch_step;       // snapshot uploaded last
+
+    // Click-to-inspect. Neurons and synapses are picked through a BVH
+    // each, built on threads of their own so a click only traverses.
+    // Positions are fixed by the layout and neuron boxes fit the largest a
+    // neuron is drawn, so the neuron tree is built once; the synapse tree
+    // is rebuilt when the edge lists are, and synapses are not picked
+    // until the tree over the current edges is in.
+    BvhBuilder pick_neurons;
+    BvhBuilder pick_synapses;
+    bool pick_neurons_staged;
+    int *pick_synapse_src;          // source neuron of each edge, within its layer
+    int pick_synapse_first[MAX_LAYERS]; // first edge of each layer pair
+    int pick_synapse_count;
+    int pick_synapse_capacity;
+    long long synapse_builds;       // edge list rebuilds, the synapse tree follows
+    long long pick_synapse_builds;  // of the staged edges, -1 = none
+    PickKind pick_kind;
+    int pick_layer;
+    int pick_index;                 // neuron of the layer, or a synapse's source
+    int pick_target;                // a synapse's neuron in the next layer
+    float pick_us;                  // tree swaps and pick of the last click
+
+    // Frustum culling and level of detail of the network, C toggles
+    bool culling;
+    CullStats cull;
 } Plug;
 
 static Plug *p = NULL;
@@ -103,6 +393,8 @@ static Plug *p = NULL;
 void PlugAudioCallback(void *bufferData, unsigned int frames) {
     if (!p) return;
     short *d = (short *)bufferData;
+    float tap[256];
+    unsigned int tap_count = 0;
     for (unsigned int i = 0; i < frames; i++) {
         p->phase += p->freq / SAMPLE_RATE;
         if (p->phase > 1.0f) p->phase -= 1.0f;
@@ -113,55 +405,598 @@ void PlugAudioCallback(void *bufferData, unsigned int frames) {
         
         d[i*2] = (short)(val * vol * 32000.0f);
         d[i*2+1] = (short)(val * vol * 32000.0f);
+
+        // Tap the output for spectrum analysis
+        tap[tap_count++] = val * vol;
+        if (tap_count == sizeof(tap)/sizeof(tap[0])) {
+            spectrum_push(&p->spectrum, tap, tap_count);
+            tap_count = 0;
+        }
     }
+    if (tap_count > 0) spectrum_push(&p->spectrum, tap, tap_count);
 }
 
 // --- NN & init ---
-static void init_layer(Layer *l, int count) {
-    l->count = count;
-    l->neurons = malloc(sizeof(Neuron) * count);
-    assert(l->neurons);
-    memset(l->neurons, 0, sizeof(Neuron) * count);
+// Convolution stages from the config, each a padded convolution and an
+// optional pooling layer. Returns the number of specs written.
+static int conv_specs(NnLayerSpec *specs) {
+    const Config *c = &p->config;
+    int n = 0;
+    for (int i = 0; i < c->conv_layers.count; i++) {
+        specs[n++] = (NnLayerSpec){ .kind = NN_CONV, .size = c->conv_layers.values[i],
+                                    .k = c->conv_kernel, .pad = c->conv_kernel / 2 };
+        if (c->conv_pool >= 2) {
+            specs[n++] = (NnLayerSpec){ .kind = NN_MAXPOOL, .k = c->conv_pool, .stride = c->conv_pool };
+        }
+    }
+    return n;
+}
+
+// Weight layers from the model file if one is open, else from the config,
+// input side first. Returns their count. A configured output layer is
+// widened if it cannot represent every label of the training data.
+static int network_topology(NnShape *input, NnLayerSpec *specs) {
+    Config *c = &p->config;
+    if (p->use_shm) {
+        const ShmRingHeader *h = p->shm.header;
+        *input = (NnShape){ 1, (int)h->input_rows, (int)h->input_cols };
+        for (uint32_t i = 1; i < h->layer_count; i++) {
+            specs[i - 1] = (NnLayerSpec){ .kind = NN_DENSE, .size = (int)p->shm.sizes[i] };
+        }
+        return (int)h->layer_count - 1;
+    }
+    if (p->use_model) {
+        *input = (NnShape){ 1, c->input_rows, c->input_cols };
+        for (int i = 1; i < p->model.layer_count; i++) {
+            specs[i - 1] = (NnLayerSpec){ .kind = NN_DENSE, .size = p->model.sizes[i] };
+        }
+        return p->model.layer_count - 1;
+    }
+    bool ok = c->input_rows > 0 && c->input_cols > 0 && c->output_size > 0 && c->conv_kernel > 0;
+    for (int i = 0; i < c->conv_layers.count; i++) ok = ok && c->conv_layers.values[i] > 0;
+    for (int i = 0; i < c->hidden_layers.count; i++) ok = ok && c->hidden_layers.values[i] > 0;
+    if (!ok) {
+        TraceLog(LOG_ERROR, "Invalid network topology in %s, using defaults", CONFIG_PATH);
+        Config def;
+        config_defaults(&def);
+        c->input_rows = def.input_rows;
+        c->input_cols = def.input_cols;
+        c->conv_layers = def.conv_layers;
+        c->conv_kernel = def.conv_kernel;
+        c->hidden_layers = def.hidden_layers;
+        c->output_size = def.output_size;
+    }
+    int classes = p->use_dataset ? p->dataset.classes : 10;
+    if (c->output_size < classes) {
+        TraceLog(LOG_WARNING, "output_size %d is below the %d classes of the training data, using %d",
+                 c->output_size, classes, classes);
+        c->output_size = classes;
+    }
+
+    *input = (NnShape){ 1, c->input_rows, c->input_cols };
+    int n = conv_specs(specs);
+    NnShape shapes[MAX_LAYERS];
+    if (n > 0 && !nn_layer_shapes(*input, specs, n, shapes)) {
+        TraceLog(LOG_ERROR, "%d convolution stages with conv_pool %d shrink a %dx%d input to nothing, "
+                 "leaving them out", c->conv_layers.count, c->conv_pool, c->input_rows, c->input_cols);
+        c->conv_layers.count = 0;
+        n = 0;
+    }
+    for (int i = 0; i < c->hidden_layers.count; i++) {
+        specs[n++] = (NnLayerSpec){ .kind = NN_DENSE, .size = c->hidden_layers.values[i] };
+    }
+    specs[n++] = (NnLayerSpec){ .kind = NN_DENSE, .size = c->output_size };
+    return n;
+}
+
+// Grid of `cols` columns centered on (0, cy, z), spacing capped so the
+// layer stays within LAYOUT_GRID_EXTENT.
+static void layout_grid(Layer *l, int cols, float spacing, float cy, float z) {
+    int rows = (l->count + cols - 1) / cols;
+    int side = cols > rows ? cols : rows;
+    if (side * spacing > LAYOUT_GRID_EXTENT) spacing = LAYOUT_GRID_EXTENT / side;
+    for (int i = 0; i < l->count; i++) {
+        int x = i % cols, y = i / cols;
+        l->position[i] = (Vector3){ (x - cols/2.0f) * spacing, (rows/2.0f - y) * spacing + cy, z };
+    }
+    l->scale = fminf(1.0f, spacing / 0.5f);
+}
+
+// Channel tiles of h x w pixels with a one pixel gap, as square as
+// possible and scaled to LAYOUT_GRID_EXTENT. Each neuron sits on its pixel
+// so connections and signals meet the plane where its value is drawn.
+static void layout_feature_map(Layer *l, float cy, float z) {
+    FeatureMap *m = &l->map;
+    NnShape s = l->shape;
+    m->tiles_x = (int)ceilf(sqrtf((float)s.c));
+    int tiles_y = (s.c + m->tiles_x - 1) / m->tiles_x;
+    m->width = m->tiles_x * (s.w + 1) - 1;
+    m->height = tiles_y * (s.h + 1) - 1;
+    int side = m->width > m->height ? m->width : m->height;
+    m->spacing = fminf(0.5f, LAYOUT_GRID_EXTENT / side);
+    m->center = (Vector3){ 0.0f, cy, z };
+    m->pixel = malloc(sizeof(int) * l->count);
+    m->pixels = calloc((size_t)m->width * m->height, sizeof(Color)); // gaps stay transparent
+    assert(m->pixel && m->pixels);
+    for (int y = 0; y < s.h; y++) {
+        for (int x = 0; x < s.w; x++) {
+            for (int ch = 0; ch < s.c; ch++) {
+                int j = (y * s.w + x) * s.c + ch;
+                int px = (ch % m->tiles_x) * (s.w + 1) + x;
+                int py = (ch / m->tiles_x) * (s.h + 1) + y;
+                m->pixel[j] = py * m->width + px;
+                l->position[j] = (Vector3){ (px + 0.5f - m->width/2.0f) * m->spacing,
+                                            (m->height/2.0f - py - 0.5f) * m->spacing + cy, z };
+            }
+        }
+    }
+    Image img = { m->pixels, m->width, m->height, 1, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8 };
+    m->texture = LoadTextureFromImage(img);
+    l->scale = fminf(1.0f, m->spacing / 0.5f);
+}
+
+// Threads that build the picking trees; like the other workers they run
+// code from this library and go down with it on reload
+static void start_pick_builders(void) {
+    if (!bvh_builder_start(&p->pick_neurons) || !bvh_builder_start(&p->pick_synapses)) {
+        TraceLog(LOG_ERROR, "Could not start the picking trees' builders, nothing can be picked");
+    }
 }
 
 static void init_network(void) {
-    p->nn.layer_count = TOTAL_LAYERS;
-    
-    // Input Grid (8x8)
-    init_layer(&p->nn.layers[0], INPUT_SIZE);
-    float grid_spacing = 0.5f;
-    for (int y = 0; y < INPUT_ROWS; y++) {
-        for (int x = 0; x < INPUT_COLS; x++) {
-            int idx = y * INPUT_COLS + x;
-            p->nn.layers[0].neurons[idx].position = (Vector3){
-                (x - INPUT_COLS/2.0f) * grid_spacing,
-                (INPUT_ROWS/2.0f - y) * grid_spacing + 5.0f,
-                -10.0f
-            };
+    int count = network_topology(&p->input_shape, p->specs) + 1;
+    NnShape shapes[MAX_LAYERS];
+    bool valid = nn_layer_shapes(p->input_shape, p->specs, count - 1, shapes);
+    assert(valid); // checked by network_topology
+    (void)valid;
+    int sizes[MAX_LAYERS];
+    for (int i = 0; i < count; i++) sizes[i] = shapes[i].c * shapes[i].h * shapes[i].w;
+    Network *nn = &p->nn;
+    nn->layer_count = count;
+    nn->layers = calloc(count, sizeof(Layer));
+    assert(nn->layers);
+    nn->neuron_count = 0;
+    for (int i = 0; i < count; i++) nn->neuron_count += sizes[i];
+    nn->position = kernels_alloc(sizeof(Vector3) * nn->neuron_count);
+    nn->activation = kernels_alloc(sizeof(float) * nn->neuron_count);
+    nn->target = kernels_alloc(sizeof(float) * nn->neuron_count);
+    nn->error = kernels_alloc(sizeof(float) * nn->neuron_count);
+    nn->outcode = kernels_alloc(nn->neuron_count);
+    assert(nn->position && nn->activation && nn->target && nn->error && nn->outcode);
+
+    float gap = fminf(LAYOUT_LAYER_GAP, LAYOUT_MAX_DEPTH / (count - 1));
+    float z0 = 2.0f - gap * (count - 1) / 2.0f;
+    int off = 0;
+    for (int i = 0; i < count; i++) {
+        Layer *l = &nn->layers[i];
+        l->kind = i > 0 ? p->specs[i - 1].kind : NN_DENSE;
+        l->shape = shapes[i];
+        l->count = sizes[i];
+        l->first = off;
+        l->position = nn->position + off;
+        l->activation = nn->activation + off;
+        l->target = nn->target + off;
+        l->error = nn->error + off;
+        l->scale = 1.0f;
+        off += sizes[i];
+
+        float z = z0 + i * gap;
+        if (i == 0) {
+            // Input keeps the image shape
+            layout_grid(l, p->config.input_cols, 0.5f, 5.0f, z);
+        } else if (l->kind != NN_DENSE) {
+            layout_feature_map(l, 3.0f, z);
+        } else if (l->count > LAYOUT_LINE_MAX) {
+            layout_grid(l, (int)ceilf(sqrtf((float)l->count)), 1.0f, 3.0f, z);
+        } else if (i == count - 1) {
+            for (int j = 0; j < l->count; j++) l->position[j] = (Vector3){ (j - l->count/2.0f) * 2.5f, -5.0f, z };
+        } else {
+            for (int j = 0; j < l->count; j++) l->position[j] = (Vector3){ 0, (j - l->count/2.0f) * 1.5f + 3.0f, z };
         }
+        // A sphere with a full glow is twice the largest neuron
+        l->cull_radius = l->map.pixels ? l->map.spacing * 0.5f : l->scale;
+        bool built = cull_grid_build(&l->cull, (const float *)l->position, l->count, l->cull_radius);
+        assert(built);
+        (void)built;
     }
-    
-    // Hidden 1
-    init_layer(&p->nn.layers[1], HIDDEN1_SIZE);
-    for (int i = 0; i < HIDDEN1_SIZE; i++) {
-        p->nn.layers[1].neurons[i].position = (Vector3){ 0, (i - HIDDEN1_SIZE/2.0f) * 1.5f + 3.0f, -2.0f };
+
+    // Pull the camera back for networks deeper than the default
+    float depth = gap * (count - 1);
+    float zoom = fmaxf(1.0f, depth / (LAYOUT_LAYER_GAP * 3.0f));
+    nn->home = (Vector3){ 20.0f * zoom, 15.0f * zoom, 20.0f * zoom };
+}
+
+static void digit_sample_fn(void *user, NnRng *rng, float *input, int *label) {
+    const Config *c = user;
+    *label = (int)(nn_rng_next(rng) % 10);
+    make_digit_sample(*label, rng, input, c->input_rows, c->input_cols);
+}
+
+static void dataset_sample_fn(void *user, NnRng *rng, float *input, int *label) {
+    const Dataset *ds = user;
+    dataset_get(ds, (int)(nn_rng_next(rng) % (uint32_t)ds->count), input, label);
+}
+
+static bool start_training(void) {
+    if (p->replaying || p->use_shm) return true;
+    if (p->use_dataset) return trainer_start(&p->trainer, dataset_sample_fn, &p->dataset);
+    return trainer_start(&p->trainer, digit_sample_fn, &p->config);
+}
+
+// MNIST/EMNIST from cona.cfg, if configured. Runs before the network is
+// built so the output layer can be sized for its labels.
+static void init_dataset(void) {
+    Config *c = &p->config;
+    if (!c->mnist_images[0]) return;
+    double t0 = GetTime();
+    if (!dataset_load_idx(&p->dataset, c->mnist_images, c->mnist_labels, c->input_rows, c->input_cols,
+                          c->dataset_transpose, c->dataset_cache, c->threads)) {
+        TraceLog(LOG_ERROR, "Could not load %s, using built-in digits", c->mnist_images);
+        return;
+    }
+    p->use_dataset = true;
+    TraceLog(LOG_INFO, "Loaded %d samples from %s in %.1f ms (%s)", p->dataset.count, c->mnist_images,
+             (GetTime() - t0) * 1000.0, p->dataset.cache.data ? "cache" : "converted");
+}
+
+// Pretrained model from cona.cfg. Its topology replaces the configured one,
+// so it has to fit the input size and the labels of the training data.
+static void init_model(void) {
+    Config *c = &p->config;
+    if (!c->model_path[0] || !stat_file(c->model_path, NULL, NULL)) return;
+    double t0 = GetTime();
+    if (!model_open(&p->model, c->model_path)) {
+        TraceLog(LOG_ERROR, "Could not load %s, starting from random weights", c->model_path);
+        return;
+    }
+    ModelFile *m = &p->model;
+    int input = c->input_rows * c->input_cols;
+    int classes = p->use_dataset ? p->dataset.classes : 10;
+    int outputs = m->sizes[m->layer_count - 1];
+    if (m->layer_count > MAX_LAYERS || m->sizes[0] != input || outputs < classes) {
+        TraceLog(LOG_ERROR, "%s (%d layers, %d inputs, %d outputs) does not fit input_rows x input_cols = %d "
+                 "with %d classes, starting from random weights",
+                 c->model_path, m->layer_count, m->sizes[0], outputs, input, classes);
+        model_close(m);
+        return;
+    }
+    p->use_model = true;
+    TraceLog(LOG_INFO, "Mapped %s (%.1f MB) in %.2f ms", c->model_path, m->file.size / 1048576.0,
+             (GetTime() - t0) * 1000.0);
+}
+
+// Live records of an external trainer from cona.cfg. Its topology replaces
+// the configured one and the model file's, and its input shape the
+// configured one.
+static void init_shm_source(void) {
+    Config *c = &p->config;
+    if (!c->shm_source[0]) return;
+    if (!shm_ring_attach(&p->shm, c->shm_source)) {
+        TraceLog(LOG_ERROR, "Could not attach to %s, training here instead", c->shm_source);
+        return;
+    }
+    const ShmRingHeader *h = p->shm.header;
+    if (h->layer_count > MAX_LAYERS) {
+        TraceLog(LOG_ERROR, "%s has %u layers, at most %d are drawn; training here instead",
+                 c->shm_source, h->layer_count, MAX_LAYERS);
+        shm_ring_close(&p->shm);
+        return;
+    }
+    if (p->use_model) {
+        model_close(&p->model);
+        p->use_model = false;
+    }
+    c->input_rows = (int)h->input_rows;
+    c->input_cols = (int)h->input_cols;
+    p->use_shm = true;
+    TraceLog(LOG_INFO, "Attached to %s: %u layers, %u neurons, %u slots of %.1f KB, producer pid %u",
+             c->shm_source, h->layer_count, h->neuron_count, h->slot_count, h->slot_bytes / 1024.0,
+             h->producer_pid);
+}
+
+// The newest record of the external trainer, read in place
+static const TrainSnapshot *update_shm(void) {
+    ShmRingSlot slot;
+    p->shm_records += shm_ring_latest(&p->shm, &slot);
+    if (!slot.record) return NULL;
+    const ShmRingRecord *r = slot.record;
+    p->shm_frame = (TrainSnapshot){
+        .act = slot.act,
+        .err = slot.err,
+        .weights = slot.weights,
+        .biases = slot.biases,
+        .label = r->label,
+        .predicted = r->predicted,
+        .loss = r->loss,
+        .loss_avg = r->loss_avg,
+        .accuracy_avg = r->accuracy_avg,
+        .step = r->step,
+        .weights_step = r->step,
+        .topology_version = r->topology_version,
+        .live_weights = r->live_weights,
+    };
+    return &p->shm_frame;
+}
+
+// Metrics socket from cona.cfg. Producers may connect at any time.
+static void init_ingest(void) {
+    Config *c = &p->config;
+    if (!c->metrics_socket[0]) return;
+    if (!ingest_init(&p->ingest, c->metrics_socket)) {
+        TraceLog(LOG_ERROR, "Could not listen on %s, metrics disabled", c->metrics_socket);
+        return;
+    }
+    if (!ingest_start(&p->ingest)) {
+        TraceLog(LOG_ERROR, "Could not start metrics thread");
+        ingest_free(&p->ingest);
+        return;
+    }
+    p->use_ingest = true;
+    TraceLog(LOG_INFO, "Listening for metrics on %s", c->metrics_socket);
+}
+
+// Folds the samples that arrived since the last frame into the latest value
+// per metric. This is all the renderer pays for the socket, so it is
+// bounded: two peeks at most, the second for the part past the wrap, and
+// INGEST_DRAIN_MAX samples. The rest waits for the next frame, and a
+// producer that outpaces the budget fills the queue and is dropped.
+static void drain_ingest(void) {
+    if (!p->use_ingest) return;
+    const IngestSample *s;
+    size_t n, budget = INGEST_DRAIN_MAX;
+    for (int peek = 0; peek < 2 && budget > 0 && (n = ingest_peek(&p->ingest, &s)) > 0; peek++) {
+        if (n > budget) n = budget;
+        budget -= n;
+        for (size_t i = 0; i < n; i++) {
+            if (s[i].metric >= INGEST_MAX_METRICS) continue;
+            IngestMetric *m = &p->metrics[s[i].metric];
+            m->value = s[i].value;
+            m->step = s[i].step;
+            m->count++;
+        }
+        ingest_consume(&p->ingest, n);
+    }
+}
+
+// From `y`, returns the y below the last line
+static int DrawMetrics(int y) {
+    Ingest *in = &p->ingest;
+    DrawText(TextFormat("METRICS %s  %d producers  %.0f samples/s  %lld dropped  %lld rejected",
+                        p->config.metrics_socket, atomic_load(&in->clients), p->ingest_per_sec,
+                        atomic_load(&in->dropped), atomic_load(&in->rejected)),
+             20, y, 20, COL_TEXT_DIM);
+    y += 25;
+    for (uint32_t id = 0; id < INGEST_MAX_METRICS && y < GetScreenHeight() / 2; id++) {
+        const IngestMetric *m = &p->metrics[id];
+        if (m->count == 0) continue;
+        char name[INGEST_NAME_MAX];
+        ingest_metric_name(in, id, name);
+        DrawText(TextFormat("%-12s %12g  step %lld", name[0] ? name : TextFormat("#%u", id), m->value, m->step),
+                 30, y, 10, COL_TEXT_MAIN);
+        y += 14;
+    }
+    return y;
+}
+
+// Background checkpoints from cona.cfg. Runs once the network exists,
+// since the file images are sized for its topology.
+static void init_checkpoint(void) {
+    Config *c = &p->config;
+    if (!c->checkpoint_path[0]) return;
+    if (c->checkpoint_interval <= 0.0f) {
+        TraceLog(LOG_ERROR, "checkpoint_interval must be positive, checkpoints disabled");
+        return;
+    }
+    if (!nn_is_dense(&p->trainer.mlp)) {
+        TraceLog(LOG_ERROR, "Checkpoints need a fully connected network, disabled with conv_layers");
+        return;
+    }
+    if (!checkpoint_init(&p->checkpoint, &p->trainer.mlp, c->checkpoint_path)) {
+        TraceLog(LOG_ERROR, "Could not allocate checkpoint buffers for %s", c->checkpoint_path);
+        return;
+    }
+    if (!checkpoint_start(&p->checkpoint)) {
+        TraceLog(LOG_ERROR, "Could not start checkpoint thread");
+        checkpoint_free(&p->checkpoint);
+        return;
+    }
+    p->use_checkpoint = true;
+    trainer_set_checkpoint(&p->trainer, &p->checkpoint, c->checkpoint_interval);
+    TraceLog(LOG_INFO, "Checkpoints to %s every %.0f s (%.1f MB, %s)", c->checkpoint_path,
+             c->checkpoint_interval, p->checkpoint.size / 1048576.0, p->checkpoint.backend);
+}
+
+// Run log from cona.cfg: play one back, or record this run. A log only
+// replays onto the network it was recorded from.
+static void init_recording(void) {
+    Config *c = &p->config;
+    if (c->replay_path[0] && p->use_shm) {
+        TraceLog(LOG_WARNING, "replay_path is ignored while shm_source is attached");
+    } else if (c->replay_path[0]) {
+        Replay *r = &p->replay;
+        if (!replay_open(r, c->replay_path)) {
+            TraceLog(LOG_ERROR, "Could not open run log %s, training instead", c->replay_path);
+            return;
+        }
+        const RecordHeader *h = &r->header;
+        bool match = (int)h->layer_count == p->trainer.mlp.layer_count
+                  && (int)h->neuron_count == p->trainer.neuron_count
+                  && (int)h->weight_count == p->trainer.weight_count
+                  && (int)h->bias_count == p->trainer.bias_count;
+        for (int l = 0; match && l < p->trainer.mlp.layer_count; l++) {
+            match = (int)r->sizes[l] == p->trainer.mlp.sizes[l];
+        }
+        if (!match) {
+            TraceLog(LOG_ERROR, "Run log %s was recorded from another network, training instead", c->replay_path);
+            replay_close(r);
+            return;
+        }
+        // Played back at the pace it was recorded
+        TrainSnapshot first, last;
+        double t0 = 0.0, t1 = 0.0;
+        if (!replay_read(r, r->frame_count - 1, &last, &t1) || !replay_read(r, 0, &first, &t0)) {
+            TraceLog(LOG_ERROR, "Could not read run log %s, training instead", c->replay_path);
+            replay_close(r);
+            return;
+        }
+        p->replay_rate = t1 > t0 ? (last.step - first.step) / (t1 - t0) : 1.0;
+        p->replaying = true;
+        p->replay_step = (double)first.step;
+        TraceLog(LOG_INFO, "Replaying %s: %lld frames, steps %lld-%lld, %zu chunks", c->replay_path,
+                 r->frame_count, replay_first_step(r), replay_last_step(r), r->chunk_count);
+        return;
     }
-    // Hidden 2
-    init_layer(&p->nn.layers[2], HIDDEN2_SIZE);
-    for (int i = 0; i < HIDDEN2_SIZE; i++) {
-        p->nn.layers[2].neurons[i].position = (Vector3){ 0, (i - HIDDEN2_SIZE/2.0f) * 1.5f + 3.0f, 6.0f };
+    if (c->record_path[0]) {
+        if (!record_init(&p->recorder, &p->trainer, c->record_path)) return;
+        if (!record_start(&p->recorder)) {
+            TraceLog(LOG_ERROR, "Could not start run log thread");
+            record_close(&p->recorder);
+            return;
+        }
+        p->recording = true;
+        p->recorded_step = -1;
+        p->record_start = GetTime();
+        TraceLog(LOG_INFO, "Recording to %s", c->record_path);
     }
-    // Output
-    init_layer(&p->nn.layers[3], OUTPUT_SIZE);
-    for (int i = 0; i < OUTPUT_SIZE; i++) {
-         p->nn.layers[3].neurons[i].position = (Vector3){ (i - OUTPUT_SIZE/2.0f) * 2.5f, -5.0f, 14.0f };
+}
+
+static TrainerMode parse_run_mode(const char *key, const char *value) {
+    for (int m = 0; m < TRAINER_MODE_COUNT; m++) {
+        if (strcmp(value, trainer_mode_name((TrainerMode)m)) == 0) return (TrainerMode)m;
+    }
+    TraceLog(LOG_ERROR, "%s must be train, float or int8, using train", key);
+    return TRAINER_TRAIN;
+}
+
+// Update rule from cona.cfg. The trainer starts out with plain SGD, which
+// is kept if the name is unknown.
+static void init_optimizer(void) {
+    Config *c = &p->config;
+    OptimKind kind;
+    if (!optim_parse(c->optimizer, &kind)) {
+        TraceLog(LOG_ERROR, "optimizer must be sgd, momentum, adam or adamw, using sgd");
+        return;
+    }
+    OptimParams params;
+    optim_defaults(&params, kind);
+    params.momentum = c->momentum;
+    params.beta1 = c->adam_beta1;
+    params.beta2 = c->adam_beta2;
+    params.eps = c->adam_eps;
+    params.weight_decay = c->weight_decay;
+    if (!trainer_set_optimizer(&p->trainer, &params)) {
+        TraceLog(LOG_ERROR, "Could not allocate %s state, using sgd", optim_name(kind));
+    }
+}
+
+// Time scales [ and ] step through, the last one unpaced
+static const float TIME_SCALES[] = { 1.0f, 10.0f, 100.0f, 1000.0f, 10000.0f, 0.0f };
+#define TIME_SCALE_COUNT ((int)(sizeof(TIME_SCALES) / sizeof(TIME_SCALES[0])))
+
+// The animation keeps its own clock whatever the scale: every cycle plays
+// in full on the latest snapshot, and only the number of training steps
+// behind it changes. Setting the pace is one atomic store, so switching
+// costs the frame nothing.
+static void set_time_scale(float scale) {
+    p->time_scale = scale;
+    trainer_set_pace(&p->trainer, scale > 0.0f ? scale / ANIM_CYCLE_SECONDS : 0.0);
+}
+
+// Index of the listed scale at or just above `scale`
+static int time_scale_index(float scale) {
+    int i = 0;
+    while (i < TIME_SCALE_COUNT - 1 && (scale <= 0.0f || TIME_SCALES[i] < scale)) i++;
+    return i;
+}
+
+// Geometry is fixed once the trainer exists, so it is copied before the
+// worker starts; only the weight pointers change, to every new snapshot.
+static void init_graph(void) {
+    const Mlp *nn = &p->trainer.mlp;
+    if (!p->graph.arena.head && !tape_init(&p->graph, GRAPH_ARENA)) {
+        TraceLog(LOG_ERROR, "Could not allocate the autodiff graph tape");
+        return;
     }
+    for (int l = 0; l < nn->layer_count - 1; l++) p->graph_layers[l] = nn->dense[l];
+    p->graph_net = (Mlp){
+        .layer_count = nn->layer_count,
+        .sizes = nn->sizes,
+        .shape = nn->shape,
+        .dense = p->graph_layers,
+    };
+}
+
+static void init_trainer(void) {
+    Config *c = &p->config;
+    Mlp nn;
+    bool ok = p->use_model ? model_bind(&p->model, &nn)
+                           : nn_init_layers(&nn, p->input_shape, p->specs, p->nn.layer_count - 1, 42);
+    ok = ok && trainer_init_from(&p->trainer, &nn, c->learning_rate, c->batch_size, c->threads, 42);
+    if (!ok) {
+        TraceLog(LOG_ERROR, "Could not allocate network");
+        return;
+    }
+    int woff = 0, boff = 0;
+    for (int i = 0; i < p->nn.layer_count - 1; i++) {
+        p->nn.layers[i].weight_offset = woff;
+        p->nn.layers[i + 1].bias_offset = boff;
+        woff += (int)nn_weight_count(&p->trainer.mlp.dense[i]);
+        boff += p->trainer.mlp.dense[i].rows;
+    }
+    float density = c->synapse_density;
+    if (density <= 0.0f || density > 1.0f) {
+        TraceLog(LOG_ERROR, "synapse_density must be in (0, 1], using 1");
+        density = 1.0f;
+    }
+    if (!trainer_set_topology(&p->trainer, density, c->prune_threshold, 43)) {
+        TraceLog(LOG_ERROR, "Could not allocate connection masks, training fully connected");
+    }
+    if (c->batch_view > 0 && !trainer_set_view(&p->trainer, c->batch_view)) {
+        TraceLog(LOG_ERROR, "Out of memory for the batch view");
+    }
+    if (!trainer_set_edges(&p->trainer, DRAW_MAX_EDGES)) {
+        TraceLog(LOG_ERROR, "Out of memory for the trainer's edge lists, selecting them here");
+    }
+    init_optimizer();
+    if (c->autodiff && !trainer_set_autodiff(&p->trainer, true)) {
+        TraceLog(LOG_ERROR, "Could not allocate autodiff tapes, using the hand-written backward pass");
+    }
+    init_graph();
+    p->synapse_version = -1;
+    p->synapse_edges = NULL;
+    p->pick_synapse_builds = -1;
+    if (!bvh_builder_init(&p->pick_neurons) || !bvh_builder_init(&p->pick_synapses)) {
+        TraceLog(LOG_ERROR, "Could not create the picking trees' builders");
+    }
+    start_pick_builders();
+    p->run_mode = parse_run_mode("run_mode", c->run_mode);
+    p->menu_run_mode = parse_run_mode("menu_run_mode", c->menu_run_mode);
+    set_time_scale(c->time_scale > 0.0f ? c->time_scale : 0.0f);
+    trainer_set_mode(&p->trainer, p->menu_run_mode);
+    TraceLog(LOG_INFO, "Network: %d layers, %d neurons, %d weights, %s, %s backward",
+             p->nn.layer_count, p->trainer.neuron_count, p->trainer.weight_count,
+             optim_name(p->trainer.optim.params.kind), p->trainer.tapes ? "autodiff" : "hand-written");
+    init_checkpoint();
+    init_recording();
+    p->vis.act = calloc(p->trainer.neuron_count, sizeof(float));
+    p->vis.err = calloc(p->trainer.neuron_count, sizeof(float));
+    p->vis.weights = NULL; // weights are always read from the live snapshot
+    assert(p->vis.act && p->vis.err);
+    if (!start_training()) {
+        TraceLog(LOG_ERROR, "Could not start training thread");
+    }
+}
+
+// Workers that split the histogram binning; they run code from this
+// library, so they go down with it on reload
+static void start_histogram_pool(void) {
+    if (parallel_cpu_count() > 1) p->histogram_pool = pool_create(0);
 }
 
 PLUG_EXPORT void plug_init(void) {
-    p = malloc(sizeof(*p));
+    // Zeroed and cache-line aligned, for the lock-free queues inside
+    p = kernels_alloc(sizeof(*p));
     assert(p);
-    memset(p, 0, sizeof(*p));
 
     p->camera.position = (Vector3){ 20.0f, 15.0f, 20.0f };
     p->camera.target = (Vector3){ 0.0f, 0.0f, 5.0f };
@@ -169,82 +1004,178 @@ PLUG_EXPORT void plug_init(void) {
     p->camera.fovy = 50.0f;
     p->camera.projection = CAMERA_PERSPECTIVE;
 
+    spectrum_init(&p->spectrum, SAMPLE_RATE);
+
     SetAudioStreamBufferSizeDefault(STREAM_BUFFER_SIZE);
     p->stream = LoadAudioStream(SAMPLE_RATE, 16, 2);
     SetAudioStreamCallback(p->stream, PlugAudioCallback);
     PlayAudioStream(p->stream);
 
+    config_defaults(&p->config);
+    if (config_load(&p->config, CONFIG_PATH)) TraceLog(LOG_INFO, "Loaded %s", CONFIG_PATH);
+
+    kernels_init(&p->kernel_tuning);
+    init_dataset();
+    init_model();
+    init_shm_source();
     init_network();
+    init_trainer();
+    init_ingest();
+    plot_init(&p->loss_plot);
+    plot_init(&p->accuracy_plot);
+    p->show_plots = true;
+    p->culling = true;
+    p->camera.position = p->nn.home;
     
     // Start at Menu
     p->state = PLUG_MENU;
     p->transition_alpha = 0.0f;
     
-    TraceLog(LOG_INFO, "CONA Production Engine Initialized");
+    TraceLog(LOG_INFO, "CONA Production Engine Initialized (%s kernels, %s int8)", kernels->name, int8_kernels->name);
 }
 
 PLUG_EXPORT void *plug_pre_reload(void) {
     if (p) {
+        // The workers run code from this library, they must not outlive it.
+        // The trainer goes first so no capture races the checkpoint thread.
+        trainer_stop(&p->trainer);
+        checkpoint_stop(&p->checkpoint);
+        record_stop(&p->recorder);
+        ingest_stop(&p->ingest);
+        bvh_builder_stop(&p->pick_neurons);
+        bvh_builder_stop(&p->pick_synapses);
+        pool_destroy(p->histogram_pool);
+        p->histogram_pool = NULL;
         StopAudioStream(p->stream);
         UnloadAudioStream(p->stream);
-        for (int i=0; i<p->nn.layer_count; i++) {
-            if (p->nn.layers[i].neurons) free(p->nn.layers[i].neurons);
-        }
+        // Layers and neuron arrays live on the heap with the rest of Plug and are
+        // reused by the new library as they are
     }
     return p;
 }
 
 PLUG_EXPORT void plug_post_reload(void *state) {
     p = state;
+    kernels_init(p ? &p->kernel_tuning : NULL);
     if (p) {
         p->stream = LoadAudioStream(SAMPLE_RATE, 16, 2);
         SetAudioStreamCallback(p->stream, PlugAudioCallback);
         PlayAudioStream(p->stream);
+        if (p->use_checkpoint) checkpoint_start(&p->checkpoint);
+        if (p->recording) record_start(&p->recorder);
+        if (p->use_ingest) ingest_start(&p->ingest);
+        if (p->histograms_ready) start_histogram_pool();
+        start_pick_builders();
+        start_training();
     }
 }
 
-static float get_digit_pixel(int digit, int x, int y) {
-    if (digit < 0 || digit > 9) return 0.0f;
-    unsigned char row = FONT_DIGITS[digit][y];
-    return (row & (1 << (7 - x))) ? 1.0f : 0.0f;
+// Copy the latched snapshot's activations into the neuron targets. Hidden
+// ReLU values are unbounded, so each layer is normalized by its peak.
+static void load_activation_targets(void) {
+    int last = p->nn.layer_count - 1;
+    for (int i=0; i<=last; i++) {
+        Layer *l = &p->nn.layers[i];
+        const float *a = p->vis.act + l->first;
+        float peak = 1.0f;
+        if (i > 0 && i < last) {
+            peak = 1e-6f;
+            for (int j=0; j<l->count; j++) if (a[j] > peak) peak = a[j];
+        }
+        for (int j=0; j<l->count; j++) l->target[j] = a[j] / peak;
+    }
+}
+
+// Error shown per neuron is -dLoss/dz scaled to [-1, 1]: green where the
+// gradient pushes the activation up, red where it pushes it down.
+static void load_error_targets(void) {
+    for (int i=1; i<p->nn.layer_count; i++) {
+        Layer *l = &p->nn.layers[i];
+        const float *d = p->vis.err + l->first;
+        float peak = 1e-6f;
+        for (int j=0; j<l->count; j++) if (fabsf(d[j]) > peak) peak = fabsf(d[j]);
+        for (int j=0; j<l->count; j++) l->error[j] = -d[j] / peak;
+    }
+}
+
+// Take the latest published step as the one the next animation cycle shows.
+// Only a step that came with its weights is taken, so the sample and the
+// weights drawn around it belong together.
+static bool latch_snapshot(void) {
+    if (!p->live || !p->vis.act || p->live->weights_step != p->live->step) return false;
+    memcpy(p->vis.act, p->live->act, sizeof(float) * p->trainer.neuron_count);
+    memcpy(p->vis.err, p->live->err, sizeof(float) * p->trainer.neuron_count);
+    p->vis.label = p->live->label;
+    p->vis.predicted = p->live->predicted;
+    p->vis.loss = p->live->loss;
+    p->vis.step = p->live->step;
+    p->vis_valid = true;
+    p->latch_pending = false;
+    p->synapse_reselect = true;
+    p->current_digit = p->vis.label;
+    return true;
+}
+
+// Asks for the next cycle's sample. The trainer copies its weights only
+// now, once per cycle, rather than with every snapshot.
+static void request_latch(void) {
+    p->latch_pending = true;
+    p->weights_asked = false;
+    latch_snapshot();
+}
+
+// The trainer overwrites a weight set only on the second request after the
+// renderer let go of it. Holding the request while the run log's thread
+// copies a keyframe therefore keeps the weights it copies from intact.
+static void ask_weights(void) {
+    if (p->weights_asked || (p->recording && record_keyframe_busy(&p->recorder))) return;
+    trainer_request_weights(&p->trainer);
+    p->weights_asked = true;
 }
 
 // --- Logic ---
 static void UpdateNN(float dt) {
+     int layers = p->nn.layer_count;
      switch (p->train_state) {
         case STATE_INPUT:
+            if (!p->vis_valid && !p->latch_pending) request_latch();
+            if (p->latch_pending && !latch_snapshot()) {
+                ask_weights();
+                p->tr_timer = 0.0f; // wait for the step and its weights
+            }
             if (p->tr_timer > 1.0f) {
                 p->train_state = STATE_PROPAGATE;
                 p->tr_timer = 0.0f;
                 p->signal_progress = 0.0f;
                 p->target_freq = 220.0f;
+                load_activation_targets();
+                p->predicted_digit = p->vis.predicted;
             } else {
-                Layer *in = &p->nn.layers[0];
-                for (int y=0; y<8; y++) {
-                    for (int x=0; x<8; x++) {
-                        float target = get_digit_pixel(p->current_digit, x, y);
-                        in->neurons[y*8 + x].activation = Lerp(in->neurons[y*8 + x].activation, target, dt * 10.0f);
-                    }
-                }
-                for (int i=1; i<TOTAL_LAYERS; i++) {
-                     for(int j=0; j<p->nn.layers[i].count; j++) {
-                         p->nn.layers[i].neurons[j].activation = Lerp(p->nn.layers[i].neurons[j].activation, 0.0f, dt * 5.0f);
-                         p->nn.layers[i].neurons[j].error = 0.0f;
-                     }
-                 }
-                 p->target_freq = 0.0f;
+                // Input eases toward the sample, everything after it decays
+                Network *nn = &p->nn;
+                int in = nn->layers[0].count;
+                if (p->vis_valid) kernels->lerp(nn->activation, p->vis.act, dt * 10.0f, in);
+                kernels->lerp(nn->activation + in, NULL, dt * 5.0f, nn->neuron_count - in);
+                memset(nn->error + in, 0, sizeof(float) * (nn->neuron_count - in));
+                p->target_freq = 0.0f;
             }
             break;
         case STATE_PROPAGATE:
              p->signal_progress += dt * 1.5f;
-             if (p->signal_progress >= 1.0f) {
-                 p->train_state = STATE_OUTPUT;
-                 p->tr_timer = 0.0f;
-                 p->target_freq = 440.0f;
-                 Layer *out = &p->nn.layers[TOTAL_LAYERS-1];
-                 for (int i=0; i<OUTPUT_SIZE; i++) {
-                     float val = (i == p->current_digit) ? 0.9f : 0.1f;
-                     out->neurons[i].activation = val;
+             // Each layer lights up once the signal front has reached it. The
+             // reached layers are a prefix, so they are one range of neurons.
+             {
+                 Network *nn = &p->nn;
+                 int reached = 1;
+                 while (reached < layers && p->signal_progress >= (float)reached / (layers-1)) reached++;
+                 int begin = nn->layers[1].first;
+                 int end = nn->layers[reached-1].first + nn->layers[reached-1].count;
+                 if (reached > 1) kernels->lerp(nn->activation + begin, nn->target + begin, dt * 10.0f, end - begin);
+                 if (p->signal_progress >= 1.0f) {
+                     p->train_state = STATE_OUTPUT;
+                     p->tr_timer = 0.0f;
+                     p->target_freq = 440.0f;
+                     memcpy(nn->activation + begin, nn->target + begin, sizeof(float) * (nn->neuron_count - begin));
                  }
              }
              break;
@@ -254,17 +1185,14 @@ static void UpdateNN(float dt) {
                  p->train_state = STATE_LEARN;
                  p->tr_timer = 0.0f;
                  p->target_freq = 110.0f; 
+                 p->sample_loss = p->vis.loss;
+                 load_error_targets();
              }
              break;
         case STATE_LEARN:
              p->target_freq = 0.0f;
-             Layer *out = &p->nn.layers[TOTAL_LAYERS-1];
-             for (int i=0; i<OUTPUT_SIZE; i++) {
-                 if (i == p->current_digit) out->neurons[i].error = 1.0f;
-                 else if (out->neurons[i].activation > 0.2f) out->neurons[i].error = -1.0f;
-             }
              if (p->tr_timer > 1.0f) {
-                 p->current_digit = (p->current_digit + 1) % 10;
+                 request_latch();
                  p->train_state = STATE_INPUT;
                  p->tr_timer = 0.0f;
              }
@@ -273,51 +1201,1204 @@ static void UpdateNN(float dt) {
 }
 
 // --- Draw ---
+// Frustum of the camera BeginMode3D set up
+static void camera_frustum(Frustum *f) {
+    Matrix vp = MatrixMultiply(rlGetMatrixModelview(), rlGetMatrixProjection());
+    frustum_from_matrix(f, MatrixToFloatV(vp).v);
+}
+
+// Grid lines entirely outside the frustum `f` are skipped and counted in
+// stats; f = NULL draws all
+static void DrawGridLine3D(Vector3 a, Vector3 b, Color c, const Frustum *f, CullStats *stats) {
+    if (f && (frustum_outcode(f, (float[3]){ a.x, a.y, a.z }, 0.0f) & frustum_outcode(f, (float[3]){ b.x, b.y, b.z }, 0.0f))) {
+        stats->grid_off++;
+        return;
+    }
+    stats->grid_lines++;
+    DrawLine3D(a, b, c);
+}
+
+// Same layout as raylib's DrawGrid, tinted by the low end of the spectrum.
+static void DrawPulseGrid(int slices, float spacing, float pulse, const Frustum *f) {
+    int half = slices / 2;
+    Color base = ColorLerp(DARKGRAY, COL_ACCENT, pulse);
+    Color center = ColorLerp(GRAY, COL_ACCENT_HOVER, pulse);
+    for (int i = -half; i <= half; i++) {
+        Color c = (i == 0) ? center : base;
+        DrawGridLine3D((Vector3){ i*spacing, 0.0f, -half*spacing }, (Vector3){ i*spacing, 0.0f, half*spacing }, c, f, &p->cull);
+        DrawGridLine3D((Vector3){ -half*spacing, 0.0f, i*spacing }, (Vector3){ half*spacing, 0.0f, i*spacing }, c, f, &p->cull);
+    }
+}
+
+// Keeps the per-pair edge lists in step with the weights. The trainer
+// selects them with every weight set it publishes, so here they are only
+// copied, in O(edges). Sources without edge lists (shared memory, run logs)
+// get them built here instead: the structure is rebuilt when the set of
+// live weights changes, and pairs thinned down to DRAW_MAX_EDGES are
+// reselected once per animation cycle so the drawn edges follow the
+// strongest weights. Otherwise only the weights of the stored edges are
+// refreshed, which is O(edges).
+static void update_synapses(void) {
+    if (!p->live) return;
+    if (p->live->edges) {
+        if (p->live->edges == p->synapse_edges && p->live->weights_step == p->synapse_step) return;
+        for (int i=0; i<p->nn.layer_count-1; i++) {
+            if (p->nn.layers[i+1].kind != NN_DENSE) continue;
+            if (!synapse_copy(&p->nn.layers[i].synapses, &p->live->edges[i])) {
+                TraceLog(LOG_ERROR, "Could not allocate edges for layer %d", i);
+            }
+        }
+        p->synapse_builds++;
+        p->synapse_edges = p->live->edges;
+        p->synapse_step = p->live->weights_step;
+        p->synapse_version = p->live->topology_version;
+        p->synapse_reselect = false;
+        return;
+    }
+    p->synapse_edges = NULL;
+    bool rebuild = p->live->topology_version != p->synapse_version;
+    for (int i=0; i<p->nn.layer_count-1; i++) {
+        Layer *l = &p->nn.layers[i];
+        // Kernels are not edges between the two layers' neurons
+        if (p->nn.layers[i+1].kind != NN_DENSE) continue;
+        const float *w = p->live->weights + l->weight_offset;
+        if (rebuild || (p->synapse_reselect && l->synapses.thinned)) {
+            if (!synapse_build(&l->synapses, w, l->count, p->nn.layers[i+1].count, DRAW_MAX_EDGES)) {
+                TraceLog(LOG_ERROR, "Could not allocate edges for layer %d", i);
+            }
+            p->synapse_builds++;
+        } else {
+            synapse_refresh(&l->synapses, w);
+        }
+    }
+    p->synapse_version = p->live->topology_version;
+    p->synapse_reselect = false;
+}
+
+// Same colors as the neuron spheres, brightness for activation
+static void update_feature_maps(void) {
+    for (int i=1; i<p->nn.layer_count; i++) {
+        Layer *l = &p->nn.layers[i];
+        FeatureMap *m = &l->map;
+        if (!m->pixels) continue;
+        bool changed = false;
+        for (int j=0; j<l->count; j++) {
+            float err = l->error[j];
+            Color base = err > 0.1f ? GREEN : err < -0.1f ? RED : WHITE;
+            float v = 0.15f + 0.85f * Clamp(l->activation[j], 0.0f, 1.0f);
+            Color c = { (unsigned char)(base.r * v), (unsigned char)(base.g * v), (unsigned char)(base.b * v), 255 };
+            Color *px = &m->pixels[m->pixel[j]];
+            if (px->r != c.r || px->g != c.g || px->b != c.b || px->a != c.a) {
+                *px = c;
+                changed = true;
+            }
+        }
+        if (changed) {
+            UpdateTexture(m->texture, m->pixels);
+            p->map_uploads++;
+        }
+    }
+}
+
+// Double-sided quad in the layer's plane, the camera orbits around it
+static void DrawFeatureMap(const FeatureMap *m) {
+    float hw = m->width * m->spacing / 2.0f, hh = m->height * m->spacing / 2.0f;
+    Vector3 c = m->center;
+    rlDisableBackfaceCulling();
+    rlSetTexture(m->texture.id);
+    rlBegin(RL_QUADS);
+        rlColor4ub(255, 255, 255, 255);
+        rlNormal3f(0.0f, 0.0f, 1.0f);
+        rlTexCoord2f(0.0f, 0.0f); rlVertex3f(c.x - hw, c.y + hh, c.z);
+        rlTexCoord2f(0.0f, 1.0f); rlVertex3f(c.x - hw, c.y - hh, c.z);
+        rlTexCoord2f(1.0f, 1.0f); rlVertex3f(c.x + hw, c.y - hh, c.z);
+        rlTexCoord2f(1.0f, 0.0f); rlVertex3f(c.x + hw, c.y + hh, c.z);
+    rlEnd();
+    rlSetTexture(0);
+    rlEnableBackfaceCulling();
+}
+
+// Forward and backward of the shown sample on the renderer's tape
+static void update_graph(void) {
+    p->graph_loss = NULL;
+    if (!p->show_graph || !p->live || !p->vis_valid || !p->graph.arena.head) return;
+    double t0 = GetTime();
+    const Mlp *nn = &p->graph_net;
+    int woff = 0, boff = 0;
+    for (int l = 0; l < nn->layer_count - 1; l++) {
+        NnDense *d = &p->graph_layers[l];
+        d->w = p->live->weights + woff;
+        d->b = p->live->biases + boff;
+        woff += (int)nn_weight_count(d);
+        boff += d->rows;
+    }
+    tape_reset(&p->graph);
+    TapeNode *loss = tape_record_mlp(&p->graph, nn, p->vis.act, 1, &p->vis.label, NULL, NULL, NULL);
+    if (loss && tape_backward(&p->graph, loss)) p->graph_loss = loss;
+    p->graph_ms = (float)((GetTime() - t0) * 1000.0);
+}
+
+static float node_grad_rms(const TapeNode *n) {
+    if (!n->grad) return 0.0f;
+    size_t count = (size_t)n->rows * n->cols;
+    double sum = 0.0;
+    for (size_t i = 0; i < count; i++) sum += (double)n->grad[i] * n->grad[i];
+    return count ? (float)sqrt(sum / count) : 0.0f;
+}
+
+// Walks the tape: every op gets a column one past its deepest input, and a
+// parameter sits in the column before the op that reads it. Boxes are
+// shaded by the RMS of their gradient.
+static void DrawGraphPanel(void) {
+    Tape *t = &p->graph;
+    int count = t->count;
+    int *depth = arena_alloc(&t->arena, sizeof(int) * count);
+    int *slot = arena_alloc(&t->arena, sizeof(int) * count);
+    int *column_size = arena_alloc(&t->arena, sizeof(int) * count);
+    float *rms = arena_alloc(&t->arena, sizeof(float) * count);
+    if (!depth || !slot || !column_size || !rms) return;
+
+    int columns = 0, rows = 0;
+    float max_rms = 1e-12f;
+    for (TapeNode *n = t->first; n; n = n->next) {
+        int d = 0;
+        for (int i = 0; i < n->in_count; i++) {
+            if (n->in[i]->op != TAPE_PARAM && depth[n->in[i]->index] + 1 > d) d = depth[n->in[i]->index] + 1;
+        }
+        depth[n->index] = d;
+        rms[n->index] = node_grad_rms(n);
+        if (rms[n->index] > max_rms) max_rms = rms[n->index];
+    }
+    for (TapeNode *n = t->first; n; n = n->next) {
+        for (int i = 0; i < n->in_count; i++) {
+            if (n->in[i]->op == TAPE_PARAM) depth[n->in[i]->index] = depth[n->index] - 1;
+        }
+    }
+    memset(column_size, 0, sizeof(int) * count);
+    for (TapeNode *n = t->first; n; n = n->next) {
+        int d = depth[n->index];
+        slot[n->index] = column_size[d]++;
+        if (d + 1 > columns) columns = d + 1;
+        if (column_size[d] > rows) rows = column_size[d];
+    }
+
+    int pw = columns * (GRAPH_BOX_W + GRAPH_GAP) + GRAPH_GAP;
+    int ph = rows * (GRAPH_BOX_H + GRAPH_GAP) + GRAPH_GAP + 24;
+    int px = GetScreenWidth() - pw - 20, py = 20;
+    DrawRectangle(px, py, pw, ph, Fade(BLACK, 0.75f));
+    DrawText(TextFormat("AUTODIFF TAPE  %d nodes  %.0f KB arena  %lld grows  %.2f ms  loss %.3f", count,
+                        t->arena.peak / 1024.0, t->arena.grows, p->graph_ms, p->graph_loss->loss),
+             px + GRAPH_GAP, py + 6, 10, COL_TEXT_MAIN);
+
+    #define BOX_X(n) (px + GRAPH_GAP + depth[(n)->index] * (GRAPH_BOX_W + GRAPH_GAP))
+    #define BOX_Y(n) (py + 24 + GRAPH_GAP + slot[(n)->index] * (GRAPH_BOX_H + GRAPH_GAP))
+    for (TapeNode *n = t->first; n; n = n->next) {
+        for (int i = 0; i < n->in_count; i++) {
+            const TapeNode *src = n->in[i];
+            Vector2 a = { BOX_X(src) + GRAPH_BOX_W, BOX_Y(src) + GRAPH_BOX_H / 2.0f };
+            Vector2 b = { BOX_X(n), BOX_Y(n) + GRAPH_BOX_H / 2.0f };
+            DrawLineEx(a, b, 1.0f, Fade(COL_TEXT_DIM, 0.8f));
+        }
+    }
+    for (TapeNode *n = t->first; n; n = n->next) {
+        Rectangle r = { BOX_X(n), BOX_Y(n), GRAPH_BOX_W, GRAPH_BOX_H };
+        float g = sqrtf(rms[n->index] / max_rms);
+        Color fill = n->op == TAPE_PARAM ? (Color){ 255, 170, 0, 255 } : COL_ACCENT;
+        DrawRectangleRec(r, Fade(fill, 0.15f + 0.7f * g));
+        DrawRectangleLinesEx(r, 1.0f, Fade(fill, 0.9f));
+        DrawText(n->name ? n->name : tape_op_name(n->op), r.x + 4, r.y + 4, 10, COL_TEXT_MAIN);
+        DrawText(TextFormat("%dx%d", n->rows, n->cols), r.x + 4, r.y + 16, 10, COL_TEXT_DIM);
+    }
+    #undef BOX_X
+    #undef BOX_Y
+}
+
+// Whether a faint synapse is too far away to be drawn, see LOD_SYNAPSE_DISTANCE
+static bool synapse_too_faint(Vector3 a, Vector3 b, float strength) {
+    float lod_d2 = LOD_SYNAPSE_DISTANCE * LOD_SYNAPSE_DISTANCE;
+    float d2 = Vector3DistanceSqr(Vector3Lerp(a, b, 0.5f), p->camera.position);
+    return p->culling && d2 > lod_d2 && strength * strength * lod_d2 <= 0.0625f * d2;
+}
+
+// Everything is classified against the camera's frustum first: every
+// neuron gets the planes it is outside of, whole grid cells at a time
+// where a cell is entirely in or out. A neuron with any is not drawn, and
+// a synapse is not when both its ends are outside the same plane.
 static void DrawNN3D() {
+    int layers = p->nn.layer_count;
+    CullStats *stats = &p->cull;
+    memset(stats, 0, sizeof(*stats));
+    Frustum frustum;
+    camera_frustum(&frustum);
+    for (int i=0; i<layers; i++) {
+        Layer *l = &p->nn.layers[i];
+        unsigned char *codes = p->nn.outcode + l->first;
+        if (p->culling) cull_grid_classify(&l->cull, &frustum, (const float *)l->position, l->cull_radius, codes);
+        else memset(codes, 0, l->count);
+    }
+    Vector3 eye = p->camera.position;
+
     // Draw Connections
-    for (int i=0; i<TOTAL_LAYERS-1; i++) {
+    for (int i=0; i<layers-1; i++) {
         Layer *l1 = &p->nn.layers[i];
         Layer *l2 = &p->nn.layers[i+1];
-        for (int j=0; j<l1->count; j++) {
-            if (l1->neurons[j].activation < 0.1f && p->train_state != STATE_PROPAGATE) continue;
-            for (int k=0; k<l2->count; k++) {
-                float layer_start_t = (float)i / (TOTAL_LAYERS-1);
-                float layer_end_t = (float)(i+1) / (TOTAL_LAYERS-1);
-                bool active_path = false;
-                if (p->train_state == STATE_PROPAGATE && p->signal_progress >= layer_start_t && p->signal_progress <= layer_end_t) {
+        const SynapseCsr *syn = &l1->synapses;
+        const unsigned char *codes1 = p->nn.outcode + l1->first, *codes2 = p->nn.outcode + l2->first;
+        for (int j=0; j<syn->in; j++) {
+            if (l1->activation[j] < 0.1f && p->train_state != STATE_PROPAGATE) continue;
+            for (int e=syn->row_start[j]; e<syn->row_start[j+1]; e++) {
+                int k = syn->dst[e];
+                float wk = syn->weight[e];
+                float layer_start_t = (float)i / (layers-1);
+                float layer_end_t = (float)(i+1) / (layers-1);
+                bool active_path = p->train_state == STATE_PROPAGATE && p->signal_progress >= layer_start_t && p->signal_progress <= layer_end_t;
+                // Opacity follows weight magnitude, hue its sign
+                float strength = fminf(fabsf(wk)*2.0f, 1.0f);
+                bool bright = active_path || (l1->activation[j] > 0.5f && l2->activation[k] > 0.5f);
+                if (!bright && strength <= 0.25f) continue;
+                if (codes1[j] & codes2[k]) {
+                    stats->synapses_off++;
+                    continue;
+                }
+                if (!bright && synapse_too_faint(l1->position[j], l2->position[k], strength)) {
+                    stats->synapses_faint++;
+                    continue;
+                }
+                stats->synapses++;
+                if (active_path) {
                     float local_t = (p->signal_progress - layer_start_t) / (layer_end_t - layer_start_t);
-                    Vector3 pos = Vector3Lerp(l1->neurons[j].position, l2->neurons[k].position, local_t);
+                    Vector3 pos = Vector3Lerp(l1->position[j], l2->position[k], local_t);
                     DrawSphere(pos, 0.15f, GOLD);
-                    active_path = true;
                 }
-                if (active_path || (l1->neurons[j].activation > 0.5f && l2->neurons[k].activation > 0.5f)) {
-                     DrawLine3D(l1->neurons[j].position, l2->neurons[k].position, Fade(WHITE, 0.15f));
-                } else if ((j+k)%7 == 0) {
-                     DrawLine3D(l1->neurons[j].position, l2->neurons[k].position, Fade(GRAY, 0.03f));
+                if (bright) {
+                     Color c = (wk < 0.0f) ? COL_ACCENT_HOVER : WHITE;
+                     DrawLine3D(l1->position[j], l2->position[k], Fade(c, 0.05f + 0.25f*strength));
+                } else {
+                     DrawLine3D(l1->position[j], l2->position[k], Fade(GRAY, 0.04f*strength));
                 }
             }
         }
     }
-    // Draw Neurons
-    for (int i=0; i<TOTAL_LAYERS; i++) {
+    // Draw Neurons. Screen radius is radius * pixels / distance.
+    float pixels = GetScreenHeight() / (2.0f * tanf(p->camera.fovy * DEG2RAD / 2.0f));
+    for (int i=0; i<layers; i++) {
         Layer *l = &p->nn.layers[i];
+        const unsigned char *codes = p->nn.outcode + l->first;
+        if (l->map.pixels) {
+            bool inside;
+            if (p->culling && frustum_box(&frustum, &l->cull.bounds, &inside)) {
+                stats->maps_off++;
+            } else {
+                stats->maps++;
+                DrawFeatureMap(&l->map);
+            }
+            continue;
+        }
+        // Band per layer; deep networks spread the bands over their depth
+        int band = layers < SPECTRUM_BANDS ? i + 1 : 1 + i * (SPECTRUM_BANDS - 2) / (layers - 1);
+        float glow = spectrum_band(&p->spectrum, band);
+        bool dense = l->count > LAYOUT_LINE_MAX;
         for (int j=0; j<l->count; j++) {
-             Neuron *n = &l->neurons[j];
+             if (codes[j]) {
+                 stats->neurons_off++;
+                 continue;
+             }
+             float act = l->activation[j];
+             float err = l->error[j];
+             Vector3 pos = l->position[j];
              Color c = WHITE;
              if (i == 0) c = COL_ACCENT;
-             if (i == TOTAL_LAYERS-1) c = GOLD;
-             if (n->error > 0.1f) c = GREEN;
-             else if (n->error < -0.1f) c = RED;
-             float alpha = (n->activation > 0.1f) ? (0.5f + n->activation*0.5f) : 0.2f;
-             DrawSphere(n->position, 0.2f + n->activation * 0.3f, ColorAlpha(c, alpha));
+             if (i == layers-1) c = GOLD;
+             if (err > 0.1f) c = GREEN;
+             else if (err < -0.1f) c = RED;
+             float alpha = (act > 0.1f) ? (0.5f + act*0.5f) : 0.2f;
+             float radius = (0.2f + act * 0.3f) * l->scale;
+             // DrawSphere's tessellation, or the coarsest for dense grids
+             int rings = dense ? 4 : 16, slices = dense ? 6 : 16;
+             if (p->culling) {
+                 float distance = Vector3Distance(pos, eye);
+                 if (radius * pixels < LOD_MID_PIXELS * distance) {
+                     rings = 4;
+                     slices = 6;
+                 } else if (radius * pixels < LOD_FULL_PIXELS * distance && !dense) {
+                     rings = 8;
+                     slices = 10;
+                 }
+             }
+             stats->neurons++;
+             stats->neurons_coarse += rings < (dense ? 4 : 16);
+             DrawSphereEx(pos, radius, rings, slices, ColorAlpha(c, alpha));
+             if (act > 0.1f && glow > 0.05f) {
+                 DrawSphereEx(pos, radius * (1.0f + glow), rings < 6 ? rings : 6, 6, ColorAlpha(c, glow * act * 0.25f));
+             }
              
-             if (i == TOTAL_LAYERS-1) {
-                 Vector2 sc = GetWorldToScreen(n->position, p->camera);
+             if (i == layers-1 && !dense) {
+                 Vector2 sc = GetWorldToScreen(pos, p->camera);
                  if (sc.x > 0) DrawText(TextFormat("%d", j), sc.x-5, sc.y-25, 20, RAYWHITE);
              }
         }
     }
-    DrawGrid(20, 1.0f);
+    DrawPulseGrid(20, 1.0f, spectrum_band(&p->spectrum, 0) * 0.5f + p->spectrum.level * 0.5f, p->culling ? &frustum : NULL);
+}
+
+static Rectangle back_button(void) {
+    return (Rectangle){ 20, 20, 100, 30 };
+}
+
+static Rectangle replay_bar(void) {
+    return (Rectangle){ 20, GetScreenHeight() - 200, GetScreenWidth() - 40, 12 };
+}
+
+// Advances playback and reads the frame at the new position. Dragging the
+// slider seeks; the animation then restarts on the frame sought.
+static const TrainSnapshot *update_replay(float dt) {
+    Replay *r = &p->replay;
+    double first = (double)replay_first_step(r), last = (double)replay_last_step(r);
+    bool seek = false;
+    if (p->state == PLUG_DEMO) {
+        if (IsKeyPressed(KEY_SPACE)) p->replay_paused = !p->replay_paused;
+        Rectangle bar = replay_bar();
+        Rectangle grab = { bar.x, bar.y - 8, bar.width, bar.height + 16 };
+        Vector2 mouse = GetMousePosition();
+        if (IsMouseButtonPressed(MOUSE_BUTTON_LEFT) && CheckCollisionPointRec(mouse, grab)) p->replay_dragging = true;
+        if (!IsMouseButtonDown(MOUSE_BUTTON_LEFT)) p->replay_dragging = false;
+        if (p->replay_dragging) {
+            p->replay_step = first + Clamp((mouse.x - bar.x) / bar.width, 0.0f, 1.0f) * (last - first);
+            seek = true;
+        }
+    }
+    if (!seek && !p->replay_paused) p->replay_step = fmin(p->replay_step + p->replay_rate * dt, last);
+
+    long long cached = r->cached;
+    double t0 = GetTime();
+    long long frame = replay_find_step(r, (long long)p->replay_step);
+    if (!replay_read(r, frame, &p->replay_frame, NULL)) {
+        TraceLog(LOG_ERROR, "Run log is corrupt at frame %lld, training instead", frame);
+        p->replaying = false;
+        start_training();
+        return trainer_snapshot(&p->trainer);
+    }
+    if (r->cached != cached) p->replay_seek_ms = (float)((GetTime() - t0) * 1000.0);
+    if (seek && frame != p->replay_frame_index) {
+        p->vis_valid = false;
+        p->train_state = STATE_INPUT;
+        p->tr_timer = 0.0f;
+    }
+    p->replay_frame_index = frame;
+    return &p->replay_frame;
+}
+
+static void DrawReplayBar(void) {
+    Replay *r = &p->replay;
+    Rectangle bar = replay_bar();
+    double first = (double)replay_first_step(r), last = (double)replay_last_step(r);
+    float t = last > first ? (float)((p->replay_step - first) / (last - first)) : 1.0f;
+    DrawRectangleRec(bar, Fade(COL_ACCENT, 0.25f));
+    DrawRectangle(bar.x, bar.y, bar.width * t, bar.height, Fade(COL_ACCENT, 0.7f));
+    DrawCircle(bar.x + bar.width * t, bar.y + bar.height / 2, p->replay_dragging ? 10 : 8, COL_TEXT_MAIN);
+    DrawText(TextFormat("REPLAY %s  SPACE pause  step %lld of %lld-%lld  frame %lld/%lld  seek %.2f ms  %zu chunks  %.1f MB",
+                        p->replay_paused ? "PAUSED" : "PLAYING", p->replay_frame.step,
+                        replay_first_step(r), replay_last_step(r), p->replay_frame_index + 1, r->frame_count,
+                        p->replay_seek_ms, r->chunk_count, r->file.size / 1048576.0),
+             20, bar.y - 30, 20, COL_TEXT_DIM);
+}
+
+static Rectangle plots_rect(void) {
+    return (Rectangle){ GetScreenWidth() - PLOT_W - 20, GetScreenHeight() - 240 - 2 * (PLOT_H + PLOT_GAP),
+                        PLOT_W, 2 * (PLOT_H + PLOT_GAP) };
+}
+
+static void append_plot_point(long long step, float loss, float accuracy) {
+    if (p->plot_full) return;
+    if (!plot_append(&p->loss_plot, step, loss) || !plot_append(&p->accuracy_plot, step, accuracy)) {
+        TraceLog(LOG_WARNING, "Out of memory for plots after %zu steps, plots stop here", plot_count(&p->loss_plot));
+        p->plot_full = true;
+    }
+}
+
+// Every training step reaches the plots through the trainer's history.
+// Replays and external trainers only have the snapshots, so those add the
+// moving averages once per new step.
+static void update_plots(void) {
+    if (!p->replaying && !p->use_shm) {
+        const TrainerPoint *pt;
+        size_t n;
+        while ((n = trainer_history_peek(&p->trainer, &pt)) > 0) {
+            for (size_t i = 0; i < n; i++) append_plot_point(pt[i].step, pt[i].loss, pt[i].accuracy);
+            trainer_history_consume(&p->trainer, n);
+        }
+    } else if (p->live && (plot_count(&p->loss_plot) == 0 || p->live->step > p->loss_plot.last_step)) {
+        append_plot_point(p->live->step, p->live->loss_avg, p->live->accuracy_avg);
+    }
+
+    if (p->state != PLUG_DEMO || !p->show_plots) return;
+    size_t count = plot_count(&p->loss_plot);
+    Rectangle r = plots_rect();
+    Vector2 mouse = GetMousePosition();
+    bool hover = CheckCollisionPointRec(mouse, r);
+    size_t span = p->plot_span ? p->plot_span : count;
+
+    // Wheel zooms about the sample under the cursor, dragging pans, right
+    // click shows the whole run again
+    float wheel = hover ? GetMouseWheelMove() : 0.0f;
+    if (wheel != 0.0f && count > PLOT_MIN_SPAN) {
+        float f = Clamp((mouse.x - r.x) / r.width, 0.0f, 1.0f);
+        double anchor = p->plot_first + (double)f * span;
+        double next = span * pow(0.8, wheel);
+        if (next < PLOT_MIN_SPAN) next = PLOT_MIN_SPAN;
+        if (next >= count) {
+            p->plot_span = 0;
+            p->plot_first = 0;
+        } else {
+            p->plot_span = (size_t)next;
+            double first = anchor - f * next;
+            p->plot_first = first < 0.0 ? 0 : (size_t)first;
+        }
+    }
+    if (hover && IsMouseButtonPressed(MOUSE_BUTTON_LEFT) && p->plot_span) {
+        p->plot_dragging = true;
+        p->plot_drag_x = mouse.x;
+        p->plot_drag_first = p->plot_first;
+    }
+    if (!IsMouseButtonDown(MOUSE_BUTTON_LEFT)) p->plot_dragging = false;
+    if (p->plot_dragging) {
+        double first = p->plot_drag_first - (double)(mouse.x - p->plot_drag_x) / r.width * p->plot_span;
+        p->plot_first = first < 0.0 ? 0 : (size_t)first;
+    }
+    if (hover && IsMouseButtonPressed(MOUSE_BUTTON_RIGHT)) p->plot_span = 0;
+
+    // Past the end means following the newest samples
+    if (p->plot_span == 0) p->plot_first = 0;
+    else if (p->plot_first + p->plot_span >= count) p->plot_first = count > p->plot_span ? count - p->plot_span : 0;
+}
+
+// One vertex per sample when zoomed in far enough, else the column's min
+// and max, ordered so consecutive columns join at the nearer end
+static void DrawPlot(Rectangle r, PlotSeries *s, const char *label, Color color, bool unit_range) {
+    size_t count = plot_count(s);
+    size_t first = p->plot_span ? p->plot_first : 0;
+    size_t last = p->plot_span ? first + p->plot_span : count;
+    int n = plot_columns(s, first, last, PLOT_W, p->plot_ranges);
+
+    PlotRange y = { 0.0f, 1.0f };
+    if (!unit_range) {
+        y = (PlotRange){ INFINITY, -INFINITY };
+        for (int c = 0; c < n; c++) {
+            y.min = fminf(y.min, p->plot_ranges[c].min);
+            y.max = fmaxf(y.max, p->plot_ranges[c].max);
+        }
+        if (!(y.max > y.min)) y = (PlotRange){ y.min - 0.5f, y.min + 0.5f };
+    }
+    DrawRectangleRec(r, Fade(BLACK, 0.6f));
+    DrawRectangleLinesEx(r, 1.0f, Fade(COL_TEXT_DIM, 0.5f));
+
+    float scale = (r.height - 4.0f) / (y.max - y.min);
+    float dx = n < PLOT_W ? (n > 1 ? r.width / (n - 1) : 0.0f) : 1.0f;
+    int k = 0;
+    for (int c = 0; c < n; c++) {
+        PlotRange q = p->plot_ranges[c];
+        if (isnan(q.min) || isnan(q.max)) continue;
+        float x = r.x + c * dx;
+        float lo = r.y + r.height - 2.0f - (q.min - y.min) * scale;
+        float hi = r.y + r.height - 2.0f - (q.max - y.min) * scale;
+        if (q.min == q.max) {
+            p->plot_points[k++] = (Vector2){ x, lo };
+        } else if (c & 1) {
+            p->plot_points[k++] = (Vector2){ x, hi };
+            p->plot_points[k++] = (Vector2){ x, lo };
+        } else {
+            p->plot_points[k++] = (Vector2){ x, lo };
+            p->plot_points[k++] = (Vector2){ x, hi };
+        }
+    }
+    if (k > 1) DrawLineStrip(p->plot_points, k, color);
+    p->plot_vertices += k;
+
+    PlotRange latest = { 0.0f, 0.0f };
+    plot_columns(s, count - 1, count, 1, &latest);
+    DrawText(TextFormat("%s %.3f   %.3f - %.3f", label, latest.max, y.min, y.max), r.x, r.y - 14, 10, color);
+}
+
+static void DrawPlots(void) {
+    double t0 = GetTime();
+    Rectangle r = plots_rect();
+    size_t count = plot_count(&p->loss_plot);
+    size_t first = p->plot_span ? p->plot_first : 0;
+    size_t last = p->plot_span ? first + p->plot_span : count;
+    p->plot_vertices = 0;
+    Rectangle top = { r.x, r.y + PLOT_GAP, PLOT_W, PLOT_H };
+    Rectangle bottom = { r.x, r.y + 2 * PLOT_GAP + PLOT_H, PLOT_W, PLOT_H };
+    DrawPlot(top, &p->loss_plot, "LOSS", COL_ACCENT_HOVER, false);
+    DrawPlot(bottom, &p->accuracy_plot, "ACCURACY", GREEN, true);
+    DrawText(TextFormat("STEPS %lld - %lld of %zu  %s  %d vertices  %.2f ms  %.0f MB",
+                        count ? plot_step_at(&p->loss_plot, first) : 0LL,
+                        count ? plot_step_at(&p->loss_plot, last - 1) : 0LL, count,
+                        p->plot_span ? "wheel/drag, right click all" : "wheel zooms",
+                        p->plot_vertices, p->plot_ms,
+                        (plot_bytes(&p->loss_plot) + plot_bytes(&p->accuracy_plot)) / 1048576.0),
+             r.x, r.y, 10, COL_TEXT_DIM);
+    p->plot_ms = (float)((GetTime() - t0) * 1000.0);
+}
+
+// Textures and tile trackers are made the first time the panels are shown
+static void init_heatmaps(void) {
+    p->heatmaps_ready = true;
+    p->heatmap_staging = malloc(sizeof(float) * HEATMAP_TILE * HEATMAP_TILE);
+    if (!p->heatmap_staging) return;
+    for (int i = 0; i < p->trainer.mlp.layer_count - 1; i++) {
+        const NnDense *d = &p->trainer.mlp.dense[i];
+        if (nn_weight_count(d) == 0) continue;
+        Heatmap *h = &p->heatmaps[p->heatmap_count];
+        h->layer = i;
+        h->dense = d->kind == NN_DENSE;
+        h->step = h->grad_step = -1;
+        int longest = d->rows > d->cols ? d->rows : d->cols;
+        float *zeros = calloc((size_t)d->rows * d->cols, sizeof(float));
+        if (!zeros || !heatmap_init(&h->tiles, d->rows, d->cols)) {
+            TraceLog(LOG_ERROR, "Out of memory for the heatmap of weight layer %d", i);
+            free(zeros);
+            heatmap_free(&h->tiles);
+            continue;
+        }
+        h->weights = LoadTextureFromImage((Image){ zeros, d->cols, d->rows, 1, PIXELFORMAT_UNCOMPRESSED_R32 });
+        if (h->dense) {
+            h->err = LoadTextureFromImage((Image){ zeros, d->rows, 1, 1, PIXELFORMAT_UNCOMPRESSED_R32 });
+            h->act = LoadTextureFromImage((Image){ zeros, d->cols, 1, 1, PIXELFORMAT_UNCOMPRESSED_R32 });
+        }
+        free(zeros);
+        h->scale = (float)HEATMAP_PANEL / longest;
+        p->heatmap_count++;
+    }
+    p->heatmap_shader = LoadShader(0, "heatmap.fs");
+    p->heatmap_loc_outer = GetShaderLocation(p->heatmap_shader, "outerProduct");
+    p->heatmap_loc_range = GetShaderLocation(p->heatmap_shader, "range");
+    p->heatmap_loc_act = GetShaderLocation(p->heatmap_shader, "texture1");
+}
+
+static float max_abs(const float *v, int n) {
+    float m = 0.0f;
+    for (int i = 0; i < n; i++) m = fmaxf(m, fabsf(v[i]));
+    return m;
+}
+
+// Weights go up as the tiles that changed by a color step. The matrices
+// share one scan budget, taken round robin from where the last frame's ran
+// out. The gradient of the shown sample is err x act for a dense layer, so
+// only those two vectors go up and the shader forms the product.
+static void update_heatmaps(void) {
+    if (p->state != PLUG_DEMO || !p->show_heatmaps || !p->live) return;
+    if (!p->heatmaps_ready) init_heatmaps();
+    const TrainSnapshot *s = p->live;
+    int dirty[HEATMAP_UPLOAD_TILES];
+    int budget = HEATMAP_SCAN_TILES, uploads = HEATMAP_UPLOAD_TILES, first = p->heatmap_next;
+    p->heatmap_tiles = 0;
+    for (int i = 0; i < p->heatmap_count; i++) {
+        int k = (first + i) % p->heatmap_count;
+        Heatmap *h = &p->heatmaps[k];
+        HeatmapTiles *t = &h->tiles;
+        const float *w = s->weights + p->nn.layers[h->layer].weight_offset;
+
+        // Nothing moved since a whole sweep came up clean
+        if (s->weights_step != h->step) h->clean_tiles = 0;
+        h->step = s->weights_step;
+        if (budget > 0 && uploads > 0 && h->clean_tiles < heatmap_tile_count(t)) {
+            float range = t->max_abs > 0.0f ? t->max_abs : t->sweep_max;
+            int left = budget;
+            int n = heatmap_scan(t, w, range / HEATMAP_LEVELS, &budget, dirty, uploads);
+            h->clean_tiles = n ? 0 : h->clean_tiles + left - budget;
+            uploads -= n;
+            if (budget == 0 || uploads == 0) p->heatmap_next = k;
+            for (int i = 0; i < n; i++) {
+                HeatmapRect r = heatmap_take(t, w, dirty[i], p->heatmap_staging);
+                UpdateTextureRec(h->weights, (Rectangle){ r.x, r.y, r.width, r.height }, p->heatmap_staging);
+                p->heatmap_bytes += sizeof(float) * r.width * r.height;
+            }
+            p->heatmap_tiles += n;
+        }
+
+        if (h->dense && s->step != h->grad_step) {
+            const Layer *in = &p->nn.layers[h->layer], *out = &p->nn.layers[h->layer + 1];
+            UpdateTexture(h->err, s->err + out->first);
+            UpdateTexture(h->act, s->act + in->first);
+            h->grad_range = max_abs(s->err + out->first, t->rows) * max_abs(s->act + in->first, t->cols);
+            h->grad_step = s->step;
+            p->heatmap_bytes += sizeof(float) * (t->rows + t->cols);
+        }
+    }
+}
+
+// Histograms, bar mesh and shader are made the first time they are shown
+static void init_histograms(void) {
+    p->histograms_ready = true;
+    for (int i = 0; i < p->nn.layer_count; i++) {
+        for (int k = 0; k < HIST_KIND_COUNT; k++) histogram_init(&p->histograms[i][k]);
+        const Layer *l = &p->nn.layers[i];
+        float top = -INFINITY;
+        for (int j = 0; j < l->count; j++) top = fmaxf(top, l->position[j].y);
+        p->histogram_top[i] = top;
+    }
+    p->histogram_step = -1;
+    p->histogram_layer = 1;
+    start_histogram_pool();
+    p->histogram_bars = malloc(sizeof(Matrix) * MAX_LAYERS * HIST_BINS);
+    if (!p->histogram_bars) TraceLog(LOG_ERROR, "Out of memory for the histogram bars");
+    p->histogram_bar = GenMeshCube(1.0f, 1.0f, 1.0f);
+    Shader s = LoadShader("histogram.vs", "histogram.fs");
+    s.locs[SHADER_LOC_MATRIX_MVP] = GetShaderLocation(s, "mvp");
+    s.locs[SHADER_LOC_MATRIX_MODEL] = GetShaderLocationAttrib(s, "instanceTransform");
+    p->histogram_material = LoadMaterialDefault();
+    p->histogram_material.shader = s;
+}
+
+// Each frame bins at most HIST_FRAME_VALUES values: first the activations
+// and errors of a new sample, which are small, then the weights a layer at
+// a time with what is left. A large layer's weights take several frames.
+static void update_histograms(void) {
+    if (p->state != PLUG_DEMO || !p->show_histograms || !p->live) return;
+    if (!p->histograms_ready) init_histograms();
+    double t0 = GetTime();
+    const TrainSnapshot *s = p->live;
+    size_t budget = HIST_FRAME_VALUES;
+    bool fresh = s->step != p->histogram_step;
+    for (int i = 0; i < p->nn.layer_count && budget > 0; i++) {
+        const Layer *l = &p->nn.layers[i];
+        Histogram *h = p->histograms[i];
+        if (fresh || h[HIST_ACT].cursor > 0) {
+            budget -= histogram_feed(&h[HIST_ACT], s->act + l->first, l->count, budget, p->histogram_pool);
+        }
+        if (i > 0 && (fresh || h[HIST_ERR].cursor > 0)) {
+            budget -= histogram_feed(&h[HIST_ERR], s->err + l->first, l->count, budget, p->histogram_pool);
+        }
+    }
+    p->histogram_step = s->step;
+
+    // Each layer at most once per frame, so small layers do not take turns
+    // from the large ones
+    for (int tries = 1; tries < p->nn.layer_count && budget > 0; tries++) {
+        int i = p->histogram_layer;
+        Histogram *h = &p->histograms[i][HIST_WEIGHTS];
+        const float *w = s->weights + p->nn.layers[i - 1].weight_offset;
+        budget -= histogram_feed(h, w, nn_weight_count(&p->trainer.mlp.dense[i - 1]), budget, p->histogram_pool);
+        if (h->cursor > 0) break;
+        p->histogram_layer = i + 1 < p->nn.layer_count ? i + 1 : 1;
+    }
+    p->histogram_values = HIST_FRAME_VALUES - budget;
+    p->histogram_ms = (float)((GetTime() - t0) * 1000.0);
+}
+
+// Left edge of a layer's histogram of one kind, the three side by side
+static float histogram_x(HistKind kind) {
+    float width = HIST_BINS * HIST_BAR_WIDTH;
+    return (kind - 1) * (width + HIST_GAP) - width / 2.0f;
+}
+
+// Bars grow with the square root of the count, so the tails of a peaked
+// distribution stay visible next to its mode
+static void DrawHistograms3D(void) {
+    if (!p->histogram_bars) return;
+    static const Color colors[HIST_KIND_COUNT] = { COL_ACCENT_HOVER, GREEN, GOLD };
+    for (int k = 0; k < HIST_KIND_COUNT; k++) {
+        int bars = 0;
+        for (int i = 0; i < p->nn.layer_count; i++) {
+            const Histogram *h = &p->histograms[i][k];
+            uint32_t peak = histogram_peak(h);
+            if (peak == 0) continue;
+            float x0 = histogram_x((HistKind)k), y0 = p->histogram_top[i] + HIST_GAP;
+            float z = p->nn.layers[i].position[0].z;
+            for (int b = 0; b < HIST_BINS; b++) {
+                if (h->bins[b] == 0) continue;
+                float height = sqrtf((float)h->bins[b] / peak) * HIST_BAR_HEIGHT;
+                p->histogram_bars[bars++] = MatrixMultiply(
+                    MatrixScale(HIST_BAR_WIDTH * 0.8f, height, HIST_BAR_WIDTH * 0.8f),
+                    MatrixTranslate(x0 + (b + 0.5f) * HIST_BAR_WIDTH, y0 + height / 2.0f, z));
+            }
+        }
+        if (bars == 0) continue;
+        p->histogram_material.maps[MATERIAL_MAP_DIFFUSE].color = colors[k];
+        DrawMeshInstanced(p->histogram_bar, p->histogram_material, p->histogram_bars, bars);
+    }
+}
+
+// Range under each histogram, where it is on screen
+static void DrawHistogramLabels(void) {
+    for (int i = 0; i < p->nn.layer_count; i++) {
+        for (int k = 0; k < HIST_KIND_COUNT; k++) {
+            const Histogram *h = &p->histograms[i][k];
+            if (h->passes == 0) continue;
+            Vector3 at = { histogram_x((HistKind)k), p->histogram_top[i] + HIST_GAP, p->nn.layers[i].position[0].z };
+            Vector2 sc = GetWorldToScreen(at, p->camera);
+            if (sc.x < 0 || sc.y < 0 || sc.x > GetScreenWidth() || sc.y > GetScreenHeight()) continue;
+            DrawText(TextFormat("%.3g .. %.3g", h->bins_lo, h->bins_hi), sc.x, sc.y + 4, 10, COL_TEXT_DIM);
+        }
+    }
+    DrawText(TextFormat("HISTOGRAMS [B]  activations  errors  weights   %.2f ms  %zu values/frame  %d threads",
+                        p->histogram_ms, p->histogram_values, pool_size(p->histogram_pool)),
+             140, 25, 20, COL_TEXT_DIM);
+}
+
+// Every neuron as an octahedron around its position: the position is the
+// center, the normal the corner direction, scaled in batch.vs by the
+// neuron's activation. texcoords carry the neuron index and its layer's
+// radius scale, colors its layer's color.
+static Mesh gen_batch_mesh(void) {
+    static const Vector3 corners[6] = { { 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 } };
+    static const int faces[8][3] = { { 0, 2, 4 }, { 2, 1, 4 }, { 1, 3, 4 }, { 3, 0, 4 },
+                                     { 2, 0, 5 }, { 1, 2, 5 }, { 3, 1, 5 }, { 0, 3, 5 } };
+    Mesh mesh = { 0 };
+    mesh.vertexCount = p->nn.neuron_count * 24;
+    mesh.triangleCount = p->nn.neuron_count * 8;
+    mesh.vertices = MemAlloc(sizeof(float) * 3 * mesh.vertexCount);
+    mesh.normals = MemAlloc(sizeof(float) * 3 * mesh.vertexCount);
+    mesh.texcoords = MemAlloc(sizeof(float) * 2 * mesh.vertexCount);
+    mesh.colors = MemAlloc(4 * mesh.vertexCount);
+    int v = 0, last = p->nn.layer_count - 1;
+    for (int i = 0; i <= last; i++) {
+        const Layer *l = &p->nn.layers[i];
+        Color c = i == 0 ? COL_ACCENT : i == last ? GOLD : WHITE;
+        for (int j = 0; j < l->count; j++) {
+            for (int f = 0; f < 8; f++) {
+                for (int k = 0; k < 3; k++, v++) {
+                    Vector3 n = corners[faces[f][k]];
+                    memcpy(mesh.vertices + 3 * v, &l->position[j], sizeof(float) * 3);
+                    memcpy(mesh.normals + 3 * v, &n, sizeof(float) * 3);
+                    mesh.texcoords[2 * v] = (float)(l->first + j);
+                    mesh.texcoords[2 * v + 1] = l->scale;
+                    memcpy(mesh.colors + 4 * v, &c, 4);
+                }
+            }
+        }
+    }
+    UploadMesh(&mesh, false);
+    return mesh;
+}
+
+// Mesh, texture and replica grid are made the first time the view is shown
+static void init_batch(void) {
+    p->batch_ready = true;
+    p->batch_rows = p->trainer.view_rows;
+    if (p->batch_rows == 0) return;
+    if (p->nn.neuron_count > BATCH_MAX_NEURONS) {
+        TraceLog(LOG_ERROR, "%d neurons are too many for the batch view, at most %d",
+                 p->nn.neuron_count, BATCH_MAX_NEURONS);
+        return;
+    }
+    p->batch_tex_rows = (p->nn.neuron_count + BATCH_TEX_W - 1) / BATCH_TEX_W;
+    int height = p->batch_rows * p->batch_tex_rows;
+    p->batch_staging = calloc((size_t)BATCH_TEX_W * height, sizeof(float));
+    if (!p->batch_staging) {
+        TraceLog(LOG_ERROR, "Out of memory for the batch view");
+        return;
+    }
+    p->batch_act = LoadTextureFromImage((Image){ p->batch_staging, BATCH_TEX_W, height, 1, PIXELFORMAT_UNCOMPRESSED_R32 });
+    p->batch_step = -1;
+
+    // Cells as large as the network's bounding box, in a square grid across x and y
+    Vector3 lo = { INFINITY, INFINITY, INFINITY }, hi = { -INFINITY, -INFINITY, -INFINITY };
+    for (int j = 0; j < p->nn.neuron_count; j++) {
+        lo = Vector3Min(lo, p->nn.position[j]);
+        hi = Vector3Max(hi, p->nn.position[j]);
+    }
+    const Layer *out = &p->nn.layers[p->nn.layer_count - 1];
+    float out_y = INFINITY;
+    for (int j = 0; j < out->count; j++) out_y = fminf(out_y, out->position[j].y);
+    p->batch_label_at = (Vector3){ 0.0f, out_y - 1.5f, out->position[0].z };
+    p->batch_cols = (int)ceilf(sqrtf((float)p->batch_rows));
+    int grid_rows = (p->batch_rows + p->batch_cols - 1) / p->batch_cols;
+    float cell_x = hi.x - lo.x + BATCH_CELL_MARGIN, cell_y = hi.y - lo.y + BATCH_CELL_MARGIN;
+    for (int r = 0; r < p->batch_rows; r++) {
+        float x = (r % p->batch_cols - (p->batch_cols - 1) / 2.0f) * cell_x;
+        float y = ((grid_rows - 1) / 2.0f - r / p->batch_cols) * cell_y;
+        p->batch_offsets[r] = MatrixTranslate(x, y, 0.0f);
+    }
+
+    p->batch_mesh = gen_batch_mesh();
+    Shader s = LoadShader("batch.vs", "batch.fs");
+    s.locs[SHADER_LOC_MATRIX_MVP] = GetShaderLocation(s, "mvp");
+    s.locs[SHADER_LOC_MATRIX_MODEL] = GetShaderLocationAttrib(s, "instanceTransform");
+    int loc = GetShaderLocation(s, "rowsPerReplica");
+    SetShaderValue(s, loc, &p->batch_tex_rows, SHADER_UNIFORM_INT);
+    p->batch_material = LoadMaterialDefault();
+    p->batch_material.shader = s;
+    p->batch_material.maps[MATERIAL_MAP_DIFFUSE].texture = p->batch_act;
+}
+
+// Each new snapshot's rows go up as one texture update, hidden layers
+// normalized by their peak per sample as in the single view
+static void update_batch(void) {
+    if (p->state != PLUG_DEMO || !p->show_batch || !p->live) return;
+    if (!p->batch_ready) init_batch();
+    const TrainSnapshot *s = p->live;
+    if (p->batch_mesh.vaoId == 0 || s->view_rows == 0 || s->step == p->batch_step) return;
+    int rows = s->view_rows < p->batch_rows ? s->view_rows : p->batch_rows;
+    int last = p->nn.layer_count - 1;
+    for (int r = 0; r < rows; r++) {
+        const float *a = s->view_act + (size_t)r * p->trainer.neuron_count;
+        float *dst = p->batch_staging + (size_t)r * p->batch_tex_rows * BATCH_TEX_W;
+        for (int i = 0; i <= last; i++) {
+            const Layer *l = &p->nn.layers[i];
+            float peak = 1.0f;
+            if (i > 0 && i < last) {
+                peak = 1e-6f;
+                for (int j = 0; j < l->count; j++) peak = fmaxf(peak, a[l->first + j]);
+            }
+            for (int j = 0; j < l->count; j++) dst[l->first + j] = a[l->first + j] / peak;
+        }
+    }
+    UpdateTexture(p->batch_act, p->batch_staging);
+    p->batch_step = s->step;
+}
+
+static bool batch_available(void) {
+    return p->batch_ready && p->batch_mesh.vaoId != 0 && p->live && p->live->view_rows > 0;
+}
+
+static void DrawBatch3D(void) {
+    int rows = p->live->view_rows < p->batch_rows ? p->live->view_rows : p->batch_rows;
+    DrawMeshInstanced(p->batch_mesh, p->batch_material, p->batch_offsets, rows);
+    DrawPulseGrid(20, 1.0f, spectrum_band(&p->spectrum, 0) * 0.5f + p->spectrum.level * 0.5f, NULL);
+}
+
+// Label and prediction under every replica
+static void DrawBatchLabels(void) {
+    const TrainSnapshot *s = p->live;
+    int rows = s->view_rows < p->batch_rows ? s->view_rows : p->batch_rows;
+    int right = 0;
+    for (int r = 0; r < rows; r++) {
+        bool ok = s->view_labels[r] == s->view_predicted[r];
+        right += ok;
+        Vector3 at = Vector3Transform(p->batch_label_at, p->batch_offsets[r]);
+        Vector2 sc = GetWorldToScreen(at, p->camera);
+        if (sc.x < 0 || sc.y < 0 || sc.x > GetScreenWidth() || sc.y > GetScreenHeight()) continue;
+        DrawText(TextFormat("%d > %d", s->view_labels[r], s->view_predicted[r]), sc.x - 15, sc.y, 20, ok ? GREEN : RED);
+    }
+    DrawText(TextFormat("BATCH VIEW [V]  %d samples of step %lld, %d right   1 draw call  %d vertices per replica",
+                        rows, s->step, right, p->batch_mesh.vertexCount),
+             140, 25, 20, COL_TEXT_DIM);
+}
+
+// --- Picking ---
+
+// Radius a neuron is drawn with. Feature map pixels are picked as spheres
+// filling their pixel.
+static float neuron_radius(const Layer *l, int j) {
+    if (l->map.pixels) return l->map.spacing * 0.5f;
+    return (0.2f + l->activation[j] * 0.3f) * l->scale;
+}
+
+// Largest neuron_radius of the layer, at full activation
+static float neuron_max_radius(const Layer *l) {
+    if (l->map.pixels) return l->map.spacing * 0.5f;
+    return (0.2f + 0.3f) * l->scale;
+}
+
+static BvhBox sphere_box(Vector3 c, float r) {
+    return (BvhBox){ { c.x - r, c.y - r, c.z - r }, { c.x + r, c.y + r, c.z + r } };
+}
+
+// Whether DrawNN3D draws edge e of the pair from layer i this frame; the
+// ones it skips cannot be picked
+static bool synapse_drawn(int i, int j, int e) {
+    const Layer *l1 = &p->nn.layers[i], *l2 = &p->nn.layers[i+1];
+    bool propagating = p->train_state == STATE_PROPAGATE;
+    if (l1->activation[j] < 0.1f && !propagating) return false;
+    int layers = p->nn.layer_count;
+    float layer_start_t = (float)i / (layers-1), layer_end_t = (float)(i+1) / (layers-1);
+    if (propagating && p->signal_progress >= layer_start_t && p->signal_progress <= layer_end_t) return true;
+    const SynapseCsr *syn = &l1->synapses;
+    int k = syn->dst[e];
+    if (l1->activation[j] > 0.5f && l2->activation[k] > 0.5f) return true;
+    float strength = fminf(fabsf(syn->weight[e]) * 2.0f, 1.0f);
+    return strength > 0.25f && !synapse_too_faint(l1->position[j], l2->position[k], strength);
+}
+
+static int layer_of_neuron(int n) {
+    int i = 0;
+    while (i + 1 < p->nn.layer_count && p->nn.layers[i + 1].first <= n) i++;
+    return i;
+}
+
+// Pairs without edges share their first with the next one
+static int pair_of_edge(int e) {
+    int i = 0;
+    while (i + 2 < p->nn.layer_count && p->pick_synapse_first[i + 1] <= e) i++;
+    return i;
+}
+
+static float hit_neuron(void *ctx, int n, const float origin[3], const float dir[3]) {
+    (void)ctx;
+    const Layer *l = &p->nn.layers[layer_of_neuron(n)];
+    Vector3 c = p->nn.position[n];
+    return bvh_ray_sphere(origin, dir, (float[3]){ c.x, c.y, c.z }, neuron_radius(l, n - l->first));
+}
+
+static float hit_synapse(void *ctx, int edge, const float origin[3], const float dir[3]) {
+    (void)ctx;
+    int i = pair_of_edge(edge), e = edge - p->pick_synapse_first[i], j = p->pick_synapse_src[edge];
+    if (!synapse_drawn(i, j, e)) return INFINITY;
+    const Layer *l1 = &p->nn.layers[i], *l2 = &p->nn.layers[i+1];
+    Vector3 a = l1->position[j], b = l2->position[l1->synapses.dst[e]];
+    return bvh_ray_segment(origin, dir, (float[3]){ a.x, a.y, a.z }, (float[3]){ b.x, b.y, b.z },
+                           PICK_SYNAPSE_RADIUS);
+}
+
+// Stages the boxes of the neuron tree once and those of the synapse tree
+// whenever the edge lists were rebuilt, for the builder threads. Neuron
+// boxes hold the sphere at full activation and hit_neuron tests the one
+// drawn, so animation leaves the tree as it is.
+static void update_pick_trees(void) {
+    Network *nn = &p->nn;
+    if (!p->pick_neurons_staged) {
+        BvhBox *boxes = bvh_builder_boxes(&p->pick_neurons, nn->neuron_count);
+        if (boxes) {
+            for (int i = 0; i < nn->layer_count; i++) {
+                const Layer *l = &nn->layers[i];
+                float r = neuron_max_radius(l);
+                for (int j = 0; j < l->count; j++) boxes[l->first + j] = sphere_box(l->position[j], r);
+            }
+            bvh_builder_submit(&p->pick_neurons, 0);
+            p->pick_neurons_staged = true;
+        }
+    }
+
+    if (p->pick_synapse_builds == p->synapse_builds) return;
+    int count = 0;
+    for (int i = 0; i < nn->layer_count - 1; i++) count += nn->layers[i].synapses.nnz;
+    if (count > p->pick_synapse_capacity) {
+        int *src = realloc(p->pick_synapse_src, sizeof(int) * count);
+        if (!src) {
+            TraceLog(LOG_ERROR, "Out of memory for picking synapses");
+            p->pick_synapse_builds = p->synapse_builds;
+            return;
+        }
+        p->pick_synapse_src = src;
+        p->pick_synapse_capacity = count;
+    }
+    // NULL while the last edges are still being built, then next frame
+    BvhBox *boxes = bvh_builder_boxes(&p->pick_synapses, count);
+    if (!boxes) return;
+    int at = 0;
+    float r = PICK_SYNAPSE_RADIUS;
+    for (int i = 0; i < nn->layer_count - 1; i++) {
+        const Layer *l1 = &nn->layers[i], *l2 = &nn->layers[i+1];
+        const SynapseCsr *syn = &l1->synapses;
+        p->pick_synapse_first[i] = at;
+        for (int j = 0; j < syn->in; j++) {
+            for (int e = syn->row_start[j]; e < syn->row_start[j+1]; e++, at++) {
+                Vector3 a = l1->position[j], b = l2->position[syn->dst[e]];
+                boxes[at] = (BvhBox){
+                    { fminf(a.x, b.x) - r, fminf(a.y, b.y) - r, fminf(a.z, b.z) - r },
+                    { fmaxf(a.x, b.x) + r, fmaxf(a.y, b.y) + r, fmaxf(a.z, b.z) + r },
+                };
+                p->pick_synapse_src[at] = j;
+            }
+        }
+    }
+    p->pick_synapse_count = at;
+    bvh_builder_submit(&p->pick_synapses, p->synapse_builds);
+    p->pick_synapse_builds = p->synapse_builds;
+}
+
+// A left click in the scene selects the nearest neuron or drawn synapse
+// under the cursor, or clears the selection when there is none
+static void update_pick(void) {
+    if (!IsMouseButtonPressed(MOUSE_BUTTON_LEFT) || p->show_batch) return;
+    Vector2 mouse = GetMousePosition();
+    if (CheckCollisionPointRec(mouse, back_button())) return;
+    if (p->show_plots && CheckCollisionPointRec(mouse, plots_rect())) return;
+    Rectangle bar = replay_bar();
+    if (p->replaying && CheckCollisionPointRec(mouse, (Rectangle){ bar.x, bar.y - 8, bar.width, bar.height + 16 })) return;
+
+    double t0 = GetTime();
+    // Trees still being built pick nothing, and one over older edges would
+    // name the wrong ones
+    const Bvh *neurons = bvh_builder_poll(&p->pick_neurons);
+    const Bvh *synapses = bvh_builder_poll(&p->pick_synapses);
+    bool edges_current = p->pick_synapses.front_tag == p->synapse_builds;
+    Ray ray = GetScreenToWorldRay(mouse, p->camera);
+    float origin[3] = { ray.position.x, ray.position.y, ray.position.z };
+    float dir[3] = { ray.direction.x, ray.direction.y, ray.direction.z };
+    float tn = INFINITY, ts = INFINITY;
+    // A synapse only wins when it is nearer than the neuron hit
+    int n = bvh_pick(neurons, origin, dir, INFINITY, hit_neuron, NULL, &tn);
+    int s = edges_current ? bvh_pick(synapses, origin, dir, tn, hit_synapse, NULL, &ts) : -1;
+    p->pick_us = (float)((GetTime() - t0) * 1e6);
+    if (s >= 0) {
+        int i = pair_of_edge(s);
+        p->pick_kind = PICK_SYNAPSE;
+        p->pick_layer = i;
+        p->pick_index = p->pick_synapse_src[s];
+        p->pick_target = p->nn.layers[i].synapses.dst[s - p->pick_synapse_first[i]];
+    } else if (n >= 0) {
+        p->pick_kind = PICK_NEURON;
+        p->pick_layer = layer_of_neuron(n);
+        p->pick_index = n - p->nn.layers[p->pick_layer].first;
+    } else {
+        p->pick_kind = PICK_NONE;
+    }
+}
+
+static void DrawPick3D(void) {
+    const Layer *l = &p->nn.layers[p->pick_layer];
+    if (p->pick_kind == PICK_NEURON) {
+        float r = neuron_radius(l, p->pick_index) * 1.3f + 0.05f;
+        DrawSphereWires(l->position[p->pick_index], r, 6, 8, GOLD);
+    } else if (p->pick_kind == PICK_SYNAPSE) {
+        Vector3 a = l->position[p->pick_index], b = p->nn.layers[p->pick_layer + 1].position[p->pick_target];
+        DrawCylinderEx(a, b, 0.04f, 0.04f, 6, Fade(GOLD, 0.8f));
+    }
+}
+
+typedef struct {
+    int count, live;
+    float mean, mean_abs, min, max;
+} WeightStats;
+
+// count weights `stride` apart from w; pruned ones are zero and not live
+static WeightStats weight_stats(const float *w, int count, int stride) {
+    WeightStats s = { count, 0, 0.0f, 0.0f, INFINITY, -INFINITY };
+    double sum = 0.0, sum_abs = 0.0;
+    for (int i = 0; i < count; i++) {
+        float v = w[(size_t)i * stride];
+        s.live += v != 0.0f;
+        sum += v;
+        sum_abs += fabsf(v);
+        s.min = v < s.min ? v : s.min;
+        s.max = v > s.max ? v : s.max;
+    }
+    if (count > 0) {
+        s.mean = (float)(sum / count);
+        s.mean_abs = (float)(sum_abs / count);
+    }
+    return s;
+}
+
+static void format_stats(char *out, size_t size, const char *label, WeightStats s) {
+    snprintf(out, size, "%s %d weights, %d live  mean %+.4f  |w| %.4f  min %+.4f  max %+.4f",
+             label, s.count, s.live, s.mean, s.mean_abs, s.min, s.max);
+}
+
+// Values of the selection for the shown sample and the live weights, in a
+// panel next to it
+static void DrawInspectPanel(void) {
+    char lines[6][128];
+    int count = 0;
+    int i = p->pick_layer, j = p->pick_index;
+    const Layer *l = &p->nn.layers[i];
+    const float *act = p->vis_valid ? p->vis.act : NULL;
+    const float *err = p->vis_valid ? p->vis.err : NULL;
+    const float *weights = p->live ? p->live->weights : NULL;
+    Vector3 at;
+    if (p->pick_kind == PICK_NEURON) {
+        at = l->position[j];
+        if (l->map.pixels) {
+            NnShape s = l->shape;
+            snprintf(lines[count++], sizeof(lines[0]), "LAYER %d  NEURON %d  (channel %d at %d,%d)",
+                     i, j, j % s.c, (j / s.c) % s.w, j / s.c / s.w);
+        } else {
+            snprintf(lines[count++], sizeof(lines[0]), "LAYER %d  NEURON %d", i, j);
+        }
+        if (act) {
+            snprintf(lines[count++], sizeof(lines[0]), "ACTIVATION %.4f  ERROR %+.5f",
+                     act[l->first + j], err[l->first + j]);
+        }
+        if (i > 0) {
+            const NnDense *d = &p->trainer.mlp.dense[i - 1];
+            int row = d->kind == NN_DENSE ? j : j % l->shape.c;
+            if (d->rows == 0) {
+                snprintf(lines[count++], sizeof(lines[0]), "BIAS none, pooling");
+            } else if (p->live) {
+                snprintf(lines[count++], sizeof(lines[0]), "BIAS %+.5f", p->live->biases[l->bias_offset + row]);
+            }
+            // A convolution's kernel is shared by every neuron of its channel
+            if (weights && d->rows > 0) {
+                const float *w = weights + p->nn.layers[i - 1].weight_offset;
+                format_stats(lines[count++], sizeof(lines[0]), d->kind == NN_DENSE ? "IN " : "KERNEL",
+                             weight_stats(w + (size_t)row * d->cols, d->cols, 1));
+            }
+        }
+        if (i < p->nn.layer_count - 1 && weights) {
+            const NnDense *d = &p->trainer.mlp.dense[i];
+            const float *w = weights + l->weight_offset;
+            // Column j of a dense matrix; every kernel entry reading channel j % c
+            if (d->kind == NN_DENSE) {
+                format_stats(lines[count++], sizeof(lines[0]), "OUT", weight_stats(w + j, d->rows, d->cols));
+            } else if (d->rows > 0) {
+                int c = d->src.c;
+                format_stats(lines[count++], sizeof(lines[0]), "OUT", weight_stats(w + j % c, d->rows * d->cols / c, c));
+            }
+        }
+    } else {
+        const Layer *l2 = &p->nn.layers[i + 1];
+        int k = p->pick_target;
+        at = Vector3Lerp(l->position[j], l2->position[k], 0.5f);
+        snprintf(lines[count++], sizeof(lines[0]), "SYNAPSE  LAYER %d NEURON %d -> LAYER %d NEURON %d", i, j, i + 1, k);
+        float w = weights ? weights[l->weight_offset + (size_t)k * l->count + j] : 0.0f;
+        snprintf(lines[count++], sizeof(lines[0]), "WEIGHT %+.5f%s", w, weights && w == 0.0f ? "  (pruned)" : "");
+        if (act) {
+            float a = act[l->first + j], e = err[l2->first + k];
+            snprintf(lines[count++], sizeof(lines[0]), "SOURCE ACTIVATION %.4f  TARGET ERROR %+.5f", a, e);
+            snprintf(lines[count++], sizeof(lines[0]), "GRADIENT %+.6f (this sample)", a * e);
+        }
+    }
+    snprintf(lines[count++], sizeof(lines[0]), "picked in %.1f us, %d neurons  %d synapses",
+             p->pick_us, p->nn.neuron_count, p->pick_synapse_count);
+
+    int width = 0;
+    for (int n = 0; n < count; n++) {
+        int w = MeasureText(lines[n], 10);
+        width = w > width ? w : width;
+    }
+    int pw = width + 16, ph = count * 14 + 10;
+    Vector2 sc = GetWorldToScreen(at, p->camera);
+    int px = (int)sc.x + 20, py = (int)sc.y + 20;
+    if (px + pw > GetScreenWidth()) px = (int)sc.x - 20 - pw;
+    if (py + ph > GetScreenHeight()) py = GetScreenHeight() - ph;
+    px = px > 0 ? px : 0;
+    py = py > 0 ? py : 0;
+    DrawRectangle(px, py, pw, ph, Fade(BLACK, 0.75f));
+    DrawRectangleLinesEx((Rectangle){ px, py, pw, ph }, 1.0f, Fade(GOLD, 0.8f));
+    for (int n = 0; n < count; n++) {
+        DrawText(lines[n], px + 8, py + 6 + n * 14, 10, n == 0 ? GOLD : n == count - 1 ? COL_TEXT_DIM : COL_TEXT_MAIN);
+    }
+}
+
+static void DrawHeatmap(Texture2D texture, Rectangle source, Rectangle dest, float range, bool outer, Texture2D act) {
+    int mode = outer;
+    BeginShaderMode(p->heatmap_shader);
+    SetShaderValue(p->heatmap_shader, p->heatmap_loc_outer, &mode, SHADER_UNIFORM_INT);
+    SetShaderValue(p->heatmap_shader, p->heatmap_loc_range, &range, SHADER_UNIFORM_FLOAT);
+    if (outer) SetShaderValueTexture(p->heatmap_shader, p->heatmap_loc_act, act);
+    DrawTexturePro(texture, source, dest, (Vector2){ 0.0f, 0.0f }, 0.0f, WHITE);
+    EndShaderMode();
+    DrawRectangleLinesEx(dest, 1.0f, Fade(COL_TEXT_DIM, 0.5f));
+}
+
+// Per weight layer, the weights and the gradient of the shown sample, rows
+// are output neurons
+static void DrawHeatmaps(int y) {
+    size_t bytes = 0;
+    for (int k = 0; k < p->heatmap_count; k++) bytes += sizeof(float) * p->heatmaps[k].tiles.rows * p->heatmaps[k].tiles.cols;
+    DrawText(TextFormat("HEATMAPS  [H] hide   %d tiles this frame  %.1f MB/s uploaded of %.1f MB",
+                        p->heatmap_tiles, p->heatmap_bytes_per_sec / 1048576.0f, bytes / 1048576.0),
+             20, y, 10, COL_TEXT_DIM);
+    y += 16;
+    for (int k = 0; k < p->heatmap_count && y < GetScreenHeight() - 260; k++) {
+        const Heatmap *h = &p->heatmaps[k];
+        const HeatmapTiles *t = &h->tiles;
+        float w = fmaxf(12.0f, t->cols * h->scale), hh = fmaxf(12.0f, t->rows * h->scale);
+        DrawText(TextFormat("W%d  %dx%d  |w| %.3f", h->layer + 1, t->rows, t->cols, t->max_abs),
+                 20, y, 10, COL_TEXT_MAIN);
+        y += 14;
+        Rectangle weights = { 20, y, w, hh };
+        DrawHeatmap(h->weights, (Rectangle){ 0, 0, t->cols, t->rows }, weights, t->max_abs, false, h->act);
+        Rectangle grad = { 30 + w, y, w, hh };
+        if (h->dense) {
+            DrawHeatmap(h->err, (Rectangle){ 0, 0, t->rows, 1 }, grad, h->grad_range, true, h->act);
+        } else {
+            DrawText("gradient: dense only", grad.x, grad.y, 10, COL_TEXT_DIM);
+        }
+        y += hh + 8;
+    }
 }
 
 PLUG_EXPORT void plug_update(void) {
@@ -325,7 +2406,69 @@ PLUG_EXPORT void plug_update(void) {
     p->time += dt;
     p->tr_timer += dt;
     p->freq = Lerp(p->freq, p->target_freq, dt * 5.0f);
+    spectrum_update(&p->spectrum, dt);
     
+    p->live = p->replaying ? update_replay(dt) : p->use_shm ? update_shm() : trainer_snapshot(&p->trainer);
+    if (p->recording && p->live && p->live->step != p->recorded_step) {
+        record_append(&p->recorder, p->live, GetTime() - p->record_start);
+        p->recorded_step = p->live->step;
+    }
+    drain_ingest();
+    update_plots();
+    update_heatmaps();
+    update_histograms();
+    update_batch();
+    update_synapses();
+    update_pick_trees();
+    p->frame_ms = dt * 1000.0f;
+    p->steps_timer += dt;
+    if (p->steps_timer >= 0.5f) {
+        long long steps = trainer_steps(&p->trainer);
+        p->steps_per_sec = (steps - p->steps_mark) / p->steps_timer;
+        p->steps_mark = steps;
+        long long samples = trainer_samples(&p->trainer);
+        p->samples_per_sec = (samples - p->samples_mark) / p->steps_timer;
+        p->samples_mark = samples;
+        p->map_uploads_per_sec = (p->map_uploads - p->map_uploads_mark) / p->steps_timer;
+        p->map_uploads_mark = p->map_uploads;
+        p->shm_records_per_sec = (p->shm_records - p->shm_records_mark) / p->steps_timer;
+        p->shm_records_mark = p->shm_records;
+        long long ingested = atomic_load(&p->ingest.samples);
+        p->ingest_per_sec = (ingested - p->ingest_mark) / p->steps_timer;
+        p->ingest_mark = ingested;
+        p->heatmap_bytes_per_sec = (p->heatmap_bytes - p->heatmap_bytes_mark) / p->steps_timer;
+        p->heatmap_bytes_mark = p->heatmap_bytes;
+        p->steps_timer = 0.0f;
+    }
+
+    // The worker picks the mode up at its next step
+    if (p->state == PLUG_DEMO && IsKeyPressed(KEY_M)) {
+        p->run_mode = (TrainerMode)((p->run_mode + 1) % TRAINER_MODE_COUNT);
+    }
+    if (p->state == PLUG_DEMO && IsKeyPressed(KEY_G)) p->show_graph = !p->show_graph;
+    if (p->state == PLUG_DEMO && IsKeyPressed(KEY_P)) p->show_plots = !p->show_plots;
+    if (p->state == PLUG_DEMO && IsKeyPressed(KEY_H)) p->show_heatmaps = !p->show_heatmaps;
+    if (p->state == PLUG_DEMO && IsKeyPressed(KEY_B)) p->show_histograms = !p->show_histograms;
+    if (p->state == PLUG_DEMO && IsKeyPressed(KEY_C)) p->culling = !p->culling;
+    if (p->state == PLUG_DEMO && IsKeyPressed(KEY_V)) {
+        // Back far enough to see the whole grid, and home again
+        p->show_batch = !p->show_batch;
+        float zoom = p->show_batch ? ceilf(sqrtf((float)p->trainer.view_rows)) : 1.0f;
+        p->camera.position = Vector3Scale(p->nn.home, fmaxf(zoom, 1.0f));
+    }
+    if (p->state == PLUG_DEMO && (IsKeyPressed(KEY_LEFT_BRACKET) || IsKeyPressed(KEY_RIGHT_BRACKET))) {
+        int i = time_scale_index(p->time_scale);
+        if (IsKeyPressed(KEY_RIGHT_BRACKET)) {
+            // From an unlisted scale, ] goes to the listed one above it
+            if (TIME_SCALES[i] == p->time_scale && i < TIME_SCALE_COUNT - 1) i++;
+        } else if (i > 0) {
+            i--;
+        }
+        set_time_scale(TIME_SCALES[i]);
+    }
+    TrainerMode mode = p->state == PLUG_MENU ? p->menu_run_mode : p->run_mode;
+    if (trainer_mode(&p->trainer) != mode) trainer_set_mode(&p->trainer, mode);
+
     // Background Animation (always run a bit of NN update for visual flair in menu)
     if (p->state == PLUG_MENU) {
         UpdateCamera(&p->camera, CAMERA_ORBITAL); // Gentle auto-rotation allowed in menu? Or just static?
@@ -337,16 +2480,29 @@ PLUG_EXPORT void plug_update(void) {
         UpdateNN(dt); 
         p->target_freq = 0.0f; // Silence in menu
     } else {
-        UpdateCamera(&p->camera, CAMERA_THIRD_PERSON); // User control in demo
+        // The wheel and drags over the plots belong to the plots
+        if (!p->show_plots || !CheckCollisionPointRec(GetMousePosition(), plots_rect())) {
+            UpdateCamera(&p->camera, CAMERA_THIRD_PERSON); // User control in demo
+        }
         UpdateNN(dt);
+        update_pick();
     }
+    update_feature_maps();
+    update_graph();
 
     BeginDrawing();
     ClearBackground(COL_BG);
     
     // 1. Draw 3D Background/Network
+    bool batch = p->state == PLUG_DEMO && p->show_batch && batch_available();
     BeginMode3D(p->camera);
-        DrawNN3D();
+        if (batch) {
+            DrawBatch3D();
+        } else {
+            DrawNN3D();
+            if (p->state == PLUG_DEMO && p->pick_kind != PICK_NONE) DrawPick3D();
+            if (p->state == PLUG_DEMO && p->show_histograms && p->histograms_ready) DrawHistograms3D();
+        }
     EndMode3D();
     
     // 2. Draw UI Overlay
@@ -397,12 +2553,12 @@ PLUG_EXPORT void plug_update(void) {
         if (hover && IsMouseButtonPressed(MOUSE_BUTTON_LEFT)) {
             p->state = PLUG_DEMO;
             // Reset Camera for demo
-            p->camera.position = (Vector3){ 20.0f, 15.0f, 20.0f };
+            p->camera.position = p->nn.home;
         }
         
     } else if (p->state == PLUG_DEMO) {
         // Simple Back Button
-        Rectangle backRect = { 20, 20, 100, 30 };
+        Rectangle backRect = back_button();
         Vector2 mouse = GetMousePosition();
         bool hover = CheckCollisionPointRec(mouse, backRect);
         
@@ -419,6 +2575,77 @@ PLUG_EXPORT void plug_update(void) {
         
         // Status HUD
         DrawText("3D TRAINING SIMULATION", 20, GetScreenHeight() - 40, 20, COL_TEXT_DIM);
+        DrawText(TextFormat("DIGIT %d  PREDICTED %d  SAMPLE LOSS %.3f", p->current_digit, p->predicted_digit, p->sample_loss),
+                 20, GetScreenHeight() - 90, 20, COL_TEXT_MAIN);
+        if (p->live) {
+            DrawText(TextFormat("AVG LOSS %.3f  ACCURACY %.0f%%  STEPS %lld  WEIGHTS %lld/%d",
+                                p->live->loss_avg, p->live->accuracy_avg * 100.0f, p->live->step,
+                                p->live->live_weights, p->trainer.weight_count),
+                     20, GetScreenHeight() - 65, 20, COL_TEXT_DIM);
+        }
+        DrawText(TextFormat("TRAIN %.0f samples/s  %.0f steps/s  x%d threads   FRAME %.2f ms  MAP UPLOADS %.0f/s",
+                            p->samples_per_sec, p->steps_per_sec, p->trainer.task_count, p->frame_ms,
+                            p->map_uploads_per_sec),
+                 20, GetScreenHeight() - 115, 20, COL_TEXT_DIM);
+        float steps_per_cycle = p->steps_per_sec * ANIM_CYCLE_SECONDS;
+        DrawText(TextFormat("TIME %s  [ ] change   %.1f steps/frame  %.0f steps per animated sample",
+                            p->time_scale > 0.0f ? TextFormat("x%g", p->time_scale) : "MAX",
+                            p->steps_per_sec * p->frame_ms * 1e-3f, steps_per_cycle),
+                 20, 60, 20, COL_TEXT_DIM);
+        TrainerMode shown = trainer_mode(&p->trainer);
+        Optimizer *opt = &p->trainer.optim;
+        DrawText(TextFormat("MODE %s (%s kernels)  [M] switch   OPTIM %s %.2f ms  %.1f GB/s   BACKWARD %s  [G] graph",
+                            trainer_mode_name(shown),
+                            shown == TRAINER_INFER_INT8 ? int8_kernels->name : kernels->name,
+                            optim_name(opt->params.kind), atomic_load(&opt->update_ns) * 1e-6,
+                            optim_bytes_per_second(opt) * 1e-9, p->trainer.tapes ? "autodiff" : "hand-written"),
+                 20, GetScreenHeight() - 140, 20, COL_TEXT_DIM);
+        if (p->use_checkpoint) {
+            Checkpointer *ck = &p->checkpoint;
+            DrawText(TextFormat("CHECKPOINT %lld saved  %lld skipped  copy %.2f ms (training)  write %.0f ms (%s)",
+                                atomic_load(&ck->saved), atomic_load(&ck->skipped),
+                                atomic_load(&ck->copy_ns) * 1e-6, atomic_load(&ck->write_ns) * 1e-6, ck->backend),
+                     20, GetScreenHeight() - 165, 20, COL_TEXT_DIM);
+        }
+        if (p->replaying) DrawReplayBar();
+        if (!batch) {
+            const CullStats *cs = &p->cull;
+            DrawText(TextFormat("DRAWN %d neurons (%d off-screen, %d coarser)  %d synapses (%d off-screen, %d faint far)  "
+                                "%d/%d maps  %d/%d grid lines   CULL %s [C]",
+                                cs->neurons, cs->neurons_off, cs->neurons_coarse, cs->synapses, cs->synapses_off,
+                                cs->synapses_faint, cs->maps, cs->maps + cs->maps_off, cs->grid_lines,
+                                cs->grid_lines + cs->grid_off, p->culling ? "on" : "off"),
+                     20, 85, 20, COL_TEXT_DIM);
+        }
+        int panel_y = p->use_ingest ? DrawMetrics(110) + 10 : 115;
+        if (p->show_heatmaps && p->heatmaps_ready) DrawHeatmaps(panel_y);
+        if (p->show_plots) DrawPlots();
+        if (batch) {
+            DrawBatchLabels();
+        } else if (p->show_batch) {
+            DrawText(TextFormat("BATCH VIEW [V]  needs the trainer's snapshots, batch_view > 0 and at most %d neurons",
+                                BATCH_MAX_NEURONS),
+                     140, 25, 20, COL_TEXT_DIM);
+        } else if (p->show_histograms && p->histograms_ready) {
+            DrawHistogramLabels();
+        }
+        if (p->use_shm) {
+            DrawText(TextFormat("SHM %s  %lld records  %.0f/s  %llu dropped by the producer (ring full)",
+                                p->config.shm_source, p->shm_records, p->shm_records_per_sec,
+                                (unsigned long long)atomic_load(&p->shm.header->dropped)),
+                     20, GetScreenHeight() - 215, 20, COL_TEXT_DIM);
+        }
+        if (p->recording) {
+            Recorder *rec = &p->recorder;
+            long long raw = atomic_load(&rec->raw_bytes), file = atomic_load(&rec->file_bytes);
+            DrawText(TextFormat("RECORDING %lld frames  %.1f MB  packed %.1fx  %lld dropped  pack %.2f ms (I/O thread)",
+                                atomic_load(&rec->frames_written), file / 1048576.0,
+                                file > 0 ? (double)raw / file : 0.0, atomic_load(&rec->dropped),
+                                atomic_load(&rec->pack_ns) * 1e-6),
+                     20, GetScreenHeight() - 190, 20, COL_TEXT_DIM);
+        }
+        if (!batch && p->pick_kind != PICK_NONE) DrawInspectPanel();
+        if (p->graph_loss) DrawGraphPanel();
     }
     
     EndDrawing();
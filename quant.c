@@ -0,0 +1,151 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "kernels.h"
+#include "quant.h"
+
+static int round_up_block(int n) {
+    return (n + KERNELS_INT8_BLOCK - 1) / KERNELS_INT8_BLOCK * KERNELS_INT8_BLOCK;
+}
+
+bool quant_init(QuantMlp *q, const Mlp *nn) {
+    memset(q, 0, sizeof(*q));
+    if (!nn_is_dense(nn)) {
+        fprintf(stderr, "ERROR: int8 inference supports fully connected networks only\n");
+        return false;
+    }
+    int L = nn->layer_count;
+    q->layer_count = L;
+    q->sizes = malloc(sizeof(int) * L);
+    q->dense = calloc(L - 1, sizeof(QuantDense));
+    if (!q->sizes || !q->dense) {
+        quant_free(q);
+        return false;
+    }
+    memcpy(q->sizes, nn->sizes, sizeof(int) * L);
+
+    for (int l = 0; l < L - 1; l++) {
+        QuantDense *d = &q->dense[l];
+        d->in = nn->dense[l].in;
+        d->out = nn->dense[l].out;
+        if (d->in > QUANT_MAX_INPUTS) {
+            fprintf(stderr, "ERROR: layer %d has %d inputs, int8 inference supports up to %d\n",
+                    l, d->in, QUANT_MAX_INPUTS);
+            quant_free(q);
+            return false;
+        }
+        d->stride = round_up_block(d->in);
+        d->w = kernels_alloc((size_t)d->out * d->stride);
+        d->scale = malloc(sizeof(float) * d->out);
+        d->b = malloc(sizeof(float) * d->out);
+        if (!d->w || !d->scale || !d->b) {
+            quant_free(q);
+            return false;
+        }
+        q->weight_bytes += (size_t)d->out * d->stride + sizeof(float) * d->out;
+    }
+    quant_update(q, nn);
+    return true;
+}
+
+void quant_update(QuantMlp *q, const Mlp *nn) {
+    for (int l = 0; l < q->layer_count - 1; l++) {
+        QuantDense *d = &q->dense[l];
+        const NnDense *src = &nn->dense[l];
+        for (int o = 0; o < d->out; o++) {
+            const float *w = src->w + (size_t)o * d->in;
+            float max = 0.0f;
+            for (int i = 0; i < d->in; i++) max = fmaxf(max, fabsf(w[i]));
+            float scale = max > 0.0f ? max / 127.0f : 1.0f;
+            float inv = 1.0f / scale;
+            int8_t *qw = d->w + (size_t)o * d->stride;
+            for (int i = 0; i < d->in; i++) {
+                long v = lrintf(w[i] * inv);
+                qw[i] = (int8_t)(v > 127 ? 127 : v < -127 ? -127 : v);
+            }
+            d->scale[o] = scale;
+        }
+        memcpy(d->b, src->b, sizeof(float) * d->out);
+    }
+}
+
+void quant_free(QuantMlp *q) {
+    for (int l = 0; q->dense && l < q->layer_count - 1; l++) {
+        kernels_free(q->dense[l].w);
+        free(q->dense[l].scale);
+        free(q->dense[l].b);
+    }
+    free(q->dense);
+    free(q->sizes);
+    memset(q, 0, sizeof(*q));
+}
+
+bool quant_scratch_init(QuantScratch *s, const QuantMlp *q, int capacity) {
+    memset(s, 0, sizeof(*s));
+    int max_stride = 0, max_out = 0;
+    for (int l = 0; l < q->layer_count - 1; l++) {
+        if (q->dense[l].stride > max_stride) max_stride = q->dense[l].stride;
+        if (q->dense[l].out > max_out) max_out = q->dense[l].out;
+    }
+    s->capacity = capacity;
+    s->xq = kernels_alloc((size_t)capacity * max_stride);
+    s->xscale = malloc(sizeof(float) * capacity);
+    s->acc = kernels_alloc(sizeof(int32_t) * (size_t)capacity * max_out);
+    if (!s->xq || !s->xscale || !s->acc) {
+        quant_scratch_free(s);
+        return false;
+    }
+    return true;
+}
+
+void quant_scratch_free(QuantScratch *s) {
+    kernels_free(s->xq);
+    free(s->xscale);
+    kernels_free(s->acc);
+    memset(s, 0, sizeof(*s));
+}
+
+// One row of non-negative floats to u8 over [0, max]. The padding after
+// `n` is rewritten every time because rows of different layers overlap.
+// Written with plain compares rather than fmaxf so the compiler vectorizes
+// both loops.
+static float quantize_row(const float *restrict x, uint8_t *restrict q, int n, int stride) {
+    float max = 0.0f;
+    for (int i = 0; i < n; i++) max = x[i] > max ? x[i] : max;
+    float scale = max > 0.0f ? max / 255.0f : 1.0f;
+    float inv = 1.0f / scale;
+    for (int i = 0; i < n; i++) {
+        float v = x[i] * inv + 0.5f;
+        v = v > 0.0f ? v : 0.0f;
+        q[i] = (uint8_t)(int32_t)(v < 255.0f ? v : 255.0f);
+    }
+    memset(q + n, 0, stride - n);
+    return scale;
+}
+
+void quant_forward_batch(const QuantMlp *q, QuantScratch *s, NnWorkspace *ws) {
+    int last = q->layer_count - 1;
+    for (int l = 1; l <= last; l++) {
+        const QuantDense *d = &q->dense[l - 1];
+        const float *x = ws->act[l - 1];
+        for (int r = 0; r < ws->rows; r++) {
+            s->xscale[r] = quantize_row(x + (size_t)r * d->in, s->xq + (size_t)r * d->stride, d->in, d->stride);
+        }
+        int8_kernels->dense_forward(s->xq, d->w, s->acc, ws->rows, d->stride, d->out);
+
+        for (int r = 0; r < ws->rows; r++) {
+            const int32_t *restrict acc = s->acc + (size_t)r * d->out;
+            float *restrict a = ws->act[l] + (size_t)r * d->out;
+            const float *restrict scale = d->scale, *restrict bias = d->b;
+            float xs = s->xscale[r];
+            for (int o = 0; o < d->out; o++) a[o] = (float)acc[o] * xs * scale[o] + bias[o];
+            if (l == last) {
+                nn_softmax(a, d->out);
+            } else {
+                for (int o = 0; o < d->out; o++) a[o] = a[o] > 0.0f ? a[o] : 0.0f;
+            }
+        }
+    }
+}
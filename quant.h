@@ -0,0 +1,58 @@
+#ifndef QUANT_H_
+#define QUANT_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "nn.h"
+
+// Widest layer input the int32 sums cannot overflow on (255 * 127 * in)
+#define QUANT_MAX_INPUTS 65536
+
+// Post-training int8 copy of a network, for inference only.
+//
+// Weights are symmetric per output channel: w ~= q * scale[o] with q in
+// [-127, 127]. Activations are quantized per sample as they flow through,
+// to unsigned 8 bits over [0, max], which fits the non-negative inputs and
+// ReLU outputs exactly; this is the u8 x s8 shape VNNI multiplies. Biases,
+// dequantization and the softmax stay in float.
+typedef struct {
+    int in, out;
+    int stride;        // in rounded up to KERNELS_INT8_BLOCK
+    int8_t *w;         // [out][stride], zero padded
+    float *scale;      // per output channel
+    float *b;
+} QuantDense;
+
+typedef struct {
+    int layer_count;
+    int *sizes;
+    QuantDense *dense;
+    size_t weight_bytes;   // int8 weights plus scales
+} QuantMlp;
+
+// Per-thread buffers for quant_forward_batch
+typedef struct {
+    int capacity;
+    uint8_t *xq;       // capacity rows of the widest layer input
+    float *xscale;     // per row
+    int32_t *acc;      // capacity rows of the widest layer output
+} QuantScratch;
+
+// Quantizes `nn`, which must be fully connected. quant_update requantizes in place after the float
+// weights changed; the topology must be the same.
+bool quant_init(QuantMlp *q, const Mlp *nn);
+void quant_update(QuantMlp *q, const Mlp *nn);
+void quant_free(QuantMlp *q);
+
+bool quant_scratch_init(QuantScratch *s, const QuantMlp *q, int capacity);
+void quant_scratch_free(QuantScratch *s);
+
+// Runs ws->rows samples from ws->act[0] through the int8 network with the
+// active int8 kernels. Every ws->act layer receives the dequantized float
+// activations, the last one softmax probabilities, so the result can be
+// scored and visualized like nn_forward_batch's. Inputs must be >= 0.
+void quant_forward_batch(const QuantMlp *q, QuantScratch *s, NnWorkspace *ws);
+
+#endif // QUANT_H_
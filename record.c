@@ -0,0 +1,484 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "model.h"
+#include "record.h"
+
+_Static_assert(sizeof(RecordHeader) == 64, "record header must be 64 bytes");
+_Static_assert(sizeof(RecordFrame) % 4 == 0, "frames are packed as 32-bit words");
+
+static long long now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// ------------------------------------------------------------
+// Packing
+// ------------------------------------------------------------
+
+// A stream of 32-bit words is packed as a bitmap of the nonzero ones
+// followed by those words. ReLU zeros, dead units' errors and pruned
+// weights then cost one bit each.
+static size_t pack_words(const uint8_t *restrict src, size_t bytes, uint8_t *restrict dst) {
+    const uint32_t *w = (const uint32_t *)src;
+    size_t words = bytes / 4, mask = (words + 7) / 8, o = mask;
+    memset(dst, 0, mask);
+    for (size_t i = 0; i < words; i++) {
+        if (w[i] == 0) continue;
+        dst[i / 8] |= (uint8_t)(1u << (i % 8));
+        memcpy(dst + o, &w[i], 4);
+        o += 4;
+    }
+    return o;
+}
+
+static bool unpack_words(const uint8_t *restrict src, size_t n, uint8_t *restrict dst, size_t bytes) {
+    uint32_t *w = (uint32_t *)dst;
+    size_t words = bytes / 4, mask = (words + 7) / 8, o = mask;
+    if (n < mask) return false;
+    for (size_t i = 0; i < words; i++) {
+        if (src[i / 8] >> (i % 8) & 1) {
+            if (n - o < 4) return false;
+            memcpy(&w[i], src + o, 4);
+            o += 4;
+        } else {
+            w[i] = 0;
+        }
+    }
+    return o == n;
+}
+
+static size_t packed_bound(size_t bytes) {
+    return bytes + (bytes / 4 + 7) / 8;
+}
+
+static size_t weight_bytes(const RecordHeader *h) {
+    return sizeof(float) * ((size_t)h->weight_count + h->bias_count);
+}
+
+// ------------------------------------------------------------
+// Writer
+// ------------------------------------------------------------
+
+bool record_init(Recorder *r, const Trainer *t, const char *path) {
+    memset(r, 0, sizeof(*r));
+    const Mlp *nn = &t->mlp;
+    RecordHeader *h = &r->header;
+    memcpy(h->magic, RECORD_MAGIC, 8);
+    h->version = RECORD_VERSION;
+    h->byte_order = RECORD_BYTE_ORDER;
+    h->layer_count = (uint32_t)nn->layer_count;
+    h->chunk_frames = RECORD_CHUNK_FRAMES;
+    h->neuron_count = (uint32_t)t->neuron_count;
+    h->weight_count = (uint32_t)t->weight_count;
+    h->bias_count = (uint32_t)t->bias_count;
+
+    r->frame_bytes = sizeof(RecordFrame) + 2 * sizeof(float) * t->neuron_count;
+    r->chunk_bytes = RECORD_CHUNK_FRAMES * r->frame_bytes + weight_bytes(h);
+    for (int i = 0; i < 2; i++) r->raw[i] = malloc(r->chunk_bytes);
+    r->packed = malloc(packed_bound(r->chunk_bytes));
+    r->file = fopen(path, "wb");
+    if (!r->raw[0] || !r->raw[1] || !r->packed || !r->file) {
+        fprintf(stderr, "ERROR: could not create run log %s\n", path);
+        if (r->file) fclose(r->file);
+        free(r->raw[0]);
+        free(r->raw[1]);
+        free(r->packed);
+        memset(r, 0, sizeof(*r));
+        return false;
+    }
+    uint32_t sizes[MODEL_MAX_LAYERS];
+    for (int l = 0; l < nn->layer_count; l++) sizes[l] = (uint32_t)nn->sizes[l];
+    fwrite(h, sizeof(*h), 1, r->file);
+    fwrite(sizes, sizeof(uint32_t), nn->layer_count, r->file);
+    r->offset = sizeof(*h) + sizeof(uint32_t) * nn->layer_count;
+
+    pthread_mutex_init(&r->lock, NULL);
+    pthread_cond_init(&r->cond, NULL);
+    r->filling = -1;
+    r->pending = -1;
+    r->writing = -1;
+    r->key_slot = -1;
+    return true;
+}
+
+// Packs buffer `slot` and appends it with its index entry. The buffer is
+// XORed in place, its contents are not needed afterwards.
+static void write_chunk(Recorder *r, int slot) {
+    long long t0 = now_ns();
+    uint8_t *raw = r->raw[slot];
+    int frames = r->frames[slot];
+    size_t fb = r->frame_bytes;
+    RecordFrame first, last;
+    memcpy(&first, raw, sizeof(first));
+    memcpy(&last, raw + (size_t)(frames - 1) * fb, sizeof(last));
+
+    size_t frame_bytes = frames * fb, wbytes = r->key[slot] ? weight_bytes(&r->header) : 0;
+    size_t fp = pack_words(raw, frame_bytes, r->packed);
+    size_t wp = wbytes ? pack_words(raw + RECORD_CHUNK_FRAMES * fb, wbytes, r->packed + fp) : 0;
+
+    if (r->header.chunk_count == r->index_capacity) {
+        size_t cap = r->index_capacity ? r->index_capacity * 2 : 256;
+        RecordIndexEntry *index = realloc(r->index, sizeof(*index) * cap);
+        if (!index) {
+            r->failed = true;
+            return;
+        }
+        r->index = index;
+        r->index_capacity = cap;
+    }
+    RecordChunk c = {
+        .magic = RECORD_CHUNK_MAGIC,
+        .frames = (uint32_t)frames,
+        .first_step = first.step,
+        .last_step = last.step,
+        .frames_packed = fp,
+        .weights_packed = wp,
+        .key_offset = r->key[slot] ? r->offset : r->key_offset,
+    };
+    bool ok = fwrite(&c, sizeof(c), 1, r->file) == 1 && fwrite(r->packed, 1, fp + wp, r->file) == fp + wp;
+    // Complete chunks reach the file even if the run is never closed
+    ok = ok && fflush(r->file) == 0;
+    if (!ok) {
+        if (!r->failed) fprintf(stderr, "ERROR: could not write the run log\n");
+        r->failed = true;
+        return;
+    }
+    r->index[r->header.chunk_count++] = (RecordIndexEntry){
+        .first_step = c.first_step,
+        .last_step = c.last_step,
+        .offset = r->offset,
+        .first_frame = r->header.frame_count,
+    };
+    r->header.frame_count += frames;
+    r->key_offset = c.key_offset;
+    r->offset += sizeof(c) + fp + wp;
+
+    atomic_fetch_add_explicit(&r->frames_written, frames, memory_order_relaxed);
+    atomic_fetch_add_explicit(&r->raw_bytes, (long long)(frame_bytes + wbytes), memory_order_relaxed);
+    atomic_store_explicit(&r->file_bytes, (long long)r->offset, memory_order_relaxed);
+    atomic_store_explicit(&r->pack_ns, now_ns() - t0, memory_order_relaxed);
+}
+
+// Copies the weights of a keyframe into its buffer. Queued when the chunk
+// starts, so it is done before the chunk can be handed over.
+static void copy_keyframe(Recorder *r) {
+    int slot = r->key_slot;
+    const float *weights = r->key_weights, *biases = r->key_biases;
+    pthread_mutex_unlock(&r->lock);
+    float *w = (float *)(r->raw[slot] + RECORD_CHUNK_FRAMES * r->frame_bytes);
+    memcpy(w, weights, sizeof(float) * r->header.weight_count);
+    memcpy(w + r->header.weight_count, biases, sizeof(float) * r->header.bias_count);
+    pthread_mutex_lock(&r->lock);
+    // The renderer may have queued another keyframe meanwhile
+    if (r->key_slot == slot && r->key_weights == weights) r->key_slot = -1;
+}
+
+static void *record_main(void *arg) {
+    Recorder *r = arg;
+    pthread_mutex_lock(&r->lock);
+    for (;;) {
+        while (r->pending < 0 && r->key_slot < 0 && !r->quit) pthread_cond_wait(&r->cond, &r->lock);
+        if (r->key_slot >= 0) {
+            copy_keyframe(r);
+            continue;
+        }
+        if (r->pending < 0) break;
+        r->writing = r->pending;
+        r->pending = -1;
+        pthread_mutex_unlock(&r->lock);
+
+        if (!r->failed) write_chunk(r, r->writing);
+
+        pthread_mutex_lock(&r->lock);
+        r->writing = -1;
+    }
+    pthread_mutex_unlock(&r->lock);
+    return NULL;
+}
+
+bool record_start(Recorder *r) {
+    if (r->thread_started || !r->file) return r->thread_started;
+    r->quit = false;
+    if (pthread_create(&r->thread, NULL, record_main, r) != 0) return false;
+    r->thread_started = true;
+    return true;
+}
+
+void record_stop(Recorder *r) {
+    if (!r->thread_started) return;
+    pthread_mutex_lock(&r->lock);
+    r->quit = true;
+    pthread_cond_signal(&r->cond);
+    pthread_mutex_unlock(&r->lock);
+    pthread_join(r->thread, NULL);
+    r->thread_started = false;
+}
+
+bool record_append(Recorder *r, const TrainSnapshot *s, double time) {
+    if (!r->file) return false;
+    if (r->filling < 0) {
+        pthread_mutex_lock(&r->lock);
+        for (int i = 0; i < 2; i++) {
+            if (i != r->pending && i != r->writing) r->filling = i;
+        }
+        pthread_mutex_unlock(&r->lock);
+        if (r->filling < 0) {
+            atomic_fetch_add_explicit(&r->dropped, 1, memory_order_relaxed);
+            return false;
+        }
+        r->frames[r->filling] = 0;
+    }
+
+    int n = (int)r->header.neuron_count;
+    uint8_t *raw = r->raw[r->filling];
+    int f = r->frames[r->filling];
+    if (f == 0) {
+        r->key[r->filling] = r->key_countdown == 0;
+    }
+    if (f == 0 && r->key[r->filling]) {
+        pthread_mutex_lock(&r->lock);
+        r->key_slot = r->filling;
+        r->key_weights = s->weights;
+        r->key_biases = s->biases;
+        pthread_cond_signal(&r->cond);
+        pthread_mutex_unlock(&r->lock);
+    }
+    RecordFrame h = {
+        .step = s->step,
+        .time = time,
+        .live_weights = s->live_weights,
+        .label = s->label,
+        .predicted = s->predicted,
+        .loss = s->loss,
+        .loss_avg = s->loss_avg,
+        .accuracy_avg = s->accuracy_avg,
+        .topology_version = s->topology_version,
+    };
+    uint8_t *frame = raw + (size_t)f * r->frame_bytes;
+    memcpy(frame, &h, sizeof(h));
+    memcpy(frame + sizeof(h), s->act, sizeof(float) * n);
+    memcpy(frame + sizeof(h) + sizeof(float) * n, s->err, sizeof(float) * n);
+
+    if (++r->frames[r->filling] == RECORD_CHUNK_FRAMES) {
+        pthread_mutex_lock(&r->lock);
+        if (r->pending < 0) {
+            r->pending = r->filling;
+            r->key_countdown = r->key[r->filling] ? RECORD_KEYFRAME_CHUNKS - 1 : r->key_countdown - 1;
+            pthread_cond_signal(&r->cond);
+        } else {
+            // The thread has not picked up the chunk before; this one is lost,
+            // and if it was a keyframe the next chunk takes its place
+            atomic_fetch_add_explicit(&r->dropped, RECORD_CHUNK_FRAMES, memory_order_relaxed);
+        }
+        pthread_mutex_unlock(&r->lock);
+        r->filling = -1;
+    }
+    return true;
+}
+
+bool record_keyframe_busy(Recorder *r) {
+    if (!r->file) return false;
+    pthread_mutex_lock(&r->lock);
+    bool busy = r->key_slot >= 0;
+    pthread_mutex_unlock(&r->lock);
+    return busy;
+}
+
+void record_close(Recorder *r) {
+    if (!r->file) return;
+    record_stop(r);
+    pthread_mutex_lock(&r->lock);
+    if (r->key_slot >= 0) copy_keyframe(r);
+    pthread_mutex_unlock(&r->lock);
+    if (r->filling >= 0 && r->frames[r->filling] > 0 && !r->failed) write_chunk(r, r->filling);
+    if (!r->failed) {
+        r->header.index_offset = r->offset;
+        bool ok = fwrite(r->index, sizeof(RecordIndexEntry), r->header.chunk_count, r->file) == r->header.chunk_count;
+        ok = ok && fseek(r->file, 0, SEEK_SET) == 0 && fwrite(&r->header, sizeof(r->header), 1, r->file) == 1;
+        if (!ok) fprintf(stderr, "ERROR: could not write the run log index\n");
+    }
+    fclose(r->file);
+    pthread_mutex_destroy(&r->lock);
+    pthread_cond_destroy(&r->cond);
+    free(r->raw[0]);
+    free(r->raw[1]);
+    free(r->packed);
+    free(r->index);
+    memset(r, 0, sizeof(*r));
+}
+
+// ------------------------------------------------------------
+// Replay
+// ------------------------------------------------------------
+
+static bool read_chunk_header(const Replay *r, uint64_t offset, RecordChunk *c) {
+    size_t size = r->file.size;
+    if (offset > size || sizeof(*c) > size - offset) return false;
+    memcpy(c, (const uint8_t *)r->file.data + offset, sizeof(*c));
+    uint64_t body = size - offset - sizeof(*c);
+    return c->magic == RECORD_CHUNK_MAGIC && c->frames >= 1 && c->frames <= r->header.chunk_frames
+        && c->frames_packed <= body && c->weights_packed <= body - c->frames_packed
+        && (c->weights_packed ? c->key_offset == offset : c->key_offset < offset);
+}
+
+// Walks the chunks of a run that was never closed
+static bool scan_chunks(Replay *r, uint64_t offset) {
+    size_t capacity = 0;
+    RecordChunk c;
+    while (read_chunk_header(r, offset, &c)) {
+        if (r->chunk_count == capacity) {
+            capacity = capacity ? capacity * 2 : 256;
+            RecordIndexEntry *index = realloc(r->index, sizeof(*index) * capacity);
+            if (!index) return false;
+            r->index = index;
+        }
+        r->index[r->chunk_count++] = (RecordIndexEntry){ c.first_step, c.last_step, offset, (uint64_t)r->frame_count };
+        r->frame_count += c.frames;
+        offset += sizeof(c) + c.frames_packed + c.weights_packed;
+    }
+    return true;
+}
+
+bool replay_open(Replay *r, const char *path) {
+    memset(r, 0, sizeof(*r));
+    r->cached = -1;
+    if (!map_file(&r->file, path, MAP_READ_ONLY)) return false;
+    RecordHeader *h = &r->header;
+    if (r->file.size < sizeof(*h)) goto corrupt;
+    memcpy(h, r->file.data, sizeof(*h));
+    if (memcmp(h->magic, RECORD_MAGIC, 8) != 0 || h->version != RECORD_VERSION) goto corrupt;
+    if (h->byte_order != RECORD_BYTE_ORDER) {
+        fprintf(stderr, "ERROR: %s was recorded with the other byte order\n", path);
+        goto fail;
+    }
+    uint64_t data = sizeof(*h) + sizeof(uint32_t) * (uint64_t)h->layer_count;
+    if (h->layer_count < 2 || h->layer_count > MODEL_MAX_LAYERS || h->chunk_frames == 0
+        || h->chunk_frames > 65536 || data > r->file.size) goto corrupt;
+    r->sizes = (const uint32_t *)((const uint8_t *)r->file.data + sizeof(*h));
+    r->frame_bytes = sizeof(RecordFrame) + 2 * sizeof(float) * (size_t)h->neuron_count;
+
+    if (h->index_offset) {
+        uint64_t bytes = sizeof(RecordIndexEntry) * h->chunk_count;
+        if (h->index_offset > r->file.size || bytes > r->file.size - h->index_offset) goto corrupt;
+        r->chunk_count = (size_t)h->chunk_count;
+        r->frame_count = (long long)h->frame_count;
+        r->index = malloc(bytes ? bytes : 1);
+        if (!r->index) goto fail;
+        memcpy(r->index, (const uint8_t *)r->file.data + h->index_offset, bytes);
+    } else if (!scan_chunks(r, data)) {
+        goto fail;
+    }
+    if (r->chunk_count == 0) {
+        fprintf(stderr, "ERROR: %s holds no frames\n", path);
+        goto fail;
+    }
+
+    size_t frames = h->chunk_frames * r->frame_bytes, weights = weight_bytes(h);
+    r->raw = malloc(frames);
+    r->weights = malloc(weights);
+    if (!r->raw || !r->weights) goto fail;
+    return true;
+
+corrupt:
+    fprintf(stderr, "ERROR: %s is not a run log\n", path);
+fail:
+    replay_close(r);
+    return false;
+}
+
+void replay_close(Replay *r) {
+    unmap_file(&r->file);
+    free(r->index);
+    free(r->raw);
+    free(r->weights);
+    memset(r, 0, sizeof(*r));
+    r->cached = -1;
+}
+
+static bool load_chunk(Replay *r, size_t chunk) {
+    if (r->cached == (long long)chunk) return true;
+    long long t0 = now_ns();
+    r->cached = -1;
+    RecordChunk c;
+    if (!read_chunk_header(r, r->index[chunk].offset, &c)) return false;
+    const uint8_t *src = (const uint8_t *)r->file.data + r->index[chunk].offset + sizeof(c);
+    size_t fb = r->frame_bytes, frame_bytes = c.frames * fb;
+    if (!unpack_words(src, c.frames_packed, r->raw, frame_bytes)) return false;
+    if (c.key_offset != r->weights_offset) {
+        RecordChunk key;
+        size_t wbytes = weight_bytes(&r->header);
+        r->weights_offset = 0;
+        if (!read_chunk_header(r, c.key_offset, &key) || key.weights_packed == 0) return false;
+        const uint8_t *w = (const uint8_t *)r->file.data + c.key_offset + sizeof(key) + key.frames_packed;
+        if (!unpack_words(w, key.weights_packed, (uint8_t *)r->weights, wbytes)) return false;
+        r->weights_offset = c.key_offset;
+    }
+    r->cached = (long long)chunk;
+    r->decode_ns = now_ns() - t0;
+    return true;
+}
+
+// Last chunk whose first frame is at or before `frame`
+static size_t chunk_of_frame(const Replay *r, long long frame) {
+    size_t lo = 0, hi = r->chunk_count;
+    while (hi - lo > 1) {
+        size_t mid = (lo + hi) / 2;
+        if ((long long)r->index[mid].first_frame <= frame) lo = mid;
+        else hi = mid;
+    }
+    return lo;
+}
+
+long long replay_find_step(Replay *r, long long step) {
+    size_t lo = 0, hi = r->chunk_count;
+    while (hi - lo > 1) {
+        size_t mid = (lo + hi) / 2;
+        if (r->index[mid].first_step <= step) lo = mid;
+        else hi = mid;
+    }
+    long long base = (long long)r->index[lo].first_frame;
+    if (!load_chunk(r, lo)) return base;
+    long long frames = (lo + 1 < r->chunk_count ? (long long)r->index[lo + 1].first_frame : r->frame_count) - base;
+    long long a = 0, b = frames;
+    while (b - a > 1) {
+        long long mid = (a + b) / 2;
+        int64_t s;
+        memcpy(&s, r->raw + mid * r->frame_bytes, sizeof(s));
+        if (s <= step) a = mid;
+        else b = mid;
+    }
+    return base + a;
+}
+
+bool replay_read(Replay *r, long long frame, TrainSnapshot *s, double *time) {
+    if (frame < 0) frame = 0;
+    if (frame >= r->frame_count) frame = r->frame_count - 1;
+    size_t chunk = chunk_of_frame(r, frame);
+    if (!load_chunk(r, chunk)) return false;
+    uint8_t *raw = r->raw + (size_t)(frame - (long long)r->index[chunk].first_frame) * r->frame_bytes;
+    RecordFrame h;
+    memcpy(&h, raw, sizeof(h));
+    if (time) *time = h.time;
+    float *weights = r->weights;
+    *s = (TrainSnapshot){
+        .act = (float *)(raw + sizeof(h)),
+        .err = (float *)(raw + sizeof(h)) + r->header.neuron_count,
+        .weights = weights,
+        .biases = weights + r->header.weight_count,
+        .label = h.label,
+        .predicted = h.predicted,
+        .loss = h.loss,
+        .loss_avg = h.loss_avg,
+        .accuracy_avg = h.accuracy_avg,
+        .step = h.step,
+        .weights_step = h.step, // the keyframe's weights stand in for every frame
+        .topology_version = h.topology_version,
+        .live_weights = h.live_weights,
+    };
+    return true;
+}
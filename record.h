@@ -0,0 +1,190 @@
+#ifndef RECORD_H_
+#define RECORD_H_
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "mapfile.h"
+#include "trainer.h"
+
+#define RECORD_MAGIC "CONARUN\0"
+#define RECORD_VERSION 1
+#define RECORD_CHUNK_MAGIC 0x4B4E4843u  // "CHNK"
+#define RECORD_BYTE_ORDER 0x01020304u
+
+// Frames per chunk. A chunk is the unit of compression and of seeking: it
+// decodes on its own, so a seek never touches more than one.
+#define RECORD_CHUNK_FRAMES 64
+
+// Every this many chunks, one carries the weights and biases: a keyframe.
+// Frames use the weights of the latest keyframe at or before their chunk.
+#define RECORD_KEYFRAME_CHUNKS 8
+
+// Training run log. Every published snapshot the renderer sees becomes a
+// frame (activations, errors and statistics of the shown sample); the
+// weights are stored in keyframe chunks, as of their first frame. All
+// fields are in the writer's byte order, which readers must share:
+//
+//     RecordHeader                       64 bytes
+//     uint32_t sizes[layer_count]        neuron layer widths, input first
+//     chunks: RecordChunk, packed frames, packed weights and biases if a keyframe
+//     RecordIndexEntry[chunk_count]      at index_offset, one per chunk
+//
+// Packing: each stream is a bitmap with one bit per 32-bit word, set for
+// the nonzero ones, followed by those words. Inputs, ReLU activations and
+// their errors are largely zero, as are pruned weights.
+//
+// The index is written when the recording is closed. A run that was cut
+// short has index_offset 0 and is indexed by walking its chunks on open.
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;      // RECORD_BYTE_ORDER as the writer stored it
+    uint32_t layer_count;
+    uint32_t chunk_frames;
+    uint32_t neuron_count;
+    uint32_t weight_count;
+    uint32_t bias_count;
+    uint32_t reserved0;
+    uint64_t index_offset;    // 0 while recording
+    uint64_t chunk_count;
+    uint64_t frame_count;
+} RecordHeader;
+
+typedef struct {
+    uint32_t magic;           // RECORD_CHUNK_MAGIC
+    uint32_t frames;
+    int64_t first_step, last_step;
+    uint64_t frames_packed;   // bytes of the packed frame stream that follows
+    uint64_t weights_packed;  // then of the weights and biases, 0 = not a keyframe
+    uint64_t key_offset;      // of the keyframe chunk whose weights apply
+} RecordChunk;
+
+typedef struct {
+    int64_t first_step;
+    int64_t last_step;
+    uint64_t offset;          // of the RecordChunk
+    uint64_t first_frame;     // frames in all chunks before
+} RecordIndexEntry;
+
+// Fixed part of a frame, followed by float act[neuron_count] and
+// err[neuron_count]
+typedef struct {
+    int64_t step;
+    double time;              // seconds since the recording started
+    int64_t live_weights;
+    int32_t label;
+    int32_t predicted;
+    float loss;
+    float loss_avg;
+    float accuracy_avg;
+    int32_t topology_version;
+} RecordFrame;
+
+// Writer. The renderer appends frames into one of two chunk buffers, which
+// is a copy of the sample's arrays; a full chunk is handed to a background
+// thread that packs and appends it to the file. If both buffers are busy
+// the frame is dropped rather than stalling the frame. A keyframe's weights
+// are copied by the thread too, from the snapshot's own arrays, so the
+// renderer never copies a whole network.
+typedef struct {
+    FILE *file;
+    RecordHeader header;
+    size_t frame_bytes;
+    size_t chunk_bytes;       // frames plus weights and biases, unpacked
+    uint8_t *raw[2];
+    int frames[2];            // filled frames per buffer
+    bool key[2];              // buffer holds weights
+    int filling;              // buffer the renderer appends to, -1 = none free
+    int key_countdown;        // chunks until the next keyframe
+    uint64_t offset;          // where the next chunk goes
+
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int pending;              // full buffer waiting for the thread, -1 = none
+    int writing;              // buffer being packed and written, -1 = none
+    int key_slot;             // buffer whose weights the thread copies next, -1 = none
+    const float *key_weights; // snapshot arrays it copies them from
+    const float *key_biases;
+    bool quit;
+    pthread_t thread;
+    bool thread_started;
+
+    // Owned by the I/O thread while it runs
+    uint8_t *packed;
+    RecordIndexEntry *index;
+    size_t index_capacity;
+    uint64_t key_offset;      // of the last keyframe written
+    bool failed;
+
+    // Statistics, read by the renderer
+    _Atomic long long frames_written;
+    _Atomic long long dropped;
+    _Atomic long long raw_bytes;
+    _Atomic long long file_bytes;
+    _Atomic long long pack_ns;   // I/O thread time of the last chunk
+} Recorder;
+
+// Frames of `t`'s network to `path`, replacing the file
+bool record_init(Recorder *r, const Trainer *t, const char *path);
+
+// Flushes the partial chunk, writes the index and closes the file
+void record_close(Recorder *r);
+
+// The I/O thread runs code from this module, so it is stopped around hot
+// reloads. Stopping waits for a queued chunk to reach the file.
+bool record_start(Recorder *r);
+void record_stop(Recorder *r);
+
+// Renderer: appends the snapshot as the next frame. False if it was dropped.
+// When it starts a keyframe, the snapshot's weights and biases must stay
+// as they are until record_keyframe_busy is false.
+bool record_append(Recorder *r, const TrainSnapshot *s, double time);
+
+// Renderer: the thread is still copying the weights of the last keyframe
+bool record_keyframe_busy(Recorder *r);
+
+// Reader over a mapping of the log. Chunks are unpacked on demand into one
+// cached chunk, and keyframe weights into a cache of their own, so
+// consecutive frames cost a pointer lookup and a seek anywhere costs at
+// most one chunk and one set of weights.
+typedef struct {
+    MappedFile file;
+    RecordHeader header;
+    const uint32_t *sizes;
+    RecordIndexEntry *index;
+    size_t chunk_count;
+    long long frame_count;
+    size_t frame_bytes;
+    uint8_t *raw;             // frames of the cached chunk, unpacked
+    float *weights;           // weights and biases of its keyframe
+    long long cached;         // chunk index, -1 = none
+    uint64_t weights_offset;  // keyframe the weights are from, 0 = none
+    long long decode_ns;      // time of the last chunk unpacked, weights included
+} Replay;
+
+bool replay_open(Replay *r, const char *path);
+void replay_close(Replay *r);
+
+// Last frame at or before `step` (the first frame if there is none), by
+// binary search over the chunk index and then the chunk's frames.
+long long replay_find_step(Replay *r, long long step);
+
+// Fills `s` with frame `frame`, and `time` with its recording time if not
+// NULL. The arrays point into the cached chunk and stay valid until the
+// next read or find. Returns false if the chunk is corrupt.
+bool replay_read(Replay *r, long long frame, TrainSnapshot *s, double *time);
+
+static inline long long replay_first_step(const Replay *r) {
+    return r->chunk_count ? r->index[0].first_step : 0;
+}
+
+static inline long long replay_last_step(const Replay *r) {
+    return r->chunk_count ? r->index[r->chunk_count - 1].last_step : 0;
+}
+
+#endif // RECORD_H_
@@ -0,0 +1,213 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <string.h>
+
+#include "shmring.h"
+
+#ifndef _WIN32
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+// Shared with another process, so the counters must not fall back to locks
+_Static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "shared-memory ring needs lock-free 64-bit atomics");
+_Static_assert(sizeof(ShmRingHeader) == 192, "ring header layout");
+_Static_assert(sizeof(ShmRingRecord) == 64, "ring record layout");
+
+static size_t align_up(size_t n) {
+    return (n + SHM_RING_ALIGN - 1) / SHM_RING_ALIGN * SHM_RING_ALIGN;
+}
+
+static void slot_at(const ShmRing *r, uint64_t record, ShmRingSlot *slot) {
+    const ShmRingHeader *h = r->header;
+    uint8_t *base = (uint8_t *)r->base + h->slots_offset + (record % h->slot_count) * h->slot_bytes;
+    slot->record = (ShmRingRecord *)base;
+    slot->act = (float *)(base + sizeof(ShmRingRecord));
+    slot->err = slot->act + h->neuron_count;
+    slot->weights = slot->err + h->neuron_count;
+    slot->biases = slot->weights + h->weight_count;
+}
+
+#ifdef _WIN32
+
+bool shm_ring_create(ShmRing *r, const char *name, const int *sizes, int layer_count,
+                     int input_rows, int input_cols, int slot_count) {
+    (void)sizes; (void)layer_count; (void)input_rows; (void)input_cols; (void)slot_count;
+    memset(r, 0, sizeof(*r));
+    fprintf(stderr, "ERROR: shared-memory source %s needs POSIX shared memory\n", name);
+    return false;
+}
+
+bool shm_ring_attach(ShmRing *r, const char *name) {
+    return shm_ring_create(r, name, NULL, 0, 0, 0, 0);
+}
+
+void shm_ring_close(ShmRing *r) {
+    memset(r, 0, sizeof(*r));
+}
+
+#else
+
+bool shm_ring_create(ShmRing *r, const char *name, const int *sizes, int layer_count,
+                     int input_rows, int input_cols, int slot_count) {
+    memset(r, 0, sizeof(*r));
+    if (layer_count < 2 || layer_count > SHM_RING_MAX_LAYERS || slot_count < 2
+        || input_rows * input_cols != sizes[0] || strlen(name) >= sizeof(r->name)) {
+        fprintf(stderr, "ERROR: invalid layout for shared-memory ring %s\n", name);
+        return false;
+    }
+    uint64_t neurons = 0, weights = 0, biases = 0;
+    for (int l = 0; l < layer_count; l++) {
+        neurons += (uint64_t)sizes[l];
+        if (l > 0) {
+            weights += (uint64_t)sizes[l - 1] * sizes[l];
+            biases += (uint64_t)sizes[l];
+        }
+    }
+    size_t slot_bytes = align_up(sizeof(ShmRingRecord) + sizeof(float) * (2 * neurons + weights + biases));
+    size_t slots_offset = align_up(sizeof(ShmRingHeader) + sizeof(uint32_t) * layer_count);
+    size_t size = slots_offset + slot_bytes * slot_count;
+
+    // A previous producer may have died without removing its object
+    shm_unlink(name);
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0) {
+        fprintf(stderr, "ERROR: could not create shared memory %s\n", name);
+        return false;
+    }
+    void *base = ftruncate(fd, (off_t)size) == 0 ? mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)
+                                                  : MAP_FAILED;
+    close(fd);
+    if (base == MAP_FAILED) {
+        fprintf(stderr, "ERROR: could not map %zu bytes of shared memory %s\n", size, name);
+        shm_unlink(name);
+        return false;
+    }
+
+    // Freshly truncated, so the counters start at zero
+    ShmRingHeader *h = base;
+    memcpy(h->magic, SHM_RING_MAGIC, 8);
+    h->version = SHM_RING_VERSION;
+    h->byte_order = SHM_RING_BYTE_ORDER;
+    h->layer_count = (uint32_t)layer_count;
+    h->slot_count = (uint32_t)slot_count;
+    h->input_rows = (uint32_t)input_rows;
+    h->input_cols = (uint32_t)input_cols;
+    h->neuron_count = (uint32_t)neurons;
+    h->weight_count = (uint32_t)weights;
+    h->bias_count = (uint32_t)biases;
+    h->producer_pid = (uint32_t)getpid();
+    h->slot_bytes = slot_bytes;
+    h->slots_offset = slots_offset;
+    uint32_t *s = (uint32_t *)(h + 1);
+    for (int l = 0; l < layer_count; l++) s[l] = (uint32_t)sizes[l];
+
+    snprintf(r->name, sizeof(r->name), "%s", name);
+    r->base = base;
+    r->size = size;
+    r->header = h;
+    r->sizes = s;
+    r->owner = true;
+    return true;
+}
+
+bool shm_ring_attach(ShmRing *r, const char *name) {
+    memset(r, 0, sizeof(*r));
+    int fd = shm_open(name, O_RDWR, 0);
+    if (fd < 0) {
+        fprintf(stderr, "ERROR: no shared-memory source %s, is the producer running?\n", name);
+        return false;
+    }
+    struct stat st;
+    void *base = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(ShmRingHeader)) {
+        base = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (base == MAP_FAILED) {
+        fprintf(stderr, "ERROR: could not map shared memory %s\n", name);
+        return false;
+    }
+    r->base = base;
+    r->size = (size_t)st.st_size;
+    r->header = base;
+    snprintf(r->name, sizeof(r->name), "%s", name);
+
+    const ShmRingHeader *h = r->header;
+    bool ok = memcmp(h->magic, SHM_RING_MAGIC, 8) == 0 && h->version == SHM_RING_VERSION
+           && h->layer_count >= 2 && h->layer_count <= SHM_RING_MAX_LAYERS && h->slot_count >= 2
+           && h->slots_offset >= sizeof(*h) + sizeof(uint32_t) * h->layer_count
+           && h->slots_offset <= r->size && (r->size - h->slots_offset) / h->slot_count >= h->slot_bytes;
+    if (ok && h->byte_order != SHM_RING_BYTE_ORDER) {
+        fprintf(stderr, "ERROR: %s was written with the other byte order\n", name);
+        shm_ring_close(r);
+        return false;
+    }
+    if (ok) {
+        // The counts must follow from the sizes, and a slot must hold them
+        r->sizes = (const uint32_t *)(h + 1);
+        uint64_t neurons = 0, weights = 0, biases = 0;
+        for (uint32_t l = 0; l < h->layer_count; l++) {
+            neurons += r->sizes[l];
+            if (l > 0) {
+                weights += (uint64_t)r->sizes[l - 1] * r->sizes[l];
+                biases += r->sizes[l];
+            }
+        }
+        ok = neurons == h->neuron_count && weights == h->weight_count && biases == h->bias_count
+          && (uint64_t)h->input_rows * h->input_cols == r->sizes[0]
+          && sizeof(ShmRingRecord) + sizeof(float) * (2 * neurons + weights + biases) <= h->slot_bytes;
+    }
+    if (!ok) {
+        fprintf(stderr, "ERROR: %s is not a CONA shared-memory ring\n", name);
+        shm_ring_close(r);
+        return false;
+    }
+    return true;
+}
+
+void shm_ring_close(ShmRing *r) {
+    if (r->base) munmap(r->base, r->size);
+    if (r->owner) shm_unlink(r->name);
+    memset(r, 0, sizeof(*r));
+}
+
+#endif // _WIN32
+
+bool shm_ring_begin(ShmRing *r, ShmRingSlot *slot) {
+    ShmRingHeader *h = r->header;
+    uint64_t head = atomic_load_explicit(&h->head, memory_order_relaxed);
+    uint64_t tail = atomic_load_explicit(&h->tail, memory_order_acquire);
+    if (head - tail >= h->slot_count) {
+        atomic_fetch_add_explicit(&h->dropped, 1, memory_order_relaxed);
+        return false;
+    }
+    slot_at(r, head, slot);
+    return true;
+}
+
+void shm_ring_publish(ShmRing *r) {
+    ShmRingHeader *h = r->header;
+    uint64_t head = atomic_load_explicit(&h->head, memory_order_relaxed);
+    atomic_store_explicit(&h->head, head + 1, memory_order_release);
+}
+
+long long shm_ring_latest(ShmRing *r, ShmRingSlot *slot) {
+    ShmRingHeader *h = r->header;
+    uint64_t head = atomic_load_explicit(&h->head, memory_order_acquire);
+    if (head == 0) {
+        memset(slot, 0, sizeof(*slot));
+        return 0;
+    }
+    uint64_t newest = head - 1;
+    long long fresh = r->holding ? (long long)(newest - r->held) : (long long)head;
+    if (!r->holding || newest != r->held) {
+        atomic_store_explicit(&h->tail, newest, memory_order_release);
+        r->held = newest;
+        r->holding = true;
+    }
+    slot_at(r, newest, slot);
+    return fresh;
+}
@@ -0,0 +1,116 @@
+#ifndef SHMRING_H_
+#define SHMRING_H_
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define SHM_RING_MAGIC "CONASHM\0"
+#define SHM_RING_VERSION 1
+#define SHM_RING_BYTE_ORDER 0x01020304u
+#define SHM_RING_MAX_LAYERS 64
+#define SHM_RING_ALIGN 64
+
+// Live training data from another process. The producer (an external
+// trainer) creates a POSIX shared-memory object and pushes records into a
+// ring of fixed-size slots; CONA attaches to it and draws straight from the
+// slots, nothing is copied on the way. Layout of the object, all fields in
+// the producer's byte order:
+//
+//     ShmRingHeader                     192 bytes
+//     uint32_t sizes[layer_count]       neuron layer widths, input first
+//     slots at slots_offset, slot_count of slot_bytes each (64-aligned):
+//         ShmRingRecord                 64 bytes, scalars of the record
+//         float act[neuron_count]       activations, input layer included
+//         float err[neuron_count]       dLoss/dz
+//         float weights[weight_count]   [out][in] per layer, in layer order
+//         float biases[bias_count]
+//
+// Protocol (single producer, single consumer): `head` counts the records
+// published and `tail` is the record the consumer is holding, so slots
+// tail..head-1 belong to the consumer and the rest to the producer. The
+// producer fills slot head % slot_count only while head - tail < slot_count,
+// then stores head + 1 with release order. The consumer loads head with
+// acquire order, keeps the newest record and stores it as tail with release
+// order, which hands every older slot back. Neither side ever waits: a
+// producer facing a full ring (no consumer, or one that stalled) counts the
+// record as dropped and carries on.
+typedef struct {
+    // Written once by the producer before anything is published
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint32_t layer_count;
+    uint32_t slot_count;
+    uint32_t input_rows;       // input layer as an image, rows * cols = sizes[0]
+    uint32_t input_cols;
+    uint32_t neuron_count;
+    uint32_t weight_count;
+    uint32_t bias_count;
+    uint32_t producer_pid;
+    uint64_t slot_bytes;
+    uint64_t slots_offset;
+
+    // Producer-owned, own cache line
+    _Alignas(64) _Atomic uint64_t head;
+    _Atomic uint64_t dropped;  // records not published because the ring was full
+
+    // Consumer-owned
+    _Alignas(64) _Atomic uint64_t tail;
+} ShmRingHeader;
+
+typedef struct {
+    int64_t step;
+    int32_t label;
+    int32_t predicted;
+    float loss;
+    float loss_avg;
+    float accuracy_avg;
+    int32_t topology_version;  // changes whenever weights were removed
+    int64_t live_weights;
+    uint8_t reserved[24];
+} ShmRingRecord;
+
+// One slot of the ring, pointers into the mapping
+typedef struct {
+    ShmRingRecord *record;     // NULL when there is nothing to show yet
+    float *act;
+    float *err;
+    float *weights;
+    float *biases;
+} ShmRingSlot;
+
+typedef struct {
+    char name[64];
+    void *base;
+    size_t size;
+    ShmRingHeader *header;
+    const uint32_t *sizes;
+    bool owner;                // created it, so unlinks it
+    uint64_t held;             // consumer: record held, valid once one was taken
+    bool holding;
+} ShmRing;
+
+// Producer: creates (replacing) the object `name` ("/cona_live") for a
+// fully connected network of `layer_count` layers.
+bool shm_ring_create(ShmRing *r, const char *name, const int *sizes, int layer_count,
+                     int input_rows, int input_cols, int slot_count);
+
+// Producer: the slot to fill next. False if the ring is full, in which case
+// the record counts as dropped and nothing is to be published.
+bool shm_ring_begin(ShmRing *r, ShmRingSlot *slot);
+void shm_ring_publish(ShmRing *r);
+
+// Consumer: maps an existing object and checks its header
+bool shm_ring_attach(ShmRing *r, const char *name);
+
+// Consumer: takes the newest record and releases the one held before. The
+// slot stays valid until the next call. Returns the number of records
+// published since the previous call.
+long long shm_ring_latest(ShmRing *r, ShmRingSlot *slot);
+
+// Unmaps; the producer also removes the object
+void shm_ring_close(ShmRing *r);
+
+#endif // SHMRING_H_
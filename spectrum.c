@@ -0,0 +1,164 @@
+#include <math.h>
+#include <string.h>
+
+#include "spectrum.h"
+
+#define SPECTRUM_PI 3.14159265358979323846f
+
+// Band energies are tracked in dB relative to a slowly decaying peak.
+#define SPECTRUM_DB_FLOOR      -60.0f
+#define SPECTRUM_DB_MIN_RANGE   24.0f
+#define SPECTRUM_PEAK_DECAY_DB   6.0f   // dB per second
+#define SPECTRUM_ATTACK         30.0f
+#define SPECTRUM_RELEASE         6.0f
+
+void spectrum_init(Spectrum *s, float sample_rate) {
+    memset(s, 0, sizeof(*s));
+    const int n = SPECTRUM_FFT_SIZE;
+
+    // Hann window
+    for (int i = 0; i < n; i++) {
+        s->window[i] = 0.5f - 0.5f * cosf(2.0f * SPECTRUM_PI * i / (n - 1));
+    }
+
+    // Bit reversal permutation
+    for (int i = 0; i < n; i++) {
+        unsigned int r = 0;
+        for (int b = 0; b < SPECTRUM_FFT_LOG2; b++) {
+            if (i & (1 << b)) r |= 1u << (SPECTRUM_FFT_LOG2 - 1 - b);
+        }
+        s->bitrev[i] = (unsigned short)r;
+    }
+
+    // Twiddles for the stage with half-size h live at [h-1, 2h-1), so every
+    // butterfly loop reads them with unit stride.
+    for (int h = 1; h < n; h <<= 1) {
+        for (int j = 0; j < h; j++) {
+            float a = -SPECTRUM_PI * j / h;
+            s->twiddle_re[h - 1 + j] = cosf(a);
+            s->twiddle_im[h - 1 + j] = sinf(a);
+        }
+    }
+
+    // Log-spaced band edges between 40Hz and 16kHz (or Nyquist)
+    float f_lo = 40.0f;
+    float f_hi = fminf(16000.0f, sample_rate * 0.5f);
+    int prev = 0;
+    for (int b = 0; b <= SPECTRUM_BANDS; b++) {
+        float f = f_lo * powf(f_hi / f_lo, (float)b / SPECTRUM_BANDS);
+        int bin = (int)(f * n / sample_rate);
+        if (bin <= prev) bin = prev + 1;
+        if (bin > n / 2) bin = n / 2;
+        s->band_edges[b] = bin;
+        prev = bin;
+    }
+
+    s->peak_db = SPECTRUM_DB_FLOOR + SPECTRUM_DB_MIN_RANGE;
+}
+
+void spectrum_push(Spectrum *s, const float *samples, size_t count) {
+    size_t w = atomic_load_explicit(&s->write_pos, memory_order_relaxed);
+    for (size_t i = 0; i < count; i++) {
+        s->ring[(w + i) & (SPECTRUM_RING_SIZE - 1)] = samples[i];
+    }
+    atomic_store_explicit(&s->write_pos, w + count, memory_order_release);
+}
+
+// In-place iterative radix-2 DIT on split complex arrays. The inner loop runs
+// over contiguous j so compilers vectorize it for every stage with h >= 4.
+static void fft_radix2(Spectrum *s) {
+    const int n = SPECTRUM_FFT_SIZE;
+    float *restrict re = s->re;
+    float *restrict im = s->im;
+
+    for (int h = 1; h < n; h <<= 1) {
+        const float *restrict wr = &s->twiddle_re[h - 1];
+        const float *restrict wi = &s->twiddle_im[h - 1];
+        for (int k = 0; k < n; k += 2 * h) {
+            float *restrict ar = re + k;
+            float *restrict ai = im + k;
+            float *restrict br = re + k + h;
+            float *restrict bi = im + k + h;
+            for (int j = 0; j < h; j++) {
+                float tr = wr[j] * br[j] - wi[j] * bi[j];
+                float ti = wr[j] * bi[j] + wi[j] * br[j];
+                br[j] = ar[j] - tr;
+                bi[j] = ai[j] - ti;
+                ar[j] += tr;
+                ai[j] += ti;
+            }
+        }
+    }
+}
+
+static void analyze_window(Spectrum *s, size_t start) {
+    const int n = SPECTRUM_FFT_SIZE;
+
+    // Windowed load in bit-reversed order
+    for (int i = 0; i < n; i++) {
+        int r = s->bitrev[i];
+        s->re[r] = s->ring[(start + i) & (SPECTRUM_RING_SIZE - 1)] * s->window[i];
+        s->im[r] = 0.0f;
+    }
+
+    fft_radix2(s);
+
+    for (int b = 0; b < SPECTRUM_BANDS; b++) {
+        int lo = s->band_edges[b];
+        int hi = s->band_edges[b + 1];
+        float sum = 0.0f;
+        for (int k = lo; k < hi; k++) {
+            sum += s->re[k] * s->re[k] + s->im[k] * s->im[k];
+        }
+        s->band_energy[b] = sum / (float)(hi - lo);
+    }
+}
+
+int spectrum_update(Spectrum *s, float dt) {
+    size_t w = atomic_load_explicit(&s->write_pos, memory_order_acquire);
+
+    // Drop anything the writer may be about to overwrite, and any backlog we
+    // could not analyze within this frame's budget.
+    size_t max_lag = SPECTRUM_FFT_SIZE + SPECTRUM_HOP * (SPECTRUM_MAX_WINDOWS_PER_FRAME - 1);
+    if (w - s->read_pos > max_lag) {
+        s->read_pos = (w > max_lag) ? w - max_lag : 0;
+    }
+
+    int windows = 0;
+    while (w - s->read_pos >= SPECTRUM_FFT_SIZE && windows < SPECTRUM_MAX_WINDOWS_PER_FRAME) {
+        analyze_window(s, s->read_pos);
+        s->read_pos += SPECTRUM_HOP;
+        windows++;
+    }
+    s->windows_last_frame = windows;
+
+    // One normalization peak shared by all bands keeps their relative levels
+    float db[SPECTRUM_BANDS];
+    if (windows > 0) {
+        s->peak_db -= SPECTRUM_PEAK_DECAY_DB * dt;
+        if (s->peak_db < SPECTRUM_DB_FLOOR + SPECTRUM_DB_MIN_RANGE) {
+            s->peak_db = SPECTRUM_DB_FLOOR + SPECTRUM_DB_MIN_RANGE;
+        }
+        for (int b = 0; b < SPECTRUM_BANDS; b++) {
+            db[b] = 10.0f * log10f(s->band_energy[b] + 1e-9f);
+            if (db[b] < SPECTRUM_DB_FLOOR) db[b] = SPECTRUM_DB_FLOOR;
+            if (db[b] > s->peak_db) s->peak_db = db[b];
+        }
+    }
+
+    float level = 0.0f;
+    for (int b = 0; b < SPECTRUM_BANDS; b++) {
+        // With no new audio this frame (stream paused) the band just releases
+        float target = 0.0f;
+        if (windows > 0) {
+            target = (db[b] - SPECTRUM_DB_FLOOR) / (s->peak_db - SPECTRUM_DB_FLOOR);
+        }
+
+        float rate = (target > s->bands[b]) ? SPECTRUM_ATTACK : SPECTRUM_RELEASE;
+        s->bands[b] += (target - s->bands[b]) * fminf(dt * rate, 1.0f);
+        level += s->bands[b];
+    }
+    s->level = level / SPECTRUM_BANDS;
+
+    return windows;
+}
@@ -0,0 +1,64 @@
+#ifndef SPECTRUM_H_
+#define SPECTRUM_H_
+
+#include <stdatomic.h>
+#include <stddef.h>
+
+// FFT window length and hop (50% overlap). Must be a power of two.
+#define SPECTRUM_FFT_SIZE 1024
+#define SPECTRUM_FFT_LOG2 10
+#define SPECTRUM_HOP (SPECTRUM_FFT_SIZE / 2)
+
+// Ring buffer between the audio thread and the analysis stage. Power of two.
+#define SPECTRUM_RING_SIZE 8192
+
+// Log-spaced frequency bands exposed to rendering code.
+#define SPECTRUM_BANDS 8
+
+// Upper bound on FFT windows analyzed per rendered frame. Any backlog beyond
+// this is skipped so the per-frame cost stays bounded.
+#define SPECTRUM_MAX_WINDOWS_PER_FRAME 4
+
+typedef struct {
+    // Single-producer/single-consumer tap. The audio thread owns write_pos,
+    // the main thread owns read_pos.
+    float ring[SPECTRUM_RING_SIZE];
+    _Atomic size_t write_pos;
+    size_t read_pos;
+
+    // Precomputed tables
+    float window[SPECTRUM_FFT_SIZE];
+    float twiddle_re[SPECTRUM_FFT_SIZE]; // per-stage tables, concatenated
+    float twiddle_im[SPECTRUM_FFT_SIZE];
+    unsigned short bitrev[SPECTRUM_FFT_SIZE];
+    int band_edges[SPECTRUM_BANDS + 1];   // FFT bin index boundaries
+
+    // Scratch (split complex)
+    float re[SPECTRUM_FFT_SIZE];
+    float im[SPECTRUM_FFT_SIZE];
+
+    // Output
+    float band_energy[SPECTRUM_BANDS]; // raw energy of the latest window
+    float peak_db;                     // slowly decaying normalization peak
+    float bands[SPECTRUM_BANDS];       // smoothed, normalized to 0..1
+    float level;                       // mean of bands, 0..1
+    int windows_last_frame;
+} Spectrum;
+
+void spectrum_init(Spectrum *s, float sample_rate);
+
+// Audio thread: append mono samples. Never blocks; if the main thread falls
+// behind, the oldest samples are overwritten.
+void spectrum_push(Spectrum *s, const float *samples, size_t count);
+
+// Main thread: analyze up to SPECTRUM_MAX_WINDOWS_PER_FRAME new windows and
+// update the smoothed band values. Returns the number of windows analyzed.
+int spectrum_update(Spectrum *s, float dt);
+
+static inline float spectrum_band(const Spectrum *s, int band) {
+    if (band < 0) band = 0;
+    if (band >= SPECTRUM_BANDS) band = SPECTRUM_BANDS - 1;
+    return s->bands[band];
+}
+
+#endif // SPECTRUM_H_
@@ -0,0 +1,62 @@
+#ifndef SPSC_QUEUE_H_
+#define SPSC_QUEUE_H_
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Lock-free queue of fixed-size items for one writer and one reader. The
+// caller owns the storage, `capacity` items with capacity a power of two.
+// The writer copies batches in; the reader looks at the items in place and
+// consumes them when done, so nothing is copied on the way out. Head and
+// tail live on separate cache lines so the two sides do not share one.
+typedef struct {
+    uint8_t *items;
+    size_t item_size;
+    uint64_t mask;                       // capacity - 1
+    _Alignas(64) _Atomic uint64_t head;  // items written, owned by the writer
+    _Alignas(64) _Atomic uint64_t tail;  // items consumed, owned by the reader
+} SpscQueue;
+
+static inline void spsc_queue_init(SpscQueue *q, void *items, size_t item_size, size_t capacity) {
+    q->items = items;
+    q->item_size = item_size;
+    q->mask = capacity - 1;
+    atomic_store(&q->head, 0);
+    atomic_store(&q->tail, 0);
+}
+
+// Writer: copies up to `count` items and returns how many fit.
+static inline size_t spsc_queue_push(SpscQueue *q, const void *src, size_t count) {
+    uint64_t head = atomic_load_explicit(&q->head, memory_order_relaxed);
+    uint64_t tail = atomic_load_explicit(&q->tail, memory_order_acquire);
+    size_t free_items = (size_t)(q->mask + 1 - (head - tail));
+    if (count > free_items) count = free_items;
+    size_t at = (size_t)(head & q->mask);
+    size_t first = count < q->mask + 1 - at ? count : (size_t)(q->mask + 1 - at);
+    memcpy(q->items + at * q->item_size, src, first * q->item_size);
+    memcpy(q->items, (const uint8_t *)src + first * q->item_size, (count - first) * q->item_size);
+    atomic_store_explicit(&q->head, head + count, memory_order_release);
+    return count;
+}
+
+// Reader: the oldest unconsumed items that are contiguous in storage. Call
+// again after consuming them to get the rest once the storage wraps.
+static inline size_t spsc_queue_peek(SpscQueue *q, const void **items) {
+    uint64_t head = atomic_load_explicit(&q->head, memory_order_acquire);
+    uint64_t tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+    size_t at = (size_t)(tail & q->mask);
+    size_t count = (size_t)(head - tail);
+    if (count > q->mask + 1 - at) count = (size_t)(q->mask + 1 - at);
+    *items = q->items + at * q->item_size;
+    return count;
+}
+
+// Reader: hands `count` peeked items back to the writer.
+static inline void spsc_queue_consume(SpscQueue *q, size_t count) {
+    uint64_t tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+    atomic_store_explicit(&q->tail, tail + count, memory_order_release);
+}
+
+#endif // SPSC_QUEUE_H_
@@ -0,0 +1,134 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "synapse.h"
+
+// |w| values sampled to estimate the cut-off for thinned builds
+#define SYNAPSE_SAMPLES 4096
+
+static int compare_float_desc(const void *a, const void *b) {
+    float x = *(const float *)a, y = *(const float *)b;
+    return (x < y) - (x > y);
+}
+
+// Magnitude that about `keep` of the `live` nonzero weights reach, estimated
+// from an evenly strided sample of the matrix.
+static float estimate_cutoff(const float *W, size_t n, long long live, int keep) {
+    float sample[SYNAPSE_SAMPLES];
+    int count = 0;
+    size_t stride = n / SYNAPSE_SAMPLES + 1;
+    for (size_t k = 0; k < n && count < SYNAPSE_SAMPLES; k += stride) {
+        if (W[k] != 0.0f) sample[count++] = fabsf(W[k]);
+    }
+    if (count == 0) return 0.0f;
+    qsort(sample, count, sizeof(float), compare_float_desc);
+    int rank = (int)((double)keep / live * count);
+    if (rank >= count) rank = count - 1;
+    return sample[rank];
+}
+
+bool synapse_build(SynapseCsr *s, const float *W, int in, int out, int max_edges) {
+    size_t n = (size_t)in * out;
+    if (s->in != in || !s->row_start) {
+        free(s->row_start);
+        s->row_start = malloc(sizeof(int) * (in + 1));
+        if (!s->row_start) return false;
+    }
+    s->in = in;
+    s->out = out;
+
+    s->live = 0;
+    for (size_t k = 0; k < n; k++) s->live += W[k] != 0.0f;
+    s->thinned = max_edges > 0 && s->live > max_edges;
+    float cutoff = s->thinned ? estimate_cutoff(W, n, s->live, max_edges) : 0.0f;
+
+    // Count per source, walking W row-major (one destination at a time)
+    memset(s->row_start, 0, sizeof(int) * (in + 1));
+    for (int o = 0; o < out; o++) {
+        const float *w = W + (size_t)o * in;
+        for (int i = 0; i < in; i++) {
+            if (w[i] != 0.0f && fabsf(w[i]) >= cutoff) s->row_start[i + 1]++;
+        }
+    }
+    for (int i = 0; i < in; i++) s->row_start[i + 1] += s->row_start[i];
+    s->nnz = s->row_start[in];
+
+    if (s->nnz > s->capacity) {
+        free(s->dst);
+        free(s->weight);
+        s->dst = malloc(sizeof(int) * s->nnz);
+        s->weight = malloc(sizeof(float) * s->nnz);
+        s->capacity = s->nnz;
+        if (!s->dst || !s->weight) {
+            memset(s->row_start, 0, sizeof(int) * (in + 1));
+            s->nnz = s->capacity = 0;
+            return false;
+        }
+    }
+
+    // Fill, using row_start[j] as the write cursor of row j and shifting the
+    // offsets back afterwards
+    for (int o = 0; o < out; o++) {
+        const float *w = W + (size_t)o * in;
+        for (int i = 0; i < in; i++) {
+            if (w[i] != 0.0f && fabsf(w[i]) >= cutoff) {
+                int e = s->row_start[i]++;
+                s->dst[e] = o;
+                s->weight[e] = w[i];
+            }
+        }
+    }
+    memmove(s->row_start + 1, s->row_start, sizeof(int) * in);
+    s->row_start[0] = 0;
+    return true;
+}
+
+void synapse_refresh(SynapseCsr *s, const float *W) {
+    for (int i = 0; i < s->in; i++) {
+        for (int e = s->row_start[i]; e < s->row_start[i + 1]; e++) {
+            s->weight[e] = W[(size_t)s->dst[e] * s->in + i];
+        }
+    }
+}
+
+bool synapse_copy(SynapseCsr *dst, const SynapseCsr *src) {
+    if (dst->in != src->in || !dst->row_start) {
+        free(dst->row_start);
+        dst->row_start = malloc(sizeof(int) * (src->in + 1));
+        if (!dst->row_start) {
+            dst->in = dst->nnz = 0;
+            return false;
+        }
+    }
+    dst->in = src->in;
+    if (src->nnz > dst->capacity) {
+        free(dst->dst);
+        free(dst->weight);
+        dst->dst = malloc(sizeof(int) * src->nnz);
+        dst->weight = malloc(sizeof(float) * src->nnz);
+        dst->capacity = src->nnz;
+        if (!dst->dst || !dst->weight) {
+            memset(dst->row_start, 0, sizeof(int) * (dst->in + 1));
+            dst->nnz = dst->capacity = 0;
+            return false;
+        }
+    }
+    memcpy(dst->row_start, src->row_start, sizeof(int) * (src->in + 1));
+    if (src->nnz) {
+        memcpy(dst->dst, src->dst, sizeof(int) * src->nnz);
+        memcpy(dst->weight, src->weight, sizeof(float) * src->nnz);
+    }
+    dst->out = src->out;
+    dst->nnz = src->nnz;
+    dst->live = src->live;
+    dst->thinned = src->thinned;
+    return true;
+}
+
+void synapse_free(SynapseCsr *s) {
+    free(s->row_start);
+    free(s->dst);
+    free(s->weight);
+    memset(s, 0, sizeof(*s));
+}
@@ -0,0 +1,34 @@
+#ifndef SYNAPSE_H_
+#define SYNAPSE_H_
+
+#include <stdbool.h>
+
+// Connections between two adjacent layers in compressed sparse row form,
+// one row per source neuron. Built from a row-major [out][in] weight matrix
+// where a weight of exactly zero means "no connection".
+typedef struct {
+    int in, out;        // source and destination layer widths
+    int nnz;            // edges stored
+    int capacity;       // allocated edge slots
+    int *row_start;     // in + 1 entries; source j owns [row_start[j], row_start[j+1])
+    int *dst;           // destination neuron of each edge, ascending within a row
+    float *weight;      // weight of each edge, refreshed by synapse_refresh
+    long long live;     // nonzero weights in the matrix at build time
+    bool thinned;       // only the strongest edges were kept, see max_edges
+} SynapseCsr;
+
+// Collects the nonzero weights of W. With max_edges > 0 and more live
+// weights than that, only about the max_edges strongest are kept. Reuses
+// the arrays when they are large enough. O(in * out).
+bool synapse_build(SynapseCsr *s, const float *W, int in, int out, int max_edges);
+
+// Copies the current weights of the stored edges from W. O(nnz).
+void synapse_refresh(SynapseCsr *s, const float *W);
+
+// Makes dst a copy of src, reusing its arrays when they are large enough.
+// O(in + nnz).
+bool synapse_copy(SynapseCsr *dst, const SynapseCsr *src);
+
+void synapse_free(SynapseCsr *s);
+
+#endif // SYNAPSE_H_
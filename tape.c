@@ -0,0 +1,359 @@
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "kernels.h"
+#include "tape.h"
+
+// ------------------------------------------------------------
+// Arena
+// ------------------------------------------------------------
+
+struct ArenaBlock {
+    ArenaBlock *next;
+    size_t size, used;
+    uint8_t *data;
+};
+
+static ArenaBlock *block_new(size_t size) {
+    ArenaBlock *b = malloc(sizeof(*b));
+    if (!b) return NULL;
+    b->data = kernels_alloc(size);
+    if (!b->data) {
+        free(b);
+        return NULL;
+    }
+    b->next = NULL;
+    b->size = size;
+    b->used = 0;
+    return b;
+}
+
+static void blocks_free(ArenaBlock *b) {
+    while (b) {
+        ArenaBlock *next = b->next;
+        kernels_free(b->data);
+        free(b);
+        b = next;
+    }
+}
+
+bool arena_init(Arena *a, size_t size) {
+    memset(a, 0, sizeof(*a));
+    a->head = block_new(size);
+    if (!a->head) return false;
+    a->capacity = size;
+    return true;
+}
+
+void arena_free(Arena *a) {
+    blocks_free(a->head);
+    memset(a, 0, sizeof(*a));
+}
+
+void arena_reset(Arena *a) {
+    if (a->head && a->head->next) {
+        ArenaBlock *b = block_new(a->capacity);
+        if (b) {
+            blocks_free(a->head);
+            a->head = b;
+        } else {
+            // Keep the chain, it still holds a whole step
+            for (ArenaBlock *it = a->head; it; it = it->next) it->used = 0;
+        }
+    }
+    if (a->head) a->head->used = 0;
+    a->used = 0;
+}
+
+void *arena_alloc(Arena *a, size_t size) {
+    size = (size + KERNELS_ALIGN - 1) & ~(size_t)(KERNELS_ALIGN - 1);
+    if (!a->head) return NULL;
+    ArenaBlock *b = a->head;
+    if (b->size - b->used < size) {
+        // Only this step sees the extra block; the next reset merges
+        size_t grow = a->capacity > size ? a->capacity : size;
+        b = block_new(grow);
+        if (!b) return NULL;
+        b->next = a->head;
+        a->head = b;
+        a->capacity += grow;
+        a->grows++;
+    }
+    void *ptr = b->data + b->used;
+    b->used += size;
+    a->used += size;
+    if (a->used > a->peak) a->peak = a->used;
+    return ptr;
+}
+
+// ------------------------------------------------------------
+// Recording
+// ------------------------------------------------------------
+
+static const char *op_names[TAPE_OP_COUNT] = {
+    "input", "param", "dense", "layer", "relu", "add", "softmax_xent",
+};
+
+const char *tape_op_name(TapeOp op) {
+    return op >= 0 && op < TAPE_OP_COUNT ? op_names[op] : "?";
+}
+
+bool tape_init(Tape *t, size_t arena_size) {
+    memset(t, 0, sizeof(*t));
+    return arena_init(&t->arena, arena_size);
+}
+
+void tape_free(Tape *t) {
+    arena_free(&t->arena);
+    memset(t, 0, sizeof(*t));
+}
+
+void tape_reset(Tape *t) {
+    arena_reset(&t->arena);
+    t->first = t->last = NULL;
+    t->count = 0;
+}
+
+static float *alloc_floats(Tape *t, int rows, int cols) {
+    return arena_alloc(&t->arena, sizeof(float) * (size_t)rows * cols);
+}
+
+// Appends a node of the given shape. `value` NULL allocates one.
+static TapeNode *push(Tape *t, TapeOp op, int rows, int cols, float *value,
+                      TapeNode *a, TapeNode *b, TapeNode *c) {
+    TapeNode *n = arena_alloc(&t->arena, sizeof(TapeNode));
+    if (!n) return NULL;
+    memset(n, 0, sizeof(*n));
+    n->value = value ? value : alloc_floats(t, rows, cols);
+    if (!n->value) return NULL;
+    n->op = op;
+    n->rows = rows;
+    n->cols = cols;
+    TapeNode *in[3] = { a, b, c };
+    for (int i = 0; i < 3 && in[i]; i++) {
+        n->in[n->in_count++] = in[i];
+        n->needs_grad |= in[i]->needs_grad;
+    }
+    n->index = t->count++;
+    n->prev = t->last;
+    if (t->last) t->last->next = n;
+    else t->first = n;
+    t->last = n;
+    return n;
+}
+
+TapeNode *tape_input(Tape *t, float *x, int rows, int cols, bool grad) {
+    TapeNode *n = push(t, TAPE_INPUT, rows, cols, x, NULL, NULL, NULL);
+    if (n) n->needs_grad = grad;
+    return n;
+}
+
+TapeNode *tape_param(Tape *t, float *value, float *grad, int rows, int cols, const char *name) {
+    TapeNode *n = push(t, TAPE_PARAM, rows, cols, value, NULL, NULL, NULL);
+    if (!n) return NULL;
+    n->needs_grad = true;
+    n->name = name;
+    // Accumulated into by the ops that read it, so it exists up front
+    if (!grad) {
+        grad = alloc_floats(t, rows, cols);
+        if (!grad) return NULL;
+        memset(grad, 0, sizeof(float) * (size_t)rows * cols);
+    }
+    n->grad = grad;
+    return n;
+}
+
+TapeNode *tape_dense(Tape *t, TapeNode *x, TapeNode *w, TapeNode *b) {
+    if (!x || !w) return NULL;
+    if (w->op != TAPE_PARAM || x->cols != w->cols) return NULL;
+    if (b && (b->op != TAPE_PARAM || b->rows != 1 || b->cols != w->rows)) return NULL;
+    TapeNode *n = push(t, TAPE_DENSE, x->rows, w->rows, NULL, x, w, b);
+    if (!n) return NULL;
+    kernels->dense_forward(x->value, w->value, b ? b->value : NULL, n->value, x->rows, x->cols, w->rows);
+    return n;
+}
+
+TapeNode *tape_layer(Tape *t, TapeNode *x, const NnDense *d, TapeNode *w, TapeNode *b) {
+    if (!x || x->cols != d->in) return NULL;
+    if (d->kind != NN_MAXPOOL) {
+        // The layer code reads d->w, so the parameters must be those
+        if (!w || !b || w->value != d->w || b->value != d->b) return NULL;
+    }
+    TapeNode *n = push(t, TAPE_LAYER, x->rows, d->out, NULL, x, w, b);
+    if (!n) return NULL;
+    n->layer = d;
+    if (nn_layer_col_floats(d)) {
+        n->col = arena_alloc(&t->arena, sizeof(float) * nn_layer_col_floats(d));
+        if (!n->col) return NULL;
+    }
+    if (d->kind == NN_MAXPOOL) {
+        n->argmax = arena_alloc(&t->arena, sizeof(int) * (size_t)x->rows * d->out);
+        if (!n->argmax) return NULL;
+    }
+    nn_layer_forward(d, x->value, n->value, x->rows, n->col, n->argmax);
+    return n;
+}
+
+TapeNode *tape_relu(Tape *t, TapeNode *x) {
+    if (!x) return NULL;
+    TapeNode *n = push(t, TAPE_RELU, x->rows, x->cols, NULL, x, NULL, NULL);
+    if (!n) return NULL;
+    size_t count = (size_t)x->rows * x->cols;
+    const float *restrict src = x->value;
+    float *restrict dst = n->value;
+    for (size_t i = 0; i < count; i++) dst[i] = src[i] > 0.0f ? src[i] : 0.0f;
+    return n;
+}
+
+TapeNode *tape_add(Tape *t, TapeNode *a, TapeNode *b) {
+    if (!a || !b || a->rows != b->rows || a->cols != b->cols) return NULL;
+    TapeNode *n = push(t, TAPE_ADD, a->rows, a->cols, NULL, a, b, NULL);
+    if (!n) return NULL;
+    size_t count = (size_t)a->rows * a->cols;
+    for (size_t i = 0; i < count; i++) n->value[i] = a->value[i] + b->value[i];
+    return n;
+}
+
+TapeNode *tape_softmax_xent(Tape *t, TapeNode *logits, const int *labels) {
+    if (!logits) return NULL;
+    TapeNode *n = push(t, TAPE_SOFTMAX_XENT, logits->rows, logits->cols, NULL, logits, NULL, NULL);
+    if (!n) return NULL;
+    n->labels = labels;
+    int classes = logits->cols;
+    memcpy(n->value, logits->value, sizeof(float) * (size_t)logits->rows * classes);
+    for (int r = 0; r < n->rows; r++) {
+        float *probs = n->value + (size_t)r * classes;
+        nn_softmax(probs, classes);
+        n->loss += -logf(fmaxf(probs[labels[r]], 1e-7f));
+        n->correct += nn_argmax(probs, classes) == labels[r];
+    }
+    return n;
+}
+
+// ------------------------------------------------------------
+// Backward
+// ------------------------------------------------------------
+
+// Where an op writes its share of x's gradient. The first share becomes
+// x->grad; later ones go to scratch that grad_end adds on. Parameters skip
+// this, their gradients are accumulated in place by the kernels. NULL when
+// x needs no gradient or the arena ran out (*ok is cleared then).
+static float *grad_begin(Tape *t, TapeNode *x, bool *ok) {
+    if (!x->needs_grad) return NULL;
+    float *g = alloc_floats(t, x->rows, x->cols);
+    if (!g) {
+        *ok = false;
+        return NULL;
+    }
+    if (!x->grad) x->grad = g;
+    return g;
+}
+
+static void grad_end(TapeNode *x, float *g) {
+    if (!g || g == x->grad) return;
+    size_t count = (size_t)x->rows * x->cols;
+    float *restrict dst = x->grad;
+    const float *restrict src = g;
+    for (size_t i = 0; i < count; i++) dst[i] += src[i];
+}
+
+static bool backprop(Tape *t, TapeNode *n) {
+    bool ok = true;
+    const float *dy = n->grad;
+    TapeNode *x = n->in[0];
+    switch (n->op) {
+        case TAPE_DENSE: {
+            TapeNode *w = n->in[1], *b = n->in_count > 2 ? n->in[2] : NULL;
+            kernels->dense_weight_grad(dy, x->value, w->grad, b ? b->grad : NULL, n->rows, x->cols, n->cols);
+            float *dx = grad_begin(t, x, &ok);
+            if (dx) kernels->dense_backward_data(dy, w->value, dx, n->rows, x->cols, n->cols);
+            grad_end(x, dx);
+        } break;
+        case TAPE_LAYER: {
+            TapeNode *w = n->in[1], *b = n->in[2];
+            float *dx = grad_begin(t, x, &ok);
+            nn_layer_backward(n->layer, x->value, dy, dx, w ? w->grad : NULL, b ? b->grad : NULL,
+                              n->rows, n->col, n->argmax);
+            grad_end(x, dx);
+        } break;
+        case TAPE_RELU: {
+            float *dx = grad_begin(t, x, &ok);
+            if (!dx) break;
+            size_t count = (size_t)n->rows * n->cols;
+            for (size_t i = 0; i < count; i++) dx[i] = n->value[i] > 0.0f ? dy[i] : 0.0f;
+            grad_end(x, dx);
+        } break;
+        case TAPE_ADD:
+            for (int i = 0; i < 2; i++) {
+                float *dx = grad_begin(t, n->in[i], &ok);
+                if (!dx) continue;
+                memcpy(dx, dy, sizeof(float) * (size_t)n->rows * n->cols);
+                grad_end(n->in[i], dx);
+            }
+            break;
+        default:
+            break;
+    }
+    return ok;
+}
+
+bool tape_backward(Tape *t, TapeNode *root) {
+    bool ok = true;
+    if (root->op == TAPE_SOFTMAX_XENT) {
+        // dLoss/dlogits = p - onehot, the softmax Jacobian folded in
+        TapeNode *x = root->in[0];
+        float *dx = grad_begin(t, x, &ok);
+        if (dx) {
+            memcpy(dx, root->value, sizeof(float) * (size_t)root->rows * root->cols);
+            for (int r = 0; r < root->rows; r++) dx[(size_t)r * root->cols + root->labels[r]] -= 1.0f;
+            grad_end(x, dx);
+        }
+    } else if (root->needs_grad) {
+        // Sum of the elements: every one contributes with weight 1
+        size_t count = (size_t)root->rows * root->cols;
+        float *g = alloc_floats(t, root->rows, root->cols);
+        if (!g) return false;
+        for (size_t i = 0; i < count; i++) g[i] = 1.0f;
+        if (root->grad) grad_end(root, g);
+        else root->grad = g;
+        ok = backprop(t, root);
+    }
+    for (TapeNode *n = root->prev; n && ok; n = n->prev) {
+        if (n->grad && n->op != TAPE_PARAM && n->op != TAPE_INPUT) ok = backprop(t, n);
+    }
+    return ok;
+}
+
+// ------------------------------------------------------------
+// Networks
+// ------------------------------------------------------------
+
+static const char *param_name(Tape *t, char kind, int layer) {
+    char *name = arena_alloc(&t->arena, 16);
+    if (name) snprintf(name, 16, "%c%d", kind, layer + 1);
+    return name;
+}
+
+TapeNode *tape_record_mlp(Tape *t, const Mlp *nn, float *input, int rows, const int *labels,
+                          float *const *gw, float *const *gb, TapeMlpLayer *layers) {
+    int last = nn->layer_count - 1;
+    // dLoss/dinput too, which nn_backward_batch also produces
+    TapeNode *x = tape_input(t, input, rows, nn->sizes[0], true);
+    if (layers) layers[0] = (TapeMlpLayer){ x, x };
+    for (int l = 0; l < last && x; l++) {
+        const NnDense *d = &nn->dense[l];
+        TapeNode *w = NULL, *b = NULL, *z;
+        if (d->kind != NN_MAXPOOL) {
+            w = tape_param(t, d->w, gw ? gw[l] : NULL, d->rows, d->cols, param_name(t, 'W', l));
+            b = tape_param(t, d->b, gb ? gb[l] : NULL, 1, d->rows, param_name(t, 'b', l));
+        }
+        if (d->kind == NN_DENSE) z = tape_dense(t, x, w, b);
+        else z = tape_layer(t, x, d, w, b);
+        x = l + 1 == last ? tape_softmax_xent(t, z, labels) : tape_relu(t, z);
+        if (layers) layers[l + 1] = (TapeMlpLayer){ x, z };
+    }
+    return x;
+}
@@ -0,0 +1,129 @@
+#ifndef TAPE_H_
+#define TAPE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "nn.h"
+
+// Bump allocator for one step's worth of graph and tensors. Reset instead
+// of freed: if a step outgrew the block, the next reset replaces the chain
+// with one block that fits, so a steady-state step allocates nothing.
+typedef struct ArenaBlock ArenaBlock;
+
+typedef struct {
+    ArenaBlock *head;     // block being filled, earlier ones behind it
+    size_t used;          // bytes handed out since the last reset
+    size_t peak;          // most used by any step
+    size_t capacity;      // of all blocks
+    long long grows;      // blocks added after init, each one a malloc on the hot path
+} Arena;
+
+bool arena_init(Arena *a, size_t size);
+void arena_free(Arena *a);
+void arena_reset(Arena *a);
+
+// KERNELS_ALIGN-aligned and uninitialized. NULL when out of memory.
+void *arena_alloc(Arena *a, size_t size);
+
+// Reverse-mode automatic differentiation over row-major [rows][cols]
+// tensors. Every op computes its value right away and appends a node to the
+// tape; tape_backward walks the nodes in reverse and hands each one's
+// gradient to its inputs. Values, gradients and the nodes themselves come
+// from the arena, so recording the same graph every step reuses the same
+// memory. The dense layers run on the active kernels in both directions.
+typedef enum {
+    TAPE_INPUT,          // leaf, caller's data
+    TAPE_PARAM,          // leaf, gradients accumulated for the optimizer
+    TAPE_DENSE,          // x W^T + b
+    TAPE_LAYER,          // convolution or pooling layer of an Mlp
+    TAPE_RELU,
+    TAPE_ADD,
+    TAPE_SOFTMAX_XENT,   // softmax probabilities, cross-entropy loss
+    TAPE_OP_COUNT
+} TapeOp;
+
+typedef struct TapeNode TapeNode;
+
+struct TapeNode {
+    TapeOp op;
+    int index;            // position on the tape
+    int rows, cols;
+    float *value;
+    float *grad;          // dLoss/dvalue, NULL until backward reaches the node
+    bool needs_grad;      // a parameter or a gradient-tracking input is upstream
+    TapeNode *in[3];
+    int in_count;
+    TapeNode *prev, *next;
+    const char *name;     // for drawing, may be NULL
+
+    // Op data
+    const NnDense *layer; // TAPE_LAYER geometry and weights
+    float *col;           // TAPE_LAYER convolution patches
+    int *argmax;          // TAPE_LAYER pooling maxima
+    const int *labels;    // TAPE_SOFTMAX_XENT, one per row
+    float loss;           // TAPE_SOFTMAX_XENT, summed over rows
+    int correct;
+};
+
+typedef struct {
+    Arena arena;
+    TapeNode *first, *last;
+    int count;
+} Tape;
+
+bool tape_init(Tape *t, size_t arena_size);
+void tape_free(Tape *t);
+
+// Forgets every node. Pointers from the previous recording are invalid.
+void tape_reset(Tape *t);
+
+// Ops return NULL when the arena is exhausted or the shapes do not fit, and
+// pass NULL inputs through, so a recording only needs its result checked.
+
+// `x` is used in place and must outlive the recording. With `grad` its
+// gradient is computed too.
+TapeNode *tape_input(Tape *t, float *x, int rows, int cols, bool grad);
+
+// Trainable tensor. Gradients are added to `grad` (zeroed by the caller
+// beforehand), or to an arena buffer when it is NULL.
+TapeNode *tape_param(Tape *t, float *value, float *grad, int rows, int cols, const char *name);
+
+// [rows][in] x with w a [out][in] parameter and b a [1][out] one (or NULL)
+TapeNode *tape_dense(Tape *t, TapeNode *x, TapeNode *w, TapeNode *b);
+
+// A convolution or pooling layer `d` over samples of x. w and b are the
+// parameters holding d->w and d->b, NULL for pooling.
+TapeNode *tape_layer(Tape *t, TapeNode *x, const NnDense *d, TapeNode *w, TapeNode *b);
+
+TapeNode *tape_relu(Tape *t, TapeNode *x);
+TapeNode *tape_add(Tape *t, TapeNode *a, TapeNode *b);
+
+// Row-wise softmax of the logits against one label per row. The value is
+// the probabilities; loss and correct count are on the node. Must be the
+// root of tape_backward.
+TapeNode *tape_softmax_xent(Tape *t, TapeNode *logits, const int *labels);
+
+// Gradients of `root` with respect to every node that needs them. A
+// TAPE_SOFTMAX_XENT root is differentiated as its summed loss, anything
+// else as the sum of its elements. Returns false if the arena ran out.
+bool tape_backward(Tape *t, TapeNode *root);
+
+const char *tape_op_name(TapeOp op);
+
+// The nodes holding one neuron layer of a recorded Mlp: its activations
+// (input, post-ReLU hidden layers, probabilities) and pre-activations
+// (dLoss/dz lives in z->grad; the input is both).
+typedef struct {
+    TapeNode *act;
+    TapeNode *z;
+} TapeMlpLayer;
+
+// Records the forward pass of `nn` over `rows` samples of `input` against
+// `labels` and returns the loss node. Weight layer l's gradients go to
+// gw[l] and gb[l] when given (laid out as in NnWorkspace), else to the
+// arena. `layers`, if not NULL, receives nn->layer_count entries.
+TapeNode *tape_record_mlp(Tape *t, const Mlp *nn, float *input, int rows, const int *labels,
+                          float *const *gw, float *const *gb, TapeMlpLayer *layers);
+
+#endif // TAPE_H_
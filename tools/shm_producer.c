@@ -0,0 +1,118 @@
+// Stand-in for an external training process. Trains a small network on
+// synthetic 16x16 glyphs with CONA's own trainer and pushes every step into
+// a shared-memory ring, the way a real trainer would. Set shm_source in
+// cona.cfg to the same name and start CONA while this runs. Built by nob.
+//
+//     ./shm_producer [name] [steps per second]    defaults: /cona_live 200
+#define _POSIX_C_SOURCE 200809L
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "shmring.h"
+#include "trainer.h"
+
+#define ROWS 16
+#define COLS 16
+
+static volatile sig_atomic_t quit = 0;
+
+static void on_signal(int sig) {
+    (void)sig;
+    quit = 1;
+}
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// A bright 5x5 block at one of ten places on a ring, per label, over noise
+static void glyph_sample_fn(void *user, NnRng *rng, float *input, int *label) {
+    (void)user;
+    int c = (int)(nn_rng_next(rng) % 10);
+    static const int at[10][2] = {
+        { 1, 5 }, { 1, 10 }, { 4, 13 }, { 8, 13 }, { 11, 10 },
+        { 11, 5 }, { 8, 1 }, { 4, 1 }, { 5, 7 }, { 8, 7 },
+    };
+    for (int i = 0; i < ROWS * COLS; i++) input[i] = nn_rng_float(rng) < 0.05f ? 0.5f : 0.0f;
+    int y0 = at[c][0] + (int)(nn_rng_next(rng) % 3) - 1, x0 = at[c][1] + (int)(nn_rng_next(rng) % 3) - 1;
+    for (int y = y0; y < y0 + 5; y++) {
+        for (int x = x0; x < x0 + 5; x++) {
+            if (y >= 0 && y < ROWS && x >= 0 && x < COLS) input[y * COLS + x] = 0.7f + 0.3f * nn_rng_float(rng);
+        }
+    }
+    *label = c;
+}
+
+int main(int argc, char **argv) {
+    const char *name = argc > 1 ? argv[1] : "/cona_live";
+    double rate = argc > 2 ? atof(argv[2]) : 200.0;
+    static const int sizes[] = { ROWS * COLS, 32, 16, 10 };
+    int layers = sizeof(sizes)/sizeof(sizes[0]);
+
+    kernels_init(NULL);
+    Trainer t;
+    ShmRing ring;
+    if (!trainer_init(&t, sizes, layers, 0.05f, 32, 1, 1)) {
+        fprintf(stderr, "ERROR: out of memory\n");
+        return 1;
+    }
+    t.sample_fn = glyph_sample_fn;
+    if (!shm_ring_create(&ring, name, sizes, layers, ROWS, COLS, 8)) return 1;
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+    printf("Publishing %d-%d-%d-%d to %s at %.0f steps/s, Ctrl-C to stop\n",
+           sizes[0], sizes[1], sizes[2], sizes[3], name, rate);
+
+    double next = now_seconds(), report = next + 1.0;
+    long long published = 0;
+    while (!quit) {
+        trainer_request_weights(&t); // every record carries them
+        trainer_step(&t, true);
+        const TrainSnapshot *s = trainer_snapshot(&t);
+        ShmRingSlot slot;
+        if (shm_ring_begin(&ring, &slot)) {
+            const ShmRingHeader *h = ring.header;
+            memcpy(slot.act, s->act, sizeof(float) * h->neuron_count);
+            memcpy(slot.err, s->err, sizeof(float) * h->neuron_count);
+            memcpy(slot.weights, s->weights, sizeof(float) * h->weight_count);
+            memcpy(slot.biases, s->biases, sizeof(float) * h->bias_count);
+            *slot.record = (ShmRingRecord){
+                .step = s->step,
+                .label = s->label,
+                .predicted = s->predicted,
+                .loss = s->loss,
+                .loss_avg = s->loss_avg,
+                .accuracy_avg = s->accuracy_avg,
+                .topology_version = s->topology_version,
+                .live_weights = s->live_weights,
+            };
+            shm_ring_publish(&ring);
+            published++;
+        }
+
+        double now = now_seconds();
+        if (now >= report) {
+            printf("step %lld  loss %.3f  accuracy %.0f%%  published %lld  dropped %llu\n",
+                   s->step, s->loss_avg, s->accuracy_avg * 100.0f, published,
+                   (unsigned long long)atomic_load(&ring.header->dropped));
+            report = now + 1.0;
+        }
+        if (rate > 0.0) {
+            next += 1.0 / rate;
+            if (next > now) {
+                double wait = next - now;
+                nanosleep(&(struct timespec){ .tv_sec = (time_t)wait, .tv_nsec = (long)((wait - (time_t)wait) * 1e9) }, NULL);
+            } else {
+                next = now;
+            }
+        }
+    }
+    shm_ring_close(&ring);
+    trainer_free(&t);
+    return 0;
+}
@@ -0,0 +1,567 @@
+#define _POSIX_C_SOURCE 200809L
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "trainer.h"
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void free_int8(Trainer *t) {
+    for (int i = 0; t->quant_scratch && i < t->task_count; i++) quant_scratch_free(&t->quant_scratch[i]);
+    free(t->quant_scratch);
+    t->quant_scratch = NULL;
+    quant_free(&t->quant);
+}
+
+bool trainer_init(Trainer *t, const int *sizes, int layer_count, float learning_rate,
+                  int batch_size, int threads, uint64_t seed) {
+    Mlp nn;
+    if (!nn_init(&nn, sizes, layer_count, seed)) {
+        memset(t, 0, sizeof(*t));
+        return false;
+    }
+    return trainer_init_from(t, &nn, learning_rate, batch_size, threads, seed);
+}
+
+bool trainer_init_from(Trainer *t, Mlp *nn, float learning_rate, int batch_size, int threads, uint64_t seed) {
+    memset(t, 0, sizeof(*t));
+    t->mlp = *nn;
+    memset(nn, 0, sizeof(*nn));
+    const int *sizes = t->mlp.sizes;
+    int layer_count = t->mlp.layer_count;
+    t->rng.state = seed * 0x9E3779B97F4A7C15ULL + 1;
+    t->learning_rate = learning_rate;
+    t->loss_avg = logf((float)sizes[layer_count - 1]);
+
+    t->batch_size = batch_size > 0 ? batch_size : 1;
+    t->threads = threads > 0 ? threads : parallel_cpu_count();
+    int max_tasks = (t->batch_size + TRAINER_MIN_ROWS_PER_TASK - 1) / TRAINER_MIN_ROWS_PER_TASK;
+    t->task_count = t->threads < max_tasks ? t->threads : max_tasks;
+    t->ws = calloc(t->task_count, sizeof(NnWorkspace));
+    if (!t->ws) {
+        trainer_free(t);
+        return false;
+    }
+    int capacity = (t->batch_size + t->task_count - 1) / t->task_count;
+    for (int i = 0; i < t->task_count; i++) {
+        if (!nn_workspace_init(&t->ws[i], &t->mlp, capacity, seed + 0x9E3779B97F4A7C15ULL * (i + 2))) {
+            trainer_free(t);
+            return false;
+        }
+    }
+
+    OptimParams sgd;
+    optim_defaults(&sgd, OPTIM_SGD);
+    if (!optim_init(&t->optim, &t->mlp, t->ws[0].gw, t->ws[0].gb, &sgd)) {
+        trainer_free(t);
+        return false;
+    }
+
+    for (int i = 0; i < layer_count; i++) t->neuron_count += sizes[i];
+    for (int i = 0; i < layer_count - 1; i++) t->weight_count += (int)nn_weight_count(&t->mlp.dense[i]);
+    for (int i = 0; i < layer_count - 1; i++) t->bias_count += t->mlp.dense[i].rows;
+    t->live_weights = t->weight_count;
+    for (int i = 0; i < layer_count - 1; i++) {
+        const NnDense *d = &t->mlp.dense[i];
+        if (!d->mask) continue;
+        size_t n = nn_weight_count(d);
+        for (size_t k = 0; k < n; k++) t->live_weights -= !d->mask[k];
+    }
+
+    for (int i = 0; i < 3; i++) {
+        TrainSnapshot *s = &t->snapshots[i];
+        s->act = calloc(t->neuron_count, sizeof(float));
+        s->err = calloc(t->neuron_count, sizeof(float));
+        s->step = -1;
+        TrainWeights *w = &t->weight_sets[i];
+        w->weights = calloc(t->weight_count, sizeof(float));
+        w->biases = calloc(t->bias_count, sizeof(float));
+        w->step = -1;
+        if (!s->act || !s->err || !w->weights || !w->biases) {
+            trainer_free(t);
+            return false;
+        }
+    }
+    t->history_items = malloc(sizeof(TrainerPoint) * TRAINER_HISTORY_CAPACITY);
+    if (!t->history_items) {
+        trainer_free(t);
+        return false;
+    }
+    spsc_queue_init(&t->history, t->history_items, sizeof(TrainerPoint), TRAINER_HISTORY_CAPACITY);
+    triple_buffer_init(&t->tb);
+    triple_buffer_init(&t->weights_tb);
+    atomic_store(&t->weights_wanted, true);
+    t->quant_stale = true;
+    return true;
+}
+
+void trainer_free(Trainer *t) {
+    trainer_stop(t);
+    for (int i = 0; t->ws && i < t->task_count; i++) nn_workspace_free(&t->ws[i], &t->mlp);
+    free(t->ws);
+    optim_free(&t->optim);
+    trainer_set_autodiff(t, false);
+    free_int8(t);
+    trainer_set_edges(t, 0); // sized by the layer count
+    nn_free(&t->mlp);
+    for (int i = 0; i < 3; i++) {
+        free(t->snapshots[i].act);
+        free(t->snapshots[i].err);
+        free(t->weight_sets[i].weights);
+        free(t->weight_sets[i].biases);
+    }
+    trainer_set_view(t, 0);
+    free(t->history_items);
+    memset(t, 0, sizeof(*t));
+}
+
+bool trainer_set_optimizer(Trainer *t, const OptimParams *params) {
+    Optimizer o;
+    if (!optim_init(&o, &t->mlp, t->ws[0].gw, t->ws[0].gb, params)) return false;
+    optim_free(&t->optim);
+    t->optim = o;
+    return true;
+}
+
+bool trainer_set_autodiff(Trainer *t, bool enabled) {
+    if (!enabled) {
+        for (int i = 0; t->tapes && i < t->task_count; i++) tape_free(&t->tapes[i]);
+        free(t->tapes);
+        t->tapes = NULL;
+        return true;
+    }
+    if (t->tapes) return true;
+    t->tapes = calloc(t->task_count, sizeof(Tape));
+    if (!t->tapes) return false;
+    for (int i = 0; i < t->task_count; i++) {
+        if (!tape_init(&t->tapes[i], TRAINER_TAPE_ARENA)) {
+            trainer_set_autodiff(t, false);
+            return false;
+        }
+    }
+    return true;
+}
+
+bool trainer_set_topology(Trainer *t, float density, float prune_threshold, uint64_t seed) {
+    t->prune_threshold = prune_threshold;
+    if (density >= 1.0f) return true;
+    long long live = nn_sparsify(&t->mlp, density, seed);
+    if (live < 0) return false;
+    t->live_weights = live;
+    t->topology_version++;
+    return true;
+}
+
+// Copies activations and errors of row 0 of the first sub-batch. Called
+// between backward and the weight update, like capture_weights. Inference
+// steps have no errors and publish zeros.
+static void capture_sample(Trainer *t, TrainSnapshot *s, bool errors) {
+    const Mlp *nn = &t->mlp;
+    const NnWorkspace *ws = &t->ws[0];
+    int off = 0;
+    for (int l = 0; l < nn->layer_count; l++) {
+        memcpy(s->act + off, ws->act[l], sizeof(float) * nn->sizes[l]);
+        if (errors) memcpy(s->err + off, ws->delta[l], sizeof(float) * nn->sizes[l]);
+        else memset(s->err + off, 0, sizeof(float) * nn->sizes[l]);
+        off += nn->sizes[l];
+    }
+    const float *probs = ws->act[nn->layer_count - 1];
+    s->label = ws->labels[0];
+    s->predicted = nn_argmax(probs, nn_output_size(nn));
+    s->loss = -logf(fmaxf(probs[s->label], 1e-7f));
+
+    // The batch view's rows, from as many sub-batches as hold them
+    int row = 0, out = nn_output_size(nn);
+    for (int task = 0; task < t->task_count && row < t->view_rows; task++) {
+        const NnWorkspace *w = &t->ws[task];
+        for (int r = 0; r < w->rows && row < t->view_rows; r++, row++) {
+            float *dst = s->view_act + (size_t)row * t->neuron_count;
+            for (int l = 0; l < nn->layer_count; l++) {
+                memcpy(dst, w->act[l] + (size_t)r * nn->sizes[l], sizeof(float) * nn->sizes[l]);
+                dst += nn->sizes[l];
+            }
+            s->view_labels[row] = w->labels[r];
+            s->view_predicted[row] = nn_argmax(w->act[nn->layer_count - 1] + (size_t)r * out, out);
+        }
+    }
+    s->view_rows = row;
+}
+
+// Whether this step's snapshot carries the weights: only when they were
+// asked for, and then before the update, so they are the weights the
+// captured sample ran on
+static bool weights_requested(Trainer *t) {
+    return atomic_exchange_explicit(&t->weights_wanted, false, memory_order_relaxed);
+}
+
+static void capture_weights(Trainer *t, long long step) {
+    TrainWeights *w = &t->weight_sets[triple_buffer_back(&t->weights_tb)];
+    const Mlp *nn = &t->mlp;
+    int off = 0, boff = 0;
+    for (int l = 0; l < nn->layer_count - 1; l++) {
+        const NnDense *d = &nn->dense[l];
+        int n = (int)nn_weight_count(d);
+        if (n) memcpy(w->weights + off, d->w, sizeof(float) * n);
+        if (d->rows) memcpy(w->biases + boff, d->b, sizeof(float) * d->rows);
+        if (w->edges && d->kind == NN_DENSE
+            && !synapse_build(&w->edges[l], w->weights + off, d->cols, d->rows, t->max_edges)) {
+            fprintf(stderr, "ERROR: out of memory for the edges of layer %d\n", l);
+        }
+        off += n;
+        boff += d->rows;
+    }
+    w->step = step;
+    w->topology_version = t->topology_version;
+    w->live_weights = t->live_weights;
+    triple_buffer_publish(&t->weights_tb);
+    t->weights_unread = true;
+}
+
+// A snapshot that came with weights stays until the reader has taken it
+static bool can_publish(Trainer *t) {
+    if (t->weights_unread && triple_buffer_unread(&t->tb)) return false;
+    t->weights_unread = false;
+    return true;
+}
+
+// Forward and backward of one sub-batch through the task's tape. The
+// results land where nn_backward_batch puts them, except that only what
+// the snapshot reads is copied back: row 0 of the errors, and the
+// activations of row 0 and of the batch view's rows. False if the tape
+// could not be recorded.
+static bool tape_batch(Trainer *t, int task, NnWorkspace *ws) {
+    const Mlp *nn = &t->mlp;
+    Tape *tape = &t->tapes[task];
+    tape_reset(tape);
+    TapeMlpLayer *layers = arena_alloc(&tape->arena, sizeof(TapeMlpLayer) * nn->layer_count);
+    if (!layers) return false;
+    memset(ws->grad, 0, sizeof(float) * ws->grad_size);
+    TapeNode *loss = tape_record_mlp(tape, nn, ws->act[0], ws->rows, ws->labels, ws->gw, ws->gb, layers);
+    if (!loss || !tape_backward(tape, loss)) return false;
+    ws->loss += loss->loss;
+    ws->correct += loss->correct;
+    int rows = t->view_rows - (int)((long long)t->batch_size * task / t->task_count);
+    if (rows > ws->rows) rows = ws->rows;
+    if (task == 0 && rows < 1) rows = 1;
+    for (int l = 0; l < nn->layer_count && rows > 0; l++) {
+        memcpy(ws->act[l], layers[l].act->value, sizeof(float) * nn->sizes[l] * rows);
+        if (task == 0) memcpy(ws->delta[l], layers[l].z->grad, sizeof(float) * nn->sizes[l]);
+    }
+    return true;
+}
+
+// Sample, forward and backward (or scoring only, when inferring) for one
+// sub-batch into its own workspace
+static void batch_task(void *ctx, int task, int worker) {
+    (void)worker;
+    Trainer *t = ctx;
+    NnWorkspace *ws = &t->ws[task];
+    int begin = (int)((long long)t->batch_size * task / t->task_count);
+    int end = (int)((long long)t->batch_size * (task + 1) / t->task_count);
+    int in = t->mlp.sizes[0];
+
+    ws->rows = end - begin;
+    ws->loss = 0.0f;
+    ws->correct = 0;
+    for (int r = 0; r < ws->rows; r++) {
+        t->sample_fn(t->sample_user, &ws->rng, ws->act[0] + (size_t)r * in, &ws->labels[r]);
+    }
+    switch (t->step_mode) {
+        case TRAINER_TRAIN:
+            if (t->tapes && tape_batch(t, task, ws)) break;
+            nn_forward_batch(&t->mlp, ws);
+            nn_backward_batch(&t->mlp, ws);
+            break;
+        case TRAINER_INFER_FLOAT:
+            nn_forward_batch(&t->mlp, ws);
+            nn_score_batch(&t->mlp, ws);
+            break;
+        default:
+            quant_forward_batch(&t->quant, &t->quant_scratch[task], ws);
+            nn_score_batch(&t->mlp, ws);
+            break;
+    }
+}
+
+// Builds or refreshes the int8 network before an int8 step
+static bool prepare_int8(Trainer *t) {
+    if (!t->quant_scratch) {
+        bool ok = quant_init(&t->quant, &t->mlp);
+        t->quant_scratch = ok ? calloc(t->task_count, sizeof(QuantScratch)) : NULL;
+        ok = ok && t->quant_scratch;
+        for (int i = 0; ok && i < t->task_count; i++) {
+            ok = quant_scratch_init(&t->quant_scratch[i], &t->quant, t->ws[i].capacity);
+        }
+        if (!ok) {
+            free_int8(t);
+            return false;
+        }
+    } else if (t->quant_stale) {
+        quant_update(&t->quant, &t->mlp);
+    }
+    t->quant_stale = false;
+    return true;
+}
+
+void trainer_set_pace(Trainer *t, double steps_per_second) {
+    atomic_store_explicit(&t->pace, steps_per_second > 0.0 ? steps_per_second : 0.0, memory_order_relaxed);
+}
+
+void trainer_set_mode(Trainer *t, TrainerMode mode) {
+    atomic_store_explicit(&t->mode, (int)mode, memory_order_relaxed);
+}
+
+const char *trainer_mode_name(TrainerMode mode) {
+    switch (mode) {
+        case TRAINER_TRAIN:       return "train";
+        case TRAINER_INFER_FLOAT: return "float";
+        case TRAINER_INFER_INT8:  return "int8";
+        default:                  return "?";
+    }
+}
+
+typedef struct {
+    Trainer *t;
+    int stride;          // ws[i] += ws[i + stride] for i a multiple of 2*stride
+    int chunks;          // TRAINER_REDUCE_CHUNK slices per pair
+} ReduceLevel;
+
+static void reduce_task(void *ctx, int task, int worker) {
+    (void)worker;
+    ReduceLevel *lv = ctx;
+    int pair = task / lv->chunks;
+    int chunk = task % lv->chunks;
+    NnWorkspace *dst = &lv->t->ws[pair * 2 * lv->stride];
+    const NnWorkspace *src = &lv->t->ws[pair * 2 * lv->stride + lv->stride];
+
+    size_t begin = (size_t)chunk * TRAINER_REDUCE_CHUNK;
+    size_t end = begin + TRAINER_REDUCE_CHUNK;
+    if (end > dst->grad_size) end = dst->grad_size;
+    float *restrict d = dst->grad;
+    const float *restrict s = src->grad;
+    for (size_t i = begin; i < end; i++) d[i] += s[i];
+}
+
+// Sums the sub-batch losses into the moving averages. Returns the summed
+// loss of the batch and its number of correct predictions.
+static float accumulate_averages(Trainer *t, int *batch_correct) {
+    float loss = 0.0f;
+    int correct = 0;
+    for (int i = 0; i < t->task_count; i++) {
+        loss += t->ws[i].loss;
+        correct += t->ws[i].correct;
+    }
+    float inv = 1.0f / t->batch_size;
+    // Moving averages with the same time constant per sample as before,
+    // independent of the batch size
+    float keep = powf(0.99f, (float)t->batch_size);
+    t->loss_avg = t->loss_avg * keep + loss * inv * (1.0f - keep);
+    t->accuracy_avg = t->accuracy_avg * keep + correct * inv * (1.0f - keep);
+    if (batch_correct) *batch_correct = correct;
+    return loss;
+}
+
+static void publish_snapshot(Trainer *t, TrainSnapshot *s, long long step) {
+    s->loss_avg = t->loss_avg;
+    s->accuracy_avg = t->accuracy_avg;
+    s->step = step;
+    triple_buffer_publish(&t->tb);
+}
+
+// The end of an inference step: statistics and the snapshot, no update
+static float infer_finish(Trainer *t, bool publish) {
+    float loss = accumulate_averages(t, NULL);
+    atomic_fetch_add_explicit(&t->samples, t->batch_size, memory_order_relaxed);
+    if (publish) {
+        TrainSnapshot *s = &t->snapshots[triple_buffer_back(&t->tb)];
+        capture_sample(t, s, false);
+        if (weights_requested(t)) capture_weights(t, trainer_steps(t));
+        publish_snapshot(t, s, trainer_steps(t));
+    }
+    return loss / t->batch_size;
+}
+
+float trainer_step(Trainer *t, bool publish) {
+    if (!t->pool && t->threads > 1 && t->task_count > 1) t->pool = pool_create(t->threads);
+    publish = publish && can_publish(t);
+    t->step_mode = trainer_mode(t);
+    if (t->step_mode == TRAINER_INFER_INT8 && !prepare_int8(t)) {
+        fprintf(stderr, "ERROR: could not build the int8 network, inferring in float\n");
+        t->step_mode = TRAINER_INFER_FLOAT;
+        trainer_set_mode(t, TRAINER_INFER_FLOAT);
+    }
+    pool_run(t->pool, t->task_count, batch_task, t);
+    if (t->step_mode != TRAINER_TRAIN) return infer_finish(t, publish);
+
+    // log2(tasks) levels; every level is split over pairs x chunks so all
+    // workers share the memory traffic of large gradients
+    int chunks = (int)((t->ws[0].grad_size + TRAINER_REDUCE_CHUNK - 1) / TRAINER_REDUCE_CHUNK);
+    for (int stride = 1; stride < t->task_count; stride *= 2) {
+        int pairs = 0;
+        for (int i = 0; i + stride < t->task_count; i += 2 * stride) pairs++;
+        ReduceLevel lv = { .t = t, .stride = stride, .chunks = chunks };
+        pool_run(t->pool, pairs * chunks, reduce_task, &lv);
+    }
+
+    int correct;
+    float loss = accumulate_averages(t, &correct);
+    float inv = 1.0f / t->batch_size;
+
+    TrainSnapshot *s = &t->snapshots[triple_buffer_back(&t->tb)];
+    if (publish) capture_sample(t, s, true);
+    if (publish && weights_requested(t)) capture_weights(t, trainer_steps(t) + 1);
+
+    optim_step(&t->optim, t->pool, t->learning_rate, inv);
+    t->quant_stale = true;
+    long long step = atomic_fetch_add_explicit(&t->steps, 1, memory_order_relaxed) + 1;
+    atomic_fetch_add_explicit(&t->samples, t->batch_size, memory_order_relaxed);
+
+    if (t->prune_threshold > 0.0f && step % TRAINER_PRUNE_INTERVAL == 0) {
+        long long removed = nn_prune(&t->mlp, t->prune_threshold);
+        if (removed > 0) {
+            t->live_weights -= removed;
+            t->topology_version++;
+        }
+    }
+
+    TrainerPoint point = { step, loss * inv, correct * inv };
+    if (spsc_queue_push(&t->history, &point, 1) == 0) {
+        atomic_fetch_add_explicit(&t->history_dropped, 1, memory_order_relaxed);
+    }
+
+    if (publish) publish_snapshot(t, s, step);
+    return loss * inv;
+}
+
+static void sleep_seconds(double seconds) {
+    struct timespec ts = { (time_t)seconds, (long)((seconds - (time_t)seconds) * 1e9) };
+    nanosleep(&ts, NULL);
+}
+
+static void *trainer_main(void *arg) {
+    Trainer *t = arg;
+    double next_publish = now_seconds();
+    double next_checkpoint = next_publish + t->checkpoint_interval;
+    double next_step = next_publish;
+    while (atomic_load_explicit(&t->running, memory_order_relaxed)) {
+        double now = now_seconds();
+        double pace = atomic_load_explicit(&t->pace, memory_order_relaxed);
+        if (pace > 0.0) {
+            // A faster pace set while waiting shortens the wait
+            if (next_step > now + 1.0 / pace) next_step = now + 1.0 / pace;
+            if (now < next_step) {
+                double wait = next_step - now;
+                sleep_seconds(wait < TRAINER_PACE_SLICE ? wait : TRAINER_PACE_SLICE);
+                continue;
+            }
+            next_step = next_step + 1.0 / pace > now ? next_step + 1.0 / pace : now;
+        }
+        bool publish = now >= next_publish;
+        trainer_step(t, publish);
+        if (publish) next_publish = now + TRAINER_PUBLISH_INTERVAL;
+        if (t->checkpoint && now >= next_checkpoint) {
+            checkpoint_capture(t->checkpoint, &t->mlp);
+            next_checkpoint = now + t->checkpoint_interval;
+        }
+    }
+    return NULL;
+}
+
+bool trainer_set_view(Trainer *t, int rows) {
+    if (rows > TRAINER_VIEW_ROWS) rows = TRAINER_VIEW_ROWS;
+    if (rows > t->batch_size) rows = t->batch_size;
+    if (rows < 0) rows = 0;
+    bool ok = true;
+    for (int i = 0; i < 3; i++) {
+        TrainSnapshot *s = &t->snapshots[i];
+        free(s->view_act);
+        free(s->view_labels);
+        free(s->view_predicted);
+        s->view_act = NULL;
+        s->view_labels = s->view_predicted = NULL;
+        s->view_rows = 0;
+        if (rows == 0) continue;
+        s->view_act = malloc(sizeof(float) * (size_t)rows * t->neuron_count);
+        s->view_labels = malloc(sizeof(int) * rows);
+        s->view_predicted = malloc(sizeof(int) * rows);
+        ok = ok && s->view_act && s->view_labels && s->view_predicted;
+    }
+    if (!ok) {
+        trainer_set_view(t, 0);
+        return false;
+    }
+    t->view_rows = rows;
+    return true;
+}
+
+bool trainer_set_edges(Trainer *t, int max_edges) {
+    int layers = t->mlp.layer_count - 1;
+    for (int i = 0; i < 3; i++) {
+        TrainWeights *w = &t->weight_sets[i];
+        for (int l = 0; w->edges && l < layers; l++) synapse_free(&w->edges[l]);
+        free(w->edges);
+        w->edges = NULL;
+    }
+    t->max_edges = 0;
+    if (max_edges <= 0) return true;
+    for (int i = 0; i < 3; i++) {
+        t->weight_sets[i].edges = calloc(layers, sizeof(SynapseCsr));
+        if (!t->weight_sets[i].edges) {
+            trainer_set_edges(t, 0);
+            return false;
+        }
+    }
+    t->max_edges = max_edges;
+    return true;
+}
+
+void trainer_set_checkpoint(Trainer *t, Checkpointer *c, double interval) {
+    t->checkpoint = c;
+    t->checkpoint_interval = interval;
+}
+
+bool trainer_start(Trainer *t, TrainSampleFn sample_fn, void *user) {
+    if (t->thread_started) return true;
+    t->sample_fn = sample_fn;
+    t->sample_user = user;
+    atomic_store(&t->running, true);
+    if (pthread_create(&t->thread, NULL, trainer_main, t) != 0) {
+        atomic_store(&t->running, false);
+        return false;
+    }
+    t->thread_started = true;
+    return true;
+}
+
+void trainer_stop(Trainer *t) {
+    if (t->thread_started) {
+        atomic_store(&t->running, false);
+        pthread_join(t->thread, NULL);
+        t->thread_started = false;
+    }
+    // Pool workers run code from this module too, so they go with the thread
+    pool_destroy(t->pool);
+    t->pool = NULL;
+}
+
+const TrainSnapshot *trainer_snapshot(Trainer *t) {
+    triple_buffer_acquire(&t->tb);
+    TrainSnapshot *s = &t->snapshots[triple_buffer_front(&t->tb)];
+    // Weights go out before their snapshot, so these are at least as new
+    triple_buffer_acquire(&t->weights_tb);
+    const TrainWeights *w = &t->weight_sets[triple_buffer_front(&t->weights_tb)];
+    s->weights = w->weights;
+    s->biases = w->biases;
+    s->weights_step = w->step;
+    s->edges = w->edges;
+    s->topology_version = w->topology_version;
+    s->live_weights = w->live_weights;
+    return s->step < 0 ? NULL : s;
+}
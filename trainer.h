@@ -0,0 +1,267 @@
+#ifndef TRAINER_H_
+#define TRAINER_H_
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+
+#include "checkpoint.h"
+#include "nn.h"
+#include "optim.h"
+#include "parallel.h"
+#include "quant.h"
+#include "spsc_queue.h"
+#include "synapse.h"
+#include "tape.h"
+#include "triple_buffer.h"
+
+// Minimum time between snapshots. The renderer never needs more than one
+// per frame.
+#define TRAINER_PUBLISH_INTERVAL (1.0 / 120.0)
+
+// Smallest sub-batch worth handing to a thread; below this the per-task
+// overhead and the gradient reduction outweigh the GEMM.
+#define TRAINER_MIN_ROWS_PER_TASK 8
+
+// Floats per reduction task, so large gradients are summed by all workers
+#define TRAINER_REDUCE_CHUNK 16384
+
+// Steps between magnitude pruning passes, when pruning is enabled
+#define TRAINER_PRUNE_INTERVAL 1000
+
+// Longest the worker sleeps at a time while paced, so a new pace applies
+// within this many seconds
+#define TRAINER_PACE_SLICE 0.005
+
+// Initial arena of each task's autodiff tape; the first step grows it to fit
+#define TRAINER_TAPE_ARENA (1u << 20)
+
+// Most samples of a batch a snapshot carries for the batch view
+#define TRAINER_VIEW_ROWS 64
+
+// Steps of history the renderer can fall behind by before points are dropped
+#define TRAINER_HISTORY_CAPACITY (1u << 16)
+
+// Everything the renderer needs about one training step. Arrays are
+// concatenated over layers; offsets come from the network topology.
+typedef struct {
+    float *act;        // activations of the published sample, input included
+    float *err;        // dLoss/dz of the published sample
+    float *weights;    // all weight matrices in layer order, as of weights_step
+    float *biases;     // all bias vectors, likewise
+    long long weights_step; // step whose sample ran on these weights
+    const SynapseCsr *edges; // per weight layer, built from these weights; NULL if not built
+    int label;         // the published sample is row 0 of the batch
+    int predicted;
+    float loss;        // loss of the published sample
+    float loss_avg;    // moving averages over all samples
+    float accuracy_avg;
+    long long step;    // mini-batch updates so far
+    int topology_version;   // changes whenever weights are removed, goes with the weights
+    long long live_weights;
+
+    // The first view_rows samples of the batch, for the batch view. Row r
+    // of view_act is laid out like act. Absent (0 rows) from other sources.
+    int view_rows;
+    float *view_act;        // [view_rows][neuron_count]
+    int *view_labels;
+    int *view_predicted;
+} TrainSnapshot;
+
+// The weights as the sample of one step saw them, before its update. They
+// are copied only when the renderer asks, not with every snapshot: a large
+// network's weights take tens of milliseconds to copy.
+typedef struct {
+    float *weights;
+    float *biases;
+    long long step;
+    int topology_version;
+    long long live_weights;
+    SynapseCsr *edges;    // per weight layer, see trainer_set_edges
+} TrainWeights;
+
+// Loss and accuracy of one training mini-batch, for plots of the whole run
+typedef struct {
+    long long step;
+    float loss;
+    float accuracy;
+} TrainerPoint;
+
+// What every step of the worker does. Inference modes leave the weights
+// alone and publish snapshots without errors; samples/s then measures
+// inference throughput.
+typedef enum {
+    TRAINER_TRAIN,        // forward, backward, SGD update
+    TRAINER_INFER_FLOAT,  // forward only, float kernels
+    TRAINER_INFER_INT8,   // forward only, int8 copy of the weights
+    TRAINER_MODE_COUNT
+} TrainerMode;
+
+// Produces one training sample. Runs on several pool workers at once, each
+// with its own rng, so it must not touch shared mutable state.
+typedef void (*TrainSampleFn)(void *user, NnRng *rng, float *input, int *label);
+
+typedef struct {
+    Mlp mlp;             // owned by the worker while it runs
+    NnRng rng;
+    float learning_rate;
+    float loss_avg;
+    float accuracy_avg;
+
+    // Every step splits batch_size samples into task_count sub-batches. Each
+    // task owns a workspace with its own gradient buffer; the buffers are
+    // summed pairwise in a tree before one optimizer update.
+    int batch_size;
+    int threads;         // pool size including the training thread
+    int task_count;
+    NnWorkspace *ws;
+    ThreadPool *pool;    // created on demand, torn down by trainer_stop
+    Optimizer optim;     // applies the summed gradients, SGD unless set
+    Tape *tapes;         // one per task when backward runs on the autodiff tape, else NULL
+
+    // Sparse topology. Removed weights are held at exactly zero by the
+    // update, so the dense kernels still apply and readers of the weights
+    // can tell live connections by w != 0.
+    float prune_threshold;  // 0 = never prune
+    long long live_weights;
+    int topology_version;
+
+    // Requested mode, may be changed from any thread. The int8 network is
+    // built on first use and requantized whenever training moved the
+    // weights in between.
+    _Atomic int mode;
+    TrainerMode step_mode;       // mode of the step in progress
+    QuantMlp quant;
+    QuantScratch *quant_scratch; // one per task
+    bool quant_stale;
+
+    TrainSampleFn sample_fn;
+    void *sample_user;
+
+    int view_rows;       // batch samples every snapshot carries, see trainer_set_view
+    int max_edges;       // of every edge list built with the weights, 0 = none built
+
+    // Optional background checkpoints, captured between steps
+    Checkpointer *checkpoint;
+    double checkpoint_interval;  // seconds
+
+    // Steps per second the worker is held to, 0 = as fast as it can. Written
+    // by any thread, read by the worker before every step.
+    _Atomic double pace;
+
+    pthread_t thread;
+    bool thread_started;
+    atomic_bool running;
+    _Atomic long long steps;
+    _Atomic long long samples;
+
+    // Every training step pushes a TrainerPoint, the renderer drains them.
+    // Points that do not fit are counted and dropped.
+    SpscQueue history;
+    TrainerPoint *history_items;
+    _Atomic long long history_dropped;
+
+    TripleBuffer tb;
+    TrainSnapshot snapshots[3];
+
+    // Weights travel in their own buffers, published before the snapshot
+    // of the same step. That snapshot is not replaced until the reader has
+    // taken it, so a requested set is never skipped.
+    atomic_bool weights_wanted;
+    bool weights_unread;
+    TripleBuffer weights_tb;
+    TrainWeights weight_sets[3];
+    int neuron_count;
+    int weight_count;
+    int bias_count;
+} Trainer;
+
+// threads = 0 uses one per CPU, batch_size = 1 is plain per-sample SGD.
+bool trainer_init(Trainer *t, const int *sizes, int layer_count, float learning_rate,
+                  int batch_size, int threads, uint64_t seed);
+
+// Same, but trains an existing network (e.g. one bound to a mapped model
+// file). The trainer takes ownership of `nn` and clears it.
+bool trainer_init_from(Trainer *t, Mlp *nn, float learning_rate, int batch_size, int threads, uint64_t seed);
+void trainer_free(Trainer *t);
+
+// Replaces the optimizer, with fresh state. Call before trainer_start.
+bool trainer_set_optimizer(Trainer *t, const OptimParams *params);
+
+// Records every training sub-batch on an autodiff tape and differentiates
+// that instead of running the hand-written backward pass. Same gradients,
+// so it can be switched at any time between steps; call before
+// trainer_start.
+bool trainer_set_autodiff(Trainer *t, bool enabled);
+
+// Keeps a random `density` fraction of the connections (1 = fully
+// connected) and, if prune_threshold > 0, removes weights below it every
+// TRAINER_PRUNE_INTERVAL steps. Call before trainer_start.
+bool trainer_set_topology(Trainer *t, float density, float prune_threshold, uint64_t seed);
+
+// Publishes the first `rows` samples of every batch (at most
+// TRAINER_VIEW_ROWS and batch_size) with the snapshots, 0 none. Call
+// before trainer_start.
+bool trainer_set_view(Trainer *t, int rows);
+
+// Builds an edge list (synapse.h) of every dense layer with each weight set
+// it publishes, keeping about the `max_edges` strongest. The selection has
+// to scan whole matrices, so it runs here rather than on the reader. 0 stops
+// building them. Call before trainer_start.
+bool trainer_set_edges(Trainer *t, int max_edges);
+
+// Captures the weights into `c` every `interval` seconds from the worker
+// thread. The checkpointer must outlive the trainer's thread. NULL disables.
+void trainer_set_checkpoint(Trainer *t, Checkpointer *c, double interval);
+
+// Never blocks, so the renderer can change it mid-frame. Time the worker
+// spent unpaced or behind is not caught up on.
+void trainer_set_pace(Trainer *t, double steps_per_second);
+
+void trainer_set_mode(Trainer *t, TrainerMode mode);
+const char *trainer_mode_name(TrainerMode mode);
+
+static inline TrainerMode trainer_mode(Trainer *t) {
+    return (TrainerMode)atomic_load_explicit(&t->mode, memory_order_relaxed);
+}
+
+// The sample function is passed on every start because its address changes
+// when the plugin is hot reloaded.
+bool trainer_start(Trainer *t, TrainSampleFn sample_fn, void *user);
+void trainer_stop(Trainer *t);
+
+// One mini-batch step on the calling thread plus the pool. This is what the
+// worker loop runs; exposed so benchmarks can drive it without the thread.
+// Returns the mean loss of the batch.
+float trainer_step(Trainer *t, bool publish);
+
+// Renderer side: latest published snapshot, never blocks. NULL before the
+// first publish. Its weights are the latest set published, which is the
+// snapshot's own when weights_step == step.
+const TrainSnapshot *trainer_snapshot(Trainer *t);
+
+// Renderer side: the next snapshot published carries the weights. The first
+// one always does.
+static inline void trainer_request_weights(Trainer *t) {
+    atomic_store_explicit(&t->weights_wanted, true, memory_order_relaxed);
+}
+
+// Renderer side: history points in order, in place. Consume them before
+// peeking again; a second peek returns the rest when the queue wrapped.
+static inline size_t trainer_history_peek(Trainer *t, const TrainerPoint **points) {
+    return spsc_queue_peek(&t->history, (const void **)points);
+}
+
+static inline void trainer_history_consume(Trainer *t, size_t count) {
+    spsc_queue_consume(&t->history, count);
+}
+
+static inline long long trainer_steps(Trainer *t) {
+    return atomic_load_explicit(&t->steps, memory_order_relaxed);
+}
+
+static inline long long trainer_samples(Trainer *t) {
+    return atomic_load_explicit(&t->samples, memory_order_relaxed);
+}
+
+#endif // TRAINER_H_
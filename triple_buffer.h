@@ -0,0 +1,56 @@
+#ifndef TRIPLE_BUFFER_H_
+#define TRIPLE_BUFFER_H_
+
+#include <stdatomic.h>
+#include <stdbool.h>
+
+// Lock-free triple buffer index exchange for one writer and one reader. The
+// caller owns three slots; the writer fills `back`, the reader looks at
+// `front`, and the third slot is parked in `middle` between them. Neither
+// side ever waits: the writer can publish as often as it likes and the
+// reader always gets the most recent complete slot.
+#define TRIPLE_BUFFER_FRESH 4
+
+typedef struct {
+    _Atomic int middle; // slot index, ORed with TRIPLE_BUFFER_FRESH when unread
+    int back;           // writer-owned
+    int front;          // reader-owned
+} TripleBuffer;
+
+static inline void triple_buffer_init(TripleBuffer *tb) {
+    tb->back = 0;
+    atomic_store(&tb->middle, 1);
+    tb->front = 2;
+}
+
+// Writer: returns the slot to fill.
+static inline int triple_buffer_back(const TripleBuffer *tb) {
+    return tb->back;
+}
+
+// Writer: hand the filled back slot to the reader and take a free one.
+static inline void triple_buffer_publish(TripleBuffer *tb) {
+    int prev = atomic_exchange_explicit(&tb->middle, tb->back | TRIPLE_BUFFER_FRESH, memory_order_acq_rel);
+    tb->back = prev & ~TRIPLE_BUFFER_FRESH;
+}
+
+// Writer: true while the last published slot has not been acquired.
+static inline bool triple_buffer_unread(const TripleBuffer *tb) {
+    return atomic_load_explicit(&tb->middle, memory_order_acquire) & TRIPLE_BUFFER_FRESH;
+}
+
+// Reader: switch to the newest published slot if there is one. Returns true
+// when the front slot changed.
+static inline bool triple_buffer_acquire(TripleBuffer *tb) {
+    if (!(atomic_load_explicit(&tb->middle, memory_order_relaxed) & TRIPLE_BUFFER_FRESH)) return false;
+    int prev = atomic_exchange_explicit(&tb->middle, tb->front, memory_order_acq_rel);
+    tb->front = prev & ~TRIPLE_BUFFER_FRESH;
+    return true;
+}
+
+// Reader: the slot currently being read.
+static inline int triple_buffer_front(const TripleBuffer *tb) {
+    return tb->front;
+}
+
+#endif // TRIPLE_BUFFER_H_